@@ -0,0 +1,278 @@
+#include "asset_pack.hpp"
+#include "lz4.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace toy2d {
+
+namespace {
+
+constexpr char kMagic[8] = { 'T', '2', 'D', 'P', 'A', 'C', 'K', '\0' };
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t entriesOffset;
+    uint64_t slotsOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+uint64_t AlignUp(uint64_t v, uint64_t alignment) {
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+bool InRange(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+}
+
+uint64_t AssetPack::Hash(std::string_view name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+AssetPack::AssetPack(const std::string& path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("asset pack: failed to open " + path);
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        throw std::runtime_error("asset pack: failed to map " + path);
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_base = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("asset pack: failed to open " + path);
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // 映射建立后不再需要文件描述符
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("asset pack: failed to map " + path);
+    }
+    m_base = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    // 构造函数抛出异常时析构函数不会执行, 校验失败要自己解除映射
+    auto fail = [&](const char* reason) {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_base);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(const_cast<uint8_t*>(m_base), m_size);
+#endif
+        throw std::runtime_error("asset pack " + path + ": " + reason);
+    };
+
+    Header header;
+    if (m_size < sizeof(header)) {
+        fail("file too small");
+    }
+    memcpy(&header, m_base, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        fail("bad magic");
+    }
+    if (header.version != Version) {
+        fail("unsupported version");
+    }
+    if (header.slotCount == 0 || (header.slotCount & (header.slotCount - 1)) != 0 ||
+        header.slotCount < header.entryCount ||
+        !InRange(header.entriesOffset, static_cast<uint64_t>(header.entryCount) * sizeof(Entry), m_size) ||
+        !InRange(header.slotsOffset, static_cast<uint64_t>(header.slotCount) * sizeof(uint32_t), m_size) ||
+        !InRange(header.namesOffset, header.namesSize, m_size) ||
+        header.entriesOffset % alignof(Entry) != 0 || header.slotsOffset % alignof(uint32_t) != 0) {
+        fail("corrupted table of contents");
+    }
+
+    m_entries = reinterpret_cast<const Entry*>(m_base + header.entriesOffset);
+    m_entryCount = header.entryCount;
+    m_slots = reinterpret_cast<const uint32_t*>(m_base + header.slotsOffset);
+    m_slotCount = header.slotCount;
+    m_names = reinterpret_cast<const char*>(m_base + header.namesOffset);
+    m_namesSize = header.namesSize;
+
+    // 打开时校验一次, 之后的查找与读取不再检查越界
+    for (const auto& entry : *this) {
+        if (!InRange(entry.offset, entry.size, m_size) || !InRange(entry.nameOffset, entry.nameLength, m_namesSize) ||
+            (!entry.IsCompressed() && entry.size != entry.rawSize)) {
+            fail("entry out of range");
+        }
+    }
+}
+
+AssetPack::~AssetPack() {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_base);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    munmap(const_cast<uint8_t*>(m_base), m_size);
+#endif
+}
+
+const AssetPack::Entry* AssetPack::Find(std::string_view name) const {
+    uint64_t hash = Hash(name);
+    uint32_t mask = m_slotCount - 1;
+    // 线性探测, 遇到空槽即不存在; 槽数至少是条目数的两倍, 探测链很短
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        uint32_t slot = m_slots[(hash + i) & mask];
+        if (slot == 0 || slot > m_entryCount) {
+            return nullptr;
+        }
+        const Entry& entry = m_entries[slot - 1];
+        if (entry.hash == hash && GetName(entry) == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view AssetPack::GetName(const Entry& entry) const {
+    return std::string_view(m_names + entry.nameOffset, entry.nameLength);
+}
+
+void AssetPack::Read(const Entry& entry, void* dst) const {
+    if (!entry.IsCompressed()) {
+        memcpy(dst, GetData(entry), entry.size);
+        return;
+    }
+    if (!Lz4Decompress(GetData(entry), entry.size, static_cast<uint8_t*>(dst), entry.rawSize)) {
+        throw std::runtime_error("asset pack: corrupted entry " + std::string(GetName(entry)));
+    }
+}
+
+void AssetPackWriter::Add(const std::string& name, std::vector<uint8_t> data, bool lz4) {
+    Item item{ name, std::move(data), 0, false };
+    item.rawSize = item.data.size();
+    if (lz4 && !item.data.empty()) {
+        auto compressed = Lz4Compress(item.data.data(), item.data.size());
+        if (compressed.size() < item.data.size()) {
+            item.data = std::move(compressed);
+            item.compressed = true;
+        }
+    }
+    m_items.push_back(std::move(item));
+}
+
+AssetPackWriter::Stats AssetPackWriter::GetStats() const {
+    Stats stats;
+    for (const auto& item : m_items) {
+        stats.rawBytes += item.rawSize;
+        stats.storedBytes += item.data.size();
+    }
+    return stats;
+}
+
+void AssetPackWriter::Write(const std::string& path) const {
+    uint32_t entryCount = static_cast<uint32_t>(m_items.size());
+    uint32_t slotCount = 1;
+    while (slotCount < entryCount * 2) {
+        slotCount <<= 1;
+    }
+
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = AssetPack::Version;
+    header.entryCount = entryCount;
+    header.slotCount = slotCount;
+    header.entriesOffset = AlignUp(sizeof(Header), AssetPack::BlobAlignment);
+    header.slotsOffset = AlignUp(header.entriesOffset + entryCount * sizeof(AssetPack::Entry), AssetPack::BlobAlignment);
+    header.namesOffset = AlignUp(header.slotsOffset + slotCount * sizeof(uint32_t), AssetPack::BlobAlignment);
+
+    std::vector<AssetPack::Entry> entries(entryCount);
+    std::vector<uint32_t> slots(slotCount, 0);
+    std::string names;
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const auto& item = m_items[i];
+        auto& entry = entries[i];
+        entry = {};
+        entry.hash = AssetPack::Hash(item.name);
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(item.name.size());
+        entry.size = item.data.size();
+        entry.rawSize = item.rawSize;
+        entry.flags = item.compressed ? AssetPack::FlagLz4 : 0;
+        names += item.name;
+
+        uint32_t slot = static_cast<uint32_t>(entry.hash & (slotCount - 1));
+        while (slots[slot] != 0) {
+            if (m_items[slots[slot] - 1].name == item.name) {
+                throw std::runtime_error("asset pack: duplicate entry " + item.name);
+            }
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    header.namesSize = names.size();
+
+    uint64_t offset = AlignUp(header.namesOffset + names.size(), AssetPack::BlobAlignment);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        entries[i].offset = offset;
+        offset = AlignUp(offset + entries[i].size, AssetPack::BlobAlignment);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    auto writeAt = [&](uint64_t position, const void* data, size_t size) {
+        // 对齐空隙补 0
+        static const char zeros[AssetPack::BlobAlignment] = {};
+        for (uint64_t current = static_cast<uint64_t>(file.tellp()); current < position;) {
+            uint64_t padding = std::min<uint64_t>(sizeof(zeros), position - current);
+            file.write(zeros, padding);
+            current += padding;
+        }
+        file.write(static_cast<const char*>(data), size);
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.entriesOffset, entries.data(), entries.size() * sizeof(AssetPack::Entry));
+    writeAt(header.slotsOffset, slots.data(), slots.size() * sizeof(uint32_t));
+    writeAt(header.namesOffset, names.data(), names.size());
+    for (uint32_t i = 0; i < entryCount; i++) {
+        writeAt(entries[i].offset, m_items[i].data.data(), m_items[i].data.size());
+    }
+    if (!file) {
+        throw std::runtime_error("asset pack: failed to write " + path);
+    }
+}
+
+}
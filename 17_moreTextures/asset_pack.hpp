@@ -0,0 +1,102 @@
+#ifndef __ASSET_PACK_H__
+#define __ASSET_PACK_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toy2d {
+
+/**
+ * @brief 资源包
+ * 文件布局: 文件头 | 条目表 | 哈希槽 | 名字字符串 | 数据 (每段按 BlobAlignment 对齐).
+ * 运行时整个文件只读映射进内存, 按名字的 FNV-1a 哈希在开放寻址的槽里查找, 期望 O(1);
+ * 未压缩的条目直接返回映射内的指针, 调用方可以把它原样拷进暂存 buffer 或交给 vkCreateShaderModule.
+ * 条目可以选择用 LZ4 (block 格式) 压缩, 这类条目需要 Read 解压到调用方的内存里
+ */
+class AssetPack final {
+public:
+    static constexpr uint32_t Version = 1;
+    // 数据段的对齐, 满足 SPIR-V 的 4 字节与块压缩纹理 16 字节的要求
+    static constexpr uint64_t BlobAlignment = 16;
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t offset;  // 相对文件开头
+        uint64_t size;    // 文件中的字节数
+        uint64_t rawSize; // 解压后的字节数, 未压缩时与 size 相同
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t flags;
+        uint32_t reserved;
+
+        bool IsCompressed() const { return flags & FlagLz4; }
+    };
+    static constexpr uint32_t FlagLz4 = 1;
+
+    // 文件不存在或格式不对时抛出 std::runtime_error
+    explicit AssetPack(const std::string& path);
+    ~AssetPack();
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    // 没有该名字时返回 nullptr
+    const Entry* Find(std::string_view name) const;
+    std::string_view GetName(const Entry& entry) const;
+    // 条目在映射中的数据, 压缩条目为压缩后的数据
+    const uint8_t* GetData(const Entry& entry) const { return m_base + entry.offset; }
+    // 解压或拷贝到 dst, dst 至少 rawSize 字节
+    void Read(const Entry& entry, void* dst) const;
+
+    const Entry* begin() const { return m_entries; }
+    const Entry* end() const { return m_entries + m_entryCount; }
+    size_t GetEntryCount() const { return m_entryCount; }
+
+    static uint64_t Hash(std::string_view name);
+
+private:
+    const uint8_t* m_base = nullptr;
+    size_t m_size = 0;
+    const Entry* m_entries = nullptr;
+    uint32_t m_entryCount = 0;
+    const uint32_t* m_slots = nullptr; // 条目下标 + 1, 0 为空槽
+    uint32_t m_slotCount = 0;          // 2 的幂
+    const char* m_names = nullptr;
+    uint64_t m_namesSize = 0;
+
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+/**
+ * @brief 资源包写入, 打包工具使用; 条目按添加顺序存放
+ */
+class AssetPackWriter final {
+public:
+    // lz4 为 true 时尝试压缩, 压缩后没有变小则仍然原样存放
+    void Add(const std::string& name, std::vector<uint8_t> data, bool lz4);
+    // 重名时抛出 std::runtime_error
+    void Write(const std::string& path) const;
+
+    struct Stats {
+        uint64_t rawBytes = 0;
+        uint64_t storedBytes = 0;
+    };
+    Stats GetStats() const;
+
+private:
+    struct Item {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint64_t rawSize;
+        bool compressed;
+    };
+    std::vector<Item> m_items;
+};
+
+}
+
+#endif // __ASSET_PACK_H__
@@ -0,0 +1,259 @@
+/**
+ * math_bench: 数学库微基准, 对比原来的标量实现与 math/simd.hpp 的向量化实现, 结果以 JSON 输出到 stdout
+ *
+ * 用法: math_bench [--count N] [--iterations N]
+ *
+ * 每一项都会先和标量参考结果逐元素比较, 误差超过阈值时返回非 0
+ */
+
+#include "math/math.hpp"
+#include "math/batch.hpp"
+#include "math/simd.hpp"
+#include "math/mipmap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 改动之前 Mat4::Mul 的三重循环 (累加器已改成 float, 否则结果不可比)
+toy2d::Mat4 LegacyMul(const toy2d::Mat4& a, const toy2d::Mat4& b) {
+    toy2d::Mat4 mat;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            float sum = 0;
+            for (int k = 0; k < 4; k++) {
+                sum += a.Get(k, i) * b.Get(j, k);
+            }
+            mat.Set(j, i, sum);
+        }
+    }
+    return mat;
+}
+
+// 逐字节的 2x2 box filter, 与 DownsampleRGBA8 的舍入一致 (偶数边长)
+void LegacyDownsample(const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst) {
+    for (uint32_t y = 0; y < h / 2; y++) {
+        for (uint32_t x = 0; x < w / 2; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = src[((2 * y) * w + 2 * x) * 4 + c] + src[((2 * y) * w + 2 * x + 1) * 4 + c] +
+                               src[((2 * y + 1) * w + 2 * x) * 4 + c] + src[((2 * y + 1) * w + 2 * x + 1) * 4 + c];
+                dst[(y * (w / 2) + x) * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+template <typename F>
+double MeasureNs(int iterations, size_t items, F&& func) {
+    // 先跑一遍预热缓存
+    func();
+    auto begin = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        func();
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    return ns / iterations / items;
+}
+
+struct Entry {
+    std::string name;
+    double legacyNs;
+    double simdNs;
+    float maxError;
+};
+
+float MaxError(const std::vector<float>& a, const std::vector<float>& b) {
+    float error = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        error = std::max(error, std::abs(a[i] - b[i]));
+    }
+    return error;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t count = 100000;
+    int iterations = 50;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--count") {
+            count = std::stoul(argv[i + 1]);
+        }
+        else if (arg == "--iterations") {
+            iterations = std::stoi(argv[i + 1]);
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(0, 1920);
+    std::uniform_real_distribution<float> extent(8, 64);
+    std::vector<toy2d::Rect> rects(count);
+    for (auto& rect : rects) {
+        rect.position.x = pos(rng);
+        rect.position.y = pos(rng);
+        rect.size.w = extent(rng);
+        rect.size.h = extent(rng);
+    }
+    auto projection = toy2d::Mat4::CreateOrtho(0, 1920, 1080, 0, 1, -1);
+
+    std::vector<Entry> entries;
+
+    // 1. Mat4 乘法
+    {
+        std::vector<toy2d::Mat4> mats(count);
+        for (size_t i = 0; i < count; i++) {
+            mats[i] = toy2d::Mat4::CreateTranslateScale(rects[i].position, rects[i].size);
+        }
+        std::vector<float> legacy(count * 16), simd(count * 16);
+        double legacyNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = LegacyMul(projection, mats[i]);
+                std::copy(m.GetData(), m.GetData() + 16, legacy.begin() + i * 16);
+            }
+        });
+        double simdNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = projection.Mul(mats[i]);
+                std::copy(m.GetData(), m.GetData() + 16, simd.begin() + i * 16);
+            }
+        });
+        entries.push_back({ "mat4_mul", legacyNs, simdNs, MaxError(legacy, simd) });
+    }
+
+    // 2. 每个精灵的模型矩阵: Translate * Scale 两次构造加一次乘法, 对比直接填值
+    {
+        std::vector<float> legacy(count * 16), direct(count * 16);
+        double legacyNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = LegacyMul(toy2d::Mat4::CreateTranslate(rects[i].position), toy2d::Mat4::CreateScale(rects[i].size));
+                std::copy(m.GetData(), m.GetData() + 16, legacy.begin() + i * 16);
+            }
+        });
+        double directNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = toy2d::Mat4::CreateTranslateScale(rects[i].position, rects[i].size);
+                std::copy(m.GetData(), m.GetData() + 16, direct.begin() + i * 16);
+            }
+        });
+        entries.push_back({ "sprite_model_matrix", legacyNs, directNs, MaxError(legacy, direct) });
+    }
+
+    std::vector<float> x(count), y(count), w(count), h(count);
+    toy2d::SplitRects(rects.data(), count, x.data(), y.data(), w.data(), h.data());
+    toy2d::RectSoA soa{ x.data(), y.data(), w.data(), h.data() };
+
+    // 3. 批量生成 2D 仿射实例数据, 对比逐个 projection * Translate * Scale 再取出 6 个分量
+    {
+        std::vector<float> legacy(count * 6), simd(count * 6);
+        double legacyNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = LegacyMul(projection,
+                    LegacyMul(toy2d::Mat4::CreateTranslate(rects[i].position), toy2d::Mat4::CreateScale(rects[i].size)));
+                legacy[i] = m.Get(0, 0);
+                legacy[count + i] = m.Get(0, 1);
+                legacy[count * 2 + i] = m.Get(1, 0);
+                legacy[count * 3 + i] = m.Get(1, 1);
+                legacy[count * 4 + i] = m.Get(3, 0);
+                legacy[count * 5 + i] = m.Get(3, 1);
+            }
+        });
+        toy2d::AffineSoA out{ simd.data(), simd.data() + count, simd.data() + count * 2,
+                              simd.data() + count * 3, simd.data() + count * 4, simd.data() + count * 5 };
+        double simdNs = MeasureNs(iterations, count, [&]() {
+            toy2d::BatchRectsToAffine(soa, count, projection, out);
+        });
+        entries.push_back({ "batch_affine", legacyNs, simdNs, MaxError(legacy, simd) });
+    }
+
+    // 4. 批量生成 4 个角点的最终坐标
+    {
+        static const toy2d::Vec corners[4] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+        std::vector<float> legacy(count * 8), simd(count * 8);
+        double legacyNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                auto m = LegacyMul(projection,
+                    LegacyMul(toy2d::Mat4::CreateTranslate(rects[i].position), toy2d::Mat4::CreateScale(rects[i].size)));
+                for (int k = 0; k < 4; k++) {
+                    auto p = m.TransformPoint(corners[k]);
+                    legacy[count * k + i] = p.x;
+                    legacy[count * (4 + k) + i] = p.y;
+                }
+            }
+        });
+        toy2d::QuadSoA out;
+        for (int k = 0; k < 4; k++) {
+            out.x[k] = simd.data() + count * k;
+            out.y[k] = simd.data() + count * (4 + k);
+        }
+        double simdNs = MeasureNs(iterations, count, [&]() {
+            toy2d::BatchRectsToQuads(soa, count, projection, out);
+        });
+        entries.push_back({ "batch_quads", legacyNs, simdNs, MaxError(legacy, simd) });
+    }
+
+    // 5. AoS -> SoA 拆分
+    {
+        std::vector<float> legacy(count * 4), simd(count * 4);
+        double legacyNs = MeasureNs(iterations, count, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                legacy[i] = rects[i].position.x;
+                legacy[count + i] = rects[i].position.y;
+                legacy[count * 2 + i] = rects[i].size.w;
+                legacy[count * 3 + i] = rects[i].size.h;
+            }
+        });
+        double simdNs = MeasureNs(iterations, count, [&]() {
+            toy2d::SplitRects(rects.data(), count, simd.data(), simd.data() + count,
+                              simd.data() + count * 2, simd.data() + count * 3);
+        });
+        entries.push_back({ "split_rects", legacyNs, simdNs, MaxError(legacy, simd) });
+    }
+
+    // 6. mip 生成的 CPU 回退: 1024x1024 RGBA8 缩小一层, 按输出像素计时
+    {
+        constexpr uint32_t Size = 1024;
+        std::vector<uint8_t> image(Size * Size * 4);
+        for (auto& v : image) {
+            v = static_cast<uint8_t>(rng());
+        }
+        size_t pixels = (Size / 2) * (Size / 2);
+        std::vector<uint8_t> legacy(pixels * 4), simd(pixels * 4);
+        double legacyNs = MeasureNs(iterations, pixels, [&]() {
+            LegacyDownsample(image.data(), Size, Size, legacy.data());
+        });
+        double simdNs = MeasureNs(iterations, pixels, [&]() {
+            toy2d::DownsampleRGBA8(image.data(), Size, Size, simd.data());
+        });
+        entries.push_back({ "mip_downsample_rgba8", legacyNs, simdNs,
+                            MaxError(std::vector<float>(legacy.begin(), legacy.end()),
+                                     std::vector<float>(simd.begin(), simd.end())) });
+    }
+
+    // 相对误差阈值, 像素坐标在千级, 裁剪空间坐标在 [-1, 1]
+    constexpr float Tolerance = 1e-3f;
+    bool ok = true;
+    std::cout << "{\n\"isa\":\"" << toy2d::simd::InstructionSet() << "\",\"width\":" << toy2d::simd::Width
+              << ",\"count\":" << count << ",\"iterations\":" << iterations << ",\n\"results\":[\n";
+    for (size_t i = 0; i < entries.size(); i++) {
+        const auto& e = entries[i];
+        ok = ok && e.maxError <= Tolerance;
+        std::cout << "{\"name\":\"" << e.name << "\",\"legacyNsPerItem\":" << e.legacyNs
+                  << ",\"simdNsPerItem\":" << e.simdNs << ",\"speedup\":" << e.legacyNs / e.simdNs
+                  << ",\"maxError\":" << e.maxError << "}" << (i + 1 < entries.size() ? "," : "") << "\n";
+    }
+    std::cout << "]\n}\n";
+
+    if (!ok) {
+        std::cerr << "simd results differ from the scalar reference!" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * texture_load_bench: 对比同步加载与异步并行加载一批图片的墙钟时间, 无窗口运行, 结果写成 JSON
+ *
+ * 用法: texture_load_bench [--count N] [--threads N] [--device NAME|cpu] [--images a.png,b.jpg]
+ *                           [--ktx2 a.ktx2,b.ktx2] [--out FILE]
+ *
+ *   serialMs   - 逐个 LoadTexture (调用线程解码) 直到全部上传完成
+ *   parallelMs - 全部 LoadTextureAsync 后不停地渲染空帧, 直到每张纹理都就绪
+ *   issueMs    - 发起全部异步加载本身的耗时, 即主线程被占用的时间
+ *   maxFrameMs - 异步加载期间最长的一帧, 衡量加载是否会卡住渲染
+ *   ktx2Ms     - 逐个 LoadTextureKtx2 直到全部上传完成, 与 serialMs 对比
+ *   pngBytes / ktx2Bytes - 两种方式所有纹理 image 占用的显存 (都带完整 mip 链)
+ *
+ * 图片默认轮流使用 resources 下的 role.png 与 texture.jpg, 同一个文件会被重复解码 count 次.
+ * 没有给 --ktx2 时把这些图片用一个简单的包围盒编码器压成 BC1 (含 mip 链) 写到临时文件,
+ * 只用于对比加载路径, 画质不代表正式的压缩工具
+ */
+
+#include "toy2d.h"
+#include "context.h"
+#include "math/mipmap.hpp"
+#include "third_party/stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct Options {
+    uint32_t count = 500;
+    uint32_t threads = 0;
+    int width = 640;
+    int height = 360;
+    std::string device;
+    std::vector<std::string> images;
+    std::vector<std::string> ktx2;
+    std::string out = "texture_load_bench.json";
+};
+
+using Clock = std::chrono::steady_clock;
+
+double Ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--count") {
+            options.count = std::stoul(next());
+        }
+        else if (arg == "--threads") {
+            options.threads = std::stoul(next());
+        }
+        else if (arg == "--device") {
+            options.device = next();
+        }
+        else if (arg == "--images") {
+            std::stringstream list(next());
+            std::string image;
+            while (std::getline(list, image, ',')) {
+                options.images.push_back(image);
+            }
+        }
+        else if (arg == "--ktx2") {
+            std::stringstream list(next());
+            std::string image;
+            while (std::getline(list, image, ',')) {
+                options.ktx2.push_back(image);
+            }
+        }
+        else if (arg == "--out") {
+            options.out = next();
+        }
+        else {
+            std::cerr << "usage: texture_load_bench [--count N] [--threads N] [--device NAME|cpu] "
+                         "[--images a.png,b.jpg] [--ktx2 a.ktx2,b.ktx2] [--out FILE]" << std::endl;
+            return false;
+        }
+    }
+    if (options.images.empty()) {
+        options.images = { S_PATH("resources/role.png"), S_PATH("resources/texture.jpg") };
+    }
+    return options.count > 0;
+}
+
+uint16_t To565(const uint8_t* rgb) {
+    return static_cast<uint16_t>(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+// 每个块取各通道的最小/最大值作为两个端点, 像素投影到端点连线上选下标
+void EncodeBC1Block(const uint8_t texels[16][4], uint8_t* out) {
+    uint8_t lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], texels[i][c]);
+            hi[c] = std::max(hi[c], texels[i][c]);
+        }
+    }
+    uint16_t c0 = To565(hi), c1 = To565(lo);
+    uint32_t indices = 0;
+    if (c0 > c1) {
+        // 下标 0/2/3/1 依次从 c0 走到 c1
+        static const uint32_t order[4] = { 0, 2, 3, 1 };
+        int axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+        int length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        for (int i = 0; i < 16; i++) {
+            int dot = 0;
+            for (int c = 0; c < 3; c++) {
+                dot += (hi[c] - texels[i][c]) * axis[c];
+            }
+            int step = length > 0 ? std::min(3, (dot * 3 + length / 2) / length) : 0;
+            indices |= order[step] << (2 * i);
+        }
+    }
+    else {
+        c0 = c1; // 两个端点量化后相同, 整块用 c0
+    }
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    memcpy(out + 4, &indices, 4);
+}
+
+std::vector<uint8_t> EncodeBC1(const uint8_t* rgba, uint32_t w, uint32_t h) {
+    uint32_t blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+    std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * 8);
+    uint8_t texels[16][4];
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx * 4 + i % 4, w - 1);
+                uint32_t y = std::min(by * 4 + i / 4, h - 1);
+                memcpy(texels[i], rgba + (static_cast<size_t>(y) * w + x) * 4, 4);
+            }
+            EncodeBC1Block(texels, blocks.data() + (static_cast<size_t>(by) * blocksX + bx) * 8);
+        }
+    }
+    return blocks;
+}
+
+template <typename T>
+void Append(std::vector<uint8_t>& out, T value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+// 把图片压成带完整 mip 链的 BC1 sRGB KTX2; 不写 DFD 与键值数据, 只保证本项目的加载器能读
+std::string WriteBC1Ktx2(const std::string& image, const std::string& path) {
+    int w, h, channel;
+    stbi_uc* pixels = stbi_load(image.c_str(), &w, &h, &channel, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error(image + ": " + stbi_failure_reason());
+    }
+    uint32_t levels = toy2d::MipLevelCount(w, h);
+    auto chain = toy2d::BuildMipChainRGBA8(pixels, w, h, levels);
+    stbi_image_free(pixels);
+
+    std::vector<std::vector<uint8_t>> encoded;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < levels; i++) {
+        uint32_t levelW = std::max(static_cast<uint32_t>(w) >> i, 1u);
+        uint32_t levelH = std::max(static_cast<uint32_t>(h) >> i, 1u);
+        encoded.push_back(EncodeBC1(chain.data() + offset, levelW, levelH));
+        offset += static_cast<size_t>(levelW) * levelH * 4;
+    }
+
+    static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> file(identifier, identifier + 12);
+    uint32_t fields[9] = { static_cast<uint32_t>(vk::Format::eBc1RgbSrgbBlock), 1, static_cast<uint32_t>(w),
+                           static_cast<uint32_t>(h), 0, 0, 1, levels, 0 };
+    for (uint32_t field : fields) {
+        Append(file, field);
+    }
+    for (int i = 0; i < 4; i++) {
+        Append(file, uint32_t(0)); // dfd/kvd
+    }
+    Append(file, uint64_t(0)); // sgd
+    Append(file, uint64_t(0));
+
+    // 数据按规范从最小的层开始存放, 每层 8 字节对齐
+    size_t dataBegin = file.size() + levels * 24;
+    std::vector<uint64_t> offsets(levels);
+    size_t cursor = dataBegin;
+    for (uint32_t i = levels; i-- > 0;) {
+        cursor = (cursor + 7) & ~size_t(7);
+        offsets[i] = cursor;
+        cursor += encoded[i].size();
+    }
+    for (uint32_t i = 0; i < levels; i++) {
+        Append(file, offsets[i]);
+        Append(file, uint64_t(encoded[i].size()));
+        Append(file, uint64_t(encoded[i].size()));
+    }
+    file.resize(cursor, 0);
+    for (uint32_t i = 0; i < levels; i++) {
+        memcpy(file.data() + offsets[i], encoded[i].data(), encoded[i].size());
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    if (!out) {
+        throw std::runtime_error("write " + path + " failed");
+    }
+    return path;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        if (!ParseOptions(argc, argv, options)) {
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!options.device.empty()) {
+        toy2d::SetPreferredDevice(options.device);
+    }
+    if (options.ktx2.empty()) {
+        auto dir = std::filesystem::temp_directory_path();
+        for (size_t i = 0; i < options.images.size(); i++) {
+            auto path = (dir / ("texture_load_bench_" + std::to_string(i) + ".ktx2")).string();
+            options.ktx2.push_back(WriteBC1Ktx2(options.images[i], path));
+        }
+    }
+
+    toy2d::InitHeadless(options.width, options.height);
+    auto& ctx = toy2d::Context::GetInstance();
+    auto& renderer = toy2d::GetRenderer();
+    auto& manager = toy2d::TextureManager::Instance();
+    manager.SetDecodeThreadCount(options.threads);
+    // 先把线程池建好, 不计入加载时间
+    uint32_t decodeThreads = manager.GetDecodeThreadCount();
+
+    // 1. 同步: 解码与拷贝都在调用线程上, 最后等上传完成
+    vk::DeviceSize pngBytes = 0;
+    auto serialBegin = Clock::now();
+    for (uint32_t i = 0; i < options.count; i++) {
+        pngBytes += toy2d::LoadTexture(options.images[i % options.images.size()])->GetMemorySize();
+    }
+    ctx.m_uploadManager->Flush();
+    ctx.GetDevice().waitIdle();
+    double serialMs = Ms(serialBegin, Clock::now());
+    manager.Clear();
+
+    // 1.5 同步加载 KTX2: 没有解码, 压缩数据直接拷进暂存 buffer
+    vk::DeviceSize ktx2Bytes = 0;
+    std::string ktx2Format;
+    auto ktx2Begin = Clock::now();
+    for (uint32_t i = 0; i < options.count; i++) {
+        auto* texture = toy2d::LoadTextureKtx2(options.ktx2[i % options.ktx2.size()]);
+        ktx2Bytes += texture->GetMemorySize();
+        ktx2Format = vk::to_string(texture->GetFormat()); // 设备不支持时为解码后的 RGBA8
+    }
+    ctx.m_uploadManager->Flush();
+    ctx.GetDevice().waitIdle();
+    double ktx2Ms = Ms(ktx2Begin, Clock::now());
+    manager.Clear();
+
+    // 2. 异步: 解码在线程池中, 主线程一边渲染一边把解码好的纹理提交上传
+    std::vector<toy2d::Texture*> textures;
+    auto parallelBegin = Clock::now();
+    for (uint32_t i = 0; i < options.count; i++) {
+        textures.push_back(toy2d::LoadTextureAsync(options.images[i % options.images.size()]));
+    }
+    double issueMs = Ms(parallelBegin, Clock::now());
+
+    uint32_t frames = 0;
+    uint32_t failed = 0;
+    double maxFrameMs = 0;
+    while (true) {
+        auto frameBegin = Clock::now();
+        renderer.StartRender();
+        renderer.EndRender();
+        maxFrameMs = std::max(maxFrameMs, Ms(frameBegin, Clock::now()));
+        frames++;
+
+        failed = 0;
+        bool done = manager.GetPendingCount() == 0;
+        for (auto* texture : textures) {
+            if (texture->IsFailed()) {
+                failed++;
+            }
+            else if (!texture->IsReady()) {
+                done = false;
+            }
+        }
+        if (done) {
+            break;
+        }
+    }
+    double parallelMs = Ms(parallelBegin, Clock::now());
+    renderer.WaitReadbacks();
+    // 每张纹理一个 set, 池按容量翻倍增长, 池数应为 log 级别
+    auto descriptors = toy2d::GetDescriptorStats();
+
+    std::ofstream file(options.out, std::ios::trunc);
+    file << "{\n\"device\":\"" << ctx.GetPhyDevice().getProperties().deviceName.data() << "\",\n"
+         << "\"count\":" << options.count << ",\"decodeThreads\":" << decodeThreads << ",\"failed\":" << failed << ",\n"
+         << "\"serialMs\":" << serialMs << ",\"parallelMs\":" << parallelMs << ",\"speedup\":" << serialMs / parallelMs << ",\n"
+         << "\"issueMs\":" << issueMs << ",\"frames\":" << frames << ",\"maxFrameMs\":" << maxFrameMs << ",\n"
+         << "\"ktx2Ms\":" << ktx2Ms << ",\"ktx2Format\":\"" << ktx2Format << "\",\"pngBytes\":" << pngBytes
+         << ",\"ktx2Bytes\":" << ktx2Bytes << ",\n"
+         << "\"imageSets\":" << descriptors.imageSets << ",\"imagePools\":" << descriptors.imagePools << "\n}\n";
+    if (!file) {
+        std::cerr << "write " << options.out << " failed" << std::endl;
+    }
+    else {
+        std::cout << "results written to " << options.out << std::endl;
+    }
+
+    toy2d::Quit();
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,426 @@
+/**
+ * toy2d_bench: 无窗口跑固定场景, 输出 JSON, 用来客观比较不同构建的性能
+ *
+ * 用法: toy2d_bench [--frames N] [--warmup N] [--device NAME|cpu] [--mode batch|bindless|parallel|cull]
+ *                   [--post-blur N] [--filter SUBSTR] [--width W] [--height H] [--out FILE]
+ *
+ * 结果写到 --out 指定的文件 (默认 toy2d_bench.json), 渲染器自己的日志仍然输出到 stdout.
+ *
+ * 没有 GPU 的机器上用 --device cpu (或环境变量 TOY2D_DEVICE=cpu) 选中 lavapipe/SwiftShader 等软件实现.
+ * 每个场景先跑 warmup 帧, 再统计 frames 帧:
+ *   frameMs  - StartRender 到 EndRender 返回的墙钟时间 (包含等待 fence, 即实际吞吐)
+ *   drawMs   - 调用 DrawTexture 的 CPU 时间
+ *   recordMs - EndRender 中录制精灵命令的 CPU 时间
+ *   submitMs - queue submit 的 CPU 时间
+ *   waitMs   - StartRender 中等待之前的帧完成的 CPU 时间, 随 --frames-in-flight 变化
+ *   gpuMs    - 帧 command buffer 的 GPU 时间 (timestamp 查询, 设备不支持时缺省)
+ *   loadMs   - 纹理加载风暴场景中每帧加载纹理的 CPU 时间
+ * barriers 为最后一帧 render graph 录制的 pipelineBarrier 次数; --post-blur 开启 N 轮离屏模糊,
+ * 另外输出临时图像别名后实际占用的 transientBytes 与不别名时需要的 unaliasedBytes;
+ * cull 模式下另外输出最后一帧读回的 visibleSprites, spread 场景把精灵撒在视口的 4x4 倍范围内
+ * zoomed_out 场景把投影放大 4 倍 (精灵缩小到 1/4), 用 256x256 纹理对比有无 mip 链的 gpuMs
+ */
+
+#include "toy2d.h"
+#include "context.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+
+struct Options {
+    int frames = 200;
+    int warmup = 20;
+    int width = 1280;
+    int height = 720;
+    int framesInFlight = 2;
+    uint32_t postBlur = 0;
+    std::string device;
+    std::string mode = "batch";
+    std::string filter;
+    std::string out = "toy2d_bench.json";
+};
+
+struct Scenario {
+    std::string name;
+    uint32_t sprites;
+    uint32_t textures;
+    bool moving;
+    uint32_t loadsPerFrame; // 每帧新加载的纹理数, 0 表示不加载
+    bool parallel;          // 强制并行录制, 用于线程扩展性测试
+    uint32_t threads;       // 并行录制线程数, 0 表示 hardware_concurrency
+    float spread = 1;       // 精灵分布范围相对视口的倍数, 大于 1 时多出的部分落在视口外
+    float zoom = 1;         // 投影覆盖的世界范围相对视口的倍数, 大于 1 时所有精灵都缩小绘制
+    bool mips = true;       // 纹理是否生成 mip 链
+};
+
+struct Summary {
+    double mean = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+    size_t count = 0;
+};
+
+Summary Summarize(std::vector<double> samples) {
+    Summary summary;
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    // nearest-rank 百分位
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+        return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+    double sum = 0;
+    for (double v : samples) {
+        sum += v;
+    }
+    summary.mean = sum / samples.size();
+    summary.p50 = percentile(50);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    summary.max = samples.back();
+    return summary;
+}
+
+struct Result {
+    Scenario scenario;
+    uint32_t threads;
+    uint32_t drawCalls;
+    uint32_t recordTasks;
+    uint32_t barriers;
+    uint64_t transientBytes;
+    uint64_t unaliasedBytes;
+    int64_t visibleSprites;
+    Summary frameMs;
+    Summary drawMs;
+    Summary recordMs;
+    Summary submitMs;
+    Summary waitMs;
+    Summary gpuMs;
+    Summary loadMs;
+};
+
+// 每张纹理一个不同颜色的棋盘格, 避免驱动对相同内容做任何优化
+std::vector<uint8_t> MakePixels(uint32_t index, uint32_t size) {
+    std::vector<uint8_t> pixels(size * size * 4);
+    uint8_t r = static_cast<uint8_t>(64 + (index * 37) % 192);
+    uint8_t g = static_cast<uint8_t>(64 + (index * 73) % 192);
+    uint8_t b = static_cast<uint8_t>(64 + (index * 151) % 192);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            uint8_t* p = &pixels[(y * size + x) * 4];
+            bool dark = ((x / 8) + (y / 8)) % 2 == 0;
+            p[0] = dark ? r / 2 : r;
+            p[1] = dark ? g / 2 : g;
+            p[2] = dark ? b / 2 : b;
+            p[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+std::vector<Scenario> MakeScenarios() {
+    std::vector<Scenario> scenarios;
+    const std::pair<const char*, uint32_t> counts[] = { {"1k", 1000}, {"10k", 10000}, {"100k", 100000}, {"1m", 1000000} };
+    for (auto& count : counts) {
+        for (bool moving : { false, true }) {
+            scenarios.push_back({ std::string("sprites_") + count.first + (moving ? "_moving" : "_static"),
+                                  count.second, 1, moving, 0, false, 0 });
+        }
+    }
+    for (uint32_t textures : { 1u, 16u, 256u }) {
+        scenarios.push_back({ "textures_" + std::to_string(textures), 10000, textures, false, 0, false, 0 });
+    }
+    scenarios.push_back({ "load_storm", 10000, 16, true, 4, false, 0 });
+    scenarios.push_back({ "spread_100k", 100000, 16, true, 0, false, 0, 4 });
+    scenarios.push_back({ "zoomed_out_10k", 10000, 16, false, 0, false, 0, 4, 4, true });
+    scenarios.push_back({ "zoomed_out_10k_nomips", 10000, 16, false, 0, false, 0, 4, 4, false });
+
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t threads = 1; threads < hardware * 2; threads *= 2) {
+        uint32_t n = std::min(threads, hardware);
+        scenarios.push_back({ "thread_scaling_" + std::to_string(n), 100000, 16, true, 0, true, n });
+        if (n == hardware) {
+            break;
+        }
+    }
+    return scenarios;
+}
+
+Result RunScenario(const Scenario& scenario, const Options& options) {
+    auto& renderer = toy2d::GetRenderer();
+    renderer.SetBatchMode(true);
+    renderer.SetBindlessMode(options.mode == "bindless");
+    bool parallel = scenario.parallel || options.mode == "parallel";
+    renderer.SetParallelMode(parallel);
+    renderer.SetCullMode(options.mode == "cull" && !scenario.parallel);
+    renderer.SetPostBlur(options.postBlur);
+    if (parallel) {
+        renderer.SetRecordThreadCount(scenario.threads);
+    }
+
+    // 缩小场景用大纹理, 才能体现 mip 对纹理缓存的影响
+    const uint32_t TextureSize = scenario.zoom > 1 ? 256 : 64;
+    toy2d::TextureManager::Instance().SetGenerateMips(scenario.mips);
+    renderer.SetProject(static_cast<int>(options.width * scenario.zoom), 0, 0,
+                        static_cast<int>(options.height * scenario.zoom), -1, 1);
+    std::vector<toy2d::Texture*> textures;
+    for (uint32_t i = 0; i < scenario.textures; i++) {
+        auto pixels = MakePixels(i, TextureSize);
+        textures.push_back(toy2d::LoadTextureFromMemory(pixels.data(), TextureSize, TextureSize));
+    }
+    // 加载风暴中的纹理内容提前生成, 只测上传路径
+    auto stormPixels = MakePixels(scenario.textures, TextureSize);
+
+    std::mt19937 rng(1234);
+    const float w = options.width * scenario.spread;
+    const float h = options.height * scenario.spread;
+    std::uniform_real_distribution<float> posX(0, w);
+    std::uniform_real_distribution<float> posY(0, h);
+    std::uniform_real_distribution<float> speed(-4, 4);
+    std::uniform_real_distribution<float> extent(8, 48);
+    std::vector<toy2d::Rect> rects(scenario.sprites);
+    std::vector<toy2d::Vec> velocities(scenario.sprites);
+    for (uint32_t i = 0; i < scenario.sprites; i++) {
+        float size = extent(rng);
+        rects[i] = toy2d::Rect{ toy2d::Vec{ posX(rng), posY(rng) }, toy2d::Size{ size, size } };
+        velocities[i] = toy2d::Vec{ speed(rng), speed(rng) };
+    }
+
+    std::vector<double> frameMs, drawMs, recordMs, submitMs, waitMs, gpuMs, loadMs;
+    Result result{};
+    result.scenario = scenario;
+    result.threads = parallel ? renderer.GetRecordThreadCount() : 1;
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+        bool measured = frame >= options.warmup;
+        auto frameBegin = Clock::now();
+        renderer.StartRender();
+
+        if (scenario.loadsPerFrame > 0) {
+            auto loadBegin = Clock::now();
+            for (uint32_t i = 0; i < scenario.loadsPerFrame; i++) {
+                textures.push_back(toy2d::LoadTextureFromMemory(stormPixels.data(), TextureSize, TextureSize));
+            }
+            if (measured) {
+                loadMs.push_back(ms(loadBegin, Clock::now()));
+            }
+        }
+
+        auto drawBegin = Clock::now();
+        for (uint32_t i = 0; i < scenario.sprites; i++) {
+            auto& rect = rects[i];
+            if (scenario.moving) {
+                auto& v = velocities[i];
+                rect.position.x += v.x;
+                rect.position.y += v.y;
+                if (rect.position.x < 0 || rect.position.x > w) {
+                    v.x = -v.x;
+                }
+                if (rect.position.y < 0 || rect.position.y > h) {
+                    v.y = -v.y;
+                }
+            }
+            // 加载风暴中新纹理的上传还没完成时 DrawTexture 会直接跳过, 这正是要观察的行为
+            renderer.DrawTexture(rect, *textures[i % textures.size()]);
+        }
+        auto drawEnd = Clock::now();
+
+        renderer.EndRender();
+        auto frameEnd = Clock::now();
+
+        if (measured) {
+            const auto& stats = renderer.GetStats();
+            frameMs.push_back(ms(frameBegin, frameEnd));
+            drawMs.push_back(ms(drawBegin, drawEnd));
+            recordMs.push_back(stats.recordMs);
+            submitMs.push_back(stats.submitMs);
+            waitMs.push_back(stats.waitMs);
+            if (stats.gpuMs >= 0) {
+                gpuMs.push_back(stats.gpuMs);
+            }
+            result.drawCalls = stats.drawCalls;
+            result.recordTasks = stats.recordTasks;
+            result.barriers = stats.barriers;
+            result.transientBytes = stats.transientBytes;
+            result.unaliasedBytes = stats.unaliasedBytes;
+            result.visibleSprites = stats.spritesVisible;
+        }
+    }
+
+    // 等所有帧结束并释放本场景的纹理, 场景之间互不影响
+    renderer.WaitReadbacks();
+    toy2d::TextureManager::Instance().Clear();
+    toy2d::TextureManager::Instance().SetGenerateMips(true);
+
+    result.frameMs = Summarize(frameMs);
+    result.drawMs = Summarize(drawMs);
+    result.recordMs = Summarize(recordMs);
+    result.submitMs = Summarize(submitMs);
+    result.waitMs = Summarize(waitMs);
+    result.gpuMs = Summarize(gpuMs);
+    result.loadMs = Summarize(loadMs);
+    return result;
+}
+
+void WriteSummary(std::ostream& os, const char* name, const Summary& summary) {
+    os << "\"" << name << "\":{\"mean\":" << summary.mean << ",\"p50\":" << summary.p50
+       << ",\"p95\":" << summary.p95 << ",\"p99\":" << summary.p99 << ",\"max\":" << summary.max
+       << ",\"count\":" << summary.count << "}";
+}
+
+void WriteJson(std::ostream& os, const Options& options, const std::vector<Result>& results) {
+    auto properties = toy2d::Context::GetInstance().GetPhyDevice().getProperties();
+    os << "{\n\"device\":\"" << properties.deviceName.data() << "\",\n"
+       << "\"deviceType\":\"" << vk::to_string(properties.deviceType) << "\",\n"
+       << "\"mode\":\"" << options.mode << "\",\n"
+       << "\"width\":" << options.width << ",\"height\":" << options.height << ",\n"
+       << "\"frames\":" << options.frames << ",\"warmup\":" << options.warmup << ",\n"
+       << "\"framesInFlight\":" << options.framesInFlight << ",\"postBlur\":" << options.postBlur << ",\n"
+       << "\"scenarios\":[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        os << "{\"name\":\"" << r.scenario.name << "\",\"sprites\":" << r.scenario.sprites
+           << ",\"textures\":" << r.scenario.textures << ",\"moving\":" << (r.scenario.moving ? "true" : "false")
+           << ",\"loadsPerFrame\":" << r.scenario.loadsPerFrame << ",\"threads\":" << r.threads
+           << ",\"drawCalls\":" << r.drawCalls << ",\"recordTasks\":" << r.recordTasks
+           << ",\"barriers\":" << r.barriers;
+        if (options.postBlur > 0) {
+            os << ",\"transientBytes\":" << r.transientBytes << ",\"unaliasedBytes\":" << r.unaliasedBytes;
+        }
+        if (r.visibleSprites >= 0) {
+            os << ",\"visibleSprites\":" << r.visibleSprites;
+        }
+        os << ",\n ";
+        WriteSummary(os, "frameMs", r.frameMs);
+        os << ",\n ";
+        WriteSummary(os, "drawMs", r.drawMs);
+        os << ",\n ";
+        WriteSummary(os, "recordMs", r.recordMs);
+        os << ",\n ";
+        WriteSummary(os, "submitMs", r.submitMs);
+        os << ",\n ";
+        WriteSummary(os, "waitMs", r.waitMs);
+        os << ",\n ";
+        WriteSummary(os, "gpuMs", r.gpuMs);
+        os << ",\n ";
+        WriteSummary(os, "loadMs", r.loadMs);
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]\n}\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--frames") {
+            options.frames = std::stoi(next());
+        }
+        else if (arg == "--warmup") {
+            options.warmup = std::stoi(next());
+        }
+        else if (arg == "--width") {
+            options.width = std::stoi(next());
+        }
+        else if (arg == "--height") {
+            options.height = std::stoi(next());
+        }
+        else if (arg == "--device") {
+            options.device = next();
+        }
+        else if (arg == "--mode") {
+            options.mode = next();
+            if (options.mode != "batch" && options.mode != "bindless" && options.mode != "parallel" &&
+                options.mode != "cull") {
+                throw std::runtime_error("unknown mode " + options.mode);
+            }
+        }
+        else if (arg == "--frames-in-flight") {
+            options.framesInFlight = std::stoi(next());
+            if (options.framesInFlight < 1 || options.framesInFlight > toy2d::FrameScheduler::MaxFramesInFlight) {
+                throw std::runtime_error("frames in flight must be in [1, 4]");
+            }
+        }
+        else if (arg == "--post-blur") {
+            options.postBlur = static_cast<uint32_t>(std::stoul(next()));
+        }
+        else if (arg == "--filter") {
+            options.filter = next();
+        }
+        else if (arg == "--out") {
+            options.out = next();
+        }
+        else {
+            std::cerr << "usage: toy2d_bench [--frames N] [--warmup N] [--device NAME|cpu] "
+                         "[--mode batch|bindless|parallel|cull] [--frames-in-flight 1-4] [--post-blur N] [--filter SUBSTR] [--width W] [--height H] [--out FILE]"
+                      << std::endl;
+            return false;
+        }
+    }
+    return options.frames > 0 && options.warmup >= 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        if (!ParseOptions(argc, argv, options)) {
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!options.device.empty()) {
+        toy2d::SetPreferredDevice(options.device);
+    }
+    toy2d::InitHeadless(options.width, options.height, options.framesInFlight);
+    toy2d::GetRenderer().SetDrawColor(toy2d::Color{ 1, 1, 1 });
+
+    std::vector<Result> results;
+    for (const auto& scenario : MakeScenarios()) {
+        if (!options.filter.empty() && scenario.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        std::cout << "running " << scenario.name << "..." << std::endl;
+        results.push_back(RunScenario(scenario, options));
+    }
+
+    std::ofstream file(options.out, std::ios::trunc);
+    WriteJson(file, options, results);
+    if (!file) {
+        std::cerr << "write " << options.out << " failed" << std::endl;
+    }
+    else {
+        std::cout << "results written to " << options.out << std::endl;
+    }
+
+    toy2d::Quit();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "bindless_table.hpp"
+#include "context.h"
+
+namespace toy2d {
+
+BindlessTextureTable::BindlessTextureTable() : m_next(0) {
+    // update-after-bind 的数组大小受单独的限制约束
+    auto properties = Context::GetInstance().GetPhyDevice()
+        .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    auto& props12 = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    m_capacity = std::min({ MaxTextures,
+        props12.maxDescriptorSetUpdateAfterBindSampledImages,
+        props12.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+    createLayout();
+    createPool();
+    allocSet();
+}
+
+BindlessTextureTable::~BindlessTextureTable() {
+    auto& device = Context::GetInstance().GetDevice();
+    device.destroyDescriptorPool(m_pool);
+    device.destroyDescriptorSetLayout(m_layout);
+}
+
+void BindlessTextureTable::createLayout() {
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0)
+        .setDescriptorCount(m_capacity)
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+        .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+    // partially bound: 没有写入的下标允许保持无效; update after bind: 绑定后仍可写入新纹理
+    vk::DescriptorBindingFlags flags = vk::DescriptorBindingFlagBits::ePartiallyBound |
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo;
+    flagsInfo.setBindingFlags(flags);
+
+    vk::DescriptorSetLayoutCreateInfo createInfo;
+    createInfo.setBindings(binding)
+        .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+        .setPNext(&flagsInfo);
+    m_layout = Context::GetInstance().GetDevice().createDescriptorSetLayout(createInfo);
+}
+
+void BindlessTextureTable::createPool() {
+    vk::DescriptorPoolSize size;
+    size.setType(vk::DescriptorType::eCombinedImageSampler)
+        .setDescriptorCount(m_capacity);
+
+    vk::DescriptorPoolCreateInfo createInfo;
+    createInfo.setMaxSets(1)
+        .setPoolSizes(size)
+        .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+    m_pool = Context::GetInstance().GetDevice().createDescriptorPool(createInfo);
+}
+
+void BindlessTextureTable::allocSet() {
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.setDescriptorPool(m_pool)
+        .setDescriptorSetCount(1)
+        .setSetLayouts(m_layout);
+    m_set = Context::GetInstance().GetDevice().allocateDescriptorSets(allocInfo)[0];
+}
+
+uint32_t BindlessTextureTable::Register(vk::ImageView view, vk::Sampler sampler) {
+    uint32_t index;
+    if (!m_freeIndices.empty()) {
+        index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else {
+        if (m_next >= m_capacity) {
+            return InvalidIndex; // 表满了, 纹理仍可以用自己的 set 绘制
+        }
+        index = m_next++;
+    }
+
+    update(index, view, sampler);
+    return index;
+}
+
+void BindlessTextureTable::update(uint32_t index, vk::ImageView view, vk::Sampler sampler) {
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setImageView(view)
+        .setSampler(sampler);
+    vk::WriteDescriptorSet writer;
+    writer.setImageInfo(imageInfo)
+        .setDstBinding(0)
+        .setDstArrayElement(index)
+        .setDstSet(m_set)
+        .setDescriptorCount(1)
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    Context::GetInstance().GetDevice().updateDescriptorSets(writer, {});
+}
+
+void BindlessTextureTable::Unregister(uint32_t index) {
+    // 调用方保证引用该下标的帧都已经结束
+    if (index != InvalidIndex) {
+        m_freeIndices.push_back(index);
+    }
+}
+
+}
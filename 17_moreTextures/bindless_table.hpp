@@ -0,0 +1,49 @@
+#ifndef __BINDLESS_TABLE_H__
+#define __BINDLESS_TABLE_H__
+
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 全局纹理表 (descriptor indexing)
+ * 一个 set 里放一个大的 combined image sampler 数组, 每个纹理占一个下标,
+ * 片元着色器按实例给出的下标取纹理, 换纹理不再需要重新绑定 set
+ */
+class BindlessTextureTable final
+{
+public:
+    static constexpr uint32_t MaxTextures = 4096;
+
+    BindlessTextureTable();
+    ~BindlessTextureTable();
+
+    // 表满时返回 InvalidIndex
+    uint32_t Register(vk::ImageView view, vk::Sampler sampler);
+    void Unregister(uint32_t index);
+
+    vk::DescriptorSetLayout GetLayout() const { return m_layout; }
+    vk::DescriptorSet GetSet() const { return m_set; }
+    uint32_t GetCapacity() const { return m_capacity; }
+
+    static constexpr uint32_t InvalidIndex = ~0u;
+
+private:
+    vk::DescriptorSetLayout m_layout;
+    vk::DescriptorPool m_pool;
+    vk::DescriptorSet m_set;
+
+    uint32_t m_capacity;
+    uint32_t m_next;
+    std::vector<uint32_t> m_freeIndices;
+
+    void createLayout();
+    void createPool();
+    void allocSet();
+    void update(uint32_t index, vk::ImageView view, vk::Sampler sampler);
+};
+
+}
+
+#endif // __BINDLESS_TABLE_H__
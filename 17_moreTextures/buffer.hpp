@@ -2,29 +2,25 @@
 #define __BUFFER_H__
 
 #include "vulkan/vulkan.hpp"
+#include "memory_allocator.hpp"
 
 namespace toy2d {
 class Buffer final
 {
 public:
     Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property);
+    // 句柄与内存交给删除队列, 不需要调用方等待 GPU
     ~Buffer();
 
     vk::Buffer m_buffer;
-    vk::DeviceMemory m_memory;
+    vk::DeviceMemory m_memory; // 所在的内存块, 与其他资源共享, buffer 从 m_allocation.offset 开始
     size_t m_size;
     void* m_map;
 
-private:
-    struct MemoryInfo final {
-        size_t size;
-        uint32_t index;
-    };
+    MemoryAllocator::Allocation m_allocation;
 
+private:
     void createBuffer(size_t size, vk::BufferUsageFlags usage);
-    void allocateMemory(const MemoryInfo& memInfo);
-    void bindingMem2Buf();
-    MemoryInfo queryMemoryInfo(vk::MemoryPropertyFlags property);
 
 public:
     static std::uint32_t QueryBufferMemTypeIndex(std::uint32_t type, vk::MemoryPropertyFlags flag);
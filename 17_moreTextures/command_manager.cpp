@@ -3,8 +3,12 @@
 
 namespace toy2d {
 
-CommandManager::CommandManager() {
-    m_pool = createCommandPool();
+CommandManager::CommandManager()
+    : CommandManager(Context::GetInstance().GetQueueFamilyIndices().grapghicsQueue.value()) {
+}
+
+CommandManager::CommandManager(uint32_t queueFamily) {
+    m_pool = createCommandPool(queueFamily);
 }
 
 CommandManager::~CommandManager() {
@@ -16,22 +20,22 @@ void CommandManager::ResetCmds() {
     Context::GetInstance().GetDevice().resetCommandPool(m_pool);
 }
 
-vk::CommandPool CommandManager::createCommandPool() {
+vk::CommandPool CommandManager::createCommandPool(uint32_t queueFamily) {
     auto& ctx = Context::GetInstance();
 
     vk::CommandPoolCreateInfo createInfo;
 
-    createInfo.setQueueFamilyIndex(ctx.GetQueueFamilyIndices().grapghicsQueue.value())
+    createInfo.setQueueFamilyIndex(queueFamily)
               .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
 
     return ctx.GetDevice().createCommandPool(createInfo);
 }
 
-std::vector<vk::CommandBuffer> CommandManager::CreateCommandBuffers(std::uint32_t count) {
+std::vector<vk::CommandBuffer> CommandManager::CreateCommandBuffers(std::uint32_t count, vk::CommandBufferLevel level) {
     vk::CommandBufferAllocateInfo allocInfo;
     allocInfo.setCommandPool(m_pool)
-             .setCommandBufferCount(1)
-             .setLevel(vk::CommandBufferLevel::ePrimary);
+             .setCommandBufferCount(count)
+             .setLevel(level);
 
     return Context::GetInstance().GetDevice().allocateCommandBuffers(allocInfo);
 }
@@ -57,8 +61,7 @@ void CommandManager::ExecuteCmd(vk::Queue queue, RecordCmdFunc func) {
     vk::SubmitInfo submitInfo;
     submitInfo.setCommandBuffers(cmdBuf);
     queue.submit(submitInfo);
-    queue.waitIdle();
-    Context::GetInstance().GetDevice().waitIdle();
+    queue.waitIdle(); // 只等这个队列, 不再让整个设备空闲
     FreeCmd(cmdBuf);
 }
 
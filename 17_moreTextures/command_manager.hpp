@@ -8,10 +8,13 @@ namespace toy2d {
 class CommandManager final {
 public:
     CommandManager();
+    // 指定队列族, 例如上传使用的传输队列族
+    CommandManager(uint32_t queueFamily);
     ~CommandManager();
 
     vk::CommandBuffer CreateOneCommandBuffer();
-    std::vector<vk::CommandBuffer> CreateCommandBuffers(std::uint32_t count);
+    std::vector<vk::CommandBuffer> CreateCommandBuffers(std::uint32_t count,
+        vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
     void ResetCmds();
     void FreeCmd(vk::CommandBuffer);
 
@@ -21,7 +24,7 @@ public:
 private:
     vk::CommandPool m_pool;
 
-    vk::CommandPool createCommandPool();
+    vk::CommandPool createCommandPool(uint32_t queueFamily);
 };
 
 }
@@ -1,5 +1,11 @@
 ﻿#include "context.h"
 #include <mutex>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include "profiler.hpp"
 #include <iostream>
 
 namespace toy2d
@@ -7,6 +13,13 @@ namespace toy2d
     Context* Context::m_instance = nullptr;
 
     static std::once_flag g_flag;
+    static std::string g_preferredDevice;
+
+    void Context::SetPreferredDevice(const std::string& name)
+    {
+        g_preferredDevice = name;
+    }
+
     Context& Context::GetInstance()
     {
         return *m_instance;
@@ -14,28 +27,52 @@ namespace toy2d
 
     Context::Context(const std::vector<const char*>& extensions, CreateSurfaceFunc func)
     {
+        TOY2D_PROFILE_SCOPE("Context::Context");
         createVulkanInstance(extensions);
         pickupPhysicalDevice();
 
+        // 没有传入创建 surface 的函数时为无窗口模式, 不创建 surface 与交换链
         m_surface = nullptr;
-        m_surface = func(m_vkInstance); // C 与 C++ 接口可以互相转换，所以可以
-        if (m_surface == nullptr)
+        if (func)
         {
-            // TODO...
+            m_surface = func(m_vkInstance); // C 与 C++ 接口可以互相转换，所以可以
+            if (m_surface == nullptr)
+            {
+                throw std::runtime_error("create surface failed!");
+            }
         }
 
         queryQueueFamilyIndices();
         createDevice();
         getQueues();
+        m_layoutCache = std::make_unique<DescriptorLayoutCache>();
     }
 
     Context::~Context()
     {
+        // 后台还可能在编译管线, 先等它们结束再销毁着色器模块
+        m_renderProcess.reset();
+        m_postShader.reset();
+        m_cullShader.reset();
+        m_bindlessShader.reset();
+        m_spriteShader.reset();
         m_shader.reset();
+        m_uploadManager.reset();
         m_commandManager.reset();
-        m_renderProcess.reset();
+        if (m_pipelineCache) {
+            m_pipelineCache->Save();
+            m_pipelineCache.reset();
+        }
+        m_bindlessTable.reset();
+        m_layoutCache.reset();
         m_swapchain.reset();
-        m_vkInstance.destroySurfaceKHR(m_surface);
+        m_renderTarget.reset();
+        // 设备已经空闲, 剩下的推迟销毁全部执行, 之后的销毁直接进行
+        m_deletionQueue.reset();
+        m_memoryAllocator.reset();
+        if (m_surface) {
+            m_vkInstance.destroySurfaceKHR(m_surface);
+        }
         m_Device.destroy();
         m_vkInstance.destroy();
     }
@@ -163,6 +200,9 @@ namespace toy2d
         uint32_t deviceCount = 0;
         // 列举可用的物理设备
         std::vector<vk::PhysicalDevice> physicalDevices = m_vkInstance.enumeratePhysicalDevices();
+        if (physicalDevices.empty()) {
+            throw std::runtime_error("no vulkan physical device found!");
+        }
         // 输出设备信息
         for (const auto& device : physicalDevices) {
             vk::PhysicalDeviceProperties deviceProperties = device.getProperties();
@@ -180,9 +220,30 @@ namespace toy2d
             // 可能还有其他设备属性信息...
         }
 
+        // 没有 GPU 的机器 (CI) 上通过名字或 "cpu" 选中软件实现
+        size_t picked = 0;
+        std::string preferred = g_preferredDevice;
+        if (preferred.empty()) {
+            const char* env = std::getenv("TOY2D_DEVICE");
+            preferred = env ? env : "";
+        }
+        if (!preferred.empty()) {
+            auto it = std::find_if(physicalDevices.begin(), physicalDevices.end(), [&](const vk::PhysicalDevice& device) {
+                auto properties = device.getProperties();
+                if (preferred == "cpu") {
+                    return properties.deviceType == vk::PhysicalDeviceType::eCpu;
+                }
+                return std::string(properties.deviceName.data()).find(preferred) != std::string::npos;
+            });
+            if (it == physicalDevices.end()) {
+                throw std::runtime_error("preferred physical device " + preferred + " not found!");
+            }
+            picked = it - physicalDevices.begin();
+        }
+
         // 获取设备属性和特性
-        vk::PhysicalDeviceProperties deviceProperties = physicalDevices[0].getProperties();
-        vk::PhysicalDeviceFeatures deviceFeatures = physicalDevices[0].getFeatures();
+        vk::PhysicalDeviceProperties deviceProperties = physicalDevices[picked].getProperties();
+        vk::PhysicalDeviceFeatures deviceFeatures = physicalDevices[picked].getFeatures();
 
         // 查询 PushConstants 限制大小
         auto maxPushConstantsSize = deviceProperties.limits.maxPushConstantsSize;
@@ -192,14 +253,25 @@ namespace toy2d
         auto isLogicOp = deviceFeatures.logicOp;
         std::cout << "isLogicOp: " << isLogicOp << std::endl;
 
-        m_phyDevice = physicalDevices[0]; // 自信输入
+        m_phyDevice = physicalDevices[picked];
+        std::cout << "use device: " << deviceProperties.deviceName << std::endl;
     }
 
     void Context::createDevice()
     {
-        // swapchain
-        std::array extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-
+        // swapchain, 无窗口模式下不需要
+        std::vector<const char*> extensions;
+        if (!IsHeadless()) {
+            extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+        // 纹理驻留管理用它读取显存预算, 没有时只按调用方给的预算换出
+        auto available = m_phyDevice.enumerateDeviceExtensionProperties();
+        m_memoryBudgetSupported = std::any_of(available.begin(), available.end(), [](const vk::ExtensionProperties& ext) {
+            return std::string(ext.extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        });
+        if (m_memoryBudgetSupported) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
 
         vk::DeviceCreateInfo createInfo;
 
@@ -211,37 +283,63 @@ namespace toy2d
 
         float propertity = 1.0f;
 
-        if (queueFamilyIndices.grapghicsQueue.value() == queueFamilyIndices.presentQueue.value())
+        // 图形, 显示, 传输队列可能来自同一个族, 每个族只创建一次
+        std::set<uint32_t> families = {
+            queueFamilyIndices.grapghicsQueue.value(),
+            queueFamilyIndices.presentQueue.value(),
+            queueFamilyIndices.transferQueue.value(),
+        };
+        for (auto family : families)
         {
             vk::DeviceQueueCreateInfo queueCreateInfo;
             queueCreateInfo.setPQueuePriorities(&propertity)
                 .setQueueCount(1)
-                .setQueueFamilyIndex(queueFamilyIndices.grapghicsQueue.value());
+                .setQueueFamilyIndex(family);
 
             queueCreateInfos.push_back(std::move(queueCreateInfo));
         }
-        else
-        {
-            vk::DeviceQueueCreateInfo queueCreateInfo1;
-            queueCreateInfo1.setPQueuePriorities(&propertity)
-                .setQueueCount(1)
-                .setQueueFamilyIndex(queueFamilyIndices.grapghicsQueue.value());
 
-            queueCreateInfos.push_back(std::move(queueCreateInfo1));
+        vk::PhysicalDeviceFeatures deviceFeatures = m_phyDevice.getFeatures();
+        createInfo.setQueueCreateInfos(queueCreateInfos)
+            .setPEnabledExtensionNames(extensions);
 
-            vk::DeviceQueueCreateInfo queueCreateInfo2;
-            queueCreateInfo2.setPQueuePriorities(&propertity)
-                .setQueueCount(1)
-                .setQueueFamilyIndex(queueFamilyIndices.presentQueue.value());
+        // 1.2 以上的设备通过 pNext 链开启 descriptor indexing 与 timeline semaphore
+        vk::PhysicalDeviceFeatures2 features2;
+        vk::PhysicalDeviceVulkan12Features features12;
+        if (m_phyDevice.getProperties().apiVersion >= VK_API_VERSION_1_2) {
+            auto supported = m_phyDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+            auto& supported12 = supported.get<vk::PhysicalDeviceVulkan12Features>();
+
+            m_bindlessSupported = supported12.descriptorIndexing &&
+                supported12.runtimeDescriptorArray &&
+                supported12.descriptorBindingPartiallyBound &&
+                supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                supported12.shaderSampledImageArrayNonUniformIndexing;
+            if (m_bindlessSupported) {
+                features12.setDescriptorIndexing(true)
+                    .setRuntimeDescriptorArray(true)
+                    .setDescriptorBindingPartiallyBound(true)
+                    .setDescriptorBindingSampledImageUpdateAfterBind(true)
+                    .setShaderSampledImageArrayNonUniformIndexing(true);
+            }
 
-            queueCreateInfos.push_back(std::move(queueCreateInfo2));
-        }
+            m_timelineSupported = supported12.timelineSemaphore;
+            features12.setTimelineSemaphore(m_timelineSupported);
 
-        vk::PhysicalDeviceFeatures deviceFeatures = m_phyDevice.getFeatures();
-        createInfo.setQueueCreateInfos(queueCreateInfos)
-            .setPEnabledExtensionNames(extensions).
-            setPEnabledFeatures(&deviceFeatures);
+            m_drawIndirectCountSupported = supported12.drawIndirectCount;
+            features12.setDrawIndirectCount(m_drawIndirectCountSupported);
 
+            features2.setFeatures(deviceFeatures)
+                .setPNext(&features12);
+            createInfo.setPNext(&features2);
+        }
+        else {
+            createInfo.setPEnabledFeatures(&deviceFeatures);
+        }
+        std::cout << "bindless textures: " << m_bindlessSupported << std::endl;
+        std::cout << "timeline semaphore: " << m_timelineSupported << std::endl;
+        std::cout << "draw indirect count: " << m_drawIndirectCountSupported << std::endl;
+        std::cout << "memory budget: " << m_memoryBudgetSupported << std::endl;
 
         m_Device = m_phyDevice.createDevice(createInfo);
     }
@@ -252,19 +350,36 @@ namespace toy2d
         for (int i = 0; i < properties.size(); ++i)
         {
             const auto& property = properties[i];
-            if (property.queueFlags & vk::QueueFlagBits::eGraphics)
+            if (!queueFamilyIndices.grapghicsQueue && (property.queueFlags & vk::QueueFlagBits::eGraphics))
             {
                 queueFamilyIndices.grapghicsQueue = i;
             }
 
-            if (m_phyDevice.getSurfaceSupportKHR(i, m_surface))
+            if (!queueFamilyIndices.presentQueue && m_surface && m_phyDevice.getSurfaceSupportKHR(i, m_surface))
             {
                 queueFamilyIndices.presentQueue = i;
             }
 
-            if (queueFamilyIndices)
-                break;
+            // 只支持传输的队列族一般对应独立的 DMA 引擎, 上传可以和渲染并行
+            if (!queueFamilyIndices.transferQueue && (property.queueFlags & vk::QueueFlagBits::eTransfer) &&
+                !(property.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+            {
+                queueFamilyIndices.transferQueue = i;
+            }
+        }
+
+        // 无窗口模式不呈现, 显示队列直接用图形队列
+        if (IsHeadless() && queueFamilyIndices.grapghicsQueue)
+        {
+            queueFamilyIndices.presentQueue = queueFamilyIndices.grapghicsQueue;
         }
+
+        // 没有独立的传输队列族时, 上传走图形队列族
+        if (!queueFamilyIndices.transferQueue && queueFamilyIndices.grapghicsQueue)
+        {
+            queueFamilyIndices.transferQueue = queueFamilyIndices.grapghicsQueue;
+        }
+        std::cout << "transfer queue family: " << queueFamilyIndices.transferQueue.value_or(~0u) << std::endl;
     }
 
     void Context::getQueues()
@@ -272,11 +387,12 @@ namespace toy2d
         // vk::Queue
         m_graphicsQueue = m_Device.getQueue(queueFamilyIndices.grapghicsQueue.value(), 0);
         m_presentQueue = m_Device.getQueue(queueFamilyIndices.presentQueue.value(), 0);
+        m_transferQueue = m_Device.getQueue(queueFamilyIndices.transferQueue.value(), 0);
     }
 
-    void Context::InitRenderer(int maxFlightCount)
+    void Context::InitRenderer(int framesInFlight)
     {
-        m_renderer.reset(new Renderer(maxFlightCount));
+        m_renderer.reset(new Renderer(framesInFlight));
     }
 
     void Context::DestroyRenderer()
@@ -289,21 +405,120 @@ namespace toy2d
         m_swapchain.reset(new swapchain(w, h));
     }
 
+    void Context::InitRenderTarget(const int w, const int h, int maxFlightCount)
+    {
+        m_renderTarget.reset(new RenderTarget(w, h, maxFlightCount));
+    }
+
+    vk::Format Context::GetColorFormat() const
+    {
+        return IsHeadless() ? m_renderTarget->GetFormat() : m_swapchain->GetFormat().format;
+    }
+
+    vk::Extent2D Context::GetRenderExtent() const
+    {
+        return IsHeadless() ? m_renderTarget->GetExtent() : m_swapchain->GetExtent();
+    }
+
     void Context::InitCommandPool()
     {
         m_commandManager = std::make_unique<CommandManager>();
     }
 
-    void Context::initShaderModules(const std::string& vertexSource, const std::string& fragSource) {
+    void Context::InitMemoryAllocator()
+    {
+        m_memoryAllocator = std::make_unique<MemoryAllocator>();
+        m_deletionQueue = std::make_unique<DeletionQueue>();
+    }
+
+    void Context::DeferDestroy(std::function<void()> destroy, uint64_t uploadValue)
+    {
+        if (m_deletionQueue) {
+            m_deletionQueue->Push(std::move(destroy), uploadValue);
+        }
+        else {
+            destroy();
+        }
+    }
+
+    void Context::InitPipelineCache(const std::string& path)
+    {
+        m_pipelineCache = std::make_unique<PipelineDiskCache>(path);
+    }
+
+    void Context::InitUploadManager()
+    {
+        m_uploadManager = std::make_unique<UploadManager>();
+    }
+
+    Context::HeapBudget Context::QueryDeviceLocalBudget() const {
+        HeapBudget result;
+        if (!m_memoryBudgetSupported) {
+            return result;
+        }
+        auto chain = m_phyDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                                      vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const auto& properties = chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+        const auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+            if (properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+                result.budget += budget.heapBudget[i];
+                result.usage += budget.heapUsage[i];
+            }
+        }
+        return result;
+    }
+
+    void Context::initShaderModules(std::string_view vertexSource, std::string_view fragSource) {
         m_shader = std::make_unique<Shader>(vertexSource, fragSource);
     }
 
+    void Context::initSpriteShaderModules(std::string_view vertexSource, std::string_view fragSource) {
+        m_spriteShader = std::make_unique<Shader>(vertexSource, fragSource);
+    }
+
+    void Context::initBindlessShaderModules(std::string_view vertexSource, std::string_view fragSource) {
+        m_bindlessShader = std::make_unique<Shader>(vertexSource, fragSource);
+    }
+
+    void Context::initCullShaderModule(std::string_view computeSource) {
+        m_cullShader = std::make_unique<ComputeShader>(computeSource);
+    }
+
+    void Context::initPostShaderModules(std::string_view vertexSource, std::string_view fragSource) {
+        m_postShader = std::make_unique<Shader>(vertexSource, fragSource);
+    }
+
+    void Context::InitBindlessTable() {
+        if (m_bindlessSupported) {
+            m_bindlessTable = std::make_unique<BindlessTextureTable>();
+        }
+    }
+
     void Context::initRenderProcess() {
         m_renderProcess.reset(new Render_process());
     }
 
     void Context::initGraphicsPipeline() {
+        TOY2D_PROFILE_FUNCTION();
+        auto begin = std::chrono::steady_clock::now();
+
         m_renderProcess->RecreateGraphicsPipeline(*m_shader);
+        m_renderProcess->RecreateSpritePipeline(*m_spriteShader);
+        if (m_bindlessTable) {
+            m_renderProcess->RecreateBindlessPipeline(*m_bindlessShader, m_bindlessTable->GetLayout());
+        }
+        m_renderProcess->RecreateCullPipeline(*m_cullShader);
+        m_renderProcess->RecreatePostPipeline(*m_postShader);
+        // 图形管线的各混合模式在工作线程上并行编译, 等它们全部完成, 统计的才是全部管线的创建时间;
+        // 录制时用的 TryGet 也因此从第一帧起就能拿到任意模式
+        m_renderProcess->GetPipelineCache().WaitIdle();
+
+        // 冷启动与热启动的对比: 删掉缓存文件运行一次, 再运行一次
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "pipeline creation: " << ms << "ms, cache "
+                  << (m_pipelineCache->IsWarm() ? "warm (" : "cold (") << m_pipelineCache->GetLoadedSize()
+                  << " bytes loaded)" << std::endl;
     }
 
     void Context::Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func)
@@ -10,6 +10,13 @@
 #include "renderer.hpp"
 #include "command_manager.hpp"
 #include "shader.hpp"
+#include "bindless_table.hpp"
+#include "upload_manager.hpp"
+#include "memory_allocator.hpp"
+#include "pipeline_disk_cache.hpp"
+#include "descriptor_layout_cache.hpp"
+#include "render_target.hpp"
+#include "deletion_queue.hpp"
 
 namespace toy2d
 {
@@ -25,15 +32,23 @@ namespace toy2d
         static Context& GetInstance();
         static void Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func);
         static void Quit();
+        // 在 Init 之前调用: 按名字子串选择物理设备, "cpu" 表示软件实现 (如 lavapipe/SwiftShader);
+        // 为空时读取环境变量 TOY2D_DEVICE, 仍为空则使用第一个设备
+        static void SetPreferredDevice(const std::string& name);
 
 
         struct QueueFamilyIndices final
         {
             std::optional<uint32_t> grapghicsQueue;
             std::optional<uint32_t> presentQueue;
+            std::optional<uint32_t> transferQueue; // 优先选只支持传输的队列族, 否则与图形队列族相同
 
             operator bool() const {
-                return grapghicsQueue.has_value() && presentQueue.has_value();
+                return grapghicsQueue.has_value() && presentQueue.has_value() && transferQueue.has_value();
+            }
+
+            bool HasDedicatedTransfer() const {
+                return transferQueue.value() != grapghicsQueue.value();
             }
         };
 
@@ -43,13 +58,47 @@ namespace toy2d
         QueueFamilyIndices& GetQueueFamilyIndices() { return this->queueFamilyIndices; };
 
         void InitSwapchain(const int w, const int h);
-
-        void InitRenderer(int maxFlightCount);
+        // 无窗口模式: 没有 surface 与交换链, 渲染到离屏图像
+        bool IsHeadless() const { return !m_surface; }
+        void InitRenderTarget(const int w, const int h, int maxFlightCount);
+        // 交换链或离屏图像的格式与大小
+        vk::Format GetColorFormat() const;
+        vk::Extent2D GetRenderExtent() const;
+
+        void InitRenderer(int framesInFlight);
         void DestroyRenderer();
 
         void InitCommandPool();
-
-        void initShaderModules(const std::string& vertexSource, const std::string& fragSource);
+        // 必须在创建任何 Buffer/Texture 之前调用, 同时创建删除队列
+        void InitMemoryAllocator();
+        // 推迟到当前帧完成 (uploadValue 非 0 时还有该批上传) 后销毁; 删除队列还没创建或已经销毁时立即执行
+        void DeferDestroy(std::function<void()> destroy, uint64_t uploadValue = 0);
+        // 从磁盘加载管线缓存, 必须在创建任何管线之前调用; 在 Quit 时写回
+        void InitPipelineCache(const std::string& path);
+
+        // 设备是否开启了 descriptor indexing (运行时数组, partially bound, update after bind)
+        bool IsBindlessSupported() const { return m_bindlessSupported; }
+        void InitBindlessTable();
+
+        bool IsTimelineSupported() const { return m_timelineSupported; }
+        // vkCmdDrawIndexedIndirectCount (1.2 核心功能), 不支持时剔除模式退回 vkCmdDrawIndexedIndirect
+        bool IsDrawIndirectCountSupported() const { return m_drawIndirectCountSupported; }
+        void InitUploadManager();
+
+        // VK_EXT_memory_budget: 驱动按进程给出的各堆预算与当前用量
+        bool IsMemoryBudgetSupported() const { return m_memoryBudgetSupported; }
+        struct HeapBudget {
+            vk::DeviceSize budget = 0;
+            vk::DeviceSize usage = 0;
+        };
+        // 所有 device local 堆的合计, 不支持该扩展时两项都为 0
+        HeapBudget QueryDeviceLocalBudget() const;
+
+        void initShaderModules(std::string_view vertexSource, std::string_view fragSource);
+        void initSpriteShaderModules(std::string_view vertexSource, std::string_view fragSource);
+        void initBindlessShaderModules(std::string_view vertexSource, std::string_view fragSource);
+        void initCullShaderModule(std::string_view computeSource);
+        void initPostShaderModules(std::string_view vertexSource, std::string_view fragSource);
         void initGraphicsPipeline();
         void initRenderProcess();
 
@@ -71,18 +120,35 @@ namespace toy2d
 
         QueueFamilyIndices queueFamilyIndices;
 
+        bool m_bindlessSupported = false;
+        bool m_timelineSupported = false;
+        bool m_drawIndirectCountSupported = false;
+        bool m_memoryBudgetSupported = false;
+
         // surface
         vk::SurfaceKHR m_surface;
 
     public:
         vk::Queue m_graphicsQueue;
         vk::Queue m_presentQueue;
+        vk::Queue m_transferQueue;
 
         std::unique_ptr<swapchain>m_swapchain;
+        std::unique_ptr<RenderTarget> m_renderTarget; // 仅无窗口模式
         std::unique_ptr<Render_process>m_renderProcess;
         std::unique_ptr<toy2d::Renderer>m_renderer;
+        std::unique_ptr<MemoryAllocator> m_memoryAllocator; // 所有 Buffer/Texture 的设备内存都从这里分配
+        std::unique_ptr<DeletionQueue> m_deletionQueue;     // 比除内存分配器以外的所有对象活得久
         std::unique_ptr<CommandManager> m_commandManager;
+        std::unique_ptr<PipelineDiskCache> m_pipelineCache;
+        std::unique_ptr<UploadManager> m_uploadManager;
         std::unique_ptr<Shader> m_shader;
+        std::unique_ptr<Shader> m_spriteShader; // 实例化精灵批处理使用
+        std::unique_ptr<Shader> m_bindlessShader; // 按下标索引全局纹理表的精灵着色器
+        std::unique_ptr<ComputeShader> m_cullShader; // GPU 剔除精灵实例
+        std::unique_ptr<Shader> m_postShader; // 离屏后处理 (模糊) 的全屏三角形
+        std::unique_ptr<BindlessTextureTable> m_bindlessTable;
+        std::unique_ptr<DescriptorLayoutCache> m_layoutCache; // 着色器反射出的布局, 比所有着色器与管线布局活得久
     };
 
 }
@@ -0,0 +1,59 @@
+#include "deletion_queue.hpp"
+#include <algorithm>
+#include "context.h"
+#include "frame_scheduler.hpp"
+#include "profiler.hpp"
+
+namespace toy2d {
+
+DeletionQueue::~DeletionQueue() {
+    Flush();
+}
+
+void DeletionQueue::Push(std::function<void()> destroy, uint64_t uploadValue) {
+    // 还没有提交的当前帧也可能引用它, 所以等的是当前帧
+    uint64_t frame = m_scheduler ? m_scheduler->GetCurrentFrame() : 0;
+    m_entries.push_back({ frame, uploadValue, std::move(destroy) });
+}
+
+void DeletionQueue::Collect() {
+    if (m_entries.empty()) {
+        return;
+    }
+    TOY2D_PROFILE_FUNCTION();
+
+    auto& uploadMgr = Context::GetInstance().m_uploadManager;
+    uint64_t current = m_scheduler ? m_scheduler->GetCurrentFrame() : 0;
+    uint64_t completed = m_scheduler ? m_scheduler->GetCompletedFrame() : current;
+
+    // 按 Push 的顺序执行, 同一个对象的多个句柄保持先后关系
+    std::deque<Entry> pending;
+    while (!m_entries.empty()) {
+        auto entry = std::move(m_entries.front());
+        m_entries.pop_front();
+
+        if (entry.uploadValue > 0 &&
+            (entry.uploadValue > uploadMgr->GetAcquiredValue() || !uploadMgr->IsComplete(entry.uploadValue))) {
+            // 所有权的 acquire 会录制在即将开始的这一帧里, 要等到它完成
+            entry.frame = std::max(entry.frame, current);
+            pending.push_back(std::move(entry));
+            continue;
+        }
+        if (entry.frame > completed) {
+            pending.push_back(std::move(entry));
+            continue;
+        }
+        entry.destroy();
+    }
+    m_entries = std::move(pending);
+}
+
+void DeletionQueue::Flush() {
+    while (!m_entries.empty()) {
+        auto entry = std::move(m_entries.front());
+        m_entries.pop_front();
+        entry.destroy();
+    }
+}
+
+}
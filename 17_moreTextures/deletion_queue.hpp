@@ -0,0 +1,51 @@
+#ifndef __DELETION_QUEUE_H__
+#define __DELETION_QUEUE_H__
+
+#include <deque>
+#include <functional>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+class FrameScheduler;
+
+/**
+ * @brief 按帧号推迟的销毁
+ * 持有 Vulkan 对象的类不再自己等待 GPU, 而是把句柄的销毁交给这里: 记下当前的帧号, 等到这一帧
+ * (以及之前所有的帧) 都完成后再执行. 图像还在上传时再等该批上传完成并被图形队列取得所有权,
+ * 因为取得所有权的屏障录制在之后的帧里. 只在主线程上使用
+ */
+class DeletionQueue final
+{
+public:
+    DeletionQueue() = default;
+    // 立即执行剩下的所有销毁, 调用方需保证设备已经空闲
+    ~DeletionQueue();
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    // 渲染器创建与销毁时设置, 为空时认为没有飞行中的帧
+    void SetScheduler(FrameScheduler* scheduler) { m_scheduler = scheduler; }
+
+    // uploadValue 为 UploadManager 的 timeline 值, 0 表示不依赖上传
+    void Push(std::function<void()> destroy, uint64_t uploadValue = 0);
+    // 执行已经安全的销毁, 渲染器在每帧开始 (录制之前) 调用
+    void Collect();
+    // 立即执行全部, 调用方需保证设备已经空闲
+    void Flush();
+
+    size_t GetPendingCount() const { return m_entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t frame; // 等到这一帧完成
+        uint64_t uploadValue;
+        std::function<void()> destroy;
+    };
+
+    std::deque<Entry> m_entries;
+    FrameScheduler* m_scheduler = nullptr;
+};
+
+}
+
+#endif // __DELETION_QUEUE_H__
@@ -0,0 +1,70 @@
+#include "descriptor_layout_cache.hpp"
+#include "context.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace toy2d {
+
+size_t DescriptorLayoutCache::KeyHash::operator()(const Key& key) const {
+    // FNV-1a, 逐个字段混入
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    mix(static_cast<uint32_t>(key.flags));
+    for (const auto& binding : key.bindings) {
+        mix(binding.binding);
+        mix(static_cast<uint64_t>(binding.type));
+        mix(binding.count);
+        mix(static_cast<uint32_t>(binding.stages));
+    }
+    return static_cast<size_t>(hash);
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache() {
+    auto& device = Context::GetInstance().GetDevice();
+    for (auto& [key, layout] : m_layouts) {
+        device.destroyDescriptorSetLayout(layout);
+    }
+}
+
+vk::DescriptorSetLayout DescriptorLayoutCache::Get(const std::vector<vk::DescriptorSetLayoutBinding>& bindings,
+                                                   vk::DescriptorSetLayoutCreateFlags flags) {
+    Key key{ flags, {} };
+    for (const auto& binding : bindings) {
+        if (binding.pImmutableSamplers) {
+            throw std::runtime_error("descriptor layout cache does not support immutable samplers");
+        }
+        key.bindings.push_back({ binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags });
+    }
+    std::sort(key.bindings.begin(), key.bindings.end(), [](const Binding& a, const Binding& b) {
+        return a.binding < b.binding;
+    });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end()) {
+        m_hits++;
+        return it->second;
+    }
+
+    vk::DescriptorSetLayoutCreateInfo createInfo;
+    createInfo.setBindings(bindings)
+        .setFlags(flags);
+    auto layout = Context::GetInstance().GetDevice().createDescriptorSetLayout(createInfo);
+    m_layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+size_t DescriptorLayoutCache::GetLayoutCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_layouts.size();
+}
+
+uint64_t DescriptorLayoutCache::GetHitCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+}
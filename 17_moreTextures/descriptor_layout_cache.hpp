@@ -0,0 +1,59 @@
+#ifndef __DESCRIPTOR_LAYOUT_CACHE_H__
+#define __DESCRIPTOR_LAYOUT_CACHE_H__
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief descriptor set layout 去重
+ * flags 与绑定 (与顺序无关) 相同的布局只创建一次, 着色器之间共用同一个 vk::DescriptorSetLayout;
+ * 布局由缓存持有, 在 Context 销毁时统一销毁, 调用方不要自己销毁. 不支持 immutable sampler 与 pNext 链
+ */
+class DescriptorLayoutCache final
+{
+public:
+    DescriptorLayoutCache() = default;
+    ~DescriptorLayoutCache();
+    DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+    DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+    // 线程安全
+    vk::DescriptorSetLayout Get(const std::vector<vk::DescriptorSetLayoutBinding>& bindings,
+                                vk::DescriptorSetLayoutCreateFlags flags = {});
+
+    size_t GetLayoutCount() const;
+    uint64_t GetHitCount() const;
+
+private:
+    struct Binding {
+        uint32_t binding;
+        vk::DescriptorType type;
+        uint32_t count;
+        vk::ShaderStageFlags stages;
+
+        bool operator==(const Binding& other) const {
+            return binding == other.binding && type == other.type && count == other.count && stages == other.stages;
+        }
+    };
+    struct Key {
+        vk::DescriptorSetLayoutCreateFlags flags;
+        std::vector<Binding> bindings; // 按 binding 排序
+
+        bool operator==(const Key& other) const { return flags == other.flags && bindings == other.bindings; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, vk::DescriptorSetLayout, KeyHash> m_layouts;
+    uint64_t m_hits = 0;
+};
+
+}
+
+#endif // __DESCRIPTOR_LAYOUT_CACHE_H__
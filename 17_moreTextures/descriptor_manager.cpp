@@ -1,5 +1,7 @@
 ﻿#include "descriptor_manager.hpp"
 #include "context.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace toy2d {
 
@@ -17,27 +19,148 @@ DescriptorSetManager& DescriptorSetManager::GetInstance() {
     return *m_instance;
 }
 
+namespace {
+
+// 纹理 set 只有一个 combined image sampler
+const std::vector<DescriptorPoolChain::PoolSizeRatio> kImageSetRatios = {
+    { vk::DescriptorType::eCombinedImageSampler, 1 },
+};
+// 帧内临时 set 的布局各不相同, 按常见组合预留
+const std::vector<DescriptorPoolChain::PoolSizeRatio> kFrameSetRatios = {
+    { vk::DescriptorType::eStorageBuffer, 4 },
+    { vk::DescriptorType::eUniformBuffer, 1 },
+    { vk::DescriptorType::eUniformBufferDynamic, 1 },
+    { vk::DescriptorType::eCombinedImageSampler, 2 },
+};
+
+constexpr uint32_t kInitialImageSets = 16;
+constexpr uint32_t kInitialFrameSets = 16;
+constexpr uint32_t kMaxSetsPerPool = 4096;
+
+}
+
+DescriptorPoolChain::DescriptorPoolChain(std::vector<PoolSizeRatio> ratios, uint32_t initialSets, bool freeable)
+    : m_ratios(std::move(ratios)), m_freeable(freeable), m_nextSets(initialSets) {
+}
+
+DescriptorPoolChain::~DescriptorPoolChain() {
+    auto& device = Context::GetInstance().GetDevice();
+    for (auto& pool : m_pools) {
+        device.destroyDescriptorPool(pool.pool);
+    }
+}
+
+DescriptorPoolChain::Pool& DescriptorPoolChain::createPool() {
+    uint32_t maxSets = m_nextSets;
+    m_nextSets = std::min(m_nextSets * 2, kMaxSetsPerPool);
+
+    std::vector<vk::DescriptorPoolSize> sizes;
+    for (const auto& ratio : m_ratios) {
+        auto count = static_cast<uint32_t>(ratio.ratio * maxSets);
+        sizes.emplace_back(ratio.type, std::max(count, 1u));
+    }
+    vk::DescriptorPoolCreateInfo createInfo;
+    createInfo.setMaxSets(maxSets)
+        .setPoolSizes(sizes);
+    if (m_freeable) {
+        createInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+    }
+    auto pool = Context::GetInstance().GetDevice().createDescriptorPool(createInfo);
+    m_pools.push_back({ pool, 0, false });
+    return m_pools.back();
+}
+
+std::pair<vk::DescriptorSet, vk::DescriptorPool> DescriptorPoolChain::Alloc(vk::DescriptorSetLayout layout) {
+    auto& device = Context::GetInstance().GetDevice();
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.setDescriptorSetCount(1)
+        .setSetLayouts(layout);
+
+    // 先试上一次成功的池, 再试其他没满的池, 都不行才开新池;
+    // 池满是正常情况, 用返回 vk::Result 的重载, 不走异常
+    auto tryAlloc = [&](Pool& pool) {
+        if (pool.full) {
+            return vk::DescriptorSet{};
+        }
+        allocInfo.setDescriptorPool(pool.pool);
+        vk::DescriptorSet set;
+        auto result = device.allocateDescriptorSets(&allocInfo, &set);
+        if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool) {
+            pool.full = true;
+            return vk::DescriptorSet{};
+        }
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("allocate descriptor set failed: " + vk::to_string(result));
+        }
+        pool.live++;
+        return set;
+    };
+
+    vk::DescriptorSet set;
+    if (m_current < m_pools.size()) {
+        set = tryAlloc(m_pools[m_current]);
+    }
+    for (size_t i = 0; !set && i < m_pools.size(); i++) {
+        if (i != m_current && (set = tryAlloc(m_pools[i]))) {
+            m_current = i;
+        }
+    }
+    if (!set) {
+        createPool();
+        m_current = m_pools.size() - 1;
+        set = tryAlloc(m_pools[m_current]);
+        if (!set) {
+            throw std::runtime_error("descriptor set layout does not fit in a new descriptor pool");
+        }
+    }
+
+    m_live++;
+    m_allocations++;
+    return { set, m_pools[m_current].pool };
+}
+
+void DescriptorPoolChain::Free(vk::DescriptorPool pool, vk::DescriptorSet set) {
+    Context::GetInstance().GetDevice().freeDescriptorSets(pool, set);
+    auto it = std::find_if(m_pools.begin(), m_pools.end(), [&](const Pool& p) { return p.pool == pool; });
+    if (it != m_pools.end()) {
+        it->live--;
+        it->full = false; // 归还后又有空位, 但可能有碎片, 下次分配失败会再标记
+    }
+    m_live--;
+}
+
+void DescriptorPoolChain::Reset() {
+    auto& device = Context::GetInstance().GetDevice();
+    for (auto& pool : m_pools) {
+        if (pool.live > 0) {
+            device.resetDescriptorPool(pool.pool);
+        }
+        pool.live = 0;
+        pool.full = false;
+    }
+    m_current = 0;
+    m_live = 0;
+}
+
 DescriptorSetManager::DescriptorSetManager(uint32_t maxFlight) : m_maxFlightCount(maxFlight) {
     createBufferDescriptorPool();
-    createImageSetPool(); // 暂时定10个容量, 未写伸缩扩容
+    // 池都是第一次分配时才创建, 之后按 16, 32, 64... 个 set 的容量增长
+    imageSetPools_ = std::make_unique<DescriptorPoolChain>(kImageSetRatios, kInitialImageSets, true);
+    for (uint32_t i = 0; i < maxFlight; i++) {
+        frameSetPools_.push_back(std::make_unique<DescriptorPoolChain>(kFrameSetRatios, kInitialFrameSets, false));
+    }
 }
 
 DescriptorSetManager::~DescriptorSetManager() {
     auto& device = Context::GetInstance().GetDevice();
 
     device.destroyDescriptorPool(bufferSetPool_.pool_);
-    for (auto pool : fulledImageSetPool_) {
-        device.destroyDescriptorPool(pool.pool_);
-    }
-    for (auto pool : avalibleImageSetPool_) {
-        device.destroyDescriptorPool(pool.pool_);
-    }
 }
 
 void DescriptorSetManager::createBufferDescriptorPool() {
     vk::DescriptorPoolCreateInfo createInfo;
     std::vector<vk::DescriptorPoolSize> poolSizes(1);
-    poolSizes[0].setType(vk::DescriptorType::eUniformBuffer)
+    poolSizes[0].setType(vk::DescriptorType::eUniformBufferDynamic)
         .setDescriptorCount(m_maxFlightCount * 2);
 
     createInfo.setMaxSets(m_maxFlightCount) // 创建个数
@@ -49,21 +172,6 @@ void DescriptorSetManager::createBufferDescriptorPool() {
     bufferSetPool_.remainNum_ = m_maxFlightCount;
 }
 
-
-void DescriptorSetManager::createImageSetPool() {
-    constexpr uint32_t MaxSetNum = 10;
-
-    vk::DescriptorPoolSize size;
-    size.setType(vk::DescriptorType::eCombinedImageSampler)
-        .setDescriptorCount(MaxSetNum);
-    vk::DescriptorPoolCreateInfo createInfo;
-    createInfo.setMaxSets(MaxSetNum)
-        .setPoolSizes(size)
-        .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
-    auto pool = Context::GetInstance().GetDevice().createDescriptorPool(createInfo);
-    avalibleImageSetPool_.push_back({ pool, MaxSetNum });
-}
-
 std::vector<DescriptorSetManager::SetInfo> DescriptorSetManager::allocBufferDescriptorSet(uint32_t num) {
     std::vector layouts(m_maxFlightCount, Context::GetInstance().m_shader->GetDescriptorSetLayouts()[0]);
     vk::DescriptorSetAllocateInfo allocInfo;
@@ -82,49 +190,39 @@ std::vector<DescriptorSetManager::SetInfo> DescriptorSetManager::allocBufferDesc
 }
 
 DescriptorSetManager::SetInfo DescriptorSetManager::AllocImageSet() {
-    std::vector<vk::DescriptorSetLayout> layouts{ Context::GetInstance().m_shader->GetDescriptorSetLayouts()[1] };
-    vk::DescriptorSetAllocateInfo allocInfo;
-
-    if (avalibleImageSetPool_.empty()) {
-        throw std::runtime_error("avalibleImageSetPool_ is empty!");
-    }
-    auto& poolInfo = avalibleImageSetPool_.back();
-
-    allocInfo.setDescriptorPool(poolInfo.pool_)
-        .setDescriptorSetCount(1)
-        .setSetLayouts(layouts);
-    auto sets = Context::GetInstance().GetDevice().allocateDescriptorSets(allocInfo);
+    auto layout = Context::GetInstance().m_shader->GetDescriptorSetLayouts()[1];
+    auto [set, pool] = imageSetPools_->Alloc(layout);
 
     SetInfo result;
-    result.pool = poolInfo.pool_;
-    result.set = sets[0];
-
-    poolInfo.remainNum_ = std::max<int>(static_cast<int>(poolInfo.remainNum_) - sets.size(), 0);
-
+    result.pool = pool;
+    result.set = set;
     return result;
 }
 
 void DescriptorSetManager::FreeImageSet(const SetInfo& info) {
-    auto it = std::find_if(fulledImageSetPool_.begin(), fulledImageSetPool_.end(),
-        [&](const PoolInfo& poolInfo) {
-        return poolInfo.pool_ == info.pool;
-    });
-    if (it != fulledImageSetPool_.end()) {
-        it->remainNum_++;
-        avalibleImageSetPool_.push_back(*it);
-        fulledImageSetPool_.erase(it);
-        return;
-    }
+    imageSetPools_->Free(info.pool, info.set);
+}
+
+vk::DescriptorSet DescriptorSetManager::AllocFrameSet(vk::DescriptorSetLayout layout) {
+    return frameSetPools_[curFrame_]->Alloc(layout).first;
+}
+
+void DescriptorSetManager::BeginFrame(uint32_t frame) {
+    curFrame_ = frame;
+    frameSetPools_[frame]->Reset();
+}
 
-    it = std::find_if(avalibleImageSetPool_.begin(), avalibleImageSetPool_.end(),
-        [&](const PoolInfo& poolInfo) {
-        return poolInfo.pool_ == info.pool;
-    });
-    if (it != avalibleImageSetPool_.end()) {
-        it->remainNum_++;
-        return;
+DescriptorSetManager::Stats DescriptorSetManager::GetStats() const {
+    Stats stats;
+    stats.imageSets = imageSetPools_->GetLiveCount();
+    stats.imagePools = imageSetPools_->GetPoolCount();
+    stats.imageAllocations = imageSetPools_->GetAllocationCount();
+    stats.frameSets = frameSetPools_[curFrame_]->GetLiveCount();
+    for (const auto& chain : frameSetPools_) {
+        stats.framePools += chain->GetPoolCount();
+        stats.frameAllocations += chain->GetAllocationCount();
     }
-    Context::GetInstance().GetDevice().freeDescriptorSets(info.pool, info.set);
+    return stats;
 }
 
 
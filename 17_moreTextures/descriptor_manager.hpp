@@ -3,10 +3,59 @@
 
 #include "vulkan/vulkan.hpp"
 #include <memory>
+#include <utility>
 #include <vector>
 
 namespace toy2d {
 
+/**
+ * @brief 一串按需增长的 descriptor pool
+ * 当前池分配失败 (eOutOfPoolMemory / eFragmentedPool) 时开一个容量翻倍的新池, 已有的池一直保留复用.
+ * freeable 的池带 eFreeDescriptorSet, 可以单独归还 set; 否则只能 Reset 整体回收, 分配开销最小
+ */
+class DescriptorPoolChain final
+{
+public:
+    // 每个 set 预留的各类 descriptor 数, 池的容量按它乘以 set 数
+    struct PoolSizeRatio {
+        vk::DescriptorType type;
+        float ratio;
+    };
+
+    DescriptorPoolChain(std::vector<PoolSizeRatio> ratios, uint32_t initialSets, bool freeable);
+    ~DescriptorPoolChain();
+    DescriptorPoolChain(const DescriptorPoolChain&) = delete;
+    DescriptorPoolChain& operator=(const DescriptorPoolChain&) = delete;
+
+    // 返回 set 与它所在的池
+    std::pair<vk::DescriptorSet, vk::DescriptorPool> Alloc(vk::DescriptorSetLayout layout);
+    // 只能用于 freeable 的池
+    void Free(vk::DescriptorPool pool, vk::DescriptorSet set);
+    // vkResetDescriptorPool 所有池, 之前分配的 set 全部失效
+    void Reset();
+
+    uint32_t GetPoolCount() const { return static_cast<uint32_t>(m_pools.size()); }
+    uint32_t GetLiveCount() const { return m_live; }
+    uint64_t GetAllocationCount() const { return m_allocations; }
+
+private:
+    struct Pool {
+        vk::DescriptorPool pool;
+        uint32_t live;
+        bool full; // 分配失败过, 有 set 归还或 Reset 之前不再尝试
+    };
+
+    Pool& createPool();
+
+    std::vector<PoolSizeRatio> m_ratios;
+    bool m_freeable;
+    uint32_t m_nextSets;
+    std::vector<Pool> m_pools;
+    size_t m_current = 0; // 上一次分配成功的池
+    uint32_t m_live = 0;
+    uint64_t m_allocations = 0;
+};
+
 class DescriptorSetManager final
 {
 public:
@@ -21,9 +70,26 @@ public:
     DescriptorSetManager(uint32_t maxFlight);
     ~DescriptorSetManager();
     std::vector<DescriptorSetManager::SetInfo> allocBufferDescriptorSet(uint32_t num);
+    // 纹理的长期 set, 池用完时自动扩容, 用 FreeImageSet 单独归还
     DescriptorSetManager::SetInfo AllocImageSet();
     void FreeImageSet(const SetInfo& info);
 
+    // 帧内临时 set: 从当前帧槽位的池里线性分配, 不能单独释放, 该槽位下一次 BeginFrame 时整体 reset;
+    // 只能在主线程上录制当前帧时调用
+    vk::DescriptorSet AllocFrameSet(vk::DescriptorSetLayout layout);
+    // 渲染器在该帧槽位上一次的帧完成后调用, 回收它上一轮分配的所有临时 set
+    void BeginFrame(uint32_t frame);
+
+    struct Stats {
+        uint32_t imageSets = 0;        // 存活的纹理 set
+        uint32_t imagePools = 0;
+        uint32_t frameSets = 0;        // 当前帧已分配的临时 set
+        uint32_t framePools = 0;       // 所有帧槽位合计
+        uint64_t imageAllocations = 0; // 累计
+        uint64_t frameAllocations = 0; // 累计
+    };
+    Stats GetStats() const;
+
 private:
     static std::unique_ptr<DescriptorSetManager>m_instance;
 
@@ -34,11 +100,11 @@ private:
     };
     PoolInfo bufferSetPool_;
 
-    std::vector<PoolInfo> fulledImageSetPool_;
-    std::vector<PoolInfo> avalibleImageSetPool_;
+    std::unique_ptr<DescriptorPoolChain> imageSetPools_;
+    std::vector<std::unique_ptr<DescriptorPoolChain>> frameSetPools_; // 每个帧槽位一串
+    uint32_t curFrame_ = 0;
 
     void createBufferDescriptorPool();
-    void createImageSetPool();
 };
 
 
@@ -0,0 +1,64 @@
+#include "frame_ring_buffer.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+namespace toy2d {
+
+FrameRingBuffer::FrameRingBuffer(int maxFlightCount, vk::DeviceSize frameSize, vk::BufferUsageFlags usage, bool growable)
+    : m_usage(usage), m_frameSize(0), m_head(0), m_maxFlightCount(maxFlightCount),
+      m_curFrame(0), m_growable(growable), m_generation(0) {
+    createBuffer(frameSize);
+}
+
+FrameRingBuffer::~FrameRingBuffer() {
+    m_retired.clear();
+    m_buffer.reset();
+}
+
+void FrameRingBuffer::createBuffer(vk::DeviceSize frameSize) {
+    m_buffer.reset(new Buffer(frameSize * m_maxFlightCount, m_usage,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+    m_frameSize = frameSize;
+    m_generation++;
+}
+
+void FrameRingBuffer::BeginFrame(int frame) {
+    m_curFrame = frame;
+    m_head = 0;
+
+    // 每过一帧计数减一, 减到 0 说明所有可能引用旧 buffer 的帧都已结束
+    for (auto& retired : m_retired) {
+        retired.framesLeft--;
+    }
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+        [](const Retired& retired) { return retired.framesLeft <= 0; }), m_retired.end());
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::Allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    vk::DeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+
+    if (offset + size > m_frameSize) {
+        if (!m_growable) {
+            throw std::runtime_error("frame ring buffer exhausted!");
+        }
+
+        // 当前帧之前分配的数据仍在旧 buffer 中, 旧 buffer 延后释放
+        vk::DeviceSize frameSize = m_frameSize * 2;
+        while (frameSize < size) {
+            frameSize *= 2;
+        }
+        m_retired.push_back({ std::move(m_buffer), m_maxFlightCount });
+        createBuffer(frameSize);
+        offset = 0;
+    }
+
+    m_head = offset + size;
+
+    Allocation allocation;
+    allocation.buffer = m_buffer->m_buffer;
+    allocation.offset = m_frameSize * m_curFrame + offset;
+    allocation.data = static_cast<char*>(m_buffer->m_map) + allocation.offset;
+    return allocation;
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef __FRAME_RING_BUFFER_H__
+#define __FRAME_RING_BUFFER_H__
+
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "buffer.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 按帧划分的持久映射 buffer
+ * 一个大的 host visible buffer 被切成 maxFlightCount 段, 每帧在自己那段里线性分配,
+ * 写数据只是一次 memcpy, 不需要提交命令也不需要等待 GPU
+ */
+class FrameRingBuffer final
+{
+public:
+    struct Allocation {
+        vk::Buffer buffer;
+        vk::DeviceSize offset;
+        void* data;
+    };
+
+    // growable 为 false 时, 单帧用量超过 frameSize 直接抛异常;
+    // 为 true 时换一个更大的 buffer, 旧 buffer 等引用它的帧都结束后再释放
+    FrameRingBuffer(int maxFlightCount, vk::DeviceSize frameSize, vk::BufferUsageFlags usage, bool growable);
+    ~FrameRingBuffer();
+
+    // 调用方需保证该帧上一次的提交已经完成
+    void BeginFrame(int frame);
+    Allocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+    vk::Buffer GetBuffer() const { return m_buffer->m_buffer; }
+    vk::DeviceSize GetFrameSize() const { return m_frameSize; }
+    // buffer 每重建一次加一, 引用它的 descriptor set 需要据此重新写入
+    uint32_t GetGeneration() const { return m_generation; }
+
+private:
+    struct Retired {
+        std::unique_ptr<Buffer> buffer;
+        int framesLeft;
+    };
+
+    void createBuffer(vk::DeviceSize frameSize);
+
+    std::unique_ptr<Buffer> m_buffer;
+    std::vector<Retired> m_retired;
+    vk::BufferUsageFlags m_usage;
+    vk::DeviceSize m_frameSize;
+    vk::DeviceSize m_head; // 当前帧段内的已用字节
+    int m_maxFlightCount;
+    int m_curFrame;
+    bool m_growable;
+    uint32_t m_generation;
+};
+
+}
+
+#endif // __FRAME_RING_BUFFER_H__
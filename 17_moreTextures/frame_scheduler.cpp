@@ -0,0 +1,154 @@
+#include "frame_scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include "context.h"
+#include "profiler.hpp"
+
+namespace toy2d {
+
+FrameScheduler::FrameScheduler(int framesInFlight)
+    : m_framesInFlight(std::clamp(framesInFlight, 1, MaxFramesInFlight)), m_slot(0), m_submitted(0),
+      m_completed(0), m_waitMs(0) {
+    auto& ctx = Context::GetInstance();
+    m_slotFrames.assign(MaxFramesInFlight, 0);
+
+    m_timeline = nullptr;
+    if (ctx.IsTimelineSupported()) {
+        vk::SemaphoreTypeCreateInfo typeInfo;
+        typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline)
+            .setInitialValue(0);
+        vk::SemaphoreCreateInfo createInfo;
+        createInfo.setPNext(&typeInfo);
+        m_timeline = ctx.GetDevice().createSemaphore(createInfo);
+        return;
+    }
+
+    m_fences.resize(MaxFramesInFlight);
+    for (auto& fence : m_fences) {
+        fence = ctx.GetDevice().createFence(vk::FenceCreateInfo{});
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    WaitIdle();
+
+    auto& device = Context::GetInstance().GetDevice();
+    for (auto& fence : m_fences) {
+        device.destroyFence(fence);
+    }
+    device.destroySemaphore(m_timeline);
+}
+
+int FrameScheduler::BeginFrame() {
+    // 槽位里的资源要等它上一次的帧; 帧数限制要等 framesInFlight 帧之前的那一帧
+    uint64_t current = GetCurrentFrame();
+    uint64_t wait = m_slotFrames[m_slot];
+    if (current > static_cast<uint64_t>(m_framesInFlight)) {
+        wait = std::max(wait, current - m_framesInFlight);
+    }
+    m_waitMs = WaitFrame(wait);
+    return m_slot;
+}
+
+void FrameScheduler::Submit(vk::Queue queue, vk::CommandBuffer cmd, const std::vector<vk::Semaphore>& waits,
+                            const std::vector<vk::PipelineStageFlags>& waitStages,
+                            const std::vector<uint64_t>& waitValues, vk::Semaphore signal) {
+    uint64_t frame = GetCurrentFrame();
+
+    std::vector<vk::Semaphore> signals;
+    std::vector<uint64_t> signalValues;
+    if (signal) {
+        signals.push_back(signal);
+        signalValues.push_back(0); // binary semaphore 的值会被忽略
+    }
+
+    vk::SubmitInfo submit;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    vk::Fence fence = nullptr;
+    if (m_timeline) {
+        signals.push_back(m_timeline);
+        signalValues.push_back(frame);
+        timelineInfo.setWaitSemaphoreValues(waitValues)
+            .setSignalSemaphoreValues(signalValues);
+        submit.setPNext(&timelineInfo);
+    }
+    else {
+        fence = m_fences[m_slot];
+        Context::GetInstance().GetDevice().resetFences(fence);
+    }
+    submit.setCommandBuffers(cmd)
+        .setWaitSemaphores(waits)
+        .setWaitDstStageMask(waitStages)
+        .setSignalSemaphores(signals);
+    queue.submit(submit, fence);
+
+    if (!m_timeline) {
+        m_pending.push_back({ frame, m_slot });
+    }
+    m_slotFrames[m_slot] = frame;
+    m_submitted = frame;
+    m_slot = (m_slot + 1) % m_framesInFlight;
+}
+
+uint64_t FrameScheduler::GetCompletedFrame() {
+    if (m_completed == m_submitted) {
+        return m_completed;
+    }
+
+    auto& device = Context::GetInstance().GetDevice();
+    if (m_timeline) {
+        m_completed = std::max(m_completed, device.getSemaphoreCounterValue(m_timeline));
+        return m_completed;
+    }
+
+    // 同一个队列上的 fence 按提交顺序 signal
+    while (!m_pending.empty() && device.getFenceStatus(m_fences[m_pending.front().slot]) == vk::Result::eSuccess) {
+        m_completed = m_pending.front().frame;
+        m_pending.pop_front();
+    }
+    return m_completed;
+}
+
+double FrameScheduler::WaitFrame(uint64_t frame) {
+    if (frame == 0 || frame <= m_completed) {
+        return 0;
+    }
+    if (frame > m_submitted) {
+        throw std::runtime_error("wait for a frame that has not been submitted!");
+    }
+    TOY2D_PROFILE_FUNCTION();
+
+    auto& device = Context::GetInstance().GetDevice();
+    auto begin = std::chrono::steady_clock::now();
+    if (m_timeline) {
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.setSemaphores(m_timeline)
+            .setValues(frame);
+        if (device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+            throw std::runtime_error("wait for frame failed");
+        }
+        m_completed = std::max(m_completed, frame);
+    }
+    else {
+        while (!m_pending.empty() && m_pending.front().frame <= frame) {
+            auto fence = m_fences[m_pending.front().slot];
+            if (device.waitForFences(fence, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+                throw std::runtime_error("wait for fence failed");
+            }
+            m_completed = m_pending.front().frame;
+            m_pending.pop_front();
+        }
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void FrameScheduler::SetFramesInFlight(int count) {
+    m_framesInFlight = std::clamp(count, 1, MaxFramesInFlight);
+    if (m_slot >= m_framesInFlight) {
+        m_slot = 0;
+    }
+}
+
+}
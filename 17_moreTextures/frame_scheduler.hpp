@@ -0,0 +1,76 @@
+#ifndef __FRAME_SCHEDULER_H__
+#define __FRAME_SCHEDULER_H__
+
+#include <deque>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 帧调度
+ * 帧号从 1 开始, 第 N 帧的提交完成时 timeline semaphore 的值为 N, 任何模块都可以用帧号查询
+ * 某一帧是否已经结束, 不需要自己持有 fence. 不支持 timeline semaphore 时每个槽位退化为一个 fence.
+ *
+ * 每帧的资源 (command buffer, ring buffer 段等) 按槽位划分, 槽位数固定为 MaxFramesInFlight,
+ * 实际飞行的帧数可以在运行时改为 1~MaxFramesInFlight: 少则延迟低, 多则 CPU 与 GPU 更能并行.
+ * 槽位复用前等待它上一次的帧, 所以改变帧数时不需要等待所有飞行中的帧
+ */
+class FrameScheduler final
+{
+public:
+    static constexpr int MaxFramesInFlight = 4;
+
+    // framesInFlight 截断到 [1, MaxFramesInFlight]
+    FrameScheduler(int framesInFlight);
+    // 等待所有已提交的帧
+    ~FrameScheduler();
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // 等到当前槽位上一次的帧与 framesInFlight 帧之前的帧都完成, 返回槽位. 多次调用而不提交时槽位不变
+    int BeginFrame();
+    // 提交当前帧, 在调用方给的等待与 binary semaphore 之外 signal 帧号; waitValues 与 waits 一一对应,
+    // binary semaphore 的值填 0. 之后槽位前进到下一个
+    void Submit(vk::Queue queue, vk::CommandBuffer cmd, const std::vector<vk::Semaphore>& waits,
+                const std::vector<vk::PipelineStageFlags>& waitStages, const std::vector<uint64_t>& waitValues,
+                vk::Semaphore signal);
+
+    int GetSlot() const { return m_slot; }
+    // 正在录制 (还没有提交) 的帧号
+    uint64_t GetCurrentFrame() const { return m_submitted + 1; }
+    uint64_t GetSubmittedFrame() const { return m_submitted; }
+    // 已经完成的最大帧号, 不阻塞
+    uint64_t GetCompletedFrame();
+    bool IsRetired(uint64_t frame) { return frame <= GetCompletedFrame(); }
+    // 阻塞到 frame 完成, 返回等待的毫秒数
+    double WaitFrame(uint64_t frame);
+    void WaitIdle() { WaitFrame(m_submitted); }
+
+    void SetFramesInFlight(int count);
+    int GetFramesInFlight() const { return m_framesInFlight; }
+    // 最近一次 BeginFrame 阻塞等待 GPU 的 CPU 时间
+    double GetWaitMs() const { return m_waitMs; }
+    bool IsTimeline() const { return static_cast<bool>(m_timeline); }
+
+private:
+    struct Pending {
+        uint64_t frame;
+        int slot;
+    };
+
+    vk::Semaphore m_timeline;
+    std::vector<vk::Fence> m_fences; // 只在不支持 timeline semaphore 时使用, 每个槽位一个
+    std::deque<Pending> m_pending;   // 同上, 按提交顺序排列的未完成帧
+
+    std::vector<uint64_t> m_slotFrames; // 每个槽位上一次提交的帧号, 0 表示没用过
+    int m_framesInFlight;
+    int m_slot;
+    uint64_t m_submitted;
+    uint64_t m_completed; // 已知完成的帧号, 避免每次都查询
+    double m_waitMs;
+};
+
+}
+
+#endif // __FRAME_SCHEDULER_H__
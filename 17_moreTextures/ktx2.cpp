@@ -0,0 +1,162 @@
+#include "ktx2.hpp"
+#include "context.h"
+#include "math/mipmap.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace toy2d {
+
+namespace {
+
+constexpr uint8_t kIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// 文件头: identifier 之后 9 个 uint32, 再是 4 个 uint32 与 2 个 uint64 的数据段索引, 共 80 字节
+constexpr size_t kHeaderSize = 80;
+constexpr size_t kLevelIndexEntrySize = 24;
+
+struct Ktx2Header {
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+};
+
+uint32_t ReadU32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v)); // KTX2 固定小端, 这里只考虑小端主机
+    return v;
+}
+
+uint64_t ReadU64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+Ktx2Header ParseHeader(const uint8_t* data, size_t size) {
+    if (size < kHeaderSize || !IsKtx2(data, size)) {
+        throw std::runtime_error("not a KTX2 file");
+    }
+    Ktx2Header header;
+    const uint8_t* p = data + sizeof(kIdentifier);
+    header.vkFormat = ReadU32(p);
+    header.typeSize = ReadU32(p + 4);
+    header.pixelWidth = ReadU32(p + 8);
+    header.pixelHeight = ReadU32(p + 12);
+    header.pixelDepth = ReadU32(p + 16);
+    header.layerCount = ReadU32(p + 20);
+    header.faceCount = ReadU32(p + 24);
+    header.levelCount = ReadU32(p + 28);
+    header.supercompressionScheme = ReadU32(p + 32);
+    return header;
+}
+
+}
+
+bool IsKtx2(const uint8_t* data, size_t size) {
+    return size >= sizeof(kIdentifier) && memcmp(data, kIdentifier, sizeof(kIdentifier)) == 0;
+}
+
+Ktx2Image ParseKtx2(const uint8_t* data, size_t size) {
+    Ktx2Header header = ParseHeader(data, size);
+
+    if (header.vkFormat == 0) {
+        throw std::runtime_error("KTX2: Basis Universal textures are not supported");
+    }
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error("KTX2: supercompressed textures are not supported");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0) {
+        throw std::runtime_error("KTX2: only 2D textures are supported");
+    }
+    if (header.layerCount > 1 || header.faceCount != 1) {
+        throw std::runtime_error("KTX2: array and cube textures are not supported");
+    }
+
+    Ktx2Image image;
+    image.format = static_cast<vk::Format>(header.vkFormat);
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    auto info = GetTextureFormatInfo(image.format);
+    if (!info) {
+        throw std::runtime_error("KTX2: unsupported format " + vk::to_string(image.format));
+    }
+
+    // levelCount 为 0 表示希望加载方自己生成 mip, 文件里只有一层
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    if (levelCount > MipLevelCount(image.width, image.height)) {
+        throw std::runtime_error("KTX2: levelCount exceeds the full mip chain");
+    }
+    if (size < kHeaderSize + static_cast<size_t>(levelCount) * kLevelIndexEntrySize) {
+        throw std::runtime_error("KTX2: truncated level index");
+    }
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const uint8_t* entry = data + kHeaderSize + i * kLevelIndexEntrySize;
+        uint64_t offset = ReadU64(entry);
+        uint64_t length = ReadU64(entry + 8);
+        uint32_t levelW = std::max(image.width >> i, 1u);
+        uint32_t levelH = std::max(image.height >> i, 1u);
+        if (offset > size || length > size - offset || length < TextureLevelSize(*info, levelW, levelH)) {
+            throw std::runtime_error("KTX2: level " + std::to_string(i) + " out of range");
+        }
+        image.levels.push_back({ data + offset, static_cast<size_t>(length) });
+    }
+    return image;
+}
+
+vk::Format ReadKtx2Format(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    uint8_t header[kHeaderSize];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        throw std::runtime_error("KTX2: failed to read " + filename);
+    }
+    return static_cast<vk::Format>(ParseHeader(header, sizeof(header)).vkFormat);
+}
+
+std::optional<TextureFormatInfo> GetTextureFormatInfo(vk::Format format) {
+    using F = vk::Format;
+    switch (format) {
+    case F::eR8G8B8A8Unorm: return TextureFormatInfo{ 1, 1, 4, false, std::nullopt };
+    case F::eR8G8B8A8Srgb: return TextureFormatInfo{ 1, 1, 4, true, std::nullopt };
+    case F::eBc1RgbUnormBlock: return TextureFormatInfo{ 4, 4, 8, false, BlockFormat::BC1 };
+    case F::eBc1RgbSrgbBlock: return TextureFormatInfo{ 4, 4, 8, true, BlockFormat::BC1 };
+    case F::eBc1RgbaUnormBlock: return TextureFormatInfo{ 4, 4, 8, false, BlockFormat::BC1A };
+    case F::eBc1RgbaSrgbBlock: return TextureFormatInfo{ 4, 4, 8, true, BlockFormat::BC1A };
+    case F::eBc3UnormBlock: return TextureFormatInfo{ 4, 4, 16, false, BlockFormat::BC3 };
+    case F::eBc3SrgbBlock: return TextureFormatInfo{ 4, 4, 16, true, BlockFormat::BC3 };
+    case F::eBc7UnormBlock: return TextureFormatInfo{ 4, 4, 16, false, BlockFormat::BC7 };
+    case F::eBc7SrgbBlock: return TextureFormatInfo{ 4, 4, 16, true, BlockFormat::BC7 };
+    case F::eEtc2R8G8B8UnormBlock: return TextureFormatInfo{ 4, 4, 8, false, BlockFormat::ETC2_RGB8 };
+    case F::eEtc2R8G8B8SrgbBlock: return TextureFormatInfo{ 4, 4, 8, true, BlockFormat::ETC2_RGB8 };
+    case F::eEtc2R8G8B8A8UnormBlock: return TextureFormatInfo{ 4, 4, 16, false, BlockFormat::ETC2_RGBA8 };
+    case F::eEtc2R8G8B8A8SrgbBlock: return TextureFormatInfo{ 4, 4, 16, true, BlockFormat::ETC2_RGBA8 };
+    case F::eAstc4x4UnormBlock: return TextureFormatInfo{ 4, 4, 16, false, std::nullopt };
+    case F::eAstc4x4SrgbBlock: return TextureFormatInfo{ 4, 4, 16, true, std::nullopt };
+    case F::eAstc6x6UnormBlock: return TextureFormatInfo{ 6, 6, 16, false, std::nullopt };
+    case F::eAstc6x6SrgbBlock: return TextureFormatInfo{ 6, 6, 16, true, std::nullopt };
+    case F::eAstc8x8UnormBlock: return TextureFormatInfo{ 8, 8, 16, false, std::nullopt };
+    case F::eAstc8x8SrgbBlock: return TextureFormatInfo{ 8, 8, 16, true, std::nullopt };
+    default: return std::nullopt;
+    }
+}
+
+size_t TextureLevelSize(const TextureFormatInfo& info, uint32_t w, uint32_t h) {
+    size_t blocksX = (w + info.blockWidth - 1) / info.blockWidth;
+    size_t blocksY = (h + info.blockHeight - 1) / info.blockHeight;
+    return blocksX * blocksY * info.blockBytes;
+}
+
+bool IsFormatSampleable(vk::Format format) {
+    auto features = Context::GetInstance().GetPhyDevice().getFormatProperties(format).optimalTilingFeatures;
+    auto required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (features & required) == required;
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef __KTX2_H__
+#define __KTX2_H__
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "math/block_decode.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief KTX2 容器
+ * 只支持单张 2D 纹理: 没有数组层/立方体面/深度, 也没有超压缩 (Basis/zstd);
+ * 各 mip 层直接指向传入的文件数据, 不做任何拷贝, 数据必须在 Ktx2Image 使用期间保持有效
+ */
+struct Ktx2Image {
+    struct Level {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    vk::Format format;
+    uint32_t width;
+    uint32_t height;
+    std::vector<Level> levels; // 第 0 层为原图
+};
+
+// 开头是否为 KTX2 的文件标识
+bool IsKtx2(const uint8_t* data, size_t size);
+// 格式不符合上面的限制或数据越界时抛出 std::runtime_error
+Ktx2Image ParseKtx2(const uint8_t* data, size_t size);
+// 只读文件头, 用于在多个候选文件中挑选设备支持的格式
+vk::Format ReadKtx2Format(const std::string& filename);
+
+struct TextureFormatInfo {
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    uint32_t blockBytes;
+    bool srgb;
+    std::optional<BlockFormat> decoder; // 没有 CPU 解码器时为空 (ASTC)
+};
+
+// 支持的格式: RGBA8, BC1/BC3/BC7, ETC2 RGB8/RGBA8, ASTC 4x4/6x6/8x8 (均含 sRGB 变体)
+std::optional<TextureFormatInfo> GetTextureFormatInfo(vk::Format format);
+// w x h 的一层在该格式下的字节数
+size_t TextureLevelSize(const TextureFormatInfo& info, uint32_t w, uint32_t h);
+// 设备能否直接以 optimal tiling 采样 (含线性过滤) 该格式
+bool IsFormatSampleable(vk::Format format);
+
+}
+
+#endif // __KTX2_H__
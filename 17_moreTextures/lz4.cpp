@@ -0,0 +1,153 @@
+#include "lz4.hpp"
+#include <cstring>
+
+namespace toy2d {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5; // 最后 5 个字节必须是字面量
+constexpr size_t kMatchLimit = 12;  // 最后一个匹配必须在结尾前 12 字节之前开始
+constexpr int kHashBits = 16;
+constexpr size_t kMaxOffset = 65535;
+
+uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t Hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// 长度字段: token 里放不下的部分用 255 的序列补上
+void WriteLength(std::vector<uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength,
+                   size_t offset, size_t matchLength) {
+    size_t tokenPos = out.size();
+    out.push_back(0);
+    uint8_t token = static_cast<uint8_t>(literalLength >= 15 ? 15 : literalLength) << 4;
+    if (literalLength >= 15) {
+        WriteLength(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+
+    if (matchLength > 0) {
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        size_t code = matchLength - kMinMatch;
+        token |= static_cast<uint8_t>(code >= 15 ? 15 : code);
+        if (code >= 15) {
+            WriteLength(out, code - 15);
+        }
+    }
+    out[tokenPos] = token;
+}
+
+}
+
+std::vector<uint8_t> Lz4Compress(const uint8_t* src, size_t size) {
+    std::vector<uint8_t> out;
+    out.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+    if (size > kMatchLimit) {
+        std::vector<uint32_t> table(size_t(1) << kHashBits, UINT32_MAX);
+        const size_t matchEnd = size - kLastLiterals;
+        size_t pos = 0;
+        while (pos + kMatchLimit <= size) {
+            uint32_t sequence = Read32(src + pos);
+            uint32_t h = Hash(sequence);
+            size_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(pos);
+            if (candidate == UINT32_MAX || pos - candidate > kMaxOffset || Read32(src + candidate) != sequence) {
+                pos++;
+                continue;
+            }
+
+            size_t length = kMinMatch;
+            while (pos + length < matchEnd && src[candidate + length] == src[pos + length]) {
+                length++;
+            }
+            WriteSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    // 剩下的全部作为最后一个只有字面量的序列
+    WriteSequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool Lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+    const uint8_t* ip = src;
+    const uint8_t* const ipEnd = src + srcSize;
+    size_t op = 0;
+
+    auto readLength = [&](size_t& length) {
+        uint8_t extra;
+        do {
+            if (ip >= ipEnd) {
+                return false;
+            }
+            extra = *ip++;
+            length += extra;
+        } while (extra == 255);
+        return true;
+    };
+
+    while (ip < ipEnd) {
+        uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(ipEnd - ip) || literalLength > dstSize - op) {
+            return false;
+        }
+        memcpy(dst + op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == ipEnd) {
+            break; // 最后一个序列没有匹配部分
+        }
+
+        if (ipEnd - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength)) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if (matchLength > dstSize - op) {
+            return false;
+        }
+        // 匹配可能与输出重叠 (offset < matchLength), 只能逐字节拷贝
+        const uint8_t* match = dst + op - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            dst[op + i] = match[i];
+        }
+        op += matchLength;
+    }
+    return op == dstSize;
+}
+
+}
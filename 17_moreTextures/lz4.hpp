@@ -0,0 +1,21 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace toy2d {
+
+/**
+ * LZ4 block 格式 (不含 frame 头), 与官方实现的 LZ4_compress_default / LZ4_decompress_safe 互通.
+ * 压缩只做单个哈希表的贪心匹配, 只在打包工具里用; 解压会检查所有越界
+ */
+std::vector<uint8_t> Lz4Compress(const uint8_t* src, size_t size);
+
+// dst 必须正好是原始大小, 数据损坏或大小不符时返回 false
+bool Lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+}
+
+#endif // __LZ4_H__
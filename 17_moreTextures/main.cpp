@@ -1,4 +1,5 @@
 ﻿#include "toy2d.h"
+#include "profiler.hpp"
 #include "SDL.h"
 #include "SDL_vulkan.h"
 #include <vector>
@@ -22,7 +23,7 @@ int main()
         SDL_WINDOWPOS_UNDEFINED, // 默认居中
         SDL_WINDOWPOS_UNDEFINED,
         width, height,
-        SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN);
+        SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_Log("can not create window, err:%s\n", SDL_GetError());
         return 1;
@@ -58,7 +59,9 @@ int main()
     float x = 100, y = 100;
 
     toy2d::Texture* texture1 = toy2d::LoadTexture(S_PATH("resources/role.png"));
-    toy2d::Texture* texture2 = toy2d::LoadTexture(S_PATH("resources/texture.jpg"));
+    // 第二张图异步加载, 就绪之前先用第一张图占位
+    toy2d::Texture* texture2 = toy2d::LoadTextureAsync(S_PATH("resources/texture.jpg"));
+    toyRenderer.SetPlaceholderTexture(texture1);
 
     toyRenderer.SetDrawColor(toy2d::Color{ 1, 1, 1 });
     while (b_exit)
@@ -68,6 +71,11 @@ int main()
             b_exit = false;
             break;
         }
+        else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+            int w = event.window.data1, h = event.window.data2;
+            toyRenderer.Resize(w, h);
+            toyRenderer.SetProject(w, 0, 0, h, -1, 1);
+        }
         else if (event.type == SDL_KEYDOWN) {
             // 注意：需要英文输入法
             if (event.key.keysym.sym == SDLK_a) {
@@ -94,6 +102,62 @@ int main()
             if (event.key.keysym.sym == SDLK_3) {
                 toyRenderer.SetDrawColor(toy2d::Color{ 1, 1, 1 });
             }
+            if (event.key.keysym.sym == SDLK_b) {
+                // 切换批处理模式, 并输出上一帧的绘制统计
+                auto& stats = toyRenderer.GetStats();
+                std::cout << "sprites: " << stats.spritesSubmitted << ", draws: " << stats.drawCalls
+                          << ", record: " << stats.recordMs << "ms (" << stats.recordTasks << " tasks)"
+                          << ", barriers: " << stats.barriers << std::endl;
+                toyRenderer.SetBatchMode(!toyRenderer.IsBatchMode());
+            }
+            if (event.key.keysym.sym == SDLK_m) {
+                auto stats = toy2d::GetMemoryStats();
+                std::cout << "memory blocks: " << stats.blockCount << ", dedicated: " << stats.dedicatedCount
+                          << ", allocations: " << stats.allocationCount << ", used: " << stats.usedBytes
+                          << ", free: " << stats.freeBytes << ", fragmentation: " << stats.fragmentation << std::endl;
+            }
+            if (event.key.keysym.sym == SDLK_t) {
+                // 未开启 TOY2D_ENABLE_PROFILER 时什么都不做
+                if (!TOY2D_PROFILE_EXPORT(S_PATH("trace.json"))) {
+                    std::cout << "profiler disabled, rebuild with -DTOY2D_ENABLE_PROFILER=ON" << std::endl;
+                }
+            }
+            if (event.key.keysym.sym == SDLK_p) {
+                toyRenderer.SetParallelMode(!toyRenderer.IsParallelMode());
+                std::cout << "parallel record: " << toyRenderer.IsParallelMode() << ", threads: "
+                          << toyRenderer.GetRecordThreadCount() << std::endl;
+            }
+            if (event.key.keysym.sym == SDLK_n) {
+                toyRenderer.SetBindlessMode(!toyRenderer.IsBindlessMode());
+            }
+            if (event.key.keysym.sym == SDLK_c) {
+                toyRenderer.SetCullMode(!toyRenderer.IsCullMode());
+                std::cout << "gpu cull: " << toyRenderer.IsCullMode() << ", visible: "
+                          << toyRenderer.GetStats().spritesVisible << std::endl;
+            }
+            if (event.key.keysym.sym == SDLK_l) {
+                // 依次切换 Opaque -> Alpha -> Additive -> Multiply -> LogicCopy, 不支持的模式会被跳过
+                auto mode = toyRenderer.GetBlendMode();
+                for (int i = 1; i < 5 && toyRenderer.GetBlendMode() == mode; i++) {
+                    toyRenderer.SetBlendMode(static_cast<toy2d::BlendMode>((static_cast<int>(mode) + i) % 5));
+                }
+                auto stats = toy2d::GetPipelineStats();
+                std::cout << "blend mode: " << static_cast<int>(toyRenderer.GetBlendMode()) << ", pipelines: "
+                          << stats.pipelines << ", stalls: " << stats.stalls << std::endl;
+            }
+            if (event.key.keysym.sym == SDLK_o) {
+                // 离屏模糊 0 -> 1 -> 2 -> 0 轮, 输出上一帧临时图像别名前后的显存
+                toyRenderer.SetPostBlur((toyRenderer.GetPostBlur() + 1) % 3);
+                auto& stats = toyRenderer.GetStats();
+                std::cout << "post blur: " << toyRenderer.GetPostBlur() << ", transient: " << stats.transientBytes
+                          << " bytes (unaliased " << stats.unaliasedBytes << ")" << std::endl;
+            }
+            if (event.key.keysym.sym == SDLK_f) {
+                // 飞行帧数 1 -> 2 -> 3 -> 4 -> 1, 输出上一帧等待 GPU 的时间
+                toyRenderer.SetFramesInFlight(toyRenderer.GetFramesInFlight() % toy2d::FrameScheduler::MaxFramesInFlight + 1);
+                std::cout << "frames in flight: " << toyRenderer.GetFramesInFlight() << ", wait: "
+                          << toyRenderer.GetStats().waitMs << "ms" << std::endl;
+            }
         }
         //toyRenderer.DrawRect(toy2d::Rect{ toy2d::Vec{x, y},
         //                               toy2d::Size{200, 200} });
@@ -0,0 +1,112 @@
+#include "batch.hpp"
+#include "simd.hpp"
+
+namespace toy2d {
+
+static constexpr float kCorners[4][2] = {
+    { -0.5f, -0.5f },
+    {  0.5f, -0.5f },
+    {  0.5f,  0.5f },
+    { -0.5f,  0.5f },
+};
+
+void SplitRects(const Rect* rects, size_t count, float* x, float* y, float* w, float* h) {
+    static_assert(sizeof(Rect) == sizeof(float) * 4, "Rect must be 4 tightly packed floats");
+    using namespace simd;
+    const float* src = reinterpret_cast<const float*>(rects);
+
+    // 一次读 4 个矩形, 4x4 转置后正好是 4 个分量
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        Float4 r0 = Load4(src + i * 4);
+        Float4 r1 = Load4(src + i * 4 + 4);
+        Float4 r2 = Load4(src + i * 4 + 8);
+        Float4 r3 = Load4(src + i * 4 + 12);
+        Transpose4(r0, r1, r2, r3);
+        Store4(x + i, r0);
+        Store4(y + i, r1);
+        Store4(w + i, r2);
+        Store4(h + i, r3);
+    }
+    for (; i < count; i++) {
+        x[i] = rects[i].position.x;
+        y[i] = rects[i].position.y;
+        w[i] = rects[i].size.w;
+        h[i] = rects[i].size.h;
+    }
+}
+
+void BatchRectsToAffine(const RectSoA& rects, size_t count, const Mat4& transform, const AffineSoA& out) {
+    using namespace simd;
+    const float a = transform.Get(0, 0), b = transform.Get(0, 1);
+    const float c = transform.Get(1, 0), d = transform.Get(1, 1);
+    const float tx = transform.Get(3, 0), ty = transform.Get(3, 1);
+
+    const FloatN va = SetN(a), vb = SetN(b), vc = SetN(c), vd = SetN(d);
+    const FloatN vtx = SetN(tx), vty = SetN(ty);
+
+    size_t i = 0;
+    for (; i + Width <= count; i += Width) {
+        FloatN x = LoadN(rects.x + i);
+        FloatN y = LoadN(rects.y + i);
+        FloatN w = LoadN(rects.w + i);
+        FloatN h = LoadN(rects.h + i);
+        StoreN(out.m00 + i, va * w);
+        StoreN(out.m10 + i, vb * w);
+        StoreN(out.m01 + i, vc * h);
+        StoreN(out.m11 + i, vd * h);
+        StoreN(out.tx + i, MulAdd(vc, y, MulAdd(va, x, vtx)));
+        StoreN(out.ty + i, MulAdd(vd, y, MulAdd(vb, x, vty)));
+    }
+    for (; i < count; i++) {
+        float x = rects.x[i], y = rects.y[i], w = rects.w[i], h = rects.h[i];
+        out.m00[i] = a * w;
+        out.m10[i] = b * w;
+        out.m01[i] = c * h;
+        out.m11[i] = d * h;
+        out.tx[i] = a * x + c * y + tx;
+        out.ty[i] = b * x + d * y + ty;
+    }
+}
+
+void BatchRectsToQuads(const RectSoA& rects, size_t count, const Mat4& transform, const QuadSoA& out) {
+    using namespace simd;
+    const float a = transform.Get(0, 0), b = transform.Get(0, 1);
+    const float c = transform.Get(1, 0), d = transform.Get(1, 1);
+    const float tx = transform.Get(3, 0), ty = transform.Get(3, 1);
+
+    const FloatN va = SetN(a), vb = SetN(b), vc = SetN(c), vd = SetN(d);
+    const FloatN vtx = SetN(tx), vty = SetN(ty);
+    FloatN cornerX[4], cornerY[4];
+    for (int k = 0; k < 4; k++) {
+        cornerX[k] = SetN(kCorners[k][0]);
+        cornerY[k] = SetN(kCorners[k][1]);
+    }
+
+    // 角点 = 中心 + cx * 第 0 列 + cy * 第 1 列, 先算出仿射再展开 4 个角
+    size_t i = 0;
+    for (; i + Width <= count; i += Width) {
+        FloatN x = LoadN(rects.x + i);
+        FloatN y = LoadN(rects.y + i);
+        FloatN w = LoadN(rects.w + i);
+        FloatN h = LoadN(rects.h + i);
+        FloatN m00 = va * w, m10 = vb * w, m01 = vc * h, m11 = vd * h;
+        FloatN cx = MulAdd(vc, y, MulAdd(va, x, vtx));
+        FloatN cy = MulAdd(vd, y, MulAdd(vb, x, vty));
+        for (int k = 0; k < 4; k++) {
+            StoreN(out.x[k] + i, MulAdd(cornerY[k], m01, MulAdd(cornerX[k], m00, cx)));
+            StoreN(out.y[k] + i, MulAdd(cornerY[k], m11, MulAdd(cornerX[k], m10, cy)));
+        }
+    }
+    for (; i < count; i++) {
+        float x = rects.x[i], y = rects.y[i], w = rects.w[i], h = rects.h[i];
+        float cx = a * x + c * y + tx;
+        float cy = b * x + d * y + ty;
+        for (int k = 0; k < 4; k++) {
+            out.x[k][i] = cx + kCorners[k][0] * a * w + kCorners[k][1] * c * h;
+            out.y[k][i] = cy + kCorners[k][0] * b * w + kCorners[k][1] * d * h;
+        }
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include "math.hpp"
+
+/**
+ * 精灵矩形的批量变换, 数据按 SoA (每个分量一个数组) 排列, 内部用 simd.hpp 一次处理 Width 个精灵
+ *
+ * 精灵模型矩阵固定为 Translate(position) * Scale(size), 单位方块的角点为 (±0.5, ±0.5),
+ * 与渲染器 kVertices 一致. transform 一般是 projection * view, 只使用其中的 2D 仿射部分
+ */
+
+namespace toy2d {
+
+struct RectSoA {
+    const float* x; // 中心点
+    const float* y;
+    const float* w;
+    const float* h;
+};
+
+// 2x3 仿射矩阵, 列主序: [m00 m01 tx; m10 m11 ty]
+struct AffineSoA {
+    float* m00;
+    float* m10;
+    float* m01;
+    float* m11;
+    float* tx;
+    float* ty;
+};
+
+// 每个角点一组 x/y 数组, 第 i 个精灵的第 c 个角点在 x[c][i], y[c][i], 角点顺序与 kVertices 相同
+struct QuadSoA {
+    float* x[4];
+    float* y[4];
+};
+
+// 把 AoS 的 Rect 数组拆成 4 个分量数组
+void SplitRects(const Rect* rects, size_t count, float* x, float* y, float* w, float* h);
+
+// 每个精灵的 transform * Translate(position) * Scale(size), 结果为 2D 仿射
+void BatchRectsToAffine(const RectSoA& rects, size_t count, const Mat4& transform, const AffineSoA& out);
+
+// 每个精灵 4 个角点经过 transform 后的最终坐标 (正交投影下即裁剪空间坐标)
+void BatchRectsToQuads(const RectSoA& rects, size_t count, const Mat4& transform, const QuadSoA& out);
+
+}
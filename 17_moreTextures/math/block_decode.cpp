@@ -0,0 +1,588 @@
+#include "block_decode.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace toy2d {
+
+namespace {
+
+// 一个块解出的 16 个像素, 行优先
+using Texels = uint8_t[16][4];
+
+uint8_t Clamp255(int v) {
+    return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+
+uint16_t ReadLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t ReadBE64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+void Expand565(uint16_t c, uint8_t* rgb) {
+    uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+    rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+    rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+}
+
+// ---------------------------------------------------------------- BC1/BC3
+
+// forceFourColor: BC2/BC3 里的颜色块总是 4 色模式
+void DecodeBC1Color(const uint8_t* block, bool forceFourColor, bool punchThrough, Texels out) {
+    uint16_t c0 = ReadLE16(block);
+    uint16_t c1 = ReadLE16(block + 2);
+    uint32_t indices = ReadLE32(block + 4);
+
+    uint8_t palette[4][4];
+    Expand565(c0, palette[0]);
+    Expand565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    if (c0 > c1 || forceFourColor) {
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+            palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+        }
+        palette[2][3] = palette[3][3] = 255;
+    }
+    else {
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+            palette[3][c] = 0;
+        }
+        palette[2][3] = 255;
+        palette[3][3] = punchThrough ? 0 : 255;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        memcpy(out[i], palette[(indices >> (2 * i)) & 3], 4);
+    }
+}
+
+// BC3/BC4 的 8 字节 alpha 块, 写入 out[i][channel]
+void DecodeBC4Channel(const uint8_t* block, int channel, Texels out) {
+    int a0 = block[0], a1 = block[1];
+    int palette[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (int i = 1; i <= 6; i++) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+    }
+    else {
+        for (int i = 1; i <= 4; i++) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (int i = 0; i < 16; i++) {
+        out[i][channel] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+    }
+}
+
+// ---------------------------------------------------------------- BC7
+
+struct BC7Mode {
+    int subsets;
+    int partitionBits;
+    int rotationBits;
+    int indexSelectionBits;
+    int colorBits;
+    int alphaBits;
+    int endpointPBits; // 每个端点一个 p 位
+    int sharedPBits;   // 每个子集一个 p 位
+    int indexBits;
+    int indexBits2;    // 模式 4/5 的第二组下标
+};
+
+constexpr BC7Mode kBC7Modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// 2 子集划分, 第 i 位为像素 i 所属子集
+constexpr uint16_t kBC7Partitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+constexpr uint8_t kBC7Partitions3[64][16] = {
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+    { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+    { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+    { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+};
+
+// 各子集的锚点像素 (下标最高位隐含为 0), 子集 0 的锚点总是像素 0
+constexpr uint8_t kBC7Anchor2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+constexpr uint8_t kBC7Anchor3a[64] = {
+     3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+     3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+     8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+     3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+
+constexpr uint8_t kBC7Anchor3b[64] = {
+    15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+    15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+    15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+    15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+constexpr uint8_t kBC7Weights2[4] = { 0, 21, 43, 64 };
+constexpr uint8_t kBC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+constexpr uint8_t kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 128 位小端, 从最低位开始读
+class BitReader {
+public:
+    explicit BitReader(const uint8_t* block) : m_lo(0), m_hi(0), m_pos(0) {
+        for (int i = 0; i < 8; i++) {
+            m_lo |= static_cast<uint64_t>(block[i]) << (8 * i);
+            m_hi |= static_cast<uint64_t>(block[8 + i]) << (8 * i);
+        }
+    }
+
+    uint32_t Read(int bits) {
+        uint32_t v = 0;
+        for (int i = 0; i < bits; i++, m_pos++) {
+            uint64_t word = m_pos < 64 ? m_lo : m_hi;
+            v |= static_cast<uint32_t>((word >> (m_pos & 63)) & 1) << i;
+        }
+        return v;
+    }
+
+private:
+    uint64_t m_lo;
+    uint64_t m_hi;
+    int m_pos;
+};
+
+uint8_t BC7Interpolate(int e0, int e1, int indexBits, uint32_t index) {
+    const uint8_t* weights = indexBits == 2 ? kBC7Weights2 : indexBits == 3 ? kBC7Weights3 : kBC7Weights4;
+    int w = weights[index];
+    return static_cast<uint8_t>(((64 - w) * e0 + w * e1 + 32) >> 6);
+}
+
+void DecodeBC7(const uint8_t* block, Texels out) {
+    int modeIndex = 0;
+    while (modeIndex < 8 && !(block[0] & (1 << modeIndex))) {
+        modeIndex++;
+    }
+    if (modeIndex == 8) {
+        // 保留的模式, 规范要求解出全 0
+        memset(out, 0, sizeof(Texels));
+        return;
+    }
+    const BC7Mode& mode = kBC7Modes[modeIndex];
+
+    BitReader bits(block);
+    bits.Read(modeIndex + 1);
+    uint32_t partition = bits.Read(mode.partitionBits);
+    uint32_t rotation = bits.Read(mode.rotationBits);
+    uint32_t indexSelection = bits.Read(mode.indexSelectionBits);
+
+    // 端点顺序: 子集 0 的两个端点, 子集 1 的两个端点...
+    int endpoints[6][4] = {};
+    const int endpointCount = mode.subsets * 2;
+    for (int c = 0; c < 3; c++) {
+        for (int e = 0; e < endpointCount; e++) {
+            endpoints[e][c] = static_cast<int>(bits.Read(mode.colorBits));
+        }
+    }
+    if (mode.alphaBits) {
+        for (int e = 0; e < endpointCount; e++) {
+            endpoints[e][3] = static_cast<int>(bits.Read(mode.alphaBits));
+        }
+    }
+
+    int pbits[6] = {};
+    if (mode.endpointPBits) {
+        for (int e = 0; e < endpointCount; e++) {
+            pbits[e] = static_cast<int>(bits.Read(1));
+        }
+    }
+    else if (mode.sharedPBits) {
+        for (int s = 0; s < mode.subsets; s++) {
+            pbits[s * 2] = pbits[s * 2 + 1] = static_cast<int>(bits.Read(1));
+        }
+    }
+    const bool hasPBit = mode.endpointPBits || mode.sharedPBits;
+
+    // 加上 p 位后把高位复制到低位, 扩展成 8 位
+    for (int e = 0; e < endpointCount; e++) {
+        for (int c = 0; c < 4; c++) {
+            int precision = c < 3 ? mode.colorBits : mode.alphaBits;
+            if (precision == 0) {
+                endpoints[e][c] = 255;
+                continue;
+            }
+            int v = endpoints[e][c];
+            if (hasPBit) {
+                v = (v << 1) | pbits[e];
+                precision++;
+            }
+            v <<= 8 - precision;
+            endpoints[e][c] = v | (v >> precision);
+        }
+    }
+
+    uint8_t subsetOf[16] = {};
+    for (int i = 0; i < 16; i++) {
+        if (mode.subsets == 2) {
+            subsetOf[i] = static_cast<uint8_t>((kBC7Partitions2[partition] >> i) & 1);
+        }
+        else if (mode.subsets == 3) {
+            subsetOf[i] = kBC7Partitions3[partition][i];
+        }
+    }
+    auto isAnchor = [&](int i) {
+        if (i == 0) {
+            return true;
+        }
+        if (mode.subsets == 2) {
+            return i == kBC7Anchor2[partition];
+        }
+        if (mode.subsets == 3) {
+            return i == kBC7Anchor3a[partition] || i == kBC7Anchor3b[partition];
+        }
+        return false;
+    };
+
+    uint32_t indices[16];
+    for (int i = 0; i < 16; i++) {
+        indices[i] = bits.Read(mode.indexBits - (isAnchor(i) ? 1 : 0));
+    }
+    uint32_t indices2[16] = {};
+    if (mode.indexBits2) {
+        for (int i = 0; i < 16; i++) {
+            indices2[i] = bits.Read(mode.indexBits2 - (i == 0 ? 1 : 0));
+        }
+    }
+
+    for (int i = 0; i < 16; i++) {
+        const int* e0 = endpoints[subsetOf[i] * 2];
+        const int* e1 = endpoints[subsetOf[i] * 2 + 1];
+        uint32_t colorIndex = indices[i];
+        int colorIndexBits = mode.indexBits;
+        uint32_t alphaIndex = indices[i];
+        int alphaIndexBits = mode.indexBits;
+        if (mode.indexBits2) {
+            // 模式 4/5: 颜色与 alpha 各用一组下标, indexSelection 决定哪组给颜色
+            alphaIndex = indices2[i];
+            alphaIndexBits = mode.indexBits2;
+            if (indexSelection) {
+                std::swap(colorIndex, alphaIndex);
+                std::swap(colorIndexBits, alphaIndexBits);
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            out[i][c] = BC7Interpolate(e0[c], e1[c], colorIndexBits, colorIndex);
+        }
+        out[i][3] = BC7Interpolate(e0[3], e1[3], alphaIndexBits, alphaIndex);
+        if (rotation) {
+            std::swap(out[i][3], out[i][rotation - 1]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------- ETC2/EAC
+
+constexpr int kEtcModifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+constexpr int kEtcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+constexpr int kEacModifiers[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+uint32_t Bits(uint64_t v, int high, int low) {
+    return static_cast<uint32_t>((v >> low) & ((1ull << (high - low + 1)) - 1));
+}
+
+int Extend4(uint32_t v) { return static_cast<int>((v << 4) | v); }
+int Extend5(uint32_t v) { return static_cast<int>((v << 3) | (v >> 2)); }
+int Extend6(uint32_t v) { return static_cast<int>((v << 2) | (v >> 4)); }
+int Extend7(uint32_t v) { return static_cast<int>((v << 1) | (v >> 6)); }
+
+// ETC 的像素下标按列排列: 像素 (x, y) 在第 x * 4 + y 位
+uint32_t EtcPixelIndex(uint64_t block, int x, int y) {
+    int p = x * 4 + y;
+    return (Bits(block, 16 + p, 16 + p) << 1) | Bits(block, p, p);
+}
+
+void DecodeEtc2Planar(uint64_t block, Texels out) {
+    int o[3] = {
+        Extend6(Bits(block, 62, 57)),
+        Extend7((Bits(block, 56, 56) << 6) | Bits(block, 54, 49)),
+        Extend6((Bits(block, 48, 48) << 5) | (Bits(block, 44, 43) << 3) | Bits(block, 41, 39)),
+    };
+    int h[3] = {
+        Extend6((Bits(block, 38, 34) << 1) | Bits(block, 32, 32)),
+        Extend7(Bits(block, 31, 25)),
+        Extend6(Bits(block, 24, 19)),
+    };
+    int v[3] = {
+        Extend6(Bits(block, 18, 13)),
+        Extend7(Bits(block, 12, 6)),
+        Extend6(Bits(block, 5, 0)),
+    };
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            uint8_t* texel = out[y * 4 + x];
+            for (int c = 0; c < 3; c++) {
+                texel[c] = Clamp255((x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2);
+            }
+            texel[3] = 255;
+        }
+    }
+}
+
+// T/H 模式: 4 个调色板颜色, 像素下标直接选颜色
+void DecodeEtc2Paint(uint64_t block, bool hMode, Texels out) {
+    int c1[3], c2[3];
+    int distance;
+    if (!hMode) {
+        c1[0] = Extend4((Bits(block, 60, 59) << 2) | Bits(block, 57, 56));
+        c1[1] = Extend4(Bits(block, 55, 52));
+        c1[2] = Extend4(Bits(block, 51, 48));
+        c2[0] = Extend4(Bits(block, 47, 44));
+        c2[1] = Extend4(Bits(block, 43, 40));
+        c2[2] = Extend4(Bits(block, 39, 36));
+        distance = kEtcDistances[(Bits(block, 35, 34) << 1) | Bits(block, 32, 32)];
+    }
+    else {
+        uint32_t r1 = Bits(block, 62, 59);
+        uint32_t g1 = (Bits(block, 58, 56) << 1) | Bits(block, 52, 52);
+        uint32_t b1 = (Bits(block, 51, 51) << 3) | Bits(block, 49, 47);
+        uint32_t r2 = Bits(block, 46, 43);
+        uint32_t g2 = Bits(block, 42, 39);
+        uint32_t b2 = Bits(block, 38, 35);
+        // 距离下标的最低位由两个颜色的大小关系隐含
+        uint32_t order = ((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2) ? 1 : 0;
+        distance = kEtcDistances[(Bits(block, 34, 34) << 2) | (Bits(block, 32, 32) << 1) | order];
+        c1[0] = Extend4(r1);
+        c1[1] = Extend4(g1);
+        c1[2] = Extend4(b1);
+        c2[0] = Extend4(r2);
+        c2[1] = Extend4(g2);
+        c2[2] = Extend4(b2);
+    }
+
+    uint8_t palette[4][3];
+    for (int c = 0; c < 3; c++) {
+        if (!hMode) {
+            palette[0][c] = static_cast<uint8_t>(c1[c]);
+            palette[1][c] = Clamp255(c2[c] + distance);
+            palette[2][c] = static_cast<uint8_t>(c2[c]);
+            palette[3][c] = Clamp255(c2[c] - distance);
+        }
+        else {
+            palette[0][c] = Clamp255(c1[c] + distance);
+            palette[1][c] = Clamp255(c1[c] - distance);
+            palette[2][c] = Clamp255(c2[c] + distance);
+            palette[3][c] = Clamp255(c2[c] - distance);
+        }
+    }
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            uint8_t* texel = out[y * 4 + x];
+            memcpy(texel, palette[EtcPixelIndex(block, x, y)], 3);
+            texel[3] = 255;
+        }
+    }
+}
+
+void DecodeEtc2Color(const uint8_t* data, Texels out) {
+    uint64_t block = ReadBE64(data);
+    int base[2][3];
+    bool diff = Bits(block, 33, 33) != 0;
+    if (!diff) {
+        for (int c = 0; c < 3; c++) {
+            base[0][c] = Extend4(Bits(block, 63 - c * 8, 60 - c * 8));
+            base[1][c] = Extend4(Bits(block, 59 - c * 8, 56 - c * 8));
+        }
+    }
+    else {
+        for (int c = 0; c < 3; c++) {
+            int v = static_cast<int>(Bits(block, 63 - c * 8, 59 - c * 8));
+            int d = static_cast<int>(Bits(block, 58 - c * 8, 56 - c * 8));
+            d = d >= 4 ? d - 8 : d;
+            if (v + d < 0 || v + d > 31) {
+                // 差分溢出表示 ETC2 新增的模式: R 溢出为 T, G 为 H, B 为 planar
+                if (c == 2) {
+                    DecodeEtc2Planar(block, out);
+                }
+                else {
+                    DecodeEtc2Paint(block, c == 1, out);
+                }
+                return;
+            }
+            base[0][c] = Extend5(static_cast<uint32_t>(v));
+            base[1][c] = Extend5(static_cast<uint32_t>(v + d));
+        }
+    }
+
+    const int tables[2] = { static_cast<int>(Bits(block, 39, 37)), static_cast<int>(Bits(block, 36, 34)) };
+    bool flip = Bits(block, 32, 32) != 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            // flip 为 0 时左右两个 2x4 子块, 为 1 时上下两个 4x2 子块
+            int sub = flip ? (y >= 2) : (x >= 2);
+            uint32_t index = EtcPixelIndex(block, x, y);
+            int modifier = kEtcModifiers[tables[sub]][index & 1];
+            if (index & 2) {
+                modifier = -modifier;
+            }
+            uint8_t* texel = out[y * 4 + x];
+            for (int c = 0; c < 3; c++) {
+                texel[c] = Clamp255(base[sub][c] + modifier);
+            }
+            texel[3] = 255;
+        }
+    }
+}
+
+void DecodeEacAlpha(const uint8_t* data, Texels out) {
+    uint64_t block = ReadBE64(data);
+    int base = static_cast<int>(Bits(block, 63, 56));
+    int multiplier = static_cast<int>(Bits(block, 55, 52));
+    const int* modifiers = kEacModifiers[Bits(block, 51, 48)];
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            int p = x * 4 + y;
+            uint32_t index = Bits(block, 47 - 3 * p, 45 - 3 * p);
+            out[y * 4 + x][3] = Clamp255(base + modifiers[index] * multiplier);
+        }
+    }
+}
+
+void DecodeBlock(BlockFormat format, const uint8_t* block, Texels out) {
+    switch (format) {
+    case BlockFormat::BC1:
+        DecodeBC1Color(block, false, false, out);
+        break;
+    case BlockFormat::BC1A:
+        DecodeBC1Color(block, false, true, out);
+        break;
+    case BlockFormat::BC3:
+        DecodeBC1Color(block + 8, true, false, out);
+        DecodeBC4Channel(block, 3, out);
+        break;
+    case BlockFormat::BC7:
+        DecodeBC7(block, out);
+        break;
+    case BlockFormat::ETC2_RGB8:
+        DecodeEtc2Color(block, out);
+        break;
+    case BlockFormat::ETC2_RGBA8:
+        DecodeEtc2Color(block + 8, out);
+        DecodeEacAlpha(block, out);
+        break;
+    }
+}
+
+}
+
+uint32_t BlockBytes(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC1A:
+    case BlockFormat::ETC2_RGB8:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+void DecodeBlocks(BlockFormat format, const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst) {
+    const uint32_t blocksX = (w + 3) / 4;
+    const uint32_t blocksY = (h + 3) / 4;
+    const uint32_t blockBytes = BlockBytes(format);
+
+    Texels texels;
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            DecodeBlock(format, src + (static_cast<size_t>(by) * blocksX + bx) * blockBytes, texels);
+            // 边长不是 4 的倍数时, 最右/最下的块只取落在图像内的部分
+            uint32_t copyW = std::min(4u, w - bx * 4);
+            uint32_t copyH = std::min(4u, h - by * 4);
+            for (uint32_t y = 0; y < copyH; y++) {
+                memcpy(dst + ((static_cast<size_t>(by) * 4 + y) * w + bx * 4) * 4, texels[y * 4], copyW * 4);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 块压缩纹理的 CPU 解码, 设备不支持某种压缩格式的采样时使用
+ *
+ * 输出为 RGBA8, 不做颜色空间转换 (sRGB 格式解出来仍是 sRGB 编码的值).
+ * ASTC 的块模式太多, 这里不提供解码, 不支持的设备上只能换用其它格式的文件
+ */
+
+namespace toy2d {
+
+enum class BlockFormat {
+    BC1,       // 不透明, c0 <= c1 时第 4 个颜色为黑色
+    BC1A,      // c0 <= c1 时第 4 个颜色为透明黑色
+    BC3,
+    BC7,
+    ETC2_RGB8,
+    ETC2_RGBA8, // ETC2 颜色 + EAC alpha
+};
+
+// 每个 4x4 块的字节数
+uint32_t BlockBytes(BlockFormat format);
+
+// 压缩数据按块行优先排列, 共 ceil(w / 4) x ceil(h / 4) 个块; dst 为 w x h 的 RGBA8
+void DecodeBlocks(BlockFormat format, const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst);
+
+}
@@ -1,4 +1,6 @@
 #include "math.hpp"
+#include "simd.hpp"
+#include <algorithm>
 
 namespace toy2d {
 
@@ -45,7 +47,8 @@ Mat4::Mat4() {
 
 Mat4 Mat4::CreateOnes() {
     Mat4 mat;
-    memset(mat.data_, 1, sizeof(float) * 4 * 4);
+    // memset 按字节填充, 不能用来填 1.0f
+    std::fill(mat.data_, mat.data_ + 4 * 4, 1.0f);
     return mat;
 }
 
@@ -59,9 +62,10 @@ Mat4 Mat4::CreateOrtho(int left, int right, int top, int bottom, int near, int f
     mat.Set(0, 0, static_cast<float>(2.0 / (right - left)));
     mat.Set(1, 1, static_cast<float>(2.0 / (top - bottom)));
     mat.Set(2, 2, static_cast<float>(2.0 / (near - far)));
-    mat.Set(3, 0, static_cast<float>((left + right) / (left - right)));
-    mat.Set(3, 1, static_cast<float>((top + bottom) / (bottom - top)));
-    mat.Set(3, 2, static_cast<float>((near + far) / (far - near)));
+    // 先转成浮点再除, 否则左右不对称时整数除法会截断
+    mat.Set(3, 0, static_cast<float>(static_cast<double>(left + right) / (left - right)));
+    mat.Set(3, 1, static_cast<float>(static_cast<double>(top + bottom) / (bottom - top)));
+    mat.Set(3, 2, static_cast<float>(static_cast<double>(near + far) / (far - near)));
 
     return mat;
 }
@@ -84,18 +88,42 @@ Mat4 Mat4::CreateScale(const Vec& scale) {
     return mat;
 }
 
+Mat4 Mat4::CreateTranslateScale(const Vec& pos, const Vec& scale) {
+    Mat4 mat = CreateIdentity();
+
+    mat.Set(0, 0, scale.x);
+    mat.Set(1, 1, scale.y);
+    mat.Set(3, 0, pos.x);
+    mat.Set(3, 1, pos.y);
+
+    return mat;
+}
+
 Mat4 Mat4::Mul(const Mat4& m) const {
+    // 列主序: 结果的第 j 列 = 本矩阵各列按 m 第 j 列的分量加权求和
+    using namespace simd;
+    Float4 c0 = Load4(data_ + 0);
+    Float4 c1 = Load4(data_ + 4);
+    Float4 c2 = Load4(data_ + 8);
+    Float4 c3 = Load4(data_ + 12);
+
     Mat4 mat;
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            int sum = 0;
-            for (int k = 0; k < 4; k++) {
-                sum += Get(k, i) * m.Get(j, k);
-            }
-            mat.Set(j, i, sum);
-        }
+    for (int j = 0; j < 4; j++) {
+        const float* col = m.data_ + j * 4;
+        Float4 sum = c0 * Set4(col[0]);
+        sum = MulAdd(c1, Set4(col[1]), sum);
+        sum = MulAdd(c2, Set4(col[2]), sum);
+        sum = MulAdd(c3, Set4(col[3]), sum);
+        Store4(mat.data_ + j * 4, sum);
     }
     return mat;
 }
 
+Vec Mat4::TransformPoint(const Vec& p) const {
+    Vec result;
+    result.x = Get(0, 0) * p.x + Get(1, 0) * p.y + Get(3, 0);
+    result.y = Get(0, 1) * p.x + Get(1, 1) * p.y + Get(3, 1);
+    return result;
+}
+
 }
\ No newline at end of file
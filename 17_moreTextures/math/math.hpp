@@ -33,6 +33,8 @@ public:
     static Mat4 CreateOrtho(int left, int right, int top, int bottom, int near, int far);
     static Mat4 CreateTranslate(const Vec&);
     static Mat4 CreateScale(const Vec&);
+    // 等价于 CreateTranslate(pos).Mul(CreateScale(scale)), 但直接填值, 不做矩阵乘法
+    static Mat4 CreateTranslateScale(const Vec& pos, const Vec& scale);
     static Mat4 Create(const std::initializer_list<float>&);
 
     Mat4();
@@ -45,6 +47,8 @@ public:
     }
 
     Mat4 Mul(const Mat4& m) const;
+    // 把 (x, y, 0, 1) 变换后取 x, y, 只适用于仿射变换 (例如正交投影)
+    Vec TransformPoint(const Vec& p) const;
 
 private:
     float data_[4 * 4];
@@ -0,0 +1,106 @@
+#include "mipmap.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace toy2d {
+
+uint32_t MipLevelCount(uint32_t w, uint32_t h) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(w, h); size > 1; size >>= 1) {
+        levels++;
+    }
+    return levels;
+}
+
+size_t MipChainSize(uint32_t w, uint32_t h, uint32_t levels) {
+    size_t size = 0;
+    for (uint32_t i = 0; i < levels; i++) {
+        size += static_cast<size_t>(std::max(w >> i, 1u)) * std::max(h >> i, 1u) * 4;
+    }
+    return size;
+}
+
+void DownsampleRGBA8(const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst) {
+    const uint32_t dw = std::max(w / 2, 1u);
+    const uint32_t dh = std::max(h / 2, 1u);
+#if defined(TOY2D_SIMD_SSE2) || defined(TOY2D_SIMD_NEON)
+    // 源图中 2x+1 仍在范围内的输出像素个数, 这一段可以整批处理
+    const uint32_t pairs = w / 2;
+#endif
+
+    for (uint32_t y = 0; y < dh; y++) {
+        const uint8_t* row0 = src + static_cast<size_t>(2 * y) * w * 4;
+        const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, h - 1)) * w * 4;
+        uint8_t* out = dst + static_cast<size_t>(y) * dw * 4;
+
+        uint32_t x = 0;
+#if defined(TOY2D_SIMD_SSE2)
+        // 一次 4 个输出像素: 两行各读 8 个源像素, 按奇偶拆开后在 16 位上求和
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 4 <= pairs; x += 4) {
+            __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8)));
+            __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16)));
+            __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8)));
+            __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16)));
+            __m128i evenA = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i oddA = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i evenB = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i oddB = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(evenA, zero), _mm_unpacklo_epi8(oddA, zero)),
+                                       _mm_add_epi16(_mm_unpacklo_epi8(evenB, zero), _mm_unpacklo_epi8(oddB, zero)));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(evenA, zero), _mm_unpackhi_epi8(oddA, zero)),
+                                       _mm_add_epi16(_mm_unpackhi_epi8(evenB, zero), _mm_unpackhi_epi8(oddB, zero)));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(lo, hi));
+        }
+#elif defined(TOY2D_SIMD_NEON)
+        for (; x + 4 <= pairs; x += 4) {
+            // vld2q 按 32 位交错读, val[0] 为偶数像素, val[1] 为奇数像素
+            uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t*>(row0 + x * 8));
+            uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t*>(row1 + x * 8));
+            uint8x16_t evenA = vreinterpretq_u8_u32(a.val[0]);
+            uint8x16_t oddA = vreinterpretq_u8_u32(a.val[1]);
+            uint8x16_t evenB = vreinterpretq_u8_u32(b.val[0]);
+            uint8x16_t oddB = vreinterpretq_u8_u32(b.val[1]);
+
+            uint16x8_t lo = vaddl_u8(vget_low_u8(evenA), vget_low_u8(oddA));
+            lo = vaddw_u8(lo, vget_low_u8(evenB));
+            lo = vaddw_u8(lo, vget_low_u8(oddB));
+            uint16x8_t hi = vaddl_u8(vget_high_u8(evenA), vget_high_u8(oddA));
+            hi = vaddw_u8(hi, vget_high_u8(evenB));
+            hi = vaddw_u8(hi, vget_high_u8(oddB));
+            // 带舍入的右移, 即 (sum + 2) >> 2
+            vst1q_u8(out + x * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+        }
+#endif
+        for (; x < dw; x++) {
+            uint32_t x0 = 2 * x;
+            uint32_t x1 = std::min(2 * x + 1, w - 1);
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+                out[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+std::vector<uint8_t> BuildMipChainRGBA8(const void* rgba, uint32_t w, uint32_t h, uint32_t levels) {
+    std::vector<uint8_t> chain(MipChainSize(w, h, levels));
+    memcpy(chain.data(), rgba, static_cast<size_t>(w) * h * 4);
+
+    size_t offset = 0;
+    for (uint32_t i = 1; i < levels; i++) {
+        uint32_t srcW = std::max(w >> (i - 1), 1u);
+        uint32_t srcH = std::max(h >> (i - 1), 1u);
+        size_t next = offset + static_cast<size_t>(srcW) * srcH * 4;
+        DownsampleRGBA8(chain.data() + offset, srcW, srcH, chain.data() + next);
+        offset = next;
+    }
+    return chain;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * RGBA8 的 mip 链 CPU 生成, 设备不支持线性 blit 时使用
+ *
+ * 每层都由上一层做 2x2 box filter 得到, 奇数边长时最后一行/列与自己平均;
+ * 直接在存储的数值上平均, sRGB 纹理会略微偏暗, 与多数驱动的 blit 结果一致
+ */
+
+namespace toy2d {
+
+// floor(log2(max(w, h))) + 1
+uint32_t MipLevelCount(uint32_t w, uint32_t h);
+
+// 所有层紧密排列时的总字节数
+size_t MipChainSize(uint32_t w, uint32_t h, uint32_t levels);
+
+// src 为 w x h, dst 为 max(w / 2, 1) x max(h / 2, 1)
+void DownsampleRGBA8(const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst);
+
+// 返回 levels 层紧密排列的像素, 第 0 层为原图
+std::vector<uint8_t> BuildMipChainRGBA8(const void* rgba, uint32_t w, uint32_t h, uint32_t levels);
+
+}
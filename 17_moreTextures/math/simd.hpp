@@ -0,0 +1,178 @@
+#pragma once
+
+/**
+ * 编译期选择的 SIMD 封装, 只包含数学库用到的几个操作
+ *
+ * - AVX2 (编译器开启 -mavx2 或 /arch:AVX2 时): 批处理 8 路, Mat4 用 SSE 4 路
+ * - SSE2 (x86-64 默认都有): 4 路
+ * - NEON (arm64 默认都有): 4 路
+ * - 其他平台或定义了 TOY2D_SIMD_DISABLE: 标量实现, 接口不变
+ *
+ * 所有读写都是非对齐的, 调用方不需要关心内存对齐
+ */
+
+#if defined(TOY2D_SIMD_DISABLE)
+#define TOY2D_SIMD_SCALAR 1
+#elif defined(__AVX2__)
+#define TOY2D_SIMD_AVX2 1
+#define TOY2D_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOY2D_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define TOY2D_SIMD_NEON 1
+#else
+#define TOY2D_SIMD_SCALAR 1
+#endif
+
+#if defined(TOY2D_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(TOY2D_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(TOY2D_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <cstddef>
+
+namespace toy2d {
+namespace simd {
+
+constexpr const char* InstructionSet() {
+#if defined(TOY2D_SIMD_AVX2)
+    return "avx2";
+#elif defined(TOY2D_SIMD_SSE2)
+    return "sse2";
+#elif defined(TOY2D_SIMD_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// 4 路 float
+struct Float4 {
+#if defined(TOY2D_SIMD_SSE2)
+    __m128 v;
+#elif defined(TOY2D_SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+inline Float4 Load4(const float* p) {
+#if defined(TOY2D_SIMD_SSE2)
+    return { _mm_loadu_ps(p) };
+#elif defined(TOY2D_SIMD_NEON)
+    return { vld1q_f32(p) };
+#else
+    return { { p[0], p[1], p[2], p[3] } };
+#endif
+}
+
+inline void Store4(float* p, Float4 a) {
+#if defined(TOY2D_SIMD_SSE2)
+    _mm_storeu_ps(p, a.v);
+#elif defined(TOY2D_SIMD_NEON)
+    vst1q_f32(p, a.v);
+#else
+    for (int i = 0; i < 4; i++) {
+        p[i] = a.v[i];
+    }
+#endif
+}
+
+inline Float4 Set4(float s) {
+#if defined(TOY2D_SIMD_SSE2)
+    return { _mm_set1_ps(s) };
+#elif defined(TOY2D_SIMD_NEON)
+    return { vdupq_n_f32(s) };
+#else
+    return { { s, s, s, s } };
+#endif
+}
+
+inline Float4 operator+(Float4 a, Float4 b) {
+#if defined(TOY2D_SIMD_SSE2)
+    return { _mm_add_ps(a.v, b.v) };
+#elif defined(TOY2D_SIMD_NEON)
+    return { vaddq_f32(a.v, b.v) };
+#else
+    return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+#endif
+}
+
+inline Float4 operator*(Float4 a, Float4 b) {
+#if defined(TOY2D_SIMD_SSE2)
+    return { _mm_mul_ps(a.v, b.v) };
+#elif defined(TOY2D_SIMD_NEON)
+    return { vmulq_f32(a.v, b.v) };
+#else
+    return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+#endif
+}
+
+// a * b + c
+inline Float4 MulAdd(Float4 a, Float4 b, Float4 c) {
+#if defined(TOY2D_SIMD_AVX2) && defined(__FMA__)
+    return { _mm_fmadd_ps(a.v, b.v, c.v) };
+#elif defined(TOY2D_SIMD_NEON)
+    return { vmlaq_f32(c.v, a.v, b.v) };
+#else
+    return a * b + c;
+#endif
+}
+
+// 把 4 个 Float4 当作 4x4 矩阵的行, 原地转置
+inline void Transpose4(Float4& r0, Float4& r1, Float4& r2, Float4& r3) {
+#if defined(TOY2D_SIMD_SSE2)
+    _MM_TRANSPOSE4_PS(r0.v, r1.v, r2.v, r3.v);
+#elif defined(TOY2D_SIMD_NEON)
+    float32x4x2_t t01 = vtrnq_f32(r0.v, r1.v);
+    float32x4x2_t t23 = vtrnq_f32(r2.v, r3.v);
+    r0.v = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r1.v = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r2.v = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r3.v = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+#else
+    Float4* rows[4] = { &r0, &r1, &r2, &r3 };
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            float t = rows[i]->v[j];
+            rows[i]->v[j] = rows[j]->v[i];
+            rows[j]->v[i] = t;
+        }
+    }
+#endif
+}
+
+// 批处理使用的最宽向量, AVX2 下 8 路, 其余与 Float4 相同
+#if defined(TOY2D_SIMD_AVX2)
+struct FloatN {
+    __m256 v;
+};
+constexpr size_t Width = 8;
+
+inline FloatN LoadN(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void StoreN(float* p, FloatN a) { _mm256_storeu_ps(p, a.v); }
+inline FloatN SetN(float s) { return { _mm256_set1_ps(s) }; }
+inline FloatN operator+(FloatN a, FloatN b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline FloatN operator*(FloatN a, FloatN b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline FloatN MulAdd(FloatN a, FloatN b, FloatN c) {
+#if defined(__FMA__)
+    return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+#else
+    return a * b + c;
+#endif
+}
+#else
+using FloatN = Float4;
+constexpr size_t Width = 4;
+
+inline FloatN LoadN(const float* p) { return Load4(p); }
+inline void StoreN(float* p, FloatN a) { Store4(p, a); }
+inline FloatN SetN(float s) { return Set4(s); }
+#endif
+
+}
+}
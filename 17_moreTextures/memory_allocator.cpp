@@ -0,0 +1,315 @@
+#include "memory_allocator.hpp"
+#include "context.h"
+#include <stdexcept>
+#include <algorithm>
+
+namespace toy2d {
+
+static uint32_t log2Floor(vk::DeviceSize value) {
+    uint32_t result = 0;
+    while (value > 1) {
+        value >>= 1;
+        result++;
+    }
+    return result;
+}
+
+static vk::DeviceSize nextPowerOfTwo(vk::DeviceSize value) {
+    vk::DeviceSize result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+MemoryAllocator::MemoryAllocator(vk::DeviceSize blockSize)
+    : m_deviceAllocationCount(0), m_dedicatedCount(0), m_dedicatedBytes(0), m_subAllocationCount(0) {
+    auto& phyDevice = Context::GetInstance().GetPhyDevice();
+    m_memProperties = phyDevice.getMemoryProperties();
+    m_maxAllocationCount = phyDevice.getProperties().limits.maxMemoryAllocationCount;
+    m_blockSize = nextPowerOfTwo(std::max(blockSize, MinAllocSize));
+
+    m_pools.resize(m_memProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < m_pools.size(); i++) {
+        m_pools[i].memoryType = i / 2;
+    }
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (auto& pool : m_pools) {
+        for (auto& block : pool.blocks) {
+            freeDeviceMemory(block->memory, block->mapped);
+        }
+        pool.blocks.clear();
+    }
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags property) const {
+    for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++) {
+        if (((1 << i) & typeBits) &&
+            (m_memProperties.memoryTypes[i].propertyFlags & property) == property) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("no suitable memory type!");
+}
+
+MemoryAllocator::Allocation MemoryAllocator::AllocateForBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags property) {
+    auto& device = Context::GetInstance().GetDevice();
+
+    vk::BufferMemoryRequirementsInfo2 info;
+    info.setBuffer(buffer);
+    auto chain = device.getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(info);
+    auto& requirements = chain.get<vk::MemoryRequirements2>().memoryRequirements;
+    auto& dedicatedReq = chain.get<vk::MemoryDedicatedRequirements>();
+    bool dedicated = dedicatedReq.requiresDedicatedAllocation || dedicatedReq.prefersDedicatedAllocation;
+
+    vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+    dedicatedInfo.setBuffer(buffer);
+    auto allocation = allocate(requirements, property, true, dedicated, &dedicatedInfo);
+    device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+MemoryAllocator::Allocation MemoryAllocator::AllocateForImage(vk::Image image, vk::MemoryPropertyFlags property) {
+    auto& device = Context::GetInstance().GetDevice();
+
+    vk::ImageMemoryRequirementsInfo2 info;
+    info.setImage(image);
+    auto chain = device.getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(info);
+    auto& requirements = chain.get<vk::MemoryRequirements2>().memoryRequirements;
+    auto& dedicatedInfo = chain.get<vk::MemoryDedicatedRequirements>();
+
+    // 超过半个块的图像单独分配, 否则一张图就会占掉整个块的大半
+    bool dedicated = dedicatedInfo.requiresDedicatedAllocation || dedicatedInfo.prefersDedicatedAllocation ||
+                     requirements.size >= m_blockSize / 2;
+
+    vk::MemoryDedicatedAllocateInfo dedicatedAlloc;
+    dedicatedAlloc.setImage(image);
+    auto allocation = allocate(requirements, property, false, dedicated, &dedicatedAlloc);
+    device.bindImageMemory(image, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+MemoryAllocator::Allocation MemoryAllocator::AllocateMemory(const vk::MemoryRequirements& requirements,
+    vk::MemoryPropertyFlags property) {
+    return allocate(requirements, property, false, requirements.size >= m_blockSize / 2);
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocate(const vk::MemoryRequirements& requirements,
+    vk::MemoryPropertyFlags property, bool linear, bool dedicated,
+    const vk::MemoryDedicatedAllocateInfo* dedicatedInfo) {
+    uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, property);
+
+    // buddy 分出来的块按自身大小对齐, 所以大小取 size 与 alignment 中较大者再取 2 的幂即可满足对齐
+    vk::DeviceSize size = nextPowerOfTwo(std::max({ requirements.size, requirements.alignment, MinAllocSize }));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (dedicated || size > m_blockSize) {
+        return allocateDedicated(requirements.size, memoryType, dedicatedInfo);
+    }
+
+    uint32_t poolIndex = memoryType * 2 + (linear ? 0 : 1);
+    auto& pool = m_pools[poolIndex];
+    uint32_t order = log2Floor(size / MinAllocSize);
+
+    Allocation allocation;
+    allocation.size = size;
+    allocation.pool = poolIndex;
+    allocation.order = order;
+
+    for (auto& block : pool.blocks) {
+        if (allocFromBlock(*block, order, allocation.offset)) {
+            allocation.block = block.get();
+            break;
+        }
+    }
+    if (!allocation.block) {
+        std::unique_ptr<Block> block(createBlock(memoryType));
+        if (!allocFromBlock(*block, order, allocation.offset)) {
+            // 堆太小导致块被缩小, 放不下时改为独占分配
+            freeDeviceMemory(block->memory, block->mapped);
+            return allocateDedicated(requirements.size, memoryType, dedicatedInfo);
+        }
+        allocation.block = block.get();
+        pool.blocks.push_back(std::move(block));
+    }
+
+    m_subAllocationCount++;
+
+    auto* block = static_cast<Block*>(allocation.block);
+    allocation.memory = block->memory;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+    return allocation;
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocateDedicated(vk::DeviceSize size, uint32_t memoryType,
+    const vk::MemoryDedicatedAllocateInfo* dedicatedInfo) {
+    Allocation allocation;
+    allocation.memory = allocateDeviceMemory(size, memoryType, &allocation.mapped, dedicatedInfo);
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.block = nullptr;
+
+    m_dedicatedCount++;
+    m_dedicatedBytes += size;
+    return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation) {
+    if (!allocation.memory) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!allocation.block) {
+        freeDeviceMemory(allocation.memory, allocation.mapped);
+        m_dedicatedCount--;
+        m_dedicatedBytes -= allocation.size;
+    }
+    else {
+        auto* block = static_cast<Block*>(allocation.block);
+        freeToBlock(*block, allocation.offset, allocation.order);
+        m_subAllocationCount--;
+
+        // 空块只保留一个, 避免反复申请释放
+        auto& blocks = m_pools[allocation.pool].blocks;
+        if (block->used == 0 && blocks.size() > 1) {
+            auto it = std::find_if(blocks.begin(), blocks.end(),
+                [&](const std::unique_ptr<Block>& b) { return b.get() == block; });
+            freeDeviceMemory(block->memory, block->mapped);
+            blocks.erase(it);
+        }
+    }
+
+    allocation = Allocation{};
+}
+
+vk::DeviceMemory MemoryAllocator::allocateDeviceMemory(vk::DeviceSize size, uint32_t memoryType, void** mapped,
+    const vk::MemoryDedicatedAllocateInfo* dedicatedInfo) {
+    if (m_deviceAllocationCount >= m_maxAllocationCount) {
+        throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+    }
+
+    auto& device = Context::GetInstance().GetDevice();
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.setMemoryTypeIndex(memoryType)
+        .setAllocationSize(size);
+    // 整块内存只给这一个资源用时告诉驱动, 它可以据此选择更合适的布局 (如压缩)
+    if (dedicatedInfo) {
+        allocInfo.setPNext(dedicatedInfo);
+    }
+    vk::DeviceMemory memory = device.allocateMemory(allocInfo);
+    m_deviceAllocationCount++;
+
+    if (m_memProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        *mapped = device.mapMemory(memory, 0, VK_WHOLE_SIZE);
+    }
+    else {
+        *mapped = nullptr;
+    }
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(vk::DeviceMemory memory, void* mapped) {
+    auto& device = Context::GetInstance().GetDevice();
+    if (mapped) {
+        device.unmapMemory(memory);
+    }
+    device.freeMemory(memory);
+    m_deviceAllocationCount--;
+}
+
+MemoryAllocator::Block* MemoryAllocator::createBlock(uint32_t memoryType) {
+    // 小的堆 (例如部分 BAR 内存) 块不超过堆的 1/8
+    auto heapSize = m_memProperties.memoryHeaps[m_memProperties.memoryTypes[memoryType].heapIndex].size;
+    vk::DeviceSize size = m_blockSize;
+    while (size > MinAllocSize && size > heapSize / 8) {
+        size >>= 1;
+    }
+
+    std::unique_ptr<Block> block(new Block);
+    block->memory = allocateDeviceMemory(size, memoryType, &block->mapped);
+    block->size = size;
+    block->maxOrder = log2Floor(size / MinAllocSize);
+    block->used = 0;
+    block->freeLists.resize(block->maxOrder + 1);
+    block->freeLists[block->maxOrder].insert(0);
+    return block.release();
+}
+
+bool MemoryAllocator::allocFromBlock(Block& block, uint32_t order, vk::DeviceSize& offset) {
+    if (order > block.maxOrder) {
+        return false;
+    }
+
+    uint32_t found = order;
+    while (found <= block.maxOrder && block.freeLists[found].empty()) {
+        found++;
+    }
+    if (found > block.maxOrder) {
+        return false;
+    }
+
+    offset = *block.freeLists[found].begin();
+    block.freeLists[found].erase(block.freeLists[found].begin());
+
+    // 把多余的部分对半拆开, 后一半放回低一级的空闲链表
+    while (found > order) {
+        found--;
+        block.freeLists[found].insert(offset + (MinAllocSize << found));
+    }
+
+    block.used += MinAllocSize << order;
+    return true;
+}
+
+void MemoryAllocator::freeToBlock(Block& block, vk::DeviceSize offset, uint32_t order) {
+    block.used -= MinAllocSize << order;
+
+    // 伙伴也空闲时合并, 直到伙伴被占用或已经是整个块
+    while (order < block.maxOrder) {
+        vk::DeviceSize buddy = offset ^ (MinAllocSize << order);
+        auto it = block.freeLists[order].find(buddy);
+        if (it == block.freeLists[order].end()) {
+            break;
+        }
+        block.freeLists[order].erase(it);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block.freeLists[order].insert(offset);
+}
+
+MemoryAllocator::Stats MemoryAllocator::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.dedicatedCount = m_dedicatedCount;
+    stats.dedicatedBytes = m_dedicatedBytes;
+    stats.allocationCount = m_dedicatedCount;
+
+    for (auto& pool : m_pools) {
+        for (auto& block : pool.blocks) {
+            stats.blockCount++;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->used;
+            stats.freeBytes += block->size - block->used;
+
+            for (uint32_t order = 0; order <= block->maxOrder; order++) {
+                if (!block->freeLists[order].empty()) {
+                    stats.largestFreeRange = std::max(stats.largestFreeRange, MinAllocSize << order);
+                }
+            }
+        }
+    }
+
+    stats.allocationCount += m_subAllocationCount;
+    if (stats.freeBytes > 0) {
+        stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(stats.freeBytes);
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef __MEMORY_ALLOCATOR_H__
+#define __MEMORY_ALLOCATOR_H__
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 设备内存子分配器
+ * 每种内存类型维护若干大块 (默认 64MB) vk::DeviceMemory, 块内用 buddy 算法切分,
+ * 线性资源 (buffer) 与非线性资源 (optimal image) 放在不同的块里, 从而不用处理 bufferImageGranularity.
+ * 大图像或驱动要求独占内存的资源走单独分配. host visible 的块在创建时映射一次, 之后不再 map/unmap
+ */
+class MemoryAllocator final
+{
+public:
+    static constexpr vk::DeviceSize DefaultBlockSize = 64ull * 1024 * 1024;
+    static constexpr vk::DeviceSize MinAllocSize = 256;
+
+    struct Allocation {
+        vk::DeviceMemory memory;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        void* mapped = nullptr; // 不是 host visible 时为空
+
+        // 内部使用
+        void* block = nullptr;  // 为空表示独占分配
+        uint32_t pool = 0;
+        uint32_t order = 0;
+    };
+
+    struct Stats {
+        uint32_t blockCount = 0;
+        uint32_t dedicatedCount = 0;
+        uint32_t allocationCount = 0;   // 子分配 + 独占分配
+        vk::DeviceSize blockBytes = 0;  // 所有块的总大小
+        vk::DeviceSize usedBytes = 0;   // 块内已分配的字节 (按 buddy 取整后)
+        vk::DeviceSize freeBytes = 0;
+        vk::DeviceSize dedicatedBytes = 0;
+        vk::DeviceSize largestFreeRange = 0;
+        // 1 - 最大空闲段 / 空闲总量, 0 表示空闲内存是连续的
+        float fragmentation = 0;
+    };
+
+    MemoryAllocator(vk::DeviceSize blockSize = DefaultBlockSize);
+    ~MemoryAllocator();
+
+    // 分配并绑定, 失败抛异常
+    Allocation AllocateForBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags property);
+    Allocation AllocateForImage(vk::Image image, vk::MemoryPropertyFlags property);
+    // 只分配不绑定, 由调用方把多个资源绑到其中 (内存别名); 按非线性资源 (optimal image) 处理
+    Allocation AllocateMemory(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags property);
+    void Free(Allocation& allocation);
+
+    Stats GetStats();
+    uint32_t FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags property) const;
+
+private:
+    struct Block {
+        vk::DeviceMemory memory;
+        void* mapped;
+        vk::DeviceSize size;
+        uint32_t maxOrder;
+        vk::DeviceSize used;
+        std::vector<std::set<vk::DeviceSize>> freeLists; // 下标为 order, 大小为 MinAllocSize << order
+    };
+
+    struct Pool {
+        uint32_t memoryType;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    Allocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags property,
+                        bool linear, bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo = nullptr);
+    // dedicatedInfo 不为空时内存只绑定其中的资源, 大小必须等于该资源的需求
+    Allocation allocateDedicated(vk::DeviceSize size, uint32_t memoryType,
+                                 const vk::MemoryDedicatedAllocateInfo* dedicatedInfo);
+    vk::DeviceMemory allocateDeviceMemory(vk::DeviceSize size, uint32_t memoryType, void** mapped,
+                                          const vk::MemoryDedicatedAllocateInfo* dedicatedInfo = nullptr);
+    void freeDeviceMemory(vk::DeviceMemory memory, void* mapped);
+
+    Block* createBlock(uint32_t memoryType);
+    bool allocFromBlock(Block& block, uint32_t order, vk::DeviceSize& offset);
+    void freeToBlock(Block& block, vk::DeviceSize offset, uint32_t order);
+
+    vk::PhysicalDeviceMemoryProperties m_memProperties;
+    vk::DeviceSize m_blockSize;
+    uint32_t m_maxAllocationCount;
+    uint32_t m_deviceAllocationCount; // 当前存活的 vkAllocateMemory 次数
+    uint32_t m_dedicatedCount;
+    vk::DeviceSize m_dedicatedBytes;
+    uint32_t m_subAllocationCount;
+
+    // 下标为 memoryType * 2 + (linear ? 0 : 1)
+    std::vector<Pool> m_pools;
+    std::mutex m_mutex;
+};
+
+}
+
+#endif // __MEMORY_ALLOCATOR_H__
@@ -0,0 +1,77 @@
+#include "parallel_recorder.hpp"
+#include <future>
+#include <stdexcept>
+
+namespace toy2d {
+
+ParallelRecorder::ParallelRecorder(int maxFlightCount, uint32_t workerCount) : m_curFrame(0) {
+    m_pool.reset(new ThreadPool(workerCount));
+
+    m_slots.resize(maxFlightCount);
+    for (auto& frameSlots : m_slots) {
+        frameSlots.resize(m_pool->GetThreadCount());
+        for (auto& slot : frameSlots) {
+            slot.cmdManager.reset(new CommandManager());
+            slot.cmd = slot.cmdManager->CreateCommandBuffers(1, vk::CommandBufferLevel::eSecondary)[0];
+        }
+    }
+}
+
+ParallelRecorder::~ParallelRecorder() {
+    // 先停线程池, 保证没有任务还在使用命令池
+    m_pool.reset();
+    m_slots.clear();
+}
+
+void ParallelRecorder::BeginFrame(int frame) {
+    m_curFrame = frame;
+    for (auto& slot : m_slots[frame]) {
+        slot.cmdManager->ResetCmds();
+    }
+}
+
+std::vector<vk::CommandBuffer> ParallelRecorder::Record(uint32_t taskCount,
+    const vk::CommandBufferInheritanceInfo& inheritance, const RecordFunc& func) {
+    auto& frameSlots = m_slots[m_curFrame];
+    if (taskCount > frameSlots.size()) {
+        throw std::runtime_error("parallel record task count exceeds worker count!");
+    }
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(taskCount);
+    for (uint32_t task = 0; task < taskCount; task++) {
+        vk::CommandBuffer cmd = frameSlots[task].cmd;
+        futures.push_back(m_pool->Submit([cmd, task, &inheritance, &func]() {
+            vk::CommandBufferBeginInfo beginInfo;
+            beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                               vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+                .setPInheritanceInfo(&inheritance);
+            cmd.begin(beginInfo);
+            func(cmd, task);
+            cmd.end();
+        }));
+    }
+
+    // 等待全部任务, 有异常时在全部结束后再抛出, 避免任务仍在引用栈上的数据
+    std::exception_ptr error;
+    std::vector<vk::CommandBuffer> cmds;
+    cmds.reserve(taskCount);
+    for (uint32_t task = 0; task < taskCount; task++) {
+        try {
+            futures[task].get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        cmds.push_back(frameSlots[task].cmd);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return cmds;
+}
+
+}
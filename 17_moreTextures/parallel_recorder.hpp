@@ -0,0 +1,49 @@
+#ifndef __PARALLEL_RECORDER_H__
+#define __PARALLEL_RECORDER_H__
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "command_manager.hpp"
+#include "thread_pool.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 多线程录制 secondary command buffer
+ * 每个录制槽位每个飞行帧各有一个命令池, 一帧内同一个槽位只会被一个任务使用,
+ * 因此命令池不需要加锁. 帧开始时整池重置, 不再逐个释放命令
+ */
+class ParallelRecorder final
+{
+public:
+    using RecordFunc = std::function<void(vk::CommandBuffer cmd, uint32_t task)>;
+
+    // workerCount 为 0 时使用 hardware_concurrency
+    ParallelRecorder(int maxFlightCount, uint32_t workerCount = 0);
+    ~ParallelRecorder();
+
+    // 调用方需保证该帧上一次的提交已经完成
+    void BeginFrame(int frame);
+    // 把 taskCount (不超过 GetWorkerCount) 个任务分发到线程池, 每个任务录一个 secondary command buffer,
+    // 阻塞到全部录完, 返回值按任务下标排列, 可以直接交给 executeCommands
+    std::vector<vk::CommandBuffer> Record(uint32_t taskCount, const vk::CommandBufferInheritanceInfo& inheritance,
+                                          const RecordFunc& func);
+
+    uint32_t GetWorkerCount() const { return m_pool->GetThreadCount(); }
+
+private:
+    struct Slot {
+        std::unique_ptr<CommandManager> cmdManager;
+        vk::CommandBuffer cmd;
+    };
+
+    std::unique_ptr<ThreadPool> m_pool;
+    std::vector<std::vector<Slot>> m_slots; // [frame][worker]
+    int m_curFrame;
+};
+
+}
+
+#endif // __PARALLEL_RECORDER_H__
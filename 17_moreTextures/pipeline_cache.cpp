@@ -0,0 +1,331 @@
+#include "pipeline_cache.hpp"
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include "context.h"
+#include "shader.hpp"
+#include "profiler.hpp"
+#include "sprite_batch.hpp"
+#include "math/math.hpp"
+
+namespace toy2d {
+    namespace {
+        constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+        constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+        void HashValue(uint64_t& hash, uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= kFnvPrime;
+            }
+        }
+
+        template <typename Handle>
+        uint64_t HandleBits(Handle handle) {
+            return (uint64_t)(static_cast<typename Handle::CType>(handle));
+        }
+
+        template <typename Future>
+        bool IsReady(const Future& future) {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+    }
+
+    uint64_t PipelineKey::Hash() const {
+        uint64_t hash = kFnvOffset;
+        HashValue(hash, reinterpret_cast<uintptr_t>(shader));
+        HashValue(hash, HandleBits(layout));
+        HashValue(hash, static_cast<uint64_t>(vertexLayout));
+        HashValue(hash, static_cast<uint64_t>(blend));
+        HashValue(hash, static_cast<uint64_t>(topology));
+        HashValue(hash, static_cast<uint64_t>(colorFormat));
+        HashValue(hash, static_cast<uint64_t>(samples));
+        for (auto value : specialization) {
+            HashValue(hash, value);
+        }
+        return hash;
+    }
+
+    bool PipelineKey::operator==(const PipelineKey& other) const {
+        // renderPass 不参与: 兼容的 render pass 可以共用同一条管线
+        return shader == other.shader &&
+            layout == other.layout &&
+            vertexLayout == other.vertexLayout &&
+            blend == other.blend &&
+            topology == other.topology &&
+            colorFormat == other.colorFormat &&
+            samples == other.samples &&
+            specialization == other.specialization;
+    }
+
+    PipelineCache::PipelineCache(uint32_t threadCount) : m_threadCount(threadCount) {}
+
+    PipelineCache::~PipelineCache() {
+        WaitIdle();
+        m_pool.reset();
+
+        auto& device = Context::GetInstance().GetDevice();
+        for (auto& [key, entry] : m_entries) {
+            try {
+                device.destroyPipeline(entry.get());
+            }
+            catch (const std::exception&) {
+                // 创建失败的排列没有管线
+            }
+        }
+    }
+
+    vk::Pipeline PipelineCache::Get(const PipelineKey& key) {
+        std::promise<vk::Pipeline> promise;
+        Entry entry;
+        bool create = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                // 先放入占位, 其他线程同时请求同一排列时等待这一次创建, 不会重复编译
+                entry = promise.get_future().share();
+                m_entries.emplace(key, entry);
+                m_stats.syncCompiles++;
+                create = true;
+            }
+            else {
+                entry = it->second;
+                if (IsReady(entry)) {
+                    m_stats.hits++;
+                    return entry.get();
+                }
+                m_stats.stalls++;
+            }
+        }
+
+        if (create) {
+            try {
+                promise.set_value(Create(key));
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+        else {
+            TOY2D_PROFILE_SCOPE("PipelineCache::Stall");
+            entry.wait();
+        }
+        return entry.get();
+    }
+
+    vk::Pipeline PipelineCache::TryGet(const PipelineKey& key) {
+        Entry entry;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                submit(key);
+                return nullptr;
+            }
+            entry = it->second;
+            if (!IsReady(entry)) {
+                return nullptr;
+            }
+            m_stats.hits++;
+        }
+        return entry.get();
+    }
+
+    void PipelineCache::Precompile(const std::vector<PipelineKey>& keys) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& key : keys) {
+            if (m_entries.find(key) == m_entries.end()) {
+                submit(key);
+            }
+        }
+    }
+
+    void PipelineCache::WaitIdle() {
+        std::vector<Entry> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& [key, entry] : m_entries) {
+                if (!IsReady(entry)) {
+                    pending.push_back(entry);
+                }
+            }
+        }
+        for (auto& entry : pending) {
+            entry.wait();
+        }
+    }
+
+    PipelineCache::Stats PipelineCache::GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Stats stats = m_stats;
+        stats.pipelines = static_cast<uint32_t>(m_entries.size());
+        return stats;
+    }
+
+    PipelineCache::Entry& PipelineCache::submit(const PipelineKey& key) {
+        Entry entry = pool().Submit([key]() { return Create(key); }).share();
+        m_stats.asyncCompiles++;
+        return m_entries.emplace(key, std::move(entry)).first->second;
+    }
+
+    ThreadPool& PipelineCache::pool() {
+        if (!m_pool) {
+            m_pool = std::make_unique<ThreadPool>(m_threadCount);
+        }
+        return *m_pool;
+    }
+
+    vk::Pipeline PipelineCache::Create(const PipelineKey& key)
+    {
+        TOY2D_PROFILE_FUNCTION();
+        auto& ctx = Context::GetInstance();
+        if (!key.shader || !key.layout || !key.renderPass) {
+            throw std::runtime_error("incomplete pipeline key!");
+        }
+
+        vk::GraphicsPipelineCreateInfo createInfo;
+
+        // 以下为渲染管线的流程
+
+        // 1.vertex input
+        std::vector<vk::VertexInputBindingDescription> bindings;
+        std::vector<vk::VertexInputAttributeDescription> attr;
+        if (key.vertexLayout != VertexLayout::None) {
+            bindings.push_back(Vec::GetBindingDescription());
+            attr = Vec::GetAttributeDescription();
+        }
+        if (key.vertexLayout == VertexLayout::Sprite) {
+            // binding 1 为 SpriteInstance
+            bindings.push_back(SpriteInstance::GetBindingDescription());
+            auto instanceAttr = SpriteInstance::GetAttributeDescription();
+            attr.insert(attr.end(), instanceAttr.begin(), instanceAttr.end());
+        }
+        vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo;
+        vertexInputCreateInfo.setVertexAttributeDescriptions(attr)
+            .setVertexBindingDescriptions(bindings);
+        createInfo.setPVertexInputState(&vertexInputCreateInfo);
+
+        // 2.Vertex Assembly 图元设置
+        vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
+        inputAssemblyInfo.setPrimitiveRestartEnable(false)
+            .setTopology(key.topology);
+        createInfo.setPInputAssemblyState(&inputAssemblyInfo);
+
+        // 3. shader prepare
+        // specialization constant: constant_id 为下标, 两个阶段共用一份数据
+        std::vector<vk::SpecializationMapEntry> specEntries;
+        for (uint32_t i = 0; i < key.specialization.size(); i++) {
+            specEntries.emplace_back(i, i * sizeof(uint32_t), sizeof(uint32_t));
+        }
+        vk::SpecializationInfo specInfo;
+        specInfo.setMapEntries(specEntries)
+            .setDataSize(key.specialization.size() * sizeof(uint32_t))
+            .setPData(key.specialization.data());
+
+        std::array<vk::PipelineShaderStageCreateInfo, 2> stageCreateInfos;
+        stageCreateInfos[0].setModule(key.shader->GetVertexModule())
+            .setPName("main")
+            .setStage(vk::ShaderStageFlagBits::eVertex);
+        stageCreateInfos[1].setModule(key.shader->GetFragModule())
+            .setPName("main")
+            .setStage(vk::ShaderStageFlagBits::eFragment);
+        if (!key.specialization.empty()) {
+            for (auto& stage : stageCreateInfos) {
+                stage.setPSpecializationInfo(&specInfo);
+            }
+        }
+        createInfo.setStages(stageCreateInfos);
+
+        // 4.viewport
+        // viewport 与 scissor 设为动态状态, 录制时再设置, 交换链重建后管线不需要重新创建
+        vk::PipelineViewportStateCreateInfo viewportState;
+        viewportState.setViewportCount(1).setScissorCount(1); // 多个viewport是否支持需要，查询，有些电脑不支持
+        createInfo.setPViewportState(&viewportState);
+
+        std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+        vk::PipelineDynamicStateCreateInfo dynamicState;
+        dynamicState.setDynamicStates(dynamicStates);
+        createInfo.setPDynamicState(&dynamicState);
+
+        // 5.光栅化
+        vk::PipelineRasterizationStateCreateInfo rastInfo;
+        rastInfo.setRasterizerDiscardEnable(false)
+            .setCullMode(vk::CullModeFlagBits::eBack)
+            .setFrontFace(vk::FrontFace::eClockwise)
+            .setPolygonMode(vk::PolygonMode::eFill)
+            .setLineWidth(1);
+        createInfo.setPRasterizationState(&rastInfo);
+
+        // 6.multisample
+        vk::PipelineMultisampleStateCreateInfo multiInfo;
+        multiInfo.setSampleShadingEnable(false)
+            .setRasterizationSamples(key.samples);
+        createInfo.setPMultisampleState(&multiInfo);
+
+        // 7.Test stencil test, depth test
+        // 暂时不用，跳过
+
+        // 8.color Blending
+        vk::PipelineColorBlendStateCreateInfo colorBlendInfo;
+        vk::PipelineColorBlendAttachmentState blendAttachmentState;
+        blendAttachmentState.setColorWriteMask(vk::ColorComponentFlagBits::eA |
+                vk::ColorComponentFlagBits::eB |
+                vk::ColorComponentFlagBits::eG |
+                vk::ColorComponentFlagBits::eR)
+            .setColorBlendOp(vk::BlendOp::eAdd)
+            .setAlphaBlendOp(vk::BlendOp::eAdd);
+        colorBlendInfo.setLogicOpEnable(false);
+
+        switch (key.blend) {
+        case BlendMode::Opaque:
+            blendAttachmentState.setBlendEnable(false);
+            break;
+        case BlendMode::Alpha:
+            // 公式法
+            blendAttachmentState.setBlendEnable(true)
+                .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+                .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+                .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+                .setDstAlphaBlendFactor(vk::BlendFactor::eZero);
+            break;
+        case BlendMode::Additive:
+            blendAttachmentState.setBlendEnable(true)
+                .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+                .setDstColorBlendFactor(vk::BlendFactor::eOne)
+                .setSrcAlphaBlendFactor(vk::BlendFactor::eZero)
+                .setDstAlphaBlendFactor(vk::BlendFactor::eOne);
+            break;
+        case BlendMode::Multiply:
+            blendAttachmentState.setBlendEnable(true)
+                .setSrcColorBlendFactor(vk::BlendFactor::eDstColor)
+                .setDstColorBlendFactor(vk::BlendFactor::eZero)
+                .setSrcAlphaBlendFactor(vk::BlendFactor::eZero)
+                .setDstAlphaBlendFactor(vk::BlendFactor::eOne);
+            break;
+        case BlendMode::LogicCopy:
+            // 按位操作混合, 开启后公式混合被忽略
+            if (!ctx.GetPhyDevice().getFeatures().logicOp) {
+                throw std::runtime_error("logic op blending not supported!");
+            }
+            blendAttachmentState.setBlendEnable(false);
+            colorBlendInfo.setLogicOpEnable(true)
+                .setLogicOp(vk::LogicOp::eCopy);
+            break;
+        }
+        colorBlendInfo.setAttachments(blendAttachmentState);
+        createInfo.setPColorBlendState(&colorBlendInfo);
+
+        // 9.renderPass, Layout
+        createInfo.setRenderPass(key.renderPass)
+            .setLayout(key.layout);
+
+        // vk::PipelineCache 内部同步, 多个线程可以同时使用
+        auto res = ctx.GetDevice().createGraphicsPipeline(ctx.m_pipelineCache->Get(), createInfo);
+        if (res.result != vk::Result::eSuccess) {
+            throw std::runtime_error("create graphics failed!");
+        }
+
+        return res.value;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef __PIPELINE_CACHE_H__
+#define __PIPELINE_CACHE_H__
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "thread_pool.hpp"
+
+namespace toy2d {
+    class Shader;
+
+    enum class BlendMode : uint8_t {
+        Opaque,    // 不混合
+        Alpha,     // src * a + dst * (1 - a), 默认
+        Additive,  // src * a + dst
+        Multiply,  // src * dst
+        LogicCopy, // 按位操作 (copy), 需要设备支持 logicOp, 对 sRGB/浮点格式无效
+    };
+
+    // 顶点输入的排布
+    enum class VertexLayout : uint8_t {
+        Quad,   // binding 0: Vec
+        Sprite, // binding 0: Vec, binding 1: SpriteInstance
+        None,   // 没有顶点输入, 顶点由 gl_VertexIndex 生成 (全屏三角形)
+    };
+
+    /**
+     * @brief 一个图形管线排列
+     * render pass 只按兼容性 (颜色格式与采样数) 参与比较, 句柄本身只用于创建
+     */
+    struct PipelineKey {
+        const Shader* shader = nullptr; // 顶点与片元着色器对
+        vk::PipelineLayout layout;
+        VertexLayout vertexLayout = VertexLayout::Quad;
+        BlendMode blend = BlendMode::Alpha;
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        vk::RenderPass renderPass;
+        vk::Format colorFormat = vk::Format::eUndefined;
+        vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+        std::vector<uint32_t> specialization; // constant_id 依次为 0, 1, 2..., 两个阶段共用
+
+        uint64_t Hash() const;
+        bool operator==(const PipelineKey& other) const;
+    };
+
+    /**
+     * @brief 按排列缓存的图形管线
+     * 第一次用到时创建, 也可以在启动时把声明的排列交给工作线程预编译 (vkCreateGraphicsPipelines
+     * 对同一个 vk::PipelineCache 是线程安全的). 管线在缓存销毁时统一销毁, 调用方不要自己销毁
+     */
+    class PipelineCache final {
+    public:
+        // threadCount 为 0 时使用 hardware_concurrency, 线程池在第一次预编译时才创建
+        PipelineCache(uint32_t threadCount = 0);
+        // 等待后台编译结束并销毁所有管线
+        ~PipelineCache();
+        PipelineCache(const PipelineCache&) = delete;
+        PipelineCache& operator=(const PipelineCache&) = delete;
+
+        // 命中时直接返回; 正在后台编译时等待它完成; 否则在调用线程上创建. 创建失败时抛出 std::runtime_error
+        vk::Pipeline Get(const PipelineKey& key);
+        // 不阻塞: 还没就绪时返回空句柄, 并在后台开始编译
+        vk::Pipeline TryGet(const PipelineKey& key);
+        // 把还没有的排列交给工作线程, 立即返回
+        void Precompile(const std::vector<PipelineKey>& keys);
+        // 阻塞到所有后台编译完成
+        void WaitIdle();
+
+        struct Stats {
+            uint32_t pipelines = 0;
+            uint64_t hits = 0;       // Get/TryGet 直接拿到了就绪的管线
+            uint64_t syncCompiles = 0;
+            uint64_t asyncCompiles = 0;
+            uint64_t stalls = 0;     // Get 等待了还在后台编译的管线
+        };
+        Stats GetStats() const;
+
+        // 线程安全, 不访问缓存
+        static vk::Pipeline Create(const PipelineKey& key);
+
+    private:
+        struct KeyHash {
+            size_t operator()(const PipelineKey& key) const { return static_cast<size_t>(key.Hash()); }
+        };
+        using Entry = std::shared_future<vk::Pipeline>;
+
+        // 调用时持有 m_mutex
+        Entry& submit(const PipelineKey& key);
+        ThreadPool& pool();
+
+        uint32_t m_threadCount;
+        std::unique_ptr<ThreadPool> m_pool;
+        mutable std::mutex m_mutex;
+        std::unordered_map<PipelineKey, Entry, KeyHash> m_entries;
+        Stats m_stats;
+    };
+}
+
+#endif // __PIPELINE_CACHE_H__
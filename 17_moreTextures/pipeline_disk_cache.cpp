@@ -0,0 +1,113 @@
+#include "pipeline_disk_cache.hpp"
+#include "context.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace toy2d {
+
+static uint64_t fnv1a(const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+PipelineDiskCache::PipelineDiskCache(const std::string& path) : m_path(path), m_warm(false), m_loadedSize(0) {
+    m_properties = Context::GetInstance().GetPhyDevice().getProperties();
+
+    std::string data = loadValidData();
+    m_warm = !data.empty();
+    m_loadedSize = data.size();
+
+    vk::PipelineCacheCreateInfo createInfo;
+    createInfo.setInitialDataSize(data.size())
+        .setPInitialData(data.empty() ? nullptr : data.data());
+    m_cache = Context::GetInstance().GetDevice().createPipelineCache(createInfo);
+}
+
+PipelineDiskCache::~PipelineDiskCache() {
+    Context::GetInstance().GetDevice().destroyPipelineCache(m_cache);
+}
+
+PipelineDiskCache::Header PipelineDiskCache::makeHeader() const {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = Magic;
+    header.version = Version;
+    header.vendorID = m_properties.vendorID;
+    header.deviceID = m_properties.deviceID;
+    header.driverVersion = m_properties.driverVersion;
+    memcpy(header.uuid, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+    return header;
+}
+
+std::string PipelineDiskCache::loadValidData() {
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    Header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        std::cout << "pipeline cache: truncated header, ignored" << std::endl;
+        return {};
+    }
+
+    Header expected = makeHeader();
+    if (header.magic != expected.magic || header.version != expected.version ||
+        header.vendorID != expected.vendorID || header.deviceID != expected.deviceID ||
+        header.driverVersion != expected.driverVersion ||
+        memcmp(header.uuid, expected.uuid, VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache: device or driver changed, ignored" << std::endl;
+        return {};
+    }
+
+    // 防止损坏的头部申请出离谱的内存
+    constexpr uint64_t MaxDataSize = 256ull * 1024 * 1024;
+    if (header.dataSize > MaxDataSize) {
+        std::cout << "pipeline cache: corrupted data, ignored" << std::endl;
+        return {};
+    }
+
+    std::string data(header.dataSize, '\0');
+    if (!file.read(data.data(), data.size()) || fnv1a(data.data(), data.size()) != header.checksum) {
+        std::cout << "pipeline cache: corrupted data, ignored" << std::endl;
+        return {};
+    }
+
+    return data;
+}
+
+void PipelineDiskCache::Save() {
+    auto data = Context::GetInstance().GetDevice().getPipelineCacheData(m_cache);
+
+    Header header = makeHeader();
+    header.dataSize = data.size();
+    header.checksum = fnv1a(data.data(), data.size());
+
+    std::string tmpPath = m_path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            std::cout << "pipeline cache: write " << tmpPath << " failed" << std::endl;
+            return;
+        }
+    }
+
+    // rename 会覆盖已有文件, 读者要么看到旧文件要么看到完整的新文件
+    std::error_code error;
+    std::filesystem::rename(tmpPath, m_path, error);
+    if (error) {
+        std::cout << "pipeline cache: rename failed, " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+}
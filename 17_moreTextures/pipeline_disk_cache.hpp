@@ -0,0 +1,55 @@
+#ifndef __PIPELINE_DISK_CACHE_H__
+#define __PIPELINE_DISK_CACHE_H__
+
+#include <string>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 持久化到磁盘的 vk::PipelineCache
+ * 文件头记录 vendor/device/driver 版本与 pipelineCacheUUID, 任一项与当前设备不符或校验失败时
+ * 丢弃旧数据从空缓存开始. 写回时先写临时文件再重命名, 中途崩溃不会留下半个文件
+ */
+class PipelineDiskCache final
+{
+public:
+    PipelineDiskCache(const std::string& path);
+    ~PipelineDiskCache();
+
+    // 写回磁盘, 失败只打印警告
+    void Save();
+
+    vk::PipelineCache Get() const { return m_cache; }
+    // 是否成功加载了与当前设备匹配的旧数据
+    bool IsWarm() const { return m_warm; }
+    size_t GetLoadedSize() const { return m_loadedSize; }
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t uuid[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t checksum;
+    };
+
+    static constexpr uint32_t Magic = 0x43503254; // "T2PC"
+    static constexpr uint32_t Version = 1;
+
+    Header makeHeader() const;
+    std::string loadValidData();
+
+    std::string m_path;
+    vk::PipelineCache m_cache;
+    vk::PhysicalDeviceProperties m_properties;
+    bool m_warm;
+    size_t m_loadedSize;
+};
+
+}
+
+#endif // __PIPELINE_DISK_CACHE_H__
@@ -0,0 +1,241 @@
+#include "profiler.hpp"
+
+#ifdef TOY2D_ENABLE_PROFILER
+
+#include "context.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace toy2d {
+
+// GPU 事件在 trace 中单独占一行
+static constexpr uint32_t GpuThreadIndex = 1000;
+static constexpr size_t MaxGpuEvents = 1 << 16;
+static constexpr uint32_t InvalidQuery = ~0u;
+
+Profiler& Profiler::Instance() {
+    static Profiler instance;
+    return instance;
+}
+
+Profiler::Profiler() : m_start(std::chrono::steady_clock::now()), m_curGpuFrame(0),
+    m_timestampPeriod(1.0f), m_timestampMask(~0ull), m_gpuEnabled(false) {
+}
+
+uint64_t Profiler::NowNs() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        std::unique_ptr<ThreadBuffer> created(new ThreadBuffer);
+        created->events.resize(ThreadBuffer::Capacity);
+        created->threadIndex = static_cast<uint32_t>(m_threads.size());
+        buffer = created.get();
+        m_threads.push_back(std::move(created));
+    }
+    return *buffer;
+}
+
+void Profiler::RecordCpu(const char* name, uint64_t beginNs, uint64_t endNs) {
+    auto& buffer = threadBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % ThreadBuffer::Capacity] = Event{ name, beginNs, endNs };
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::InitGpu(int maxFlightCount) {
+    auto& ctx = Context::GetInstance();
+    auto properties = ctx.GetPhyDevice().getProperties();
+    auto families = ctx.GetPhyDevice().getQueueFamilyProperties();
+    uint32_t validBits = families[ctx.GetQueueFamilyIndices().grapghicsQueue.value()].timestampValidBits;
+
+    m_gpuEnabled = validBits > 0 && properties.limits.timestampPeriod > 0;
+    if (!m_gpuEnabled) {
+        std::cout << "profiler: graphics queue has no timestamp support, GPU scopes disabled" << std::endl;
+        return;
+    }
+
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    vk::QueryPoolCreateInfo createInfo;
+    createInfo.setQueryType(vk::QueryType::eTimestamp)
+        .setQueryCount(MaxQueriesPerFrame);
+
+    m_gpuFrames.resize(maxFlightCount);
+    for (auto& frame : m_gpuFrames) {
+        frame.pool = ctx.GetDevice().createQueryPool(createInfo);
+    }
+}
+
+void Profiler::ShutdownGpu() {
+    auto& device = Context::GetInstance().GetDevice();
+    for (auto& frame : m_gpuFrames) {
+        device.destroyQueryPool(frame.pool);
+    }
+    m_gpuFrames.clear();
+    m_gpuEnabled = false;
+}
+
+uint32_t Profiler::writeTimestamp(vk::CommandBuffer cmd, vk::PipelineStageFlagBits stage) {
+    auto& frame = m_gpuFrames[m_curGpuFrame];
+    cmd.writeTimestamp(stage, frame.pool, frame.queryCount);
+    return frame.queryCount++;
+}
+
+void Profiler::GpuBeginFrame(vk::CommandBuffer cmd, int frameIndex) {
+    if (!m_gpuEnabled) {
+        return;
+    }
+
+    m_curGpuFrame = frameIndex;
+    auto& frame = m_gpuFrames[frameIndex];
+    collectGpuFrame(frame);
+
+    frame.scopes.clear();
+    frame.stack.clear();
+    frame.queryCount = 0;
+    frame.submitted = false;
+    cmd.resetQueryPool(frame.pool, 0, MaxQueriesPerFrame);
+
+    // 0 号查询作为这一帧的时间基准
+    writeTimestamp(cmd, vk::PipelineStageFlagBits::eTopOfPipe);
+}
+
+void Profiler::GpuBegin(vk::CommandBuffer cmd, const char* name) {
+    if (!m_gpuEnabled) {
+        return;
+    }
+
+    auto& frame = m_gpuFrames[m_curGpuFrame];
+    if (frame.queryCount + 2 > MaxQueriesPerFrame) {
+        // 查询用完了, 丢弃这个 scope, 但要保持 begin/end 配对
+        frame.stack.push_back(InvalidQuery);
+        return;
+    }
+
+    GpuScope scope;
+    scope.name = name;
+    scope.beginQuery = writeTimestamp(cmd, vk::PipelineStageFlagBits::eTopOfPipe);
+    scope.endQuery = InvalidQuery;
+    frame.stack.push_back(static_cast<uint32_t>(frame.scopes.size()));
+    frame.scopes.push_back(scope);
+}
+
+void Profiler::GpuEnd(vk::CommandBuffer cmd) {
+    if (!m_gpuEnabled) {
+        return;
+    }
+
+    auto& frame = m_gpuFrames[m_curGpuFrame];
+    if (frame.stack.empty()) {
+        return;
+    }
+    uint32_t index = frame.stack.back();
+    frame.stack.pop_back();
+    if (index != InvalidQuery) {
+        frame.scopes[index].endQuery = writeTimestamp(cmd, vk::PipelineStageFlagBits::eBottomOfPipe);
+    }
+}
+
+void Profiler::GpuSubmitted() {
+    if (!m_gpuEnabled) {
+        return;
+    }
+
+    auto& frame = m_gpuFrames[m_curGpuFrame];
+    frame.submitNs = NowNs();
+    frame.submitted = true;
+}
+
+void Profiler::collectGpuFrame(GpuFrame& frame) {
+    if (!frame.submitted || frame.queryCount == 0) {
+        return;
+    }
+
+    // 调用方已经等过该帧的 fence, 这里不会阻塞
+    auto result = Context::GetInstance().GetDevice().getQueryPoolResults<uint64_t>(frame.pool, 0, frame.queryCount,
+        frame.queryCount * sizeof(uint64_t), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (result.result != vk::Result::eSuccess) {
+        return;
+    }
+    auto& ticks = result.value;
+
+    // 没有校准扩展时, 把帧的第一个时间戳近似对齐到提交时刻
+    auto toNs = [&](uint32_t query) {
+        uint64_t delta = (ticks[query] - ticks[0]) & m_timestampMask;
+        return frame.submitNs + static_cast<uint64_t>(delta * static_cast<double>(m_timestampPeriod));
+    };
+
+    std::lock_guard<std::mutex> lock(m_gpuMutex);
+    for (auto& scope : frame.scopes) {
+        if (scope.endQuery == InvalidQuery) {
+            continue;
+        }
+        m_gpuEvents.push_back(Event{ scope.name, toNs(scope.beginQuery), toNs(scope.endQuery) });
+    }
+    if (m_gpuEvents.size() > MaxGpuEvents) {
+        m_gpuEvents.erase(m_gpuEvents.begin(), m_gpuEvents.begin() + (m_gpuEvents.size() - MaxGpuEvents));
+    }
+    frame.submitted = false;
+}
+
+static void writeEvent(std::ofstream& file, bool& first, const char* name, uint64_t beginNs, uint64_t endNs, uint32_t tid) {
+    file << (first ? "" : ",\n") << "{\"name\":\"";
+    for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            file << '\\';
+        }
+        file << *c;
+    }
+    file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+         << ",\"ts\":" << beginNs / 1000.0
+         << ",\"dur\":" << (endNs > beginNs ? endNs - beginNs : 0) / 1000.0 << "}";
+    first = false;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "profiler: can not open " << path << std::endl;
+        return false;
+    }
+
+    // ts/dur 单位为微秒, 默认 6 位有效数字在程序运行几秒后就丢掉了小数部分
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    {
+        // 录制线程不停的话最旧的几个事件可能正被覆盖, 对分析没有影响
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        for (auto& buffer : m_threads) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t count = std::min<uint64_t>(head, ThreadBuffer::Capacity);
+            for (uint64_t i = head - count; i < head; i++) {
+                const Event& event = buffer->events[i % ThreadBuffer::Capacity];
+                writeEvent(file, first, event.name, event.beginNs, event.endNs, buffer->threadIndex);
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_gpuMutex);
+        for (const auto& event : m_gpuEvents) {
+            writeEvent(file, first, event.name, event.beginNs, event.endNs, GpuThreadIndex);
+        }
+    }
+    file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuThreadIndex
+         << ",\"args\":{\"name\":\"GPU\"}}\n]}\n";
+
+    std::cout << "profiler: trace written to " << path << std::endl;
+    return static_cast<bool>(file);
+}
+
+}
+
+#endif // TOY2D_ENABLE_PROFILER
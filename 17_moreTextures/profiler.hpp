@@ -0,0 +1,156 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/**
+ * 性能分析: CPU 作用域计时 + GPU timestamp 查询, 导出为 Chrome trace JSON (chrome://tracing, Perfetto 均可打开)
+ *
+ * 只有定义了 TOY2D_ENABLE_PROFILER (cmake -DTOY2D_ENABLE_PROFILER=ON) 时才会编译进来,
+ * 否则下面的宏全部展开为空, 不产生任何代码.
+ *
+ * CPU 事件写进每个线程自己的 ring buffer, 记录时不加锁; 写满后覆盖最旧的事件.
+ * GPU 事件每个飞行帧一个 query pool, 等该帧的 fence 之后才读回, 读回时按提交时刻对齐到 CPU 时间轴上.
+ */
+
+#ifdef TOY2D_ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+class Profiler final
+{
+public:
+    static Profiler& Instance();
+
+    // CPU 事件, name 必须是字符串字面量之类生命周期足够长的字符串
+    void RecordCpu(const char* name, uint64_t beginNs, uint64_t endNs);
+    uint64_t NowNs() const;
+
+    // GPU 部分: 需要设备已经创建, 由 Renderer 负责初始化与销毁
+    void InitGpu(int maxFlightCount);
+    void ShutdownGpu();
+    // 在帧 command buffer 开头 (render pass 之外) 调用, 会先读回该槽位上一次的结果
+    void GpuBeginFrame(vk::CommandBuffer cmd, int frame);
+    void GpuBegin(vk::CommandBuffer cmd, const char* name);
+    void GpuEnd(vk::CommandBuffer cmd);
+    // 帧提交时调用, 记录用于对齐 GPU 时间的 CPU 时刻
+    void GpuSubmitted();
+
+    bool WriteChromeTrace(const std::string& path);
+
+private:
+    Profiler();
+
+    struct Event {
+        const char* name;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+
+    // 单生产者 ring buffer, 只有所属线程写入, 导出时读取
+    struct ThreadBuffer {
+        static constexpr size_t Capacity = 1 << 16;
+        std::vector<Event> events;
+        std::atomic<uint64_t> head{ 0 };
+        uint32_t threadIndex;
+    };
+
+    struct GpuScope {
+        const char* name;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct GpuFrame {
+        vk::QueryPool pool;
+        std::vector<GpuScope> scopes;
+        std::vector<uint32_t> stack; // 未结束的 scope 下标
+        uint32_t queryCount = 0;
+        uint64_t submitNs = 0;
+        bool submitted = false;
+    };
+
+    ThreadBuffer& threadBuffer();
+    void collectGpuFrame(GpuFrame& frame);
+    uint32_t writeTimestamp(vk::CommandBuffer cmd, vk::PipelineStageFlagBits stage);
+
+    static constexpr uint32_t MaxQueriesPerFrame = 256;
+
+    std::chrono::steady_clock::time_point m_start;
+
+    std::mutex m_threadsMutex; // 只在线程第一次记录与导出时使用
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+    std::mutex m_gpuMutex;     // GPU 结果读回与导出之间的互斥
+    std::vector<GpuFrame> m_gpuFrames;
+    std::vector<Event> m_gpuEvents;
+    int m_curGpuFrame;
+    float m_timestampPeriod;   // 每个 tick 的纳秒数
+    uint64_t m_timestampMask;
+    bool m_gpuEnabled;
+};
+
+class ProfileScope final
+{
+public:
+    ProfileScope(const char* name) : m_name(name), m_begin(Profiler::Instance().NowNs()) {}
+    ~ProfileScope() { Profiler::Instance().RecordCpu(m_name, m_begin, Profiler::Instance().NowNs()); }
+
+private:
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+class GpuProfileScope final
+{
+public:
+    GpuProfileScope(vk::CommandBuffer cmd, const char* name) : m_cmd(cmd) { Profiler::Instance().GpuBegin(cmd, name); }
+    ~GpuProfileScope() { Profiler::Instance().GpuEnd(m_cmd); }
+
+private:
+    vk::CommandBuffer m_cmd;
+};
+
+}
+
+#define TOY2D_PROFILE_CONCAT_IMPL(a, b) a##b
+#define TOY2D_PROFILE_CONCAT(a, b) TOY2D_PROFILE_CONCAT_IMPL(a, b)
+
+#define TOY2D_PROFILE_SCOPE(name) ::toy2d::ProfileScope TOY2D_PROFILE_CONCAT(toy2dProfileScope, __LINE__)(name)
+#define TOY2D_PROFILE_FUNCTION() TOY2D_PROFILE_SCOPE(__FUNCTION__)
+
+#define TOY2D_PROFILE_GPU_INIT(maxFlightCount) ::toy2d::Profiler::Instance().InitGpu(maxFlightCount)
+#define TOY2D_PROFILE_GPU_SHUTDOWN() ::toy2d::Profiler::Instance().ShutdownGpu()
+#define TOY2D_PROFILE_GPU_FRAME(cmd, frame) ::toy2d::Profiler::Instance().GpuBeginFrame(cmd, frame)
+#define TOY2D_PROFILE_GPU_BEGIN(cmd, name) ::toy2d::Profiler::Instance().GpuBegin(cmd, name)
+#define TOY2D_PROFILE_GPU_END(cmd) ::toy2d::Profiler::Instance().GpuEnd(cmd)
+#define TOY2D_PROFILE_GPU_SCOPE(cmd, name) \
+    ::toy2d::GpuProfileScope TOY2D_PROFILE_CONCAT(toy2dGpuProfileScope, __LINE__)(cmd, name)
+#define TOY2D_PROFILE_GPU_SUBMITTED() ::toy2d::Profiler::Instance().GpuSubmitted()
+
+#define TOY2D_PROFILE_EXPORT(path) ::toy2d::Profiler::Instance().WriteChromeTrace(path)
+
+#else
+
+#define TOY2D_PROFILE_SCOPE(name) ((void)0)
+#define TOY2D_PROFILE_FUNCTION() ((void)0)
+
+#define TOY2D_PROFILE_GPU_INIT(maxFlightCount) ((void)0)
+#define TOY2D_PROFILE_GPU_SHUTDOWN() ((void)0)
+#define TOY2D_PROFILE_GPU_FRAME(cmd, frame) ((void)0)
+#define TOY2D_PROFILE_GPU_BEGIN(cmd, name) ((void)0)
+#define TOY2D_PROFILE_GPU_END(cmd) ((void)0)
+#define TOY2D_PROFILE_GPU_SCOPE(cmd, name) ((void)0)
+#define TOY2D_PROFILE_GPU_SUBMITTED() ((void)0)
+
+#define TOY2D_PROFILE_EXPORT(path) false
+
+#endif // TOY2D_ENABLE_PROFILER
+
+#endif // __PROFILER_H__
@@ -0,0 +1,601 @@
+#include "render_graph.hpp"
+#include "context.h"
+#include "profiler.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace toy2d {
+
+namespace {
+
+struct AccessInfo {
+    vk::PipelineStageFlags stages;
+    vk::AccessFlags access;
+    vk::ImageLayout layout;        // eUndefined 表示不能用于图像
+    vk::ImageUsageFlags usage;     // 为空表示不能用于临时图像
+    bool buffer;                   // 能否用于 buffer
+};
+
+constexpr vk::AccessFlags kWriteAccess = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+    vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostWrite;
+
+AccessInfo GetAccessInfo(GraphAccess access)
+{
+    using Stage = vk::PipelineStageFlagBits;
+    using Access = vk::AccessFlagBits;
+    using Layout = vk::ImageLayout;
+    using Usage = vk::ImageUsageFlagBits;
+
+    switch (access) {
+    case GraphAccess::VertexBuffer:
+        return { Stage::eVertexInput, Access::eVertexAttributeRead, Layout::eUndefined, {}, true };
+    case GraphAccess::IndexBuffer:
+        return { Stage::eVertexInput, Access::eIndexRead, Layout::eUndefined, {}, true };
+    case GraphAccess::IndirectBuffer:
+        return { Stage::eDrawIndirect, Access::eIndirectCommandRead, Layout::eUndefined, {}, true };
+    case GraphAccess::UniformBuffer:
+        return { Stage::eVertexShader | Stage::eFragmentShader, Access::eUniformRead, Layout::eUndefined, {}, true };
+    case GraphAccess::HostRead:
+        return { Stage::eHost, Access::eHostRead, Layout::eUndefined, {}, true };
+    case GraphAccess::ComputeRead:
+        return { Stage::eComputeShader, Access::eShaderRead, Layout::eGeneral, Usage::eStorage, true };
+    case GraphAccess::ComputeWrite:
+        return { Stage::eComputeShader, Access::eShaderRead | Access::eShaderWrite, Layout::eGeneral, Usage::eStorage, true };
+    case GraphAccess::TransferRead:
+        return { Stage::eTransfer, Access::eTransferRead, Layout::eTransferSrcOptimal, Usage::eTransferSrc, true };
+    case GraphAccess::TransferWrite:
+        return { Stage::eTransfer, Access::eTransferWrite, Layout::eTransferDstOptimal, Usage::eTransferDst, true };
+    case GraphAccess::ColorAttachment:
+        return { Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+                 Layout::eColorAttachmentOptimal, Usage::eColorAttachment, false };
+    case GraphAccess::FragmentSampled:
+        return { Stage::eFragmentShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal, Usage::eSampled, false };
+    case GraphAccess::ComputeSampled:
+        return { Stage::eComputeShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal, Usage::eSampled, false };
+    case GraphAccess::Present:
+        // 呈现由 semaphore 同步, 这里只需要布局转换
+        return { Stage::eBottomOfPipe, {}, Layout::ePresentSrcKHR, {}, false };
+    }
+    throw std::runtime_error("unknown render graph access!");
+}
+
+bool Overlaps(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB)
+{
+    return firstA <= lastB && firstB <= lastA;
+}
+
+vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void RenderGraph::PassBuilder::Read(Resource resource, GraphAccess access)
+{
+    m_graph.m_passes[m_pass].uses.push_back({ resource, access, false });
+}
+
+void RenderGraph::PassBuilder::Write(Resource resource, GraphAccess access)
+{
+    if (access == GraphAccess::HostRead || access == GraphAccess::Present) {
+        throw std::runtime_error("render graph: HostRead/Present can only be a final access!");
+    }
+    m_graph.m_passes[m_pass].uses.push_back({ resource, access, true });
+}
+
+void RenderGraph::PassBuilder::SideEffect()
+{
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+RenderGraph::~RenderGraph()
+{
+    destroyPhysical();
+}
+
+void RenderGraph::Reset()
+{
+    m_passes.clear();
+    m_resources.clear();
+    m_finalBarrier = Barrier{};
+    m_compiled = false;
+    m_nextPass = 0;
+    m_finished = false;
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(const std::string& name, vk::Image image, vk::ImageLayout initialLayout,
+                                               std::optional<GraphAccess> finalAccess)
+{
+    ResourceNode node;
+    node.name = name;
+    node.image = true;
+    node.imageHandle = image;
+    node.initialLayout = initialLayout;
+    node.finalAccess = finalAccess;
+    m_resources.push_back(std::move(node));
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(const std::string& name, vk::Buffer buffer,
+                                                std::optional<GraphAccess> finalAccess)
+{
+    ResourceNode node;
+    node.name = name;
+    node.buffer = buffer;
+    node.finalAccess = finalAccess;
+    m_resources.push_back(std::move(node));
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(const std::string& name, const ImageDesc& desc)
+{
+    ResourceNode node;
+    node.name = name;
+    node.image = true;
+    node.transient = true;
+    node.desc = desc;
+    m_resources.push_back(std::move(node));
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::AddPass(const std::string& name, const SetupFunc& setup, ExecuteFunc execute)
+{
+    if (m_compiled) {
+        throw std::runtime_error("render graph: AddPass after Compile, call Reset first!");
+    }
+    PassNode node;
+    node.name = name;
+    node.execute = std::move(execute);
+    m_passes.push_back(std::move(node));
+
+    auto pass = static_cast<Pass>(m_passes.size() - 1);
+    PassBuilder builder(*this, pass);
+    setup(builder);
+
+    // 声明与资源类型对不上时尽早报错
+    for (const auto& use : m_passes[pass].uses) {
+        if (use.resource >= m_resources.size()) {
+            throw std::runtime_error("render graph: pass " + name + " uses an unknown resource!");
+        }
+        const auto& resource = m_resources[use.resource];
+        auto info = GetAccessInfo(use.access);
+        bool valid = resource.image ? info.layout != vk::ImageLayout::eUndefined : info.buffer;
+        if (!valid) {
+            throw std::runtime_error("render graph: invalid access to " + resource.name + " in pass " + name);
+        }
+    }
+    return pass;
+}
+
+void RenderGraph::Compile()
+{
+    TOY2D_PROFILE_FUNCTION();
+    m_stats = Stats{};
+    cull();
+    allocateTransients();
+    computeBarriers();
+    m_compiled = true;
+}
+
+void RenderGraph::cull()
+{
+    // 从后往前: pass 写的资源之后还有人要, 或者它有副作用时保留, 保留的 pass 读的资源变成需要的.
+    // 写入不会让资源变成 "不需要", 同一资源更早的写入者 (例如先画底图再叠加) 也都保留
+    std::vector<bool> needed(m_resources.size(), false);
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        needed[i] = m_resources[i].finalAccess.has_value();
+    }
+
+    for (auto it = m_passes.rbegin(); it != m_passes.rend(); ++it) {
+        auto& pass = *it;
+        bool live = pass.sideEffect;
+        for (const auto& use : pass.uses) {
+            live = live || (use.write && needed[use.resource]);
+        }
+        pass.culled = !live;
+        if (!live) {
+            m_stats.culledPasses++;
+            continue;
+        }
+        for (const auto& use : pass.uses) {
+            if (!use.write) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+    m_stats.passes = static_cast<uint32_t>(m_passes.size()) - m_stats.culledPasses;
+}
+
+void RenderGraph::allocateTransients()
+{
+    // 每张用到的临时图像一个物理图像, 生命周期为第一个到最后一个用到它的 pass
+    std::vector<PhysicalImage> images;
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        auto& resource = m_resources[r];
+        resource.physical = UINT32_MAX;
+        if (!resource.transient) {
+            continue;
+        }
+
+        PhysicalImage image;
+        image.desc = resource.desc;
+        bool used = false;
+        for (uint32_t p = 0; p < m_passes.size(); p++) {
+            if (m_passes[p].culled) {
+                continue;
+            }
+            for (const auto& use : m_passes[p].uses) {
+                if (use.resource != r) {
+                    continue;
+                }
+                if (!used && !use.write) {
+                    throw std::runtime_error("render graph: transient image " + resource.name + " is read before written!");
+                }
+                if (!used) {
+                    image.first = p;
+                }
+                used = true;
+                image.last = p;
+                image.usage |= GetAccessInfo(use.access).usage;
+            }
+        }
+        if (resource.finalAccess) {
+            throw std::runtime_error("render graph: transient image " + resource.name + " cannot be an output!");
+        }
+        if (used) {
+            resource.physical = static_cast<uint32_t>(images.size());
+            images.push_back(std::move(image));
+        }
+    }
+
+    // 和上一次编译的声明完全一样时直接复用图像与内存
+    bool same = images.size() == m_physicalImages.size();
+    for (size_t i = 0; same && i < images.size(); i++) {
+        const auto& a = images[i];
+        const auto& b = m_physicalImages[i];
+        same = a.desc.format == b.desc.format && a.desc.extent == b.desc.extent && a.usage == b.usage &&
+               a.first == b.first && a.last == b.last;
+    }
+    if (!same) {
+        destroyPhysical();
+        createPhysical(std::move(images));
+    }
+
+    for (const auto& image : m_physicalImages) {
+        m_stats.unaliasedBytes += image.requirements.size;
+    }
+    for (const auto& arena : m_arenas) {
+        m_stats.transientBytes += arena.size;
+    }
+    m_stats.transientImages = static_cast<uint32_t>(m_physicalImages.size());
+}
+
+void RenderGraph::createPhysical(std::vector<PhysicalImage> images)
+{
+    auto& ctx = Context::GetInstance();
+    auto& device = ctx.GetDevice();
+
+    m_physicalImages = std::move(images);
+    for (auto& image : m_physicalImages) {
+        vk::ImageCreateInfo createInfo;
+        createInfo.setImageType(vk::ImageType::e2D)
+            .setFormat(image.desc.format)
+            .setExtent({ image.desc.extent.width, image.desc.extent.height, 1 })
+            .setMipLevels(1)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(image.usage)
+            .setSharingMode(vk::SharingMode::eExclusive)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+        image.image = device.createImage(createInfo);
+        image.requirements = device.getImageMemoryRequirements(image.image);
+    }
+
+    placeTransients();
+
+    for (auto& arena : m_arenas) {
+        vk::MemoryRequirements requirements;
+        requirements.setSize(arena.size)
+            .setAlignment(arena.alignment)
+            .setMemoryTypeBits(arena.memoryTypeBits);
+        arena.allocation = ctx.m_memoryAllocator->AllocateMemory(requirements, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    vk::ImageSubresourceRange range;
+    range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseMipLevel(0)
+        .setLevelCount(1)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1);
+    for (auto& image : m_physicalImages) {
+        auto& arena = m_arenas[image.arena];
+        device.bindImageMemory(image.image, arena.allocation.memory, arena.allocation.offset + image.offset);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.setImage(image.image)
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(image.desc.format)
+            .setSubresourceRange(range);
+        image.view = device.createImageView(viewInfo);
+    }
+}
+
+void RenderGraph::placeTransients()
+{
+    // 从大到小放置: 每张图像在兼容的内存里, 避开生命周期与它重叠的图像, 取最低的空隙
+    std::vector<uint32_t> order(m_physicalImages.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return m_physicalImages[a].requirements.size > m_physicalImages[b].requirements.size;
+    });
+
+    m_arenas.clear();
+    std::vector<std::vector<uint32_t>> placed;
+    for (auto i : order) {
+        auto& image = m_physicalImages[i];
+        const auto& requirements = image.requirements;
+
+        uint32_t a = 0;
+        while (a < m_arenas.size() && !(m_arenas[a].memoryTypeBits & requirements.memoryTypeBits)) {
+            a++;
+        }
+        if (a == m_arenas.size()) {
+            m_arenas.emplace_back();
+            m_arenas.back().memoryTypeBits = requirements.memoryTypeBits;
+            placed.emplace_back();
+        }
+        auto& arena = m_arenas[a];
+        arena.memoryTypeBits &= requirements.memoryTypeBits;
+
+        std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> busy;
+        for (auto j : placed[a]) {
+            const auto& other = m_physicalImages[j];
+            if (Overlaps(image.first, image.last, other.first, other.last)) {
+                busy.emplace_back(other.offset, other.offset + other.requirements.size);
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+
+        vk::DeviceSize offset = 0;
+        for (const auto& [begin, end] : busy) {
+            offset = AlignUp(offset, requirements.alignment);
+            if (offset + requirements.size <= begin) {
+                break;
+            }
+            offset = std::max(offset, end);
+        }
+        offset = AlignUp(offset, requirements.alignment);
+
+        image.arena = a;
+        image.offset = offset;
+        arena.size = std::max(arena.size, offset + requirements.size);
+        arena.alignment = std::max(arena.alignment, requirements.alignment);
+
+        // 内存重叠的图像生命周期必然不重叠, 后用的那张首次使用前要等先用的那张
+        for (auto j : placed[a]) {
+            auto& other = m_physicalImages[j];
+            bool memoryOverlaps = offset < other.offset + other.requirements.size &&
+                                  other.offset < offset + requirements.size;
+            if (!memoryOverlaps) {
+                continue;
+            }
+            if (other.last < image.first) {
+                image.aliases.push_back(j);
+            }
+            else {
+                other.aliases.push_back(i);
+            }
+        }
+        placed[a].push_back(i);
+    }
+}
+
+void RenderGraph::destroyPhysical()
+{
+    if (m_physicalImages.empty() && m_arenas.empty()) {
+        return;
+    }
+    auto& ctx = Context::GetInstance();
+    auto& device = ctx.GetDevice();
+    for (auto& image : m_physicalImages) {
+        device.destroyImageView(image.view);
+        device.destroyImage(image.image);
+    }
+    for (auto& arena : m_arenas) {
+        ctx.m_memoryAllocator->Free(arena.allocation);
+    }
+    m_physicalImages.clear();
+    m_arenas.clear();
+}
+
+void RenderGraph::computeBarriers()
+{
+    std::vector<State> states(m_resources.size());
+    std::vector<Resource> owners(m_physicalImages.size());
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        states[r].layout = m_resources[r].initialLayout;
+        if (m_resources[r].physical != UINT32_MAX) {
+            owners[m_resources[r].physical] = static_cast<Resource>(r);
+        }
+    }
+
+    for (uint32_t p = 0; p < m_passes.size(); p++) {
+        auto& pass = m_passes[p];
+        if (pass.culled) {
+            continue;
+        }
+        for (const auto& use : pass.uses) {
+            const auto& resource = m_resources[use.resource];
+            // 别名内存上的图像第一次使用: 等之前用这段内存的图像
+            std::optional<State> aliased;
+            if (resource.physical != UINT32_MAX) {
+                const auto& image = m_physicalImages[resource.physical];
+                if (image.first == p && !image.aliases.empty() && !states[use.resource].writeStages) {
+                    aliased = State{};
+                    for (auto j : image.aliases) {
+                        const auto& other = states[owners[j]];
+                        aliased->writeStages |= other.writeStages | other.readStages;
+                        aliased->writeAccess |= other.writeAccess;
+                    }
+                }
+            }
+            addBarrier(pass.barrier, states[use.resource], resource, use.access, use.write,
+                       aliased ? &*aliased : nullptr);
+        }
+    }
+
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        if (m_resources[r].finalAccess) {
+            addBarrier(m_finalBarrier, states[r], m_resources[r], *m_resources[r].finalAccess, false, nullptr);
+        }
+    }
+}
+
+void RenderGraph::addBarrier(Barrier& barrier, State& state, const ResourceNode& resource, GraphAccess access,
+                             bool write, const State* aliased)
+{
+    auto info = GetAccessInfo(access);
+    bool transition = resource.image && state.layout != info.layout;
+
+    if (!write && !transition) {
+        // 读: 上一次写入之后, 这个阶段的这种访问还没有同步过时才需要屏障, 读后读不需要
+        bool covered = !(info.stages & ~state.visibleStages) && !(info.access & ~state.visibleAccess);
+        if (state.writeStages && !covered) {
+            barrier.srcStages |= state.writeStages;
+            barrier.dstStages |= info.stages;
+            if (state.writeAccess) {
+                barrier.srcAccess |= state.writeAccess;
+                barrier.dstAccess |= info.access;
+            }
+            state.visibleStages |= info.stages;
+            state.visibleAccess |= info.access;
+        }
+        state.readStages |= info.stages;
+        return;
+    }
+
+    // 写或者布局转换: 等之前所有的读 (只要执行依赖) 与写 (还要让写入可用)
+    vk::PipelineStageFlags srcStages = state.writeStages | state.readStages;
+    vk::AccessFlags srcAccess = state.writeAccess;
+    if (aliased) {
+        srcStages |= aliased->writeStages;
+        srcAccess |= aliased->writeAccess;
+    }
+
+    if (transition) {
+        vk::ImageSubresourceRange range;
+        range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+            .setBaseMipLevel(0)
+            .setLevelCount(VK_REMAINING_MIP_LEVELS)
+            .setBaseArrayLayer(0)
+            .setLayerCount(VK_REMAINING_ARRAY_LAYERS);
+        vk::ImageMemoryBarrier imageBarrier;
+        imageBarrier.setImage(resource.transient ? m_physicalImages[resource.physical].image : resource.imageHandle)
+            .setOldLayout(state.layout)
+            .setNewLayout(info.layout)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setSrcAccessMask(srcAccess)
+            .setDstAccessMask(info.access)
+            .setSubresourceRange(range);
+        barrier.images.push_back(imageBarrier);
+        // 图里第一次访问: 源阶段取目标阶段, 与 acquire semaphore 的等待阶段接成依赖链
+        barrier.srcStages |= srcStages ? srcStages : info.stages;
+        barrier.dstStages |= info.stages;
+    }
+    else if (srcStages) {
+        barrier.srcStages |= srcStages;
+        barrier.dstStages |= info.stages;
+        if (srcAccess) {
+            barrier.srcAccess |= srcAccess;
+            barrier.dstAccess |= info.access;
+        }
+    }
+
+    // 只读使用时的布局转换也算一次写入: 之后别的阶段来读还要等它
+    state.layout = resource.image ? info.layout : state.layout;
+    state.writeStages = info.stages;
+    state.writeAccess = write ? info.access & kWriteAccess : vk::AccessFlags{};
+    state.readStages = write ? vk::PipelineStageFlags{} : info.stages;
+    state.visibleStages = write ? vk::PipelineStageFlags{} : info.stages;
+    state.visibleAccess = write ? vk::AccessFlags{} : info.access;
+}
+
+void RenderGraph::record(vk::CommandBuffer cmd, const Barrier& barrier)
+{
+    if (barrier.Empty()) {
+        return;
+    }
+    vk::MemoryBarrier memoryBarrier;
+    memoryBarrier.setSrcAccessMask(barrier.srcAccess)
+        .setDstAccessMask(barrier.dstAccess);
+    bool hasMemory = barrier.srcAccess || barrier.dstAccess;
+    if (hasMemory) {
+        cmd.pipelineBarrier(barrier.srcStages, barrier.dstStages, {}, memoryBarrier, nullptr, barrier.images);
+    }
+    else {
+        cmd.pipelineBarrier(barrier.srcStages, barrier.dstStages, {}, nullptr, nullptr, barrier.images);
+    }
+    m_stats.barrierBatches++;
+    m_stats.memoryBarriers += hasMemory ? 1 : 0;
+    m_stats.imageBarriers += static_cast<uint32_t>(barrier.images.size());
+}
+
+void RenderGraph::ExecuteThrough(vk::CommandBuffer cmd, Pass pass)
+{
+    if (!m_compiled) {
+        throw std::runtime_error("render graph: Execute before Compile!");
+    }
+    for (; m_nextPass <= pass && m_nextPass < m_passes.size(); m_nextPass++) {
+        auto& node = m_passes[m_nextPass];
+        if (node.culled) {
+            continue;
+        }
+        // profiler 只保存名字指针, pass 名字每帧重建, 这里用固定的名字
+        TOY2D_PROFILE_SCOPE("RenderGraph::Pass");
+        record(cmd, node.barrier);
+        if (node.execute) {
+            node.execute(cmd);
+        }
+    }
+}
+
+void RenderGraph::Execute(vk::CommandBuffer cmd)
+{
+    if (!m_passes.empty()) {
+        ExecuteThrough(cmd, static_cast<Pass>(m_passes.size() - 1));
+    }
+    else if (!m_compiled) {
+        throw std::runtime_error("render graph: Execute before Compile!");
+    }
+    if (!m_finished) {
+        record(cmd, m_finalBarrier);
+        m_finished = true;
+    }
+}
+
+vk::Image RenderGraph::GetImage(Resource resource) const
+{
+    const auto& node = m_resources[resource];
+    if (!node.transient) {
+        return node.imageHandle;
+    }
+    if (node.physical == UINT32_MAX) {
+        throw std::runtime_error("render graph: image " + node.name + " is not allocated!");
+    }
+    return m_physicalImages[node.physical].image;
+}
+
+vk::ImageView RenderGraph::GetImageView(Resource resource) const
+{
+    const auto& node = m_resources[resource];
+    if (!node.transient || node.physical == UINT32_MAX) {
+        throw std::runtime_error("render graph: image " + node.name + " has no view owned by the graph!");
+    }
+    return m_physicalImages[node.physical].view;
+}
+
+}
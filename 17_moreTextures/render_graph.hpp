@@ -0,0 +1,210 @@
+#ifndef __RENDER_GRAPH_H__
+#define __RENDER_GRAPH_H__
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "memory_allocator.hpp"
+
+namespace toy2d {
+
+// pass 对资源的一次使用, 决定屏障的 stage/access 以及图像的布局
+enum class GraphAccess : uint8_t {
+    // buffer
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    UniformBuffer,
+    HostRead,        // 只用作导入资源的最终用途, 如读回 buffer
+    // buffer 或 image
+    ComputeRead,     // storage buffer/image, 图像为 eGeneral
+    ComputeWrite,    // 可读可写
+    TransferRead,
+    TransferWrite,
+    // image
+    ColorAttachment, // 可读可写, render pass 的 initial/final layout 都需为 eColorAttachmentOptimal
+    FragmentSampled,
+    ComputeSampled,
+    Present,         // 只用作导入资源的最终用途
+};
+
+/**
+ * @brief 帧渲染图
+ * pass 按添加顺序执行, 每个 pass 声明自己读写的 buffer/image 与用途, Compile 时:
+ * 1. 从输出 (导入时给了最终用途的资源) 与有副作用的 pass 往前推, 剔除结果没有人用到的 pass;
+ * 2. 按每个资源上一次的访问算出每个 pass 前需要的屏障 (读后读不需要), 同一个 pass 前的屏障合并为一次
+ *    pipelineBarrier, buffer 与不换布局的图像并成一个全局 memory barrier, 只有换布局时才用 image barrier;
+ * 3. 给图内创建的临时图像分配内存, 生命周期不重叠的图像绑到同一段内存上.
+ * 图每帧重建 (Reset 后重新声明), 临时图像与内存在声明不变时跨帧复用. 同一个图不能同时被两帧使用,
+ * 多帧飞行时每个帧槽位一个图, Compile 前调用方需保证该槽位上一次的提交已经完成
+ *
+ * 离屏 pass 的例子: 临时图像先作为 ColorAttachment 写入, 再在交换链 pass 中作为 FragmentSampled 读取,
+ * 两个 pass 之间的布局转换与同步由图负责; 临时图像的 framebuffer 由使用它的 pass 自己管理
+ */
+class RenderGraph final
+{
+public:
+    using Resource = uint32_t;
+    using Pass = uint32_t;
+
+    struct ImageDesc {
+        vk::Format format;
+        vk::Extent2D extent;
+    };
+
+    class PassBuilder final {
+    public:
+        void Read(Resource resource, GraphAccess access);
+        void Write(Resource resource, GraphAccess access);
+        // 没有输出也不能剔除的 pass, 例如写查询或者读回
+        void SideEffect();
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, Pass pass) : m_graph(graph), m_pass(pass) {}
+        RenderGraph& m_graph;
+        Pass m_pass;
+    };
+
+    using SetupFunc = std::function<void(PassBuilder&)>;
+    using ExecuteFunc = std::function<void(vk::CommandBuffer)>;
+
+    struct Stats {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        uint32_t barrierBatches = 0;   // pipelineBarrier 的调用次数
+        uint32_t imageBarriers = 0;
+        uint32_t memoryBarriers = 0;
+        uint32_t transientImages = 0;
+        vk::DeviceSize transientBytes = 0; // 别名后实际分配的内存
+        vk::DeviceSize unaliasedBytes = 0; // 每张临时图像单独分配时需要的内存
+    };
+
+    RenderGraph() = default;
+    ~RenderGraph();
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // 清空上一帧的 pass 与资源声明, 临时图像保留到下一次 Compile 再决定是否复用
+    void Reset();
+
+    // 外部图像, 进入图时处于 initialLayout; finalAccess 非空时是图的输出, 执行完后转换到对应布局
+    Resource ImportImage(const std::string& name, vk::Image image, vk::ImageLayout initialLayout,
+                         std::optional<GraphAccess> finalAccess = std::nullopt);
+    // 外部 buffer, 图开始前的写入 (host 写入或上一次提交) 视为已经可见
+    Resource ImportBuffer(const std::string& name, vk::Buffer buffer,
+                          std::optional<GraphAccess> finalAccess = std::nullopt);
+    // 临时图像, 内容不跨帧保留; usage 由各 pass 的声明推出
+    Resource CreateImage(const std::string& name, const ImageDesc& desc);
+
+    Pass AddPass(const std::string& name, const SetupFunc& setup, ExecuteFunc execute);
+
+    // 剔除, 计算屏障, 分配临时图像; 声明有误 (读了从没写过的临时图像等) 时抛出 std::runtime_error
+    void Compile();
+    // 录制剩下的所有 pass, 最后把输出转换到最终布局
+    void Execute(vk::CommandBuffer cmd);
+    // 只录制到 pass (含) 为止: pass 的回调开始了 render pass, 之后还要在外面继续录制时使用
+    void ExecuteThrough(vk::CommandBuffer cmd, Pass pass);
+
+    // 临时图像的句柄在 Compile 之后才有效
+    vk::Image GetImage(Resource resource) const;
+    vk::ImageView GetImageView(Resource resource) const;
+    vk::Buffer GetBuffer(Resource resource) const { return m_resources[resource].buffer; }
+    bool IsCulled(Pass pass) const { return m_passes[pass].culled; }
+    // 最近一次 Compile 与已经录制的屏障的统计
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct Use {
+        Resource resource;
+        GraphAccess access;
+        bool write;
+    };
+
+    struct Barrier {
+        vk::PipelineStageFlags srcStages;
+        vk::PipelineStageFlags dstStages;
+        vk::AccessFlags srcAccess; // 全局 memory barrier
+        vk::AccessFlags dstAccess;
+        std::vector<vk::ImageMemoryBarrier> images;
+
+        bool Empty() const { return !srcStages && !dstStages; }
+    };
+
+    struct PassNode {
+        std::string name;
+        ExecuteFunc execute;
+        std::vector<Use> uses;
+        bool sideEffect = false;
+        bool culled = false;
+        Barrier barrier; // 执行前录制
+    };
+
+    struct ResourceNode {
+        std::string name;
+        bool image = false;
+        bool transient = false;
+        vk::Image imageHandle;
+        vk::Buffer buffer;
+        vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+        std::optional<GraphAccess> finalAccess;
+        ImageDesc desc{};
+        uint32_t physical = UINT32_MAX; // 临时图像在 m_physicalImages 中的下标
+    };
+
+    // 资源在录制过程中的状态
+    struct State {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags writeStages;   // 上一次写入 (包括布局转换)
+        vk::AccessFlags writeAccess;
+        vk::PipelineStageFlags readStages;    // 上一次写入之后的读取, 下一次写入前要等它们
+        vk::PipelineStageFlags visibleStages; // 上一次写入之后已经同步过的读取
+        vk::AccessFlags visibleAccess;
+    };
+
+    struct PhysicalImage {
+        ImageDesc desc;
+        vk::ImageUsageFlags usage;
+        uint32_t first; // 用到它的第一个与最后一个 pass
+        uint32_t last;
+        vk::Image image;
+        vk::ImageView view;
+        vk::MemoryRequirements requirements;
+        uint32_t arena = 0;
+        vk::DeviceSize offset = 0;
+        std::vector<uint32_t> aliases; // 同一段内存上更早结束的图像, 首次使用前要等它们的访问完成
+    };
+
+    struct Arena {
+        MemoryAllocator::Allocation allocation;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize alignment = 1;
+        uint32_t memoryTypeBits = 0;
+    };
+
+    void cull();
+    void allocateTransients();
+    void placeTransients();
+    void createPhysical(std::vector<PhysicalImage> images);
+    void destroyPhysical();
+    void computeBarriers();
+    void addBarrier(Barrier& barrier, State& state, const ResourceNode& resource, GraphAccess access, bool write,
+                    const State* aliased);
+    void record(vk::CommandBuffer cmd, const Barrier& barrier);
+
+    std::vector<PassNode> m_passes;
+    std::vector<ResourceNode> m_resources;
+    Barrier m_finalBarrier;
+    bool m_compiled = false;
+    uint32_t m_nextPass = 0;
+    bool m_finished = false;
+
+    std::vector<PhysicalImage> m_physicalImages;
+    std::vector<Arena> m_arenas;
+    Stats m_stats;
+};
+
+}
+
+#endif // __RENDER_GRAPH_H__
@@ -3,156 +3,173 @@
 #include "context.h"
 #include "swapchain.h"
 #include "uniform.hpp"
+#include "sprite_batch.hpp"
 
 namespace toy2d {
+    // 逻辑运算只作用于整数与归一化整数格式, 颜色目标是 sRGB 或浮点时会被忽略
+    static bool isLogicOpIgnored(vk::Format format) {
+        switch (format) {
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eB8G8R8A8Srgb:
+        case vk::Format::eA8B8G8R8SrgbPack32:
+        case vk::Format::eR16G16B16A16Sfloat:
+        case vk::Format::eR32G32B32A32Sfloat:
+        case vk::Format::eB10G11R11UfloatPack32:
+        case vk::Format::eE5B9G9R9UfloatPack32:
+            return true;
+        default:
+            return false;
+        }
+    }
+
     Render_process::Render_process(/* args */)
     {
         InitLayout();
         InitRenderPass();
-        m_pipeline = nullptr;
+        m_pipelines = std::make_unique<PipelineCache>();
+        m_bindlessLayout = nullptr;
+        m_cullPipeline = nullptr;
+        m_cullLayout = nullptr;
+        m_postLayout = nullptr;
     }
 
     Render_process::~Render_process()
     {
+        // 先等后台编译结束, 它们还在使用 layout 与 render pass
+        DestroyPipeline();
         DestroyRenderPass();
         DestroyLayout();
-        DestroyPipeline();
     }
 
     void Render_process::RecreateGraphicsPipeline(const Shader& shader) {
-        if (m_pipeline) {
-            DestroyPipeline();
-        }
-        InitPipeline(shader);
+        m_shader = &shader;
+        precompile(shader, VertexLayout::Quad, m_layout);
     }
 
-    void Render_process::InitPipeline(const Shader& shader)
-    {
-        const int width = Context::GetInstance().m_swapchain->GetExtent().width;
-        const int height = Context::GetInstance().m_swapchain->GetExtent().height;
-
-        vk::GraphicsPipelineCreateInfo createInfo;
+    void Render_process::RecreateSpritePipeline(const Shader& shader) {
+        m_spriteShader = &shader;
+        precompile(shader, VertexLayout::Sprite, m_layout);
+    }
 
-        // 以下为渲染管线的流程
+    void Render_process::RecreateBindlessPipeline(const Shader& shader, vk::DescriptorSetLayout tableLayout) {
+        auto& device = Context::GetInstance().GetDevice();
+        if (!m_bindlessLayout) {
+            // set 0 与普通管线相同, 两个 layout 在 set 0 上保持兼容
+            std::array layouts = { Context::GetInstance().m_shader->GetDescriptorSetLayouts()[0], tableLayout };
+            auto range = Context::GetInstance().m_shader->GetPushConstantRange();
+            vk::PipelineLayoutCreateInfo layoutInfo;
+            layoutInfo.setSetLayouts(layouts)
+                .setPushConstantRanges(range);
+            m_bindlessLayout = device.createPipelineLayout(layoutInfo);
+        }
 
-        // 1.vertex input
-        auto attr = Vec::GetAttributeDescription();
-        auto binding = Vec::GetBindingDescription();
+        m_bindlessShader = &shader;
+        precompile(shader, VertexLayout::Sprite, m_bindlessLayout);
+    }
 
-        vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo;
-        vertexInputCreateInfo.setVertexAttributeDescriptions(attr)
-            .setVertexBindingDescriptions(binding);
-        createInfo.setPVertexInputState(&vertexInputCreateInfo);
+    void Render_process::RecreateCullPipeline(const ComputeShader& shader) {
+        auto& ctx = Context::GetInstance();
+        auto& device = ctx.GetDevice();
+        if (m_cullPipeline) {
+            // 重建时旧管线可能还在飞行中的帧里使用
+            ctx.DeferDestroy([pipeline = m_cullPipeline]() {
+                Context::GetInstance().GetDevice().destroyPipeline(pipeline);
+            });
+        }
 
-        // 2.Vertex Assembly 图元设置
-        vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
-        inputAssemblyInfo.setPrimitiveRestartEnable(false)
-            .setTopology(vk::PrimitiveTopology::eTriangleList);
-        createInfo.setPInputAssemblyState(&inputAssemblyInfo);
+        if (!m_cullLayout) {
+            auto setLayout = shader.GetDescriptorSetLayout();
+            auto range = shader.GetPushConstantRange();
+            vk::PipelineLayoutCreateInfo layoutInfo;
+            layoutInfo.setSetLayouts(setLayout)
+                .setPushConstantRanges(range);
+            m_cullLayout = device.createPipelineLayout(layoutInfo);
+        }
 
-        // 3. shader prepare
-        std::array<vk::PipelineShaderStageCreateInfo, 2> stageCreateInfos;
-        stageCreateInfos[0].setModule(shader.GetVertexModule())
-            .setPName("main")
-            .setStage(vk::ShaderStageFlagBits::eVertex);
-        stageCreateInfos[1].setModule(shader.GetFragModule())
+        vk::ComputePipelineCreateInfo createInfo;
+        createInfo.stage.setModule(shader.GetModule())
             .setPName("main")
-            .setStage(vk::ShaderStageFlagBits::eFragment);
-        createInfo.setStages(stageCreateInfos);
-
-        // 4.viewport
-        vk::PipelineViewportStateCreateInfo viewportState;
-        vk::Viewport viewport(0, 0, static_cast<float>(width), static_cast<float>(height), 0, 1); // 多个viewport是否支持需要，查询，有些电脑不支持
-        vk::Rect2D rect{ {0,0},{static_cast<uint32_t>(width), static_cast<uint32_t>(height)} };
-        viewportState.setViewports(viewport).setScissors(rect);
-        createInfo.setPViewportState(&viewportState);
-
-        // 5.光栅化
-        vk::PipelineRasterizationStateCreateInfo rastInfo;
-        rastInfo.setRasterizerDiscardEnable(false)
-            .setCullMode(vk::CullModeFlagBits::eBack)
-            .setFrontFace(vk::FrontFace::eClockwise)
-            .setPolygonMode(vk::PolygonMode::eFill)
-            .setLineWidth(1);
-        createInfo.setPRasterizationState(&rastInfo);
-
-        // 6.multisample
-        vk::PipelineMultisampleStateCreateInfo multiInfo;
-        // 这里关闭 multisample, 但是还是需要指定setRasterizationSamples，需要对点进行采样
-        multiInfo.setSampleShadingEnable(false)
-            .setRasterizationSamples(vk::SampleCountFlagBits::e1);
-        createInfo.setPMultisampleState(&multiInfo);
-
-        // 7.Test stencil test, depth test
-        // 暂时不用，跳过
-
-
-        // 8.color Blending, 暂不开启
-#if 1
-        // 公式法开启
-        vk::PipelineColorBlendStateCreateInfo colorBlendInfo;
-        vk::PipelineColorBlendAttachmentState blendAttachmentState;
-        blendAttachmentState.setBlendEnable(true)
-            .setColorWriteMask(vk::ColorComponentFlagBits::eA |
-                vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eG |
-                vk::ColorComponentFlagBits::eR)
-            .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
-            .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
-            .setColorBlendOp(vk::BlendOp::eAdd)
-            .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
-            .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
-            .setAlphaBlendOp(vk::BlendOp::eAdd);
-
-
-        colorBlendInfo.setLogicOpEnable(false)
-            .setAttachments(blendAttachmentState);
-        createInfo.setPColorBlendState(&colorBlendInfo);
-
-#elif 0
-        // 按位操作混合
-        vk::PipelineColorBlendStateCreateInfo colorBlendInfo;
-        vk::PipelineColorBlendAttachmentState blendAttachmentState;
-        blendAttachmentState.setBlendEnable(true)
-            .setColorWriteMask(vk::ColorComponentFlagBits::eA |
-                vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eG |
-                vk::ColorComponentFlagBits::eR);
-
-        colorBlendInfo.setLogicOpEnable(true)
-            .setLogicOp(vk::LogicOp::eCopy)
-            .setAttachments(blendAttachmentState);
-        createInfo.setPColorBlendState(&colorBlendInfo);
-#else
-        // 不开启
-        vk::PipelineColorBlendStateCreateInfo colorBlendInfo;
-        vk::PipelineColorBlendAttachmentState attachState;
-        attachState.setBlendEnable(false)
-            .setColorWriteMask(vk::ColorComponentFlagBits::eA |
-                vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eG |
-                vk::ColorComponentFlagBits::eR);
-
-        colorBlendInfo.setLogicOpEnable(false)
-            .setAttachments(attachState);
-        createInfo.setPColorBlendState(&colorBlendInfo);
-#endif
-
-        // 9.renderPass, Layout
-        createInfo.setRenderPass(m_renderPass)
-            .setLayout(m_layout);
-
-        auto res = Context::GetInstance().GetDevice().createGraphicsPipeline(nullptr, createInfo);
+            .setStage(vk::ShaderStageFlagBits::eCompute);
+        createInfo.setLayout(m_cullLayout);
+        auto res = device.createComputePipeline(ctx.m_pipelineCache->Get(), createInfo);
         if (res.result != vk::Result::eSuccess) {
-            throw std::runtime_error("create graphics failed!");
+            throw std::runtime_error("create cull pipeline failed!");
+        }
+        m_cullPipeline = res.value;
+    }
+
+    void Render_process::RecreatePostPipeline(const Shader& shader) {
+        if (!m_postLayout) {
+            auto& layouts = shader.GetDescriptorSetLayouts();
+            auto range = shader.GetPushConstantRange();
+            vk::PipelineLayoutCreateInfo layoutInfo;
+            layoutInfo.setSetLayouts(layouts)
+                .setPushConstantRanges(range);
+            m_postLayout = Context::GetInstance().GetDevice().createPipelineLayout(layoutInfo);
+        }
+
+        m_postShader = &shader;
+        m_pipelines->Precompile({ makeKey(&shader, VertexLayout::None, m_postLayout, BlendMode::Opaque) });
+    }
+
+    vk::Pipeline Render_process::GetPostPipeline() {
+        return m_pipelines->Get(makeKey(m_postShader, VertexLayout::None, m_postLayout, BlendMode::Opaque));
+    }
+
+    vk::Pipeline Render_process::GetPipeline(BlendMode blend) {
+        return getOrFallback(makeKey(m_shader, VertexLayout::Quad, m_layout, blend));
+    }
+
+    vk::Pipeline Render_process::GetSpritePipeline(BlendMode blend) {
+        return getOrFallback(makeKey(m_spriteShader, VertexLayout::Sprite, m_layout, blend));
+    }
+
+    vk::Pipeline Render_process::GetBindlessPipeline(BlendMode blend) {
+        return getOrFallback(makeKey(m_bindlessShader, VertexLayout::Sprite, m_bindlessLayout, blend));
+    }
+
+    vk::Pipeline Render_process::getOrFallback(PipelineKey key) {
+        if (auto pipeline = m_pipelines->TryGet(key)) {
+            return pipeline;
         }
+        // 颜色格式变化后 Alpha 也可能要重新编译, 总得有一个管线可画, 只有这时才会阻塞
+        key.blend = BlendMode::Alpha;
+        return m_pipelines->Get(key);
+    }
+
+    bool Render_process::IsBlendModeSupported(BlendMode blend) const {
+        if (blend == BlendMode::LogicCopy) {
+            auto& ctx = Context::GetInstance();
+            return ctx.GetPhyDevice().getFeatures().logicOp && !isLogicOpIgnored(ctx.GetColorFormat());
+        }
+        return true;
+    }
 
-        m_pipeline = res.value;
+    PipelineKey Render_process::makeKey(const Shader* shader, VertexLayout vertexLayout, vk::PipelineLayout layout, BlendMode blend) const {
+        PipelineKey key;
+        key.shader = shader;
+        key.layout = layout;
+        key.vertexLayout = vertexLayout;
+        key.blend = blend;
+        key.renderPass = m_renderPass;
+        key.colorFormat = Context::GetInstance().GetColorFormat();
+        return key;
+    }
+
+    void Render_process::precompile(const Shader& shader, VertexLayout vertexLayout, vk::PipelineLayout layout) {
+        std::vector<PipelineKey> keys;
+        for (auto blend : { BlendMode::Alpha, BlendMode::Opaque, BlendMode::Additive, BlendMode::Multiply, BlendMode::LogicCopy }) {
+            if (IsBlendModeSupported(blend)) {
+                keys.push_back(makeKey(&shader, vertexLayout, layout, blend));
+            }
+        }
+        m_pipelines->Precompile(keys);
     }
 
     void Render_process::DestroyPipeline()
     {
-        Context::GetInstance().GetDevice().destroyPipeline(m_pipeline);
+        m_pipelines.reset();
+        Context::GetInstance().GetDevice().destroyPipeline(m_cullPipeline);
     }
 
     void Render_process::InitLayout()
@@ -171,6 +188,9 @@ namespace toy2d {
     {
         auto& device = Context::GetInstance().GetDevice();
         device.destroyPipelineLayout(m_layout);
+        device.destroyPipelineLayout(m_bindlessLayout);
+        device.destroyPipelineLayout(m_cullLayout);
+        device.destroyPipelineLayout(m_postLayout);
     }
 
     void Render_process::InitRenderPass()
@@ -178,9 +198,12 @@ namespace toy2d {
         vk::RenderPassCreateInfo renderPassInfo;
 
         vk::AttachmentDescription attachDesc;
-        attachDesc.setFormat(Context::GetInstance().m_swapchain->m_swapchainInfo.format.format)
-            .setInitialLayout(vk::ImageLayout::eUndefined)
-            .setFinalLayout(vk::ImageLayout::ePresentSrcKHR)
+        // 布局转换与同步都交给 RenderGraph: 进出 render pass 时附件都处于 eColorAttachmentOptimal,
+        // 呈现/读回前的转换在帧末由图录制
+        auto& ctx = Context::GetInstance();
+        attachDesc.setFormat(ctx.GetColorFormat())
+            .setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal)
             .setLoadOp(vk::AttachmentLoadOp::eClear)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
             .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
@@ -197,15 +220,6 @@ namespace toy2d {
             .setColorAttachments(attachRef);
         renderPassInfo.setSubpasses(subpassDesc);
 
-        // initsubpass -> subpass1 -> subpass2 -> ...
-        vk::SubpassDependency dependency;
-        dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL)
-            .setDstSubpass(0)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-        renderPassInfo.setDependencies(dependency);
-
         m_renderPass = Context::GetInstance().GetDevice().createRenderPass(renderPassInfo);
     }
 
@@ -1,8 +1,10 @@
 ﻿#ifndef __RENDER_PROCESS_H__
 #define __RENDER_PROCESS_H__
 
+#include <memory>
 #include "vulkan/vulkan.hpp"
 #include "shader.hpp"
+#include "pipeline_cache.hpp"
 
 namespace toy2d {
     class Render_process final
@@ -11,21 +13,50 @@ namespace toy2d {
         Render_process(/* args */);
         ~Render_process();
 
-        void InitPipeline(const Shader& shader);
         vk::RenderPass& GetRenderPass() { return m_renderPass; }
-        vk::Pipeline& GetPipeline() { return m_pipeline; }
+        // 图形管线按混合模式从缓存取, 不阻塞: 该模式还在后台编译时先返回 Alpha 的排列,
+        // 之后的帧自动换成请求的模式. Alpha 在启动时已经编译好
+        vk::Pipeline GetPipeline(BlendMode blend = BlendMode::Alpha);
+        vk::Pipeline GetSpritePipeline(BlendMode blend = BlendMode::Alpha);
+        vk::Pipeline GetBindlessPipeline(BlendMode blend = BlendMode::Alpha);
+        vk::Pipeline& GetCullPipeline() { return m_cullPipeline; }
+        // 后处理只有一种 (不混合) 排列, 启动时已经编译好; 颜色格式变化后第一次调用会阻塞编译
+        vk::Pipeline GetPostPipeline();
+        PipelineCache& GetPipelineCache() { return *m_pipelines; }
+        // 设备与当前颜色格式支持的混合模式 (LogicCopy 需要 logicOp 特性, 且颜色目标不能是 sRGB 或浮点格式)
+        bool IsBlendModeSupported(BlendMode blend) const;
         //vk::DescriptorSetLayout createSetLayout();
 
         vk::PipelineLayout m_layout;
+        vk::PipelineLayout m_bindlessLayout; // set 1 为全局纹理表
+        vk::PipelineLayout m_cullLayout; // 剔除计算管线, 与图形管线不共享
+        vk::PipelineLayout m_postLayout; // 后处理: set 0 为上一趟的结果, push constant 为采样步长
 
+        // 以下三个只记录着色器并把各混合模式的排列交给工作线程预编译
         void RecreateGraphicsPipeline(const Shader& shader);
+        // 实例化精灵管线: binding 0 为四边形顶点, binding 1 为 SpriteInstance
+        void RecreateSpritePipeline(const Shader& shader);
+        void RecreateBindlessPipeline(const Shader& shader, vk::DescriptorSetLayout tableLayout);
+        // 精灵剔除计算管线, 与 render pass 无关
+        void RecreateCullPipeline(const ComputeShader& shader);
+        // 全屏后处理管线, 没有顶点输入, 与精灵共用 render pass
+        void RecreatePostPipeline(const Shader& shader);
     private:
-        vk::Pipeline m_pipeline;
+        std::unique_ptr<PipelineCache> m_pipelines;
+        const Shader* m_shader = nullptr;
+        const Shader* m_spriteShader = nullptr;
+        const Shader* m_bindlessShader = nullptr;
+        const Shader* m_postShader = nullptr;
+        vk::Pipeline m_cullPipeline;
         vk::RenderPass m_renderPass;
 
         void InitLayout();
         void InitRenderPass();
 
+        PipelineKey makeKey(const Shader* shader, VertexLayout vertexLayout, vk::PipelineLayout layout, BlendMode blend) const;
+        vk::Pipeline getOrFallback(PipelineKey key);
+        void precompile(const Shader& shader, VertexLayout vertexLayout, vk::PipelineLayout layout);
+
         void DestroyPipeline();
         void DestroyLayout();
         void DestroyRenderPass();
@@ -0,0 +1,144 @@
+#include "render_target.hpp"
+#include "context.h"
+#include <cstring>
+
+namespace toy2d {
+
+RenderTarget::RenderTarget(uint32_t w, uint32_t h, int maxFlightCount) : m_extent(w, h) {
+    m_frames.resize(maxFlightCount);
+    for (auto& frame : m_frames) {
+        createImage(frame);
+        createImageView(frame);
+        frame.framebuffer = nullptr;
+    }
+}
+
+RenderTarget::~RenderTarget() {
+    auto& ctx = Context::GetInstance();
+    auto& device = ctx.GetDevice();
+    for (auto& frame : m_frames) {
+        // 没等到结果的请求随 promise 析构得到 broken_promise
+        frame.readbackBuffer.reset();
+        device.destroyFramebuffer(frame.framebuffer);
+        device.destroyImageView(frame.view);
+        device.destroyImage(frame.image);
+        ctx.m_memoryAllocator->Free(frame.allocation);
+    }
+}
+
+void RenderTarget::createImage(Frame& frame) {
+    vk::ImageCreateInfo createInfo;
+    createInfo.setImageType(vk::ImageType::e2D)
+        .setArrayLayers(1)
+        .setMipLevels(1)
+        .setExtent({ m_extent.width, m_extent.height, 1 })
+        .setFormat(GetFormat())
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setInitialLayout(vk::ImageLayout::eUndefined)
+        .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+        .setSamples(vk::SampleCountFlagBits::e1);
+
+    auto& ctx = Context::GetInstance();
+    frame.image = ctx.GetDevice().createImage(createInfo);
+    frame.allocation = ctx.m_memoryAllocator->AllocateForImage(frame.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void RenderTarget::createImageView(Frame& frame) {
+    vk::ImageSubresourceRange range;
+    range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1)
+        .setLevelCount(1)
+        .setBaseMipLevel(0);
+
+    vk::ImageViewCreateInfo createInfo;
+    createInfo.setImage(frame.image)
+        .setViewType(vk::ImageViewType::e2D)
+        .setFormat(GetFormat())
+        .setSubresourceRange(range);
+    frame.view = Context::GetInstance().GetDevice().createImageView(createInfo);
+}
+
+void RenderTarget::createFramebuffers() {
+    auto& ctx = Context::GetInstance();
+    for (auto& frame : m_frames) {
+        vk::FramebufferCreateInfo createInfo;
+        createInfo.setAttachments(frame.view)
+            .setWidth(m_extent.width)
+            .setHeight(m_extent.height)
+            .setRenderPass(ctx.m_renderProcess->GetRenderPass())
+            .setLayers(1);
+        frame.framebuffer = ctx.GetDevice().createFramebuffer(createInfo);
+    }
+}
+
+std::future<RenderTarget::Pixels> RenderTarget::RequestReadback(int frameIndex) {
+    auto& frame = m_frames[frameIndex];
+    frame.requested.emplace_back();
+    return frame.requested.back().get_future();
+}
+
+void RenderTarget::RecordReadback(vk::CommandBuffer cmd, int frameIndex) {
+    auto& frame = m_frames[frameIndex];
+    if (frame.requested.empty()) {
+        return;
+    }
+
+    vk::DeviceSize size = static_cast<vk::DeviceSize>(m_extent.width) * m_extent.height * 4;
+    if (!frame.readbackBuffer) {
+        frame.readbackBuffer.reset(new Buffer(size, vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+    }
+
+    // 图像已经由 render graph 转换到 eTransferSrcOptimal, 颜色写入对传输阶段可见
+    vk::ImageSubresourceLayers subsource;
+    subsource.setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseArrayLayer(0)
+        .setMipLevel(0)
+        .setLayerCount(1);
+    vk::BufferImageCopy region;
+    region.setBufferOffset(0)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageOffset({ 0, 0, 0 })
+        .setImageExtent({ m_extent.width, m_extent.height, 1 })
+        .setImageSubresource(subsource);
+    cmd.copyImageToBuffer(frame.image, vk::ImageLayout::eTransferSrcOptimal, frame.readbackBuffer->m_buffer, region);
+
+    vk::BufferMemoryBarrier toHost;
+    toHost.setBuffer(frame.readbackBuffer->m_buffer)
+        .setOffset(0)
+        .setSize(size)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+        {}, nullptr, toHost, nullptr);
+
+    for (auto& promise : frame.requested) {
+        frame.pending.push_back(std::move(promise));
+    }
+    frame.requested.clear();
+}
+
+void RenderTarget::Collect(int frameIndex) {
+    auto& frame = m_frames[frameIndex];
+    if (frame.pending.empty()) {
+        return;
+    }
+
+    Pixels pixels;
+    pixels.width = m_extent.width;
+    pixels.height = m_extent.height;
+    pixels.rgba.resize(static_cast<size_t>(m_extent.width) * m_extent.height * 4);
+    memcpy(pixels.rgba.data(), frame.readbackBuffer->m_map, pixels.rgba.size());
+
+    for (size_t i = 0; i + 1 < frame.pending.size(); i++) {
+        frame.pending[i].set_value(pixels);
+    }
+    frame.pending.back().set_value(std::move(pixels));
+    frame.pending.clear();
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef __RENDER_TARGET_H__
+#define __RENDER_TARGET_H__
+
+#include <future>
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "buffer.hpp"
+#include "memory_allocator.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 离屏渲染目标, 无窗口 (headless) 模式下代替交换链
+ * 每个飞行帧一张颜色图像, 帧末由 render graph 转换到 eTransferSrcOptimal, 可以直接拷贝回读
+ */
+class RenderTarget final
+{
+public:
+    struct Pixels {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> rgba; // 每像素 4 字节, 行紧密排列, 与 GetFormat 一致 (sRGB 编码)
+    };
+
+    RenderTarget(uint32_t w, uint32_t h, int maxFlightCount);
+    ~RenderTarget();
+
+    void createFramebuffers();
+
+    const vk::Extent2D& GetExtent() const { return m_extent; }
+    vk::Format GetFormat() const { return vk::Format::eR8G8B8A8Srgb; }
+    vk::Framebuffer GetFramebuffer(int frame) const { return m_frames[frame].framebuffer; }
+    vk::Image GetImage(int frame) const { return m_frames[frame].image; }
+
+    // 请求读回该帧渲染的结果, 需在 render pass 结束后用 RecordReadback 录制拷贝
+    std::future<Pixels> RequestReadback(int frame);
+    // 在帧的 render graph 执行完之后录制拷贝, 没有请求时什么都不做
+    void RecordReadback(vk::CommandBuffer cmd, int frame);
+    // 该帧槽位上一次的帧完成后调用, 兑现之前的读回请求
+    void Collect(int frame);
+
+private:
+    struct Frame {
+        vk::Image image;
+        MemoryAllocator::Allocation allocation;
+        vk::ImageView view;
+        vk::Framebuffer framebuffer;
+
+        std::unique_ptr<Buffer> readbackBuffer; // 第一次请求读回时才创建
+        std::vector<std::promise<Pixels>> requested; // 本帧录制中的请求
+        std::vector<std::promise<Pixels>> pending;   // 已录制拷贝, 等待 GPU 完成
+    };
+
+    void createImage(Frame& frame);
+    void createImageView(Frame& frame);
+
+    vk::Extent2D m_extent;
+    std::vector<Frame> m_frames;
+};
+
+}
+
+#endif // __RENDER_TARGET_H__
@@ -1,6 +1,9 @@
 ﻿#include "renderer.hpp"
 #include "context.h"
 #include "uniform.hpp"
+#include "profiler.hpp"
+#include <chrono>
+#include <algorithm>
 
 namespace toy2d {
     // 顶点设置
@@ -18,50 +21,75 @@ namespace toy2d {
     static const  Color kColor{0, 1, 0} ;
 
 
-    Renderer::Renderer(int maxFlightCount) :m_maxFlightCount(maxFlightCount), m_curFrame(0)
+    Renderer::Renderer(int framesInFlight) :m_staticUploadValue(0), m_frameUploadWait(0),
+        m_dynamicOffsets{ 0, 0 }, m_recording(false),
+        m_maxFlightCount(FrameScheduler::MaxFramesInFlight), m_curFrame(0),
+        m_swapchainDirty(false),
+        m_batchMode(false), m_bindlessMode(false), m_parallelMode(false), m_cullMode(false),
+        m_blendMode(BlendMode::Alpha), m_postBlurIterations(0),
+        m_placeholder(nullptr)
     {
+        const auto extent = Context::GetInstance().GetRenderExtent();
+        m_surfaceWidth = static_cast<int>(extent.width);
+        m_surfaceHeight = static_cast<int>(extent.height);
+
+        m_scheduler.reset(new FrameScheduler(framesInFlight));
+        Context::GetInstance().m_deletionQueue->SetScheduler(m_scheduler.get());
         createSems();
-        createFence();
         CreateCmdBuffer();
         createVertexBuffer();
         bufferVertexData();
         createIndexBuffer();
         bufferIndexData();
-        createColorBuffer();
+        createRingBuffers();
         SetDrawColor(kColor);
 
         // mvp
-        createMVPBuffer();
         initMats();
 
         createSampler();
+        createPostSampler();
+        createTimestampPool();
+
+        m_spriteBatch.reset(new SpriteBatch(*m_vertexRing));
+        m_parallelRecorder.reset(new ParallelRecorder(m_maxFlightCount));
+        m_culler.reset(new SpriteCuller(m_maxFlightCount));
+        for (int i = 0; i < m_maxFlightCount; i++) {
+            m_frameGraphs.push_back(std::make_unique<RenderGraph>());
+        }
 
         descriptorSets_ = DescriptorSetManager::GetInstance().allocBufferDescriptorSet(m_maxFlightCount);
         updateBufferSets();
+
+        TOY2D_PROFILE_GPU_INIT(m_maxFlightCount);
     }
 
     Renderer::~Renderer() {
-        m_hostVertexBuffer.reset();
+        // 等待所有已提交的帧, 之后推迟的销毁不再需要按帧号等待
+        Context::GetInstance().m_deletionQueue->SetScheduler(nullptr);
+        m_scheduler.reset();
+        TOY2D_PROFILE_GPU_SHUTDOWN();
+        m_parallelRecorder.reset();
+        m_culler.reset();
+        m_frameGraphs.clear();
+        m_spriteBatch.reset();
         m_deviceVertexBuffer.reset();
-        m_hostIndexBuffer.reset();
         m_deviceIndexBuffer.reset();
-        m_hostColorBuffers.clear();
-        m_deviceColorBuffers.clear();
-        m_hostMVPBuffers.clear();
-        m_deviceMVPBuffers.clear();
+        m_uniformRing.reset();
+        m_vertexRing.reset();
 
         auto& device = Context::GetInstance().GetDevice();
 
         device.destroySampler(m_sampler);
+        device.destroySampler(m_postSampler);
+        if (m_timestampPool) {
+            device.destroyQueryPool(m_timestampPool);
+        }
 
         for (auto& i : m_cmdBuffers) {
             Context::GetInstance().m_commandManager->FreeCmd(i);
         }
 
-        for (auto& i : m_cmdFences) {
-            device.destroyFence(i);
-        }
-        
         for (auto& i : m_imageAvaliables) {
             device.destroySemaphore(i);
         }
@@ -72,36 +100,404 @@ namespace toy2d {
     }
 
     void Renderer::DrawTexture(const Rect& rect, Texture& texture) {
+        TOY2D_PROFILE_FUNCTION();
+        // 统一走 32 字节的实例数据, 不再每次推送 64 字节的模型矩阵; 非批处理模式下 DrawSprite 会立即绘制
+        DrawSprite(rect, texture, Rect{ Vec{0, 0}, Size{1, 1} }, Color{ 1, 1, 1 });
+    }
+
+    void Renderer::DrawSprite(const Rect& rect, Texture& texture, const Rect& uvRect, const Color& tint, float alpha, float rotation) {
+        if (!m_recording) {
+            return;
+        }
+        // 记录使用的帧, 已被换出的纹理在这里重新排队加载
+        TextureManager::Instance().Touch(texture, m_scheduler->GetCurrentFrame());
+        Texture* target = &texture;
+        if (!requireUpload(texture.m_uploadValue)) {
+            if (!m_placeholder || !requireUpload(m_placeholder->m_uploadValue)) {
+                return;
+            }
+            target = m_placeholder;
+        }
+
+        // 提交时就把绘制颜色乘进去, 帧中途 SetDrawColor 不影响已收集的精灵
+        Color color{ tint.r * m_drawColor.r, tint.g * m_drawColor.g, tint.b * m_drawColor.b };
+        m_spriteBatch->Push(*target, SpriteInstance::Create(rect, uvRect, color, alpha, rotation, target->m_bindlessIndex));
+        m_stats.spritesSubmitted++;
+
+        if (!m_batchMode && !m_parallelMode && !m_cullMode) {
+            flushSprites();
+        }
+    }
+
+    void Renderer::SetBindlessMode(bool enable) {
+        if (enable && !Context::GetInstance().m_bindlessTable) {
+            std::cout << "bindless textures not supported, keep per-texture descriptor sets" << std::endl;
+            return;
+        }
+        m_bindlessMode = enable;
+    }
+
+    void Renderer::SetBlendMode(BlendMode mode) {
+        if (mode == m_blendMode) {
+            return;
+        }
+        if (!Context::GetInstance().m_renderProcess->IsBlendModeSupported(mode)) {
+            std::cout << "blend mode " << static_cast<int>(mode) << " not supported, ignored" << std::endl;
+            return;
+        }
+        // 内联录制: 已收集的精灵按旧模式先画掉
+        if (m_recording && !m_parallelMode && !m_cullMode) {
+            flushSprites();
+        }
+        m_blendMode = mode;
+    }
+
+    void Renderer::flushSprites() {
+        if (m_spriteBatch->Empty()) {
+            return;
+        }
+        TOY2D_PROFILE_FUNCTION();
+
         auto& ctx = Context::GetInstance();
-        auto& device = ctx.GetDevice();
         auto& cmd = m_cmdBuffers[m_curFrame];
+        TOY2D_PROFILE_GPU_SCOPE(cmd, "SpriteBatch");
+        auto& renderProcess = ctx.m_renderProcess;
+        bool bindless = useBindless();
+        auto& layout = bindless ? renderProcess->m_bindlessLayout : renderProcess->m_layout;
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+            bindless ? renderProcess->GetBindlessPipeline(m_blendMode) : renderProcess->GetSpritePipeline(m_blendMode));
         vk::DeviceSize offset = 0;
         cmd.bindVertexBuffers(0, m_deviceVertexBuffer->m_buffer, offset);
         cmd.bindIndexBuffer(m_deviceIndexBuffer->m_buffer, 0, vk::IndexType::eUint32);
+        bindFrameSet(cmd, layout);
+
+        if (bindless) {
+            m_stats.drawCalls += m_spriteBatch->FlushBindless(cmd, layout, ctx.m_bindlessTable->GetSet());
+        }
+        else {
+            m_stats.drawCalls += m_spriteBatch->Flush(cmd, layout);
+        }
+    }
+
+    void Renderer::recordSpritesParallel(vk::CommandBuffer cmd) {
+        // 每段至少这么多精灵, 太碎的话线程调度的开销会超过录制本身
+        constexpr size_t MinSpritesPerTask = 2048;
+        TOY2D_PROFILE_FUNCTION();
+
+        auto& ctx = Context::GetInstance();
+        auto& renderProcess = ctx.m_renderProcess;
+        auto& batch = *m_spriteBatch;
+
+        beginRenderPass(cmd, vk::SubpassContents::eSecondaryCommandBuffers);
+        m_parallelRecorder->BeginFrame(m_curFrame);
+        if (batch.Empty()) {
+            return;
+        }
+
+        size_t count = batch.Size();
+        uint32_t taskCount = static_cast<uint32_t>(std::min<size_t>(m_parallelRecorder->GetWorkerCount(),
+            (count + MinSpritesPerTask - 1) / MinSpritesPerTask));
+
+        // ring buffer 不是线程安全的, 整批的实例空间在主线程一次分配好
+        auto instances = batch.AllocateInstances();
+        bool bindless = useBindless();
+        vk::PipelineLayout layout = bindless ? renderProcess->m_bindlessLayout : renderProcess->m_layout;
+        vk::Pipeline pipeline = bindless ? renderProcess->GetBindlessPipeline(m_blendMode) : renderProcess->GetSpritePipeline(m_blendMode);
+        vk::DescriptorSet tableSet = bindless ? ctx.m_bindlessTable->GetSet() : vk::DescriptorSet{};
+
+        vk::CommandBufferInheritanceInfo inheritance;
+        inheritance.setRenderPass(renderProcess->GetRenderPass())
+            .setSubpass(0)
+            .setFramebuffer(m_spriteFramebuffer);
+
+        std::vector<uint32_t> drawCalls(taskCount, 0);
+        auto cmds = m_parallelRecorder->Record(taskCount, inheritance, [&](vk::CommandBuffer secondary, uint32_t task) {
+            TOY2D_PROFILE_SCOPE("RecordSecondary");
+            size_t begin = count * task / taskCount;
+            size_t end = count * (task + 1) / taskCount;
+
+            // secondary command buffer 不继承任何绑定与动态状态, 每段都要完整设置一遍
+            setViewport(secondary);
+            secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            vk::DeviceSize offset = 0;
+            secondary.bindVertexBuffers(0, m_deviceVertexBuffer->m_buffer, offset);
+            secondary.bindIndexBuffer(m_deviceIndexBuffer->m_buffer, 0, vk::IndexType::eUint32);
+            bindFrameSet(secondary, layout);
+
+            drawCalls[task] = bindless
+                ? batch.RecordRangeBindless(secondary, layout, tableSet, instances, begin, end)
+                : batch.RecordRange(secondary, layout, instances, begin, end);
+        });
+
+        cmd.executeCommands(cmds);
+        batch.Clear();
+
+        for (auto calls : drawCalls) {
+            m_stats.drawCalls += calls;
+        }
+        m_stats.recordTasks = taskCount;
+    }
+
+    Rect Renderer::computeViewBounds() const {
+        // 投影与视图矩阵在 xy 上是仿射变换, 求逆后把 NDC 的四个角映射回世界坐标, 取包围盒
+        Mat4 m = projectMat_.Mul(viewMat_);
+        float a = m.Get(0, 0), c = m.Get(1, 0), tx = m.Get(3, 0);
+        float b = m.Get(0, 1), d = m.Get(1, 1), ty = m.Get(3, 1);
+        float det = a * d - b * c;
+        if (det == 0) {
+            return Rect{ Vec{ 0, 0 }, Size{ 0, 0 } };
+        }
+
+        float minX = std::numeric_limits<float>::max(), minY = minX;
+        float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        for (float nx : { -1.0f, 1.0f }) {
+            for (float ny : { -1.0f, 1.0f }) {
+                float x = (d * (nx - tx) - c * (ny - ty)) / det;
+                float y = (a * (ny - ty) - b * (nx - tx)) / det;
+                minX = std::min(minX, x);
+                maxX = std::max(maxX, x);
+                minY = std::min(minY, y);
+                maxY = std::max(maxY, y);
+            }
+        }
+        return Rect{ Vec{ minX, minY }, Size{ maxX - minX, maxY - minY } };
+    }
+
+    bool Renderer::prepareCull() {
+        TOY2D_PROFILE_FUNCTION();
+        auto& ctx = Context::GetInstance();
+        auto& batch = *m_spriteBatch;
+
+        m_cullGroups.clear();
+        if (batch.Empty()) {
+            return false;
+        }
 
-        auto& layout = Context::GetInstance().m_renderProcess->m_layout;
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-            layout,
-            0, { descriptorSets_[m_curFrame].set, texture.m_setInfo.set }, {});
-        auto model = Mat4::CreateTranslate(rect.position).Mul(Mat4::CreateScale(rect.size));
-        cmd.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Mat4), model.GetData());
-        cmd.drawIndexed(6, 1, 0, 0, 0);
+        // 整批作为 storage buffer 绑定给计算着色器, 起点需满足 storage buffer 的偏移对齐
+        auto storageAlignment = ctx.GetPhyDevice().getProperties().limits.minStorageBufferOffsetAlignment;
+        auto instances = batch.AllocateInstances(std::max<vk::DeviceSize>(storageAlignment, alignof(SpriteInstance)));
+        if (useBindless()) {
+            batch.WriteInOrder(instances, 0, batch.Size());
+            m_cullGroups.push_back({ nullptr, batch.Size() });
+        }
+        else {
+            m_cullGroups = batch.WriteGrouped(instances, 0, batch.Size());
+        }
+        std::vector<uint32_t> groupSizes;
+        groupSizes.reserve(m_cullGroups.size());
+        for (const auto& group : m_cullGroups) {
+            groupSizes.push_back(static_cast<uint32_t>(group.count));
+        }
+        m_culler->Prepare(instances, groupSizes, computeViewBounds());
+        return true;
+    }
+
+    void Renderer::recordSpritesCulled(vk::CommandBuffer cmd) {
+        TOY2D_PROFILE_FUNCTION();
+        auto& ctx = Context::GetInstance();
+        auto& renderProcess = ctx.m_renderProcess;
+        const auto& groups = m_cullGroups;
+
+        // 剔除的 dispatch 不能放在 render pass 里, 它是图中的前一个 pass, render pass 推迟到这里才开始
+        beginRenderPass(cmd, vk::SubpassContents::eInline);
+        if (groups.empty()) {
+            return;
+        }
+        TOY2D_PROFILE_GPU_SCOPE(cmd, "SpriteBatch");
+        // 批次在 Clear 之前不变, 与 prepareCull 的选择一致
+        bool bindless = useBindless();
+        auto& layout = bindless ? renderProcess->m_bindlessLayout : renderProcess->m_layout;
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+            bindless ? renderProcess->GetBindlessPipeline(m_blendMode) : renderProcess->GetSpritePipeline(m_blendMode));
+        vk::DeviceSize offset = 0;
+        cmd.bindVertexBuffers(0, m_deviceVertexBuffer->m_buffer, offset);
+        cmd.bindIndexBuffer(m_deviceIndexBuffer->m_buffer, 0, vk::IndexType::eUint32);
+        bindFrameSet(cmd, layout);
+        m_culler->BindInstances(cmd);
+
+        for (uint32_t i = 0; i < groups.size(); i++) {
+            vk::DescriptorSet set = bindless ? ctx.m_bindlessTable->GetSet() : groups[i].texture->m_setInfo.set;
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, set, {});
+            m_culler->DrawGroup(cmd, i);
+        }
+        m_spriteBatch->Clear();
+        m_stats.drawCalls += static_cast<uint32_t>(groups.size());
+    }
+
+    RenderGraph::Pass Renderer::buildFrameGraph(bool cull, RenderGraph::ExecuteFunc draw) {
+        auto& ctx = Context::GetInstance();
+        auto& graph = *m_frameGraphs[m_curFrame];
+        graph.Reset();
+
+        // 颜色目标每帧从 undefined 开始 (load op 为 clear), 帧末转换到呈现或读回需要的布局
+        bool headless = ctx.IsHeadless();
+        vk::Image image = headless ? ctx.m_renderTarget->GetImage(m_imageIndex) : ctx.m_swapchain->m_images[m_imageIndex];
+        auto target = graph.ImportImage("ColorTarget", image, vk::ImageLayout::eUndefined,
+            headless ? GraphAccess::TransferRead : GraphAccess::Present);
+
+        // 开启后处理时精灵先画到离屏图像, 由后处理的最后一趟写入颜色目标
+        std::optional<RenderGraph::Resource> scene;
+        RenderGraph::ImageDesc desc{ ctx.GetColorFormat(), ctx.GetRenderExtent() };
+        if (m_postBlurIterations > 0) {
+            scene = graph.CreateImage("SceneColor", desc);
+        }
+        auto spriteTarget = scene ? *scene : target;
+        // 临时图像在 Compile 之后才有句柄, framebuffer 在执行时再取
+        RenderGraph::ExecuteFunc drawSprites = [this, graph = &graph, scene, draw = std::move(draw)](vk::CommandBuffer cmd) {
+            m_spriteFramebuffer = scene ? createPassFramebuffer(graph->GetImageView(*scene)) : currentFramebuffer();
+            draw(cmd);
+        };
+
+        RenderGraph::Pass sprites;
+        if (!cull) {
+            sprites = graph.AddPass("Sprites", [&](RenderGraph::PassBuilder& pass) {
+                pass.Write(spriteTarget, GraphAccess::ColorAttachment);
+            }, std::move(drawSprites));
+            addPostPasses(scene, target, desc);
+            return sprites;
+        }
+
+        // 剔除的三个输出先由计算着色器写入, 再作为实例数据与间接命令读取;
+        // 绘制命令在该槽位下一次 BeginFrame 时还要由 CPU 读出可见数量, 帧末需要对 host 可见
+        auto instances = graph.ImportBuffer("CulledInstances", m_culler->GetInstanceBuffer());
+        auto commands = graph.ImportBuffer("DrawCommands", m_culler->GetCommandBuffer(), GraphAccess::HostRead);
+        auto counts = graph.ImportBuffer("DrawCounts", m_culler->GetCountBuffer());
+        graph.AddPass("SpriteCull", [&](RenderGraph::PassBuilder& pass) {
+            pass.Write(instances, GraphAccess::ComputeWrite);
+            pass.Write(commands, GraphAccess::ComputeWrite);
+            pass.Write(counts, GraphAccess::ComputeWrite);
+        }, [this](vk::CommandBuffer cmd) {
+            TOY2D_PROFILE_GPU_SCOPE(cmd, "SpriteCull");
+            m_culler->Dispatch(cmd);
+        });
+        sprites = graph.AddPass("Sprites", [&](RenderGraph::PassBuilder& pass) {
+            pass.Read(instances, GraphAccess::VertexBuffer);
+            pass.Read(commands, GraphAccess::IndirectBuffer);
+            pass.Read(counts, GraphAccess::IndirectBuffer);
+            pass.Write(spriteTarget, GraphAccess::ColorAttachment);
+        }, std::move(drawSprites));
+        addPostPasses(scene, target, desc);
+        return sprites;
+    }
+
+    void Renderer::addPostPasses(std::optional<RenderGraph::Resource> scene, RenderGraph::Resource target,
+                                 const RenderGraph::ImageDesc& desc) {
+        if (!scene) {
+            return;
+        }
+        auto& graph = *m_frameGraphs[m_curFrame];
+
+        // 每轮横竖两趟, 最后一趟直接写颜色目标. 中间结果都是临时图像, 例如两轮时
+        // SceneColor -> Blur0 -> Blur1 -> Blur2 -> 目标, SceneColor 与 Blur1, Blur0 与 Blur2 的生命周期不重叠, 共用内存
+        uint32_t passCount = m_postBlurIterations * 2;
+        RenderGraph::Resource source = *scene;
+        for (uint32_t i = 0; i < passCount; i++) {
+            bool last = i + 1 == passCount;
+            bool horizontal = i % 2 == 0;
+            auto dest = last ? target : graph.CreateImage("Blur" + std::to_string(i), desc);
+            graph.AddPass(horizontal ? "BlurH" : "BlurV", [&](RenderGraph::PassBuilder& pass) {
+                pass.Read(source, GraphAccess::FragmentSampled);
+                pass.Write(dest, GraphAccess::ColorAttachment);
+            }, [this, graph = &graph, source, dest, last, horizontal](vk::CommandBuffer cmd) {
+                vk::Framebuffer framebuffer = last ? currentFramebuffer() : createPassFramebuffer(graph->GetImageView(dest));
+                recordPostPass(cmd, graph->GetImageView(source), framebuffer, horizontal);
+            });
+            source = dest;
+        }
+    }
+
+    vk::Framebuffer Renderer::createPassFramebuffer(vk::ImageView view) {
+        auto& ctx = Context::GetInstance();
+        const auto extent = ctx.GetRenderExtent();
+        vk::FramebufferCreateInfo createInfo;
+        createInfo.setRenderPass(ctx.m_renderProcess->GetRenderPass())
+            .setAttachments(view)
+            .setWidth(extent.width)
+            .setHeight(extent.height)
+            .setLayers(1);
+        vk::Framebuffer framebuffer = ctx.GetDevice().createFramebuffer(createInfo);
+        // 图重新编译时临时图像可能换掉, 不缓存, 这一帧结束后销毁
+        ctx.DeferDestroy([framebuffer]() {
+            Context::GetInstance().GetDevice().destroyFramebuffer(framebuffer);
+        });
+        return framebuffer;
+    }
+
+    void Renderer::recordPostPass(vk::CommandBuffer cmd, vk::ImageView source, vk::Framebuffer framebuffer, bool horizontal) {
+        auto& ctx = Context::GetInstance();
+        auto& renderProcess = ctx.m_renderProcess;
+        TOY2D_PROFILE_GPU_SCOPE(cmd, "PostBlur");
+
+        // 全屏三角形覆盖每个像素, 清屏的值不会留下
+        vk::ClearValue clearValue;
+        vk::RenderPassBeginInfo renderPassBegin;
+        renderPassBegin.setRenderPass(renderProcess->GetRenderPass())
+            .setFramebuffer(framebuffer)
+            .setClearValues(clearValue)
+            .setRenderArea(vk::Rect2D({}, ctx.GetRenderExtent()));
+        cmd.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+        setViewport(cmd);
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, renderProcess->GetPostPipeline());
+
+        // 源图像在图重新编译后会换, set 每帧从帧内临时池分配
+        auto set = DescriptorSetManager::GetInstance().AllocFrameSet(ctx.m_postShader->GetDescriptorSetLayouts()[0]);
+        vk::DescriptorImageInfo imageInfo;
+        imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+            .setImageView(source)
+            .setSampler(m_postSampler);
+        vk::WriteDescriptorSet writer;
+        writer.setImageInfo(imageInfo)
+            .setDstBinding(0)
+            .setDstArrayElement(0)
+            .setDstSet(set)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        ctx.GetDevice().updateDescriptorSets(writer, {});
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, renderProcess->m_postLayout, 0, set, {});
+
+        const auto extent = ctx.GetRenderExtent();
+        std::array<float, 2> texelStep = { horizontal ? 1.0f / extent.width : 0.0f,
+                                           horizontal ? 0.0f : 1.0f / extent.height };
+        cmd.pushConstants(renderProcess->m_postLayout, ctx.m_postShader->GetPushConstantRange().stageFlags, 0,
+                          sizeof(texelStep), texelStep.data());
+        cmd.draw(3, 1, 0, 0);
+        cmd.endRenderPass();
+        m_stats.drawCalls++;
     }
 
     void Renderer::StartRender() {
+        TOY2D_PROFILE_FUNCTION();
         auto& ctx = Context::GetInstance();
-        auto& device = ctx.GetDevice();
-        if (device.waitForFences(m_cmdFences[m_curFrame], true, std::numeric_limits<std::uint64_t>::max()) != vk::Result::eSuccess) {
-            throw std::runtime_error("wait for fence failed");
+        m_curFrame = m_scheduler->BeginFrame();
+        ctx.m_deletionQueue->Collect();
+
+        m_stats = FrameStats{};
+        m_stats.waitMs = m_scheduler->GetWaitMs();
+        m_stats.gpuMs = readFrameGpuMs();
+        // 解码完成的异步纹理放进这一帧的上传批次, 在 beginUploads 中一起提交;
+        // 超出显存预算时换出只被已完成的帧用过的纹理
+        auto& textures = TextureManager::Instance();
+        textures.Update();
+        textures.UpdateResidency(m_scheduler->GetCurrentFrame(), m_scheduler->GetCompletedFrame());
+        // 拿不到图像 (例如窗口最小化) 时这一帧的绘制与 EndRender 都会被忽略, 下一次 StartRender 仍用这个槽位
+        if (!acquireImage()) {
+            return;
         }
-        device.resetFences(m_cmdFences[m_curFrame]);
 
-        auto& swapchain = ctx.m_swapchain;
-        auto resultValue = device.acquireNextImageKHR(swapchain->m_swapchain, std::numeric_limits<std::uint64_t>::max(), m_imageAvaliables[m_curFrame], nullptr);
-        if (resultValue.result != vk::Result::eSuccess) {
-            throw std::runtime_error("wait for image in swapchain failed");
+        m_spriteBatch->Begin();
+
+        // 该帧上一轮的提交已经完成, 它在 ring buffer 中的那段可以直接覆盖
+        m_uniformRing->BeginFrame(m_curFrame);
+        m_vertexRing->BeginFrame(m_curFrame);
+        DescriptorSetManager::GetInstance().BeginFrame(m_curFrame);
+        m_culler->BeginFrame(m_curFrame);
+        if (m_cullMode) {
+            m_stats.spritesVisible = m_culler->GetLastVisibleCount();
         }
-        m_imageIndex = resultValue.value;
+        m_recording = true;
+        bufferMVPData();
+        bufferColorData();
 
         auto& cmdMgr = ctx.m_commandManager;
         auto& cmd = m_cmdBuffers[m_curFrame];
@@ -110,52 +506,327 @@ namespace toy2d {
         vk::CommandBufferBeginInfo beginInfo;
         beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
         cmd.begin(beginInfo);
+        writeFrameTimestamp(cmd, false);
+        TOY2D_PROFILE_GPU_FRAME(cmd, m_curFrame);
+        TOY2D_PROFILE_GPU_BEGIN(cmd, "Uploads");
+        beginUploads(cmd);
+        TOY2D_PROFILE_GPU_END(cmd);
+
+        // 并行模式下 render pass 推迟到 EndRender 才开始, 整个 subpass 只能执行 secondary command buffer;
+        // 剔除模式同样推迟, 计算着色器要在 render pass 之外执行. 其余模式的图在这里编译,
+        // 录制到开始 render pass 的 pass 为止, 剩下的最终布局转换在 EndRender 中录制
+        if (!m_parallelMode && !m_cullMode) {
+            auto pass = buildFrameGraph(false, [this](vk::CommandBuffer cmd) {
+                beginRenderPass(cmd, vk::SubpassContents::eInline);
+            });
+            auto& graph = *m_frameGraphs[m_curFrame];
+            graph.Compile();
+            graph.ExecuteThrough(cmd, pass);
+        }
+    }
+
+    bool Renderer::acquireImage() {
+        auto& ctx = Context::GetInstance();
+        auto& device = ctx.GetDevice();
+
+        // 无窗口模式每个飞行帧固定使用自己的离屏图像, 顺便兑现上一轮的读回请求 (槽位上一次的帧已经完成)
+        if (ctx.IsHeadless()) {
+            m_imageIndex = m_curFrame;
+            ctx.m_renderTarget->Collect(m_curFrame);
+            return true;
+        }
+
+        // 第一次拿到 out of date 时重建交换链再试一次
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (m_swapchainDirty && !recreateSwapchain()) {
+                return false;
+            }
+
+            try {
+                auto resultValue = device.acquireNextImageKHR(ctx.m_swapchain->m_swapchain,
+                    std::numeric_limits<std::uint64_t>::max(), m_imageAvaliables[m_curFrame], nullptr);
+                m_imageIndex = resultValue.value;
+
+                // suboptimal 时图像已经拿到, semaphore 也会被 signal, 这一帧照常绘制, 下一帧之前再重建
+                if (resultValue.result == vk::Result::eSuboptimalKHR) {
+                    m_swapchainDirty = true;
+                }
+                return true;
+            }
+            catch (const vk::OutOfDateKHRError&) {
+                m_swapchainDirty = true;
+            }
+        }
+        return false;
+    }
+
+    bool Renderer::recreateSwapchain() {
+        if (!swapchain::IsSurfaceDrawable()) {
+            return false;
+        }
+
+        // 管线的 viewport/scissor 是动态状态, 只需要换交换链与 framebuffer;
+        // 旧交换链交给新交换链接管, 它的 image view 与 framebuffer 可能仍被飞行中的帧引用, 交给删除队列
+        auto& ctx = Context::GetInstance();
+        std::unique_ptr<swapchain> old = std::move(ctx.m_swapchain);
+        ctx.m_swapchain.reset(new swapchain(m_surfaceWidth, m_surfaceHeight, old->m_swapchain));
+        const auto& extent = ctx.m_swapchain->GetExtent();
+        ctx.m_swapchain->createFramebuffers(extent.width, extent.height);
+
+        ctx.DeferDestroy([retired = old.release()]() { delete retired; });
+        m_swapchainDirty = false;
+        return true;
+    }
+
+    void Renderer::Resize(int w, int h) {
+        if (Context::GetInstance().IsHeadless()) {
+            std::cout << "resize is not supported in headless mode" << std::endl;
+            return;
+        }
+        m_surfaceWidth = w;
+        m_surfaceHeight = h;
+        m_swapchainDirty = true;
+    }
+
+    vk::Framebuffer Renderer::currentFramebuffer() {
+        auto& ctx = Context::GetInstance();
+        return ctx.IsHeadless() ? ctx.m_renderTarget->GetFramebuffer(m_imageIndex)
+                                : ctx.m_swapchain->m_framebuffers[m_imageIndex];
+    }
+
+    std::future<RenderTarget::Pixels> Renderer::ReadbackFrame() {
+        auto& ctx = Context::GetInstance();
+        if (!ctx.IsHeadless()) {
+            throw std::runtime_error("readback is only supported in headless mode!");
+        }
+        if (!m_recording) {
+            throw std::runtime_error("ReadbackFrame must be called between StartRender and EndRender!");
+        }
+        return ctx.m_renderTarget->RequestReadback(m_curFrame);
+    }
+
+    void Renderer::WaitReadbacks() {
+        auto& ctx = Context::GetInstance();
+        if (!ctx.IsHeadless()) {
+            return;
+        }
+
+        m_scheduler->WaitIdle();
+        for (int i = 0; i < m_maxFlightCount; i++) {
+            ctx.m_renderTarget->Collect(i);
+        }
+    }
+
+    void Renderer::setViewport(vk::CommandBuffer cmd) {
+        const auto extent = Context::GetInstance().GetRenderExtent();
+        vk::Viewport viewport(0, 0, static_cast<float>(extent.width), static_cast<float>(extent.height), 0, 1);
+        vk::Rect2D scissor({ 0, 0 }, extent);
+        cmd.setViewport(0, viewport);
+        cmd.setScissor(0, scissor);
+    }
+
+    void Renderer::beginRenderPass(vk::CommandBuffer cmd, vk::SubpassContents contents) {
+        auto& ctx = Context::GetInstance();
+
         vk::ClearValue clearValue;
         clearValue.setColor(vk::ClearColorValue(std::array<float, 4>{0.1, 0.1, 0.1, 1}));
         vk::RenderPassBeginInfo renderPassBegin;
         renderPassBegin.setRenderPass(ctx.m_renderProcess->GetRenderPass())
-            .setFramebuffer(swapchain->m_framebuffers[m_imageIndex])
+            .setFramebuffer(m_spriteFramebuffer)
             .setClearValues(clearValue)
-            .setRenderArea(vk::Rect2D({}, swapchain->GetExtent()));
-        cmd.beginRenderPass(&renderPassBegin, vk::SubpassContents::eInline);
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, ctx.m_renderProcess->GetPipeline());
+            .setRenderArea(vk::Rect2D({}, ctx.GetRenderExtent()));
+        TOY2D_PROFILE_GPU_BEGIN(cmd, "RenderPass");
+        cmd.beginRenderPass(&renderPassBegin, contents);
+        if (contents == vk::SubpassContents::eInline) {
+            setViewport(cmd);
+        }
     }
 
     void Renderer::EndRender() {
+        if (!m_recording) {
+            return;
+        }
+        TOY2D_PROFILE_FUNCTION();
+
         auto& ctx = Context::GetInstance();
-        auto& swapchain = ctx.m_swapchain;
         auto& cmd = m_cmdBuffers[m_curFrame];
-        cmd.endRenderPass();
+
+        auto& graph = *m_frameGraphs[m_curFrame];
+        auto recordBegin = std::chrono::steady_clock::now();
+        if (m_cullMode || m_parallelMode) {
+            bool cull = m_cullMode && prepareCull();
+            buildFrameGraph(cull, [this](vk::CommandBuffer cmd) {
+                if (m_cullMode) {
+                    recordSpritesCulled(cmd);
+                }
+                else {
+                    recordSpritesParallel(cmd);
+                }
+                cmd.endRenderPass();
+                TOY2D_PROFILE_GPU_END(cmd);
+            });
+            graph.Compile();
+            graph.Execute(cmd);
+        }
+        else {
+            flushSprites();
+            cmd.endRenderPass();
+            TOY2D_PROFILE_GPU_END(cmd);
+            graph.Execute(cmd);
+        }
+        m_stats.recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordBegin).count();
+        m_stats.barriers = graph.GetStats().barrierBatches;
+        m_stats.transientBytes = graph.GetStats().transientBytes;
+        m_stats.unaliasedBytes = graph.GetStats().unaliasedBytes;
+
+        if (ctx.IsHeadless()) {
+            ctx.m_renderTarget->RecordReadback(cmd, m_curFrame);
+        }
+        writeFrameTimestamp(cmd, true);
         cmd.end();
+        m_recording = false;
+
+        submitAndPresent(cmd, m_imageIndex);
+    }
+
+    void Renderer::beginUploads(vk::CommandBuffer cmd) {
+        // 提交攒下的上传, 并在 render pass 之前取得它们的所有权
+        auto& uploadMgr = Context::GetInstance().m_uploadManager;
+        uploadMgr->Collect();
+        uploadMgr->Flush();
+        m_frameUploadWait = uploadMgr->AcquirePending(cmd);
+        requireUpload(m_staticUploadValue);
+    }
+
+    bool Renderer::requireUpload(uint64_t value) {
+        auto& uploadMgr = Context::GetInstance().m_uploadManager;
+        if (value > uploadMgr->GetAcquiredValue()) {
+            return false;
+        }
+
+        // 资源第一次被用到且上传还没结束时, 才让这一帧等待
+        if (value > m_frameUploadWait && !uploadMgr->IsComplete(value)) {
+            m_frameUploadWait = value;
+        }
+        return true;
+    }
+
+    void Renderer::submitAndPresent(vk::CommandBuffer cmd, uint32_t imageIndex) {
+        auto& ctx = Context::GetInstance();
+        auto& swapchain = ctx.m_swapchain;
+        bool headless = ctx.IsHeadless();
+
+        // 无窗口模式没有 acquire/present, 不需要这两个 semaphore
+        std::vector<vk::Semaphore> waitSemaphores;
+        std::vector<vk::PipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        if (!headless) {
+            waitSemaphores.push_back(m_imageAvaliables[m_curFrame]);
+            waitStages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+            waitValues.push_back(0); // binary semaphore 的值会被忽略
+        }
 
-        vk::SubmitInfo submit;
-        vk::PipelineStageFlags flags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        if (m_frameUploadWait > 0) {
+            waitSemaphores.push_back(ctx.m_uploadManager->GetSemaphore());
+            waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+            waitValues.push_back(m_frameUploadWait);
+        }
 
-        submit.setCommandBuffers(cmd)
-            .setWaitSemaphores(m_imageAvaliables[m_curFrame])
-            .setSignalSemaphores(m_imageDrawFinishs[m_curFrame])
-            .setWaitDstStageMask(flags);
-        ctx.m_graphicsQueue.submit(submit, m_cmdFences[m_curFrame]);
+        // 帧完成时由调度器 signal 帧号
+        auto submitBegin = std::chrono::steady_clock::now();
+        {
+            TOY2D_PROFILE_SCOPE("QueueSubmit");
+            m_scheduler->Submit(ctx.m_graphicsQueue, cmd, waitSemaphores, waitStages, waitValues,
+                headless ? vk::Semaphore{} : m_imageDrawFinishs[m_curFrame]);
+        }
+        TOY2D_PROFILE_GPU_SUBMITTED();
+        m_frameUploadWait = 0;
+
+        if (headless) {
+            m_stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitBegin).count();
+            return;
+        }
 
         vk::PresentInfoKHR presentInfo;
-        presentInfo.setImageIndices(m_imageIndex)
+        presentInfo.setImageIndices(imageIndex)
             .setSwapchains(swapchain->m_swapchain)
             .setWaitSemaphores(m_imageDrawFinishs[m_curFrame]);
-        if (ctx.m_presentQueue.presentKHR(presentInfo) != vk::Result::eSuccess) {
-            throw std::runtime_error("present queue execute failed");
+        TOY2D_PROFILE_SCOPE("QueuePresent");
+        try {
+            if (ctx.m_presentQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR) {
+                m_swapchainDirty = true;
+            }
+        }
+        catch (const vk::OutOfDateKHRError&) {
+            // 图像没有被呈现, 但 semaphore 的等待照常发生, 下一帧开始前重建交换链即可
+            m_swapchainDirty = true;
+        }
+        m_stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitBegin).count();
+    }
+
+    void Renderer::createTimestampPool() {
+        auto& ctx = Context::GetInstance();
+        auto families = ctx.GetPhyDevice().getQueueFamilyProperties();
+        float period = ctx.GetPhyDevice().getProperties().limits.timestampPeriod;
+        m_timestampPeriod = period;
+        m_frameTimed.assign(m_maxFlightCount, false);
+        m_timestampPool = nullptr;
+        if (families[ctx.GetQueueFamilyIndices().grapghicsQueue.value()].timestampValidBits == 0 || period <= 0) {
+            return;
         }
 
-        m_curFrame = (m_curFrame + 1) % m_maxFlightCount;
+        vk::QueryPoolCreateInfo createInfo;
+        createInfo.setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(m_maxFlightCount * 2);
+        m_timestampPool = ctx.GetDevice().createQueryPool(createInfo);
+    }
+
+    void Renderer::writeFrameTimestamp(vk::CommandBuffer cmd, bool end) {
+        if (!m_timestampPool) {
+            return;
+        }
+        uint32_t first = m_curFrame * 2;
+        if (!end) {
+            cmd.resetQueryPool(m_timestampPool, first, 2);
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_timestampPool, first);
+        }
+        else {
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_timestampPool, first + 1);
+            m_frameTimed[m_curFrame] = true;
+        }
     }
 
-    void Renderer::createFence() {
-        m_cmdFences.resize(m_maxFlightCount, nullptr);
+    double Renderer::readFrameGpuMs() {
+        // 调用时该槽位上一次的帧已经完成, 查询结果一定可用
+        if (!m_timestampPool || !m_frameTimed[m_curFrame]) {
+            return -1;
+        }
+        m_frameTimed[m_curFrame] = false;
+
+        uint64_t ticks[2];
+        auto result = Context::GetInstance().GetDevice().getQueryPoolResults(m_timestampPool, m_curFrame * 2, 2,
+            sizeof(ticks), ticks, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess || ticks[1] < ticks[0]) {
+            return -1;
+        }
+        return (ticks[1] - ticks[0]) * static_cast<double>(m_timestampPeriod) / 1e6;
+    }
+
+    void Renderer::SetRecordThreadCount(uint32_t count) {
+        if (m_recording) {
+            throw std::runtime_error("SetRecordThreadCount can not be called while recording!");
+        }
+
+        // 旧的录制槽位里的 secondary command buffer 可能还被飞行中的帧引用
+        m_scheduler->WaitIdle();
+        m_parallelRecorder.reset(new ParallelRecorder(m_maxFlightCount, count));
+    }
 
-        for (auto& fence : m_cmdFences) {
-            vk::FenceCreateInfo fenceCreateInfo;
-            fenceCreateInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
-            fence = Context::GetInstance().GetDevice().createFence(fenceCreateInfo);
+    void Renderer::SetFramesInFlight(int count) {
+        if (m_recording) {
+            throw std::runtime_error("SetFramesInFlight can not be called while recording!");
         }
+        m_scheduler->SetFramesInFlight(count);
     }
 
     void Renderer::createSems() {
@@ -182,124 +853,86 @@ namespace toy2d {
     }
 
     void Renderer::createVertexBuffer() {
-        // CPU
-        m_hostVertexBuffer.reset(new Buffer(sizeof(kVertices),
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-
-        // GPU
+        // GPU, 数据经 UploadManager 的暂存 buffer 拷贝过去
         m_deviceVertexBuffer.reset(new Buffer(sizeof(kVertices),
             vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
             vk::MemoryPropertyFlagBits::eDeviceLocal));
     }
 
     void Renderer::createIndexBuffer() {
-        // CPU
-        m_hostIndexBuffer.reset(new Buffer(sizeof(kIndices),
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-
         // GPU
         m_deviceIndexBuffer.reset(new Buffer(sizeof(kIndices),
             vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
             vk::MemoryPropertyFlagBits::eDeviceLocal));
     }
 
-    void Renderer::createColorBuffer() {
-        m_hostColorBuffers.resize(m_maxFlightCount);
-        m_deviceColorBuffers.resize(m_maxFlightCount);
-
-        for (auto& buffer : m_hostColorBuffers) {
-            // CPU
-            buffer.reset(new Buffer(sizeof(Color),
-                vk::BufferUsageFlagBits::eTransferSrc,
-                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-        }
+    void Renderer::createRingBuffers() {
+        auto limits = Context::GetInstance().GetPhyDevice().getProperties().limits;
+        m_uniformAlignment = limits.minUniformBufferOffsetAlignment;
 
-        for (auto& buffer : m_deviceColorBuffers) {
-            // GPU
-            buffer.reset(new Buffer(sizeof(Color),
-                vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer,
-                vk::MemoryPropertyFlagBits::eDeviceLocal));
-        }
+        // uniform 通过 dynamic offset 引用, descriptor set 在录制期间不能改写, 所以这个 ring 不扩容
+        m_uniformRing.reset(new FrameRingBuffer(m_maxFlightCount, 256 * 1024,
+            vk::BufferUsageFlagBits::eUniformBuffer, false));
+        m_vertexRing.reset(new FrameRingBuffer(m_maxFlightCount, 1024 * 1024,
+            vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, true));
     }
 
-    void Renderer::copyBuffer(vk::Buffer & src, vk::Buffer& dst, size_t size, size_t srcOffset, size_t dstOffset) {
-        auto cmdBuffer = Context::GetInstance().m_commandManager->CreateOneCommandBuffer();
+    void Renderer::SetDrawColor(Color color) {
+        m_drawColor = color;
+        bufferColorData();
+    }
 
-        vk::CommandBufferBeginInfo cmdbeginInfo;
-        cmdbeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit); // 这里设置为每次重置
-        cmdBuffer.begin(cmdbeginInfo); {
-            vk::BufferCopy region;
-            region.setSize(size)
-                .setSrcOffset(srcOffset)
-                .setDstOffset(dstOffset);
-            cmdBuffer.copyBuffer(src, dst, region);
+    void Renderer::bufferColorData() {
+        // 不在录制中时只记录颜色, 等 StartRender 时再写入
+        if (!m_recording) {
+            return;
         }
-        cmdBuffer.end();
-
-        vk::SubmitInfo submitInfo;
-        submitInfo.setCommandBuffers(cmdBuffer);
-        Context::GetInstance().m_graphicsQueue.submit(submitInfo);
-
-        Context::GetInstance().GetDevice().waitIdle(); // 这里没有用信号，直接粗暴等待
 
-        Context::GetInstance().m_commandManager->FreeCmd(cmdBuffer);
+        auto allocation = m_uniformRing->Allocate(sizeof(Color), m_uniformAlignment);
+        memcpy(allocation.data, &m_drawColor, sizeof(Color));
+        m_dynamicOffsets[1] = static_cast<uint32_t>(allocation.offset);
     }
 
-    void Renderer::SetDrawColor(Color color) {
-        auto& device = Context::GetInstance().GetDevice();
-
-        for (int i = 0; i < m_hostColorBuffers.size(); ++i) {
-            auto& host_buffer = m_hostColorBuffers[i];
-
-            // 传输到 GPU
-            memcpy(host_buffer->m_map, &color, sizeof(Color));
-
-            copyBuffer(host_buffer->m_buffer, m_deviceColorBuffers[i]->m_buffer, host_buffer->m_size, 0, 0);
-        }
+    void Renderer::bindFrameSet(vk::CommandBuffer cmd, vk::PipelineLayout layout) {
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, descriptorSets_[m_curFrame].set, m_dynamicOffsets);
     }
 
     void Renderer::bufferVertexData() {
         // 传输到 GPU
-        auto& device = Context::GetInstance().GetDevice();
-        memcpy(m_hostVertexBuffer->m_map, kVertices.data(), sizeof(kVertices));
-
-        copyBuffer(m_hostVertexBuffer->m_buffer, m_deviceVertexBuffer->m_buffer, m_hostVertexBuffer->m_size, 0, 0);
+        m_staticUploadValue = Context::GetInstance().m_uploadManager->UploadBuffer(
+            kVertices.data(), sizeof(kVertices), m_deviceVertexBuffer->m_buffer, 0);
     }
 
     void Renderer::bufferIndexData() {
         // 传输到 GPU
-        auto& device = Context::GetInstance().GetDevice();
-        memcpy(m_hostIndexBuffer->m_map, kIndices, sizeof(kIndices));
-
-        copyBuffer(m_hostIndexBuffer->m_buffer, m_deviceIndexBuffer->m_buffer, m_hostIndexBuffer->m_size, 0, 0);
+        m_staticUploadValue = Context::GetInstance().m_uploadManager->UploadBuffer(
+            kIndices, sizeof(kIndices), m_deviceIndexBuffer->m_buffer, 0);
     }
 
     void Renderer::DrawRect(const Rect& rect)
     {
         // 开始绘制三角形
-        auto& device = Context::GetInstance().GetDevice();
-        auto& _swapchain = Context::GetInstance().m_swapchain;
         auto& _render_process = Context::GetInstance().m_renderProcess;
 
-        if (device.waitForFences(m_cmdFences[m_curFrame], true, std::numeric_limits<std::uint64_t>::max()) != vk::Result::eSuccess) {
-            throw std::runtime_error("wait for fence failed");
+        m_curFrame = m_scheduler->BeginFrame();
+        Context::GetInstance().m_deletionQueue->Collect();
+
+        // 该接口会阻塞程序, 拿不到图像 (例如窗口最小化) 时跳过这一帧
+        if (!acquireImage()) {
+            return;
         }
-        device.resetFences(m_cmdFences[m_curFrame]);
 
         //auto model = Mat4::CreateTranslate(rect.position).Mul(Mat4::CreateScale(rect.size));
         //bufferMVPData(model);
-
-        // 该接口会阻塞程序, 第二个参数为等待时间，这里设置为无限等待
-        auto result = device.acquireNextImageKHR(_swapchain->m_swapchain, std::numeric_limits<uint64_t>::max(), m_imageAvaliables[m_curFrame]);
-        // device.acquireNextImage2KHR
-        if (result.result != vk::Result::eSuccess) {
-            std::cout << "acquireNextImageKHR error" << std::endl;
-        }
+        m_uniformRing->BeginFrame(m_curFrame);
+        m_vertexRing->BeginFrame(m_curFrame);
+        DescriptorSetManager::GetInstance().BeginFrame(m_curFrame);
+        m_recording = true;
+        bufferMVPData();
+        bufferColorData();
 
         // 拿到 image 下标
-        auto imageIndex = result.value;
+        auto imageIndex = m_imageIndex;
         auto& cmd = m_cmdBuffers[m_curFrame];
 
         // 清空命令buffer, 与之前代码
@@ -310,82 +943,68 @@ namespace toy2d {
         vk::CommandBufferBeginInfo cmdbeginInfo;
         cmdbeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit); // 这里设置为每次重置
         cmd.begin(cmdbeginInfo);
-        {
+        TOY2D_PROFILE_GPU_FRAME(cmd, m_curFrame);
+        beginUploads(cmd);
+        buildFrameGraph(false, [&](vk::CommandBuffer cmd) {
             vk::RenderPassBeginInfo renderPassBeginInfo;
             vk::Rect2D area;
-            area.setOffset({ 0, 0 }).setExtent(_swapchain->m_swapchainInfo.imageExtent);
+            area.setOffset({ 0, 0 }).setExtent(Context::GetInstance().GetRenderExtent());
 
             vk::ClearValue clearValue; // 可以设置 0-255 uint32, 也可以设置 0~1 float
             clearValue.color = vk::ClearColorValue(std::array < float, 4>{0.1f, 0.1f, 1.0f, 1.0f});
 
             renderPassBeginInfo.setRenderPass(_render_process->GetRenderPass())
                 .setRenderArea(area)
-                .setFramebuffer(_swapchain->m_framebuffers[imageIndex])
+                .setFramebuffer(m_spriteFramebuffer)
                 .setClearValues(clearValue);
             cmd.beginRenderPass(renderPassBeginInfo, {});
             {
-                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _render_process->GetPipeline());
+                setViewport(cmd);
+                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _render_process->GetPipeline(m_blendMode));
 
                 static vk::DeviceSize offset = 0;
                 cmd.bindVertexBuffers(0, m_deviceVertexBuffer->m_buffer, offset);
                 cmd.bindIndexBuffer(m_deviceIndexBuffer->m_buffer, 0, vk::IndexType::eUint32);
 
                 auto& layout = Context::GetInstance().m_renderProcess->m_layout;
-                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                    layout,
-                    0, descriptorSets_[m_curFrame].set, {});
+                bindFrameSet(cmd, layout);
 
-                auto model = Mat4::CreateTranslate(rect.position).Mul(Mat4::CreateScale(rect.size));
+                auto model = Mat4::CreateTranslateScale(rect.position, rect.size);
                 cmd.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Mat4), model.GetData());
 
                 cmd.drawIndexed(6, 1, 0, 0, 0);
             }
             cmd.endRenderPass();
-        }
+        });
+        auto& graph = *m_frameGraphs[m_curFrame];
+        graph.Compile();
+        graph.Execute(cmd);
         cmd.end();
+        m_recording = false;
 
-        // 命令传入 GPU
-        vk::PipelineStageFlags const pipe_stage_flags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        vk::SubmitInfo submitInfo;
-        submitInfo.setCommandBuffers(cmd)
-            .setWaitSemaphores(m_imageAvaliables[m_curFrame])
-            .setSignalSemaphores(m_imageDrawFinishs[m_curFrame])
-            .setWaitDstStageMask(pipe_stage_flags);
-
-        // vk::SubmitInfo submitInfo;
-        Context::GetInstance().m_graphicsQueue.submit(submitInfo, m_cmdFences[m_curFrame]);
-
-        // 开始显示
-        vk::PresentInfoKHR presentInfo;
-        presentInfo.setImageIndices(imageIndex)
-            .setSwapchains(_swapchain->m_swapchain)
-            .setWaitSemaphores(m_imageDrawFinishs[m_curFrame]);
-        if (Context::GetInstance().m_presentQueue.presentKHR(presentInfo) != vk::Result::eSuccess) {
-            std::cout << "presentKHR error" << std::endl;
-        }
-
-        m_curFrame = (m_curFrame + 1) % m_maxFlightCount;
+        // 命令传入 GPU 并显示
+        submitAndPresent(cmd, imageIndex);
     }
 
     void Renderer::updateBufferSets() {
         for (int i = 0; i < descriptorSets_.size(); i++) {
             // bind MVP buffer
             vk::DescriptorBufferInfo bufferInfo1;
-            bufferInfo1.setBuffer(m_deviceMVPBuffers[i]->m_buffer)
+            bufferInfo1.setBuffer(m_uniformRing->GetBuffer())
                 .setOffset(0)
                 .setRange(sizeof(Mat4) * 2); // 改成 2 个矩阵大小
 
             std::vector<vk::WriteDescriptorSet> writeInfos(2);
             writeInfos[0].setBufferInfo(bufferInfo1)
                 .setDstBinding(0)
-                .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+                .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
                 .setDescriptorCount(1)
                 .setDstArrayElement(0)
                 .setDstSet(descriptorSets_[i].set);
 
             // bind Color buffer
             vk::DescriptorBufferInfo bufferInfo2;
-            bufferInfo2.setBuffer(m_deviceColorBuffers[i]->m_buffer)
+            bufferInfo2.setBuffer(m_uniformRing->GetBuffer())
                 .setOffset(0)
                 .setRange(sizeof(Color));
 
@@ -393,43 +1012,25 @@ namespace toy2d {
                 .setDstBinding(1) // 根据shader中 bind 修改为1
                 .setDstArrayElement(0)
                 .setDescriptorCount(1)
-                .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+                .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
                 .setDstSet(descriptorSets_[i].set);
 
             Context::GetInstance().GetDevice().updateDescriptorSets(writeInfos, {});
         }
     }
 
-    void Renderer::createMVPBuffer() {
-        m_hostMVPBuffers.resize(m_maxFlightCount);
-        m_deviceMVPBuffers.resize(m_maxFlightCount);
-
-        for (auto& buffer : m_hostMVPBuffers) {
-            // CPU
-            buffer.reset(new Buffer(sizeof(MVP),
-                vk::BufferUsageFlagBits::eTransferSrc,
-                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-        }
-
-        for (auto& buffer : m_deviceMVPBuffers) {
-            // GPU
-            buffer.reset(new Buffer(sizeof(MVP),
-                vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer,
-                vk::MemoryPropertyFlagBits::eDeviceLocal));
+    void Renderer::bufferMVPData(/*const Mat4& model*/) {
+        if (!m_recording) {
+            return;
         }
-    }
 
-    void Renderer::bufferMVPData(/*const Mat4& model*/) {
         MVP mvp;
         mvp.project = projectMat_;
         mvp.view = viewMat_;
         //mvp.model = model;
-        auto& device = Context::GetInstance().GetDevice();
-        for (int i = 0; i < m_hostMVPBuffers.size(); i++) {
-            auto& host_buffer = m_hostMVPBuffers[i];
-            memcpy(host_buffer->m_map, (void*)&mvp, sizeof(mvp));
-            copyBuffer(host_buffer->m_buffer, m_deviceMVPBuffers[i]->m_buffer, host_buffer->m_size, 0, 0);
-        }
+        auto allocation = m_uniformRing->Allocate(sizeof(MVP), m_uniformAlignment);
+        memcpy(allocation.data, (void*)&mvp, sizeof(mvp));
+        m_dynamicOffsets[0] = static_cast<uint32_t>(allocation.offset);
     }
 
     void Renderer::initMats() {
@@ -453,8 +1054,51 @@ namespace toy2d {
             .setBorderColor(vk::BorderColor::eIntOpaqueBlack)
             .setUnnormalizedCoordinates(false)
             .setCompareEnable(false)
-            .setMipmapMode(vk::SamplerMipmapMode::eLinear);
+            .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+            .setMipLodBias(m_samplerConfig.lodBias)
+            .setMinLod(0)
+            .setMaxLod(m_samplerConfig.mipmaps ? VK_LOD_CLAMP_NONE : 0.0f);
+
+        // 各向异性需要设备开启 samplerAnisotropy 特性 (createDevice 中开启了所有支持的特性)
+        auto& phyDevice = Context::GetInstance().GetPhyDevice();
+        if (m_samplerConfig.maxAnisotropy > 1 && phyDevice.getFeatures().samplerAnisotropy) {
+            float limit = phyDevice.getProperties().limits.maxSamplerAnisotropy;
+            createInfo.setAnisotropyEnable(true)
+                .setMaxAnisotropy(std::min(m_samplerConfig.maxAnisotropy, limit));
+        }
         m_sampler = Context::GetInstance().GetDevice().createSampler(createInfo);
     }
 
+    void Renderer::createPostSampler() {
+        // 模糊在边缘处取到的是边缘像素, 不能绕回另一边
+        vk::SamplerCreateInfo createInfo;
+        createInfo.setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setAnisotropyEnable(false)
+            .setBorderColor(vk::BorderColor::eIntOpaqueBlack)
+            .setUnnormalizedCoordinates(false)
+            .setCompareEnable(false)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setMinLod(0)
+            .setMaxLod(0);
+        m_postSampler = Context::GetInstance().GetDevice().createSampler(createInfo);
+    }
+
+    void Renderer::SetSamplerConfig(const SamplerConfig& config) {
+        if (m_recording) {
+            throw std::runtime_error("SetSamplerConfig can not be called while recording!");
+        }
+
+        // 飞行中的帧还在通过纹理的 set 使用旧采样器, 等它们结束后再销毁
+        Context::GetInstance().DeferDestroy([sampler = m_sampler]() {
+            Context::GetInstance().GetDevice().destroySampler(sampler);
+        });
+        m_samplerConfig = config;
+        createSampler();
+        TextureManager::Instance().RefreshSamplers();
+    }
+
 }
@@ -7,13 +7,24 @@
 #include "buffer.hpp"
 #include "math/math.hpp"
 #include "texture2d.hpp"
+#include "sprite_batch.hpp"
+#include "frame_ring_buffer.hpp"
+#include "parallel_recorder.hpp"
+#include "sprite_culler.hpp"
+#include "render_target.hpp"
+#include "pipeline_cache.hpp"
+#include "render_graph.hpp"
+#include "frame_scheduler.hpp"
 
 
 namespace toy2d {
+    class swapchain;
+
     class Renderer final
     {
     public:
-        Renderer(int maxFlightCount = 2);
+        // 每帧的资源按 FrameScheduler::MaxFramesInFlight 个槽位分配, framesInFlight 为初始的飞行帧数
+        Renderer(int framesInFlight = 2);
         ~Renderer();
 
         void DrawRect(const Rect& rect);
@@ -21,44 +32,160 @@ namespace toy2d {
         void SetDrawColor(Color kColor);
         vk::Sampler GetSampler() { return m_sampler; };
 
+        struct SamplerConfig {
+            bool mipmaps = true;     // false 时只采样第 0 层
+            float lodBias = 0;       // 正值偏向更小的 mip (更模糊), 负值更锐利
+            float maxAnisotropy = 1; // 大于 1 时开启各向异性过滤, 截断到设备上限, 设备不支持时忽略
+        };
+        // 重建采样器, 所有纹理换用写入新采样器的 set; 旧的推迟到飞行中的帧结束后销毁, 不能在录制中调用
+        void SetSamplerConfig(const SamplerConfig& config);
+        const SamplerConfig& GetSamplerConfig() const { return m_samplerConfig; }
+
+        // 纹理的上传在 StartRender 时才会提交并取得所有权, 帧中途加载的纹理从下一帧开始绘制
         void DrawTexture(const Rect& rect, Texture& texture);
+        // uvRect 为纹理坐标中的子矩形 (x, y, w, h), 分量需在 [0, 1] 内; tint 会再乘上当前的绘制颜色;
+        // rotation 为绕精灵中心旋转的弧度
+        void DrawSprite(const Rect& rect, Texture& texture, const Rect& uvRect, const Color& tint, float alpha = 1.0f,
+                        float rotation = 0.0f);
+        // 还没上传完成 (包括异步加载中与换出后重新加载中) 的纹理用占位图代替绘制, 为空时直接跳过;
+        // 占位图本身需由调用方保证存活, 设置后会被钉住不再换出
+        void SetPlaceholderTexture(Texture* texture) {
+            m_placeholder = texture;
+            if (texture) {
+                texture->SetPinned(true);
+            }
+        }
+        // 交换链过期或大小改变时会在 StartRender 中重建, 窗口最小化时 StartRender 到 EndRender 之间的绘制被忽略
         void StartRender();
         void EndRender();
+        // 窗口大小改变时调用, 交换链在下一次 StartRender 时重建; 投影矩阵仍需调用方用 SetProject 更新
+        void Resize(int w, int h);
+
+        // 无窗口模式: 在 StartRender 与 EndRender 之间调用, 读回这一帧的渲染结果;
+        // 该帧在之后某次 StartRender 或 WaitReadbacks 中等到完成时 future 就绪
+        std::future<RenderTarget::Pixels> ReadbackFrame();
+        // 等待所有已提交的帧并兑现全部读回请求
+        void WaitReadbacks();
+
+        // 批处理模式: 绘制只收集精灵, 在 EndRender 时按纹理合并成实例化绘制; 需在 StartRender 之前切换
+        void SetBatchMode(bool enable) { m_batchMode = enable; }
+        bool IsBatchMode() const { return m_batchMode; }
+        // bindless 模式: 批处理时所有纹理走全局纹理表, 不同纹理的精灵也合并为一次 draw, 设备不支持时忽略
+        void SetBindlessMode(bool enable);
+        bool IsBindlessMode() const { return m_bindlessMode; }
+        // 并行录制: 隐含批处理模式, EndRender 时把整批精灵切成若干段, 由工作线程各自录制 secondary
+        // command buffer, 主 command buffer 按顺序执行; 需在 StartRender 之前切换
+        void SetParallelMode(bool enable) { m_parallelMode = enable; }
+        bool IsParallelMode() const { return m_parallelMode; }
+        // GPU 剔除: 隐含批处理模式并优先于并行录制, EndRender 时先由计算着色器剔除视口外的精灵,
+        // 再按纹理分组间接绘制; 组内绘制顺序不保证与提交顺序一致, 需在 StartRender 之前切换
+        void SetCullMode(bool enable) { m_cullMode = enable; }
+        bool IsCullMode() const { return m_cullMode; }
+        // 混合模式: 各模式的管线启动时已在后台编译, 切换不会等待编译; 设备不支持的模式被忽略.
+        // 非批处理与批处理模式下录制中切换会先画掉已收集的精灵, 可以逐批切换;
+        // 并行录制与剔除模式在 EndRender 时统一录制, 整帧使用 EndRender 时的模式
+        void SetBlendMode(BlendMode mode);
+        BlendMode GetBlendMode() const { return m_blendMode; }
+        // 后处理模糊: 精灵先画到离屏的临时图像, 再经过 iterations 轮横向+纵向的高斯模糊写入颜色目标, 0 关闭.
+        // 中间结果都是 render graph 的临时图像, 生命周期不重叠的共用同一段内存; 需在 StartRender 之前切换
+        void SetPostBlur(uint32_t iterations) { m_postBlurIterations = iterations; }
+        uint32_t GetPostBlur() const { return m_postBlurIterations; }
+        // 同时在 GPU 上排队的帧数 (1~4), 少则输入延迟低, 多则吞吐高; 不能在录制中调用, 不需要等待飞行中的帧
+        void SetFramesInFlight(int count);
+        int GetFramesInFlight() const { return m_scheduler->GetFramesInFlight(); }
+        // 按帧号查询某一帧是否完成, 当前帧号见 GetCurrentFrame
+        FrameScheduler& GetFrameScheduler() { return *m_scheduler; }
+        uint32_t GetRecordThreadCount() const { return m_parallelRecorder->GetWorkerCount(); }
+        // 改变并行录制的线程数, 0 表示 hardware_concurrency; 会等待所有飞行中的帧, 不能在录制中调用
+        void SetRecordThreadCount(uint32_t count);
+
+        struct FrameStats {
+            uint32_t spritesSubmitted = 0;
+            uint32_t drawCalls = 0;
+            uint32_t recordTasks = 0;  // 并行录制时使用的 secondary command buffer 数
+            double recordMs = 0;       // EndRender 中录制精灵命令的 CPU 耗时
+            double submitMs = 0;       // queue submit 与 present 的 CPU 耗时
+            double waitMs = 0;         // StartRender 中等待之前的帧完成的 CPU 耗时, 飞行帧数越少越大
+            // 同一槽位上一次提交 (即飞行帧数那么多帧之前) 的 GPU 耗时, 在 StartRender 等到它完成后读回;
+            // 设备不支持 timestamp 或该槽位还没有提交过时为负数
+            double gpuMs = -1;
+            // 剔除模式: 同一槽位上一次提交中通过剔除的精灵数, 与 gpuMs 一样滞后飞行帧数那么多帧; 否则为负数
+            int64_t spritesVisible = -1;
+            // 帧 render graph 录制的 pipelineBarrier 次数, 不含上传与读回
+            uint32_t barriers = 0;
+            // 帧 render graph 临时图像实际占用的显存, 以及每张单独分配时需要的显存
+            uint64_t transientBytes = 0;
+            uint64_t unaliasedBytes = 0;
+        };
+        const FrameStats& GetStats() const { return m_stats; }
 
     private:
         void CreateCmdBuffer();
         void createSems();
-        void createFence();
         void createVertexBuffer();
         void bufferVertexData();
         void createIndexBuffer();
         void bufferIndexData();
-        void createColorBuffer();
-        void copyBuffer(vk::Buffer& src, vk::Buffer& dst, size_t size, size_t srcOffset, size_t dstOffset);
+        void createRingBuffers();
+        void bufferColorData();
+        void bindFrameSet(vk::CommandBuffer cmd, vk::PipelineLayout layout);
+        void beginUploads(vk::CommandBuffer cmd);
+        bool requireUpload(uint64_t value);
+        void submitAndPresent(vk::CommandBuffer cmd, uint32_t imageIndex);
         void updateBufferSets();
         void updateImageSets(std::unique_ptr<Texture>& texture);
-        void createMVPBuffer();
         void bufferMVPData(/*const Mat4& model*/);
         void initMats();
         void createSampler();
         void createTexture();
+        void flushSprites();
+        // bindless 模式下批次中有纹理没能进入全局纹理表时, 这一批按纹理绑定 set
+        bool useBindless() const { return m_bindlessMode && m_spriteBatch->IsBindlessReady(); }
+        void recordSpritesParallel(vk::CommandBuffer cmd);
+        bool prepareCull();
+        void recordSpritesCulled(vk::CommandBuffer cmd);
+        // 用当前帧的图: 导入颜色目标, cull 时先加剔除 pass, 返回开始 render pass 的那个 pass
+        RenderGraph::Pass buildFrameGraph(bool cull, RenderGraph::ExecuteFunc draw);
+        // 离屏 pass 用的 framebuffer, 只在这一帧使用, 帧结束后销毁
+        vk::Framebuffer createPassFramebuffer(vk::ImageView view);
+        // 开启后处理时在精灵 pass 之后加入各趟模糊, scene 为精灵画到的离屏图像
+        void addPostPasses(std::optional<RenderGraph::Resource> scene, RenderGraph::Resource target,
+                           const RenderGraph::ImageDesc& desc);
+        // 一趟全屏模糊: 采样 source, 写入 framebuffer, 自己开始并结束 render pass
+        void recordPostPass(vk::CommandBuffer cmd, vk::ImageView source, vk::Framebuffer framebuffer, bool horizontal);
+        void createPostSampler();
+        Rect computeViewBounds() const;
+        void beginRenderPass(vk::CommandBuffer cmd, vk::SubpassContents contents);
+        void setViewport(vk::CommandBuffer cmd);
+        vk::Framebuffer currentFramebuffer();
+        bool acquireImage();
+        bool recreateSwapchain();
+        void createTimestampPool();
+        void writeFrameTimestamp(vk::CommandBuffer cmd, bool end);
+        double readFrameGpuMs();
 
         std::vector<vk::CommandBuffer> m_cmdBuffers;
         std::vector<vk::Semaphore> m_imageAvaliables;
         std::vector<vk::Semaphore> m_imageDrawFinishs;
-        std::vector<vk::Fence> m_cmdFences;
+        std::unique_ptr<FrameScheduler> m_scheduler;
 
-        std::unique_ptr<Buffer> m_hostVertexBuffer; // CPU
-        std::unique_ptr<Buffer> m_deviceVertexBuffer; // GPU
+        // 每个飞行帧两个 timestamp, 记录整个帧 command buffer 的 GPU 耗时
+        vk::QueryPool m_timestampPool;
+        float m_timestampPeriod; // 每个 tick 的纳秒数
+        std::vector<bool> m_frameTimed; // 该槽位上一次提交是否写了 timestamp
 
-        std::unique_ptr<Buffer> m_hostIndexBuffer; // CPU
+        std::unique_ptr<Buffer> m_deviceVertexBuffer; // GPU
         std::unique_ptr<Buffer> m_deviceIndexBuffer; // GPU
+        uint64_t m_staticUploadValue; // 顶点/索引数据上传完成时的 timeline 值
+        uint64_t m_frameUploadWait;   // 本帧提交时需要等待的上传 timeline 值, 0 表示不等待
 
-        std::vector<std::unique_ptr<Buffer>> m_hostColorBuffers; // CPU
-        std::vector<std::unique_ptr<Buffer>> m_deviceColorBuffers; // GPU
+        // 每帧的 MVP 与绘制颜色都从 uniform ring 中分配, 通过 dynamic offset 绑定
+        std::unique_ptr<FrameRingBuffer> m_uniformRing;
+        std::unique_ptr<FrameRingBuffer> m_vertexRing; // 精灵实例数据
+        std::array<uint32_t, 2> m_dynamicOffsets; // set 0: binding 0 为 MVP, binding 1 为 Color
+        vk::DeviceSize m_uniformAlignment;
+        bool m_recording; // StartRender 与 EndRender 之间为 true
 
-        std::vector<std::unique_ptr<Buffer>> m_hostMVPBuffers; // CPU
-        std::vector<std::unique_ptr<Buffer>> m_deviceMVPBuffers; // GPU
         Mat4 projectMat_;
         Mat4 viewMat_;
         struct MVP {
@@ -67,13 +194,35 @@ namespace toy2d {
             //Mat4 model;
         };
 
-        int m_maxFlightCount;
-        int m_curFrame;
+        int m_maxFlightCount; // 槽位数, 实际飞行帧数由 m_scheduler 决定
+        int m_curFrame;       // 当前帧的槽位
 
         std::vector<DescriptorSetManager::SetInfo> descriptorSets_;
         vk::Sampler m_sampler;
+        SamplerConfig m_samplerConfig;
+        vk::Sampler m_postSampler; // 后处理采样离屏图像, clamp to edge, 不受 SamplerConfig 影响
+        vk::Framebuffer m_spriteFramebuffer; // 本帧精灵 pass 的目标, 开启后处理时为离屏图像
 
         uint32_t m_imageIndex;
+
+        bool m_swapchainDirty;
+        int m_surfaceWidth;
+        int m_surfaceHeight;
+
+        std::unique_ptr<SpriteBatch> m_spriteBatch;
+        bool m_batchMode;
+        bool m_bindlessMode;
+        bool m_parallelMode;
+        bool m_cullMode;
+        BlendMode m_blendMode;
+        uint32_t m_postBlurIterations;
+        std::unique_ptr<ParallelRecorder> m_parallelRecorder;
+        std::unique_ptr<SpriteCuller> m_culler;
+        std::vector<SpriteBatch::Group> m_cullGroups; // 本帧剔除的分组, prepareCull 到 recordSpritesCulled 之间有效
+        std::vector<std::unique_ptr<RenderGraph>> m_frameGraphs; // 每个飞行帧一个
+        Color m_drawColor;
+        Texture* m_placeholder;
+        FrameStats m_stats;
     };
 }
 
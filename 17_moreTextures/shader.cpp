@@ -1,9 +1,10 @@
 ﻿#include "shader.hpp"
 #include "context.h"
+#include <algorithm>
 
 namespace toy2d{
 
-Shader::Shader(const std::string& vertexSource, const std::string& fragSource)
+Shader::Shader(std::string_view vertexSource, std::string_view fragSource)
 {
     // 创建
     vk::ShaderModuleCreateInfo createInfo;
@@ -16,51 +17,52 @@ Shader::Shader(const std::string& vertexSource, const std::string& fragSource)
     createInfo.pCode = reinterpret_cast<const uint32_t*>(fragSource.data());
     m_fragModule = Context::GetInstance().GetDevice().createShaderModule(createInfo);
 
+    m_reflection = ReflectSpirv(vertexSource);
+    m_reflection.Merge(ReflectSpirv(fragSource));
     initDescriptorSetLayouts();
 }
 
 Shader::~Shader()
 {
     auto& device = Context::GetInstance().GetDevice();
-    for (auto& layout : m_layouts) {
-        device.destroyDescriptorSetLayout(layout);
-    }
-    m_layouts.clear();
     device.destroyShaderModule(m_vertModule);
     device.destroyShaderModule(m_fragModule);
 }
 
 void Shader::initDescriptorSetLayouts() {
+    auto& cache = *Context::GetInstance().m_layoutCache;
+    for (uint32_t set = 0; set < m_reflection.GetSetCount(); set++) {
+        auto bindings = m_reflection.GetSetLayoutBindings(set);
+        // 运行时数组 (bindless 纹理表) 需要 update after bind 等标志, 它所在的 set 由 BindlessTextureTable 提供
+        bindings.erase(std::remove_if(bindings.begin(), bindings.end(),
+            [](const vk::DescriptorSetLayoutBinding& binding) { return binding.descriptorCount == 0; }), bindings.end());
+        // set 0 的 uniform 都放在按帧分配的 ring buffer 里, 绑定时用 dynamic offset 指定位置
+        if (set == 0) {
+            for (auto& binding : bindings) {
+                if (binding.descriptorType == vk::DescriptorType::eUniformBuffer) {
+                    binding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+                }
+            }
+        }
+        m_layouts.push_back(cache.Get(bindings));
+    }
+}
+
+ComputeShader::ComputeShader(std::string_view source)
+{
     auto& device = Context::GetInstance().GetDevice();
-    vk::DescriptorSetLayoutCreateInfo createInfo;
-    std::vector<vk::DescriptorSetLayoutBinding> bindings(2);
-    bindings[0].setBinding(0)
-        .setDescriptorCount(1)
-        .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-        .setStageFlags(vk::ShaderStageFlagBits::eVertex);
-    bindings[1].setBinding(1)
-        .setDescriptorCount(1)
-        .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-        .setStageFlags(vk::ShaderStageFlagBits::eFragment);
-    createInfo.setBindings(bindings);
-    m_layouts.push_back(device.createDescriptorSetLayout(createInfo));
+    vk::ShaderModuleCreateInfo createInfo;
+    createInfo.codeSize = source.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(source.data());
+    m_module = device.createShaderModule(createInfo);
 
-    // 拆分成两个，方法更新 image
-    bindings.resize(1);
-    bindings[0].setBinding(0)
-        .setDescriptorCount(1)
-        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-        .setStageFlags(vk::ShaderStageFlagBits::eFragment);
-    createInfo.setBindings(bindings);
-    m_layouts.push_back(device.createDescriptorSetLayout(createInfo));
+    m_reflection = ReflectSpirv(source);
+    m_layout = Context::GetInstance().m_layoutCache->Get(m_reflection.GetSetLayoutBindings(0));
 }
 
-vk::PushConstantRange Shader::GetPushConstantRange() const {
-    vk::PushConstantRange range;
-    range.setOffset(0)
-        .setSize(sizeof(Mat4))
-        .setStageFlags(vk::ShaderStageFlagBits::eVertex); // 指定哪个着色器使用
-    return range;
+ComputeShader::~ComputeShader()
+{
+    Context::GetInstance().GetDevice().destroyShaderModule(m_module);
 }
 
-}
\ No newline at end of file
+}
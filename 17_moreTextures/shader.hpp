@@ -3,14 +3,18 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include "vulkan/vulkan.hpp"
+#include "spirv_reflect.hpp"
 
 namespace toy2d{
 
+// 着色器都接受 SPIR-V 字节码的视图 (4 字节对齐), 可以直接指向资源包的映射内存;
+// descriptor set layout 与 push constant 范围从字节码反射得到, 布局由 Context 的 DescriptorLayoutCache 持有
 class Shader final
 {
 public:
-    Shader(const std::string& vertexSource, const std::string& fragSource);
+    Shader(std::string_view vertexSource, std::string_view fragSource);
     ~Shader();
 
     vk::ShaderModule GetVertexModule() const {
@@ -20,17 +24,42 @@ public:
         return m_fragModule;
     }
 
+    // 下标为 set 编号
     const std::vector<vk::DescriptorSetLayout>& GetDescriptorSetLayouts() const { return m_layouts; }
+    // 两个阶段合并后的结果
+    const ShaderReflection& GetReflection() const { return m_reflection; }
 
-    vk::PushConstantRange GetPushConstantRange() const;
+    vk::PushConstantRange GetPushConstantRange() const { return m_reflection.GetPushConstantRange(); }
 private:
     void initDescriptorSetLayouts();
 
     vk::ShaderModule m_vertModule;
     vk::ShaderModule m_fragModule;
 
+    ShaderReflection m_reflection;
     std::vector<vk::DescriptorSetLayout> m_layouts;
 };
+
+/**
+ * @brief 精灵剔除用的计算着色器
+ * set 0: binding 0 输入实例, 1 输出实例, 2 间接绘制命令, 3 每条命令的 draw count, 全部为 storage buffer (由反射得到)
+ */
+class ComputeShader final
+{
+public:
+    ComputeShader(std::string_view source);
+    ~ComputeShader();
+
+    vk::ShaderModule GetModule() const { return m_module; }
+    vk::DescriptorSetLayout GetDescriptorSetLayout() const { return m_layout; }
+    const ShaderReflection& GetReflection() const { return m_reflection; }
+    vk::PushConstantRange GetPushConstantRange() const { return m_reflection.GetPushConstantRange(); }
+
+private:
+    vk::ShaderModule m_module;
+    ShaderReflection m_reflection;
+    vk::DescriptorSetLayout m_layout; // set 0
+};
 }
 
 #endif // __SHADER_H__
@@ -0,0 +1,25 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec2 Texcoord;
+
+// 上一趟的结果 (离屏临时图像)
+layout(set = 0, binding = 0) uniform sampler2D Source;
+
+// 沿模糊方向相邻两个像素的纹理坐标差, 横向为 (1/w, 0), 纵向为 (0, 1/h)
+layout(push_constant) uniform PushConstant {
+    vec2 texelStep;
+} pc;
+
+void main() {
+    // 9 个 tap 的一维高斯核, 相邻两个 tap 借线性过滤合成一次采样, 共 5 次采样
+    const float offsets[2] = float[](1.3846153846, 3.2307692308);
+    const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+    vec4 color = texture(Source, Texcoord) * weights[0];
+    for (int i = 0; i < 2; i++) {
+        color += texture(Source, Texcoord + pc.texelStep * offsets[i]) * weights[i + 1];
+        color += texture(Source, Texcoord - pc.texelStep * offsets[i]) * weights[i + 1];
+    }
+    outColor = color;
+}
@@ -0,0 +1,9 @@
+#version 450
+
+// 覆盖整个目标的大三角形, 由 gl_VertexIndex 生成, 不需要顶点 buffer
+layout(location = 0) out vec2 outTexcoord;
+
+void main() {
+    outTexcoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(outTexcoord * 2.0 - 1.0, 0.0, 1.0);
+}
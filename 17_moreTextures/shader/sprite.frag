@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec2 Texcoord;
+layout(location = 1) in vec4 Tint;
+
+layout(set = 1, binding = 0) uniform sampler2D Sampler;
+
+void main() {
+    // 绘制颜色在提交精灵时已经乘进 Tint
+    outColor = Tint * texture(Sampler, Texcoord);
+}
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec2 Texcoord;
+layout(location = 1) in vec4 Tint;
+layout(location = 2) flat in uint TextureIndex;
+
+// 全局纹理表, 数组大小由 descriptor set layout 决定
+layout(set = 1, binding = 0) uniform sampler2D Textures[];
+
+void main() {
+    outColor = Tint * texture(Textures[nonuniformEXT(TextureIndex)], Texcoord);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+// binding 0: 单位四边形
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inTexcoord;
+
+// binding 1: 每个精灵一份的实例数据
+layout(location = 2) in vec2 inInstPosition;
+layout(location = 3) in vec2 inInstSize;
+layout(location = 4) in vec4 inInstUvRect;  // unorm16, 已解码到 [0, 1]
+layout(location = 5) in vec4 inInstTint;    // RGBA8 unorm
+layout(location = 6) in uvec2 inInstRotationIndex; // x: 角度, 一整圈为 65536; y: 全局纹理表下标
+
+layout(location = 0) out vec2 outTexcoord;
+layout(location = 1) out vec4 outTint;
+layout(location = 2) flat out uint outTextureIndex;
+
+layout(set = 0, binding = 0) uniform UniformBuffer {
+    mat4 project;
+    mat4 view;
+} ubo;
+
+void main() {
+    float angle = float(inInstRotationIndex.x) * (6.28318530718 / 65536.0);
+    float c = cos(angle);
+    float s = sin(angle);
+    vec2 local = inPosition * inInstSize;
+    vec2 position = inInstPosition + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+    gl_Position = ubo.project * ubo.view * vec4(position, 0.0, 1.0);
+    outTexcoord = inInstUvRect.xy + inTexcoord * inInstUvRect.zw;
+    outTint = inInstTint;
+    outTextureIndex = inInstRotationIndex.y;
+}
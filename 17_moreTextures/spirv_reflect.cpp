@@ -0,0 +1,419 @@
+#include "spirv_reflect.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace toy2d {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x07230203;
+constexpr size_t kHeaderWords = 5;
+
+// 用到的 opcode, 见 SPIR-V 规范 3.52
+enum Op : uint32_t {
+    OpName = 5,
+    OpEntryPoint = 15,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpSpecConstant = 50,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpTypeAccelerationStructureKHR = 5341,
+};
+
+enum Decoration : uint32_t {
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationRowMajor = 4,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+    StorageUniformConstant = 0,
+    StorageUniform = 2,
+    StoragePushConstant = 9,
+    StorageStorageBuffer = 12,
+};
+
+enum Dim : uint32_t {
+    DimBuffer = 5,
+    DimSubpassData = 6,
+};
+
+constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+struct Member {
+    uint32_t offset = kNone;
+    uint32_t matrixStride = 0;
+    bool rowMajor = false;
+};
+
+// 每个 id 一份, 只记录反射需要的字段
+struct Id {
+    uint32_t op = 0;
+    std::vector<uint32_t> operands; // 去掉 result id 之后的操作数
+    std::string name;
+    uint32_t set = kNone;
+    uint32_t binding = kNone;
+    uint32_t arrayStride = 0;
+    bool block = false;
+    bool bufferBlock = false;
+    std::vector<Member> members;
+};
+
+vk::ShaderStageFlags StageOf(uint32_t executionModel) {
+    switch (executionModel) {
+    case 0: return vk::ShaderStageFlagBits::eVertex;
+    case 1: return vk::ShaderStageFlagBits::eTessellationControl;
+    case 2: return vk::ShaderStageFlagBits::eTessellationEvaluation;
+    case 3: return vk::ShaderStageFlagBits::eGeometry;
+    case 4: return vk::ShaderStageFlagBits::eFragment;
+    case 5: return vk::ShaderStageFlagBits::eCompute;
+    default: return {};
+    }
+}
+
+class Parser {
+public:
+    Parser(const uint32_t* words, size_t wordCount) {
+        if (wordCount < kHeaderWords || words[0] != kMagic) {
+            throw std::runtime_error("SPIR-V: bad header");
+        }
+        m_ids.resize(words[3]); // id 上界
+        for (size_t pos = kHeaderWords; pos < wordCount;) {
+            uint32_t count = words[pos] >> 16;
+            uint32_t op = words[pos] & 0xffff;
+            if (count == 0 || pos + count > wordCount) {
+                throw std::runtime_error("SPIR-V: truncated instruction");
+            }
+            instruction(op, words + pos + 1, count - 1);
+            pos += count;
+        }
+    }
+
+    ShaderReflection Reflect() {
+        ShaderReflection result;
+        result.stages = m_stages;
+        for (uint32_t variable : m_variables) {
+            const Id& var = m_ids[variable];
+            uint32_t storage = var.operands[1];
+            const Id& pointer = get(var.operands[0]);
+            if (pointer.op != OpTypePointer) {
+                throw std::runtime_error("SPIR-V: variable is not a pointer");
+            }
+            uint32_t typeId = pointer.operands[1];
+
+            if (storage == StoragePushConstant) {
+                const Id& block = get(typeId);
+                uint32_t begin = kNone;
+                for (const auto& member : block.members) {
+                    begin = std::min(begin, member.offset);
+                }
+                uint32_t end = sizeOf(typeId);
+                if (begin == kNone || end <= begin) {
+                    continue;
+                }
+                result.pushConstants.emplace_back(m_stages, begin, end - begin);
+                continue;
+            }
+            if (storage != StorageUniformConstant && storage != StorageUniform && storage != StorageStorageBuffer) {
+                continue;
+            }
+            if (var.set == kNone || var.binding == kNone) {
+                continue;
+            }
+
+            ReflectedBinding binding{ var.set, var.binding, vk::DescriptorType::eSampler, 1, m_stages, var.name };
+            // 外层的数组决定 descriptor 个数
+            const Id* type = &get(typeId);
+            while (type->op == OpTypeArray || type->op == OpTypeRuntimeArray) {
+                binding.count = type->op == OpTypeRuntimeArray ? 0 : binding.count * constant(type->operands[1]);
+                type = &get(type->operands[0]);
+            }
+            binding.type = descriptorType(*type, storage);
+            if (binding.name.empty()) {
+                binding.name = type->name; // 块变量常常没有名字, 用块类型名
+            }
+            result.bindings.push_back(std::move(binding));
+        }
+
+        std::sort(result.bindings.begin(), result.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        return result;
+    }
+
+private:
+    std::vector<Id> m_ids;
+    std::vector<uint32_t> m_variables;
+    vk::ShaderStageFlags m_stages;
+
+    Id& get(uint32_t id) {
+        if (id >= m_ids.size()) {
+            throw std::runtime_error("SPIR-V: id out of bound");
+        }
+        return m_ids[id];
+    }
+
+    static std::string literalString(const uint32_t* words, uint32_t count) {
+        const char* begin = reinterpret_cast<const char*>(words);
+        const char* end = begin + count * sizeof(uint32_t);
+        return std::string(begin, std::find(begin, end, '\0'));
+    }
+
+    Member& member(uint32_t structId, uint32_t index) {
+        auto& members = get(structId).members;
+        if (index >= members.size()) {
+            members.resize(index + 1);
+        }
+        return members[index];
+    }
+
+    void instruction(uint32_t op, const uint32_t* operands, uint32_t count) {
+        switch (op) {
+        case OpName:
+            if (count >= 1) {
+                get(operands[0]).name = literalString(operands + 1, count - 1);
+            }
+            break;
+        case OpEntryPoint:
+            if (count >= 1) {
+                m_stages |= StageOf(operands[0]);
+            }
+            break;
+        case OpDecorate:
+            if (count >= 2) {
+                Id& target = get(operands[0]);
+                uint32_t value = count >= 3 ? operands[2] : 0;
+                switch (operands[1]) {
+                case DecorationBlock: target.block = true; break;
+                case DecorationBufferBlock: target.bufferBlock = true; break;
+                case DecorationArrayStride: target.arrayStride = value; break;
+                case DecorationBinding: target.binding = value; break;
+                case DecorationDescriptorSet: target.set = value; break;
+                default: break;
+                }
+            }
+            break;
+        case OpMemberDecorate:
+            if (count >= 3) {
+                uint32_t value = count >= 4 ? operands[3] : 0;
+                switch (operands[2]) {
+                case DecorationOffset: member(operands[0], operands[1]).offset = value; break;
+                case DecorationMatrixStride: member(operands[0], operands[1]).matrixStride = value; break;
+                case DecorationRowMajor: member(operands[0], operands[1]).rowMajor = true; break;
+                default: break;
+                }
+            }
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+        case OpTypeAccelerationStructureKHR:
+            if (count >= 1) {
+                Id& id = get(operands[0]);
+                id.op = op;
+                id.operands.assign(operands + 1, operands + count);
+            }
+            break;
+        case OpConstant:
+        case OpSpecConstant:
+        case OpVariable:
+            // result type, result id 的顺序与类型指令相反
+            if (count >= 2) {
+                Id& id = get(operands[1]);
+                id.op = op;
+                id.operands.assign(operands, operands + count);
+                id.operands.erase(id.operands.begin() + 1);
+                if (op == OpVariable) {
+                    if (id.operands.size() < 2) {
+                        throw std::runtime_error("SPIR-V: bad OpVariable");
+                    }
+                    m_variables.push_back(operands[1]);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint32_t constant(uint32_t id) {
+        const Id& c = get(id);
+        if ((c.op != OpConstant && c.op != OpSpecConstant) || c.operands.size() < 2) {
+            throw std::runtime_error("SPIR-V: array length is not a constant");
+        }
+        return c.operands[1]; // 只取低 32 位
+    }
+
+    vk::DescriptorType descriptorType(const Id& type, uint32_t storage) {
+        switch (type.op) {
+        case OpTypeSampler:
+            return vk::DescriptorType::eSampler;
+        case OpTypeSampledImage: {
+            const Id& image = get(type.operands[0]);
+            return image.operands.size() > 1 && image.operands[1] == DimBuffer ? vk::DescriptorType::eUniformTexelBuffer
+                                                                                : vk::DescriptorType::eCombinedImageSampler;
+        }
+        case OpTypeImage: {
+            // operands: sampled type, dim, depth, arrayed, ms, sampled (1 采样 / 2 存储), format
+            if (type.operands.size() < 6) {
+                throw std::runtime_error("SPIR-V: bad OpTypeImage");
+            }
+            uint32_t dim = type.operands[1];
+            bool storageImage = type.operands[5] == 2;
+            if (dim == DimBuffer) {
+                return storageImage ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+            }
+            if (dim == DimSubpassData) {
+                return vk::DescriptorType::eInputAttachment;
+            }
+            return storageImage ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+        case OpTypeAccelerationStructureKHR:
+            return vk::DescriptorType::eAccelerationStructureKHR;
+        case OpTypeStruct:
+            // SPIR-V 1.3 之前的 storage buffer 是 Uniform + BufferBlock
+            if (storage == StorageStorageBuffer || type.bufferBlock) {
+                return vk::DescriptorType::eStorageBuffer;
+            }
+            return vk::DescriptorType::eUniformBuffer;
+        default:
+            throw std::runtime_error("SPIR-V: unsupported resource type for " + type.name);
+        }
+    }
+
+    // 按 Offset/ArrayStride/MatrixStride 装饰计算的字节数, 用于 push constant 块
+    uint32_t sizeOf(uint32_t typeId, const Member* decoration = nullptr) {
+        const Id& type = get(typeId);
+        switch (type.op) {
+        case OpTypeInt:
+        case OpTypeFloat:
+            return type.operands[0] / 8;
+        case OpTypeVector:
+            return sizeOf(type.operands[0]) * type.operands[1];
+        case OpTypeMatrix: {
+            uint32_t columns = type.operands[1];
+            const Id& column = get(type.operands[0]);
+            uint32_t rows = column.operands.size() > 1 ? column.operands[1] : 1;
+            if (decoration && decoration->matrixStride) {
+                return decoration->matrixStride * (decoration->rowMajor ? rows : columns);
+            }
+            return sizeOf(type.operands[0]) * columns;
+        }
+        case OpTypeArray: {
+            uint32_t length = constant(type.operands[1]);
+            uint32_t stride = type.arrayStride ? type.arrayStride : sizeOf(type.operands[0], decoration);
+            return stride * length;
+        }
+        case OpTypeStruct: {
+            uint32_t size = 0;
+            for (size_t i = 0; i < type.operands.size(); i++) {
+                const Member* m = i < type.members.size() ? &type.members[i] : nullptr;
+                uint32_t offset = m && m->offset != kNone ? m->offset : size;
+                size = std::max(size, offset + sizeOf(type.operands[i], m));
+            }
+            return size;
+        }
+        default:
+            return 0; // 运行时数组等, push constant 里不会出现
+        }
+    }
+};
+
+}
+
+ShaderReflection ReflectSpirv(const uint32_t* words, size_t wordCount) {
+    return Parser(words, wordCount).Reflect();
+}
+
+void ShaderReflection::Merge(const ShaderReflection& other) {
+    stages |= other.stages;
+    for (const auto& binding : other.bindings) {
+        auto it = std::find_if(bindings.begin(), bindings.end(), [&](const ReflectedBinding& b) {
+            return b.set == binding.set && b.binding == binding.binding;
+        });
+        if (it == bindings.end()) {
+            bindings.push_back(binding);
+            continue;
+        }
+        if (it->type != binding.type) {
+            throw std::runtime_error("shader stages disagree on set " + std::to_string(binding.set) + " binding " +
+                                     std::to_string(binding.binding) + ": " + vk::to_string(it->type) + " vs " +
+                                     vk::to_string(binding.type));
+        }
+        it->stages |= binding.stages;
+        // 运行时数组 (0) 与定长数组合并时保持运行时数组
+        it->count = it->count == 0 || binding.count == 0 ? 0 : std::max(it->count, binding.count);
+    }
+    std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    for (const auto& range : other.pushConstants) {
+        auto it = std::find_if(pushConstants.begin(), pushConstants.end(), [&](const vk::PushConstantRange& r) {
+            return r.offset == range.offset && r.size == range.size;
+        });
+        if (it != pushConstants.end()) {
+            it->stageFlags |= range.stageFlags;
+        }
+        else {
+            pushConstants.push_back(range);
+        }
+    }
+}
+
+uint32_t ShaderReflection::GetSetCount() const {
+    return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+std::vector<vk::DescriptorSetLayoutBinding> ShaderReflection::GetSetLayoutBindings(uint32_t set) const {
+    std::vector<vk::DescriptorSetLayoutBinding> result;
+    for (const auto& binding : bindings) {
+        if (binding.set == set) {
+            result.emplace_back(binding.binding, binding.type, binding.count, binding.stages);
+        }
+    }
+    return result;
+}
+
+vk::PushConstantRange ShaderReflection::GetPushConstantRange() const {
+    if (pushConstants.empty()) {
+        return {};
+    }
+    uint32_t begin = std::numeric_limits<uint32_t>::max();
+    uint32_t end = 0;
+    vk::ShaderStageFlags flags;
+    for (const auto& range : pushConstants) {
+        begin = std::min(begin, range.offset);
+        end = std::max(end, range.offset + range.size);
+        flags |= range.stageFlags;
+    }
+    return vk::PushConstantRange(flags, begin, end - begin);
+}
+
+}
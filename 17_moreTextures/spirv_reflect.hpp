@@ -0,0 +1,47 @@
+#ifndef __SPIRV_REFLECT_H__
+#define __SPIRV_REFLECT_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace toy2d {
+
+struct ReflectedBinding {
+    uint32_t set;
+    uint32_t binding;
+    vk::DescriptorType type; // uniform buffer 一律报告为 eUniformBuffer, 是否 dynamic 由使用方决定
+    uint32_t count;          // 数组元素个数, 运行时数组 (bindless) 为 0
+    vk::ShaderStageFlags stages;
+    std::string name;        // 调试用, 没有 OpName 时为空
+};
+
+/**
+ * @brief 从 SPIR-V 中读出的资源接口
+ * 只看声明, 不分析是否真的被使用; 不支持 immutable sampler 与 specialization constant 决定的数组大小
+ */
+struct ShaderReflection {
+    vk::ShaderStageFlags stages;
+    std::vector<ReflectedBinding> bindings; // 按 (set, binding) 排序
+    std::vector<vk::PushConstantRange> pushConstants;
+
+    // 合并另一个阶段: 相同 (set, binding) 的类型必须一致 (否则抛出 std::runtime_error), 阶段取并集
+    void Merge(const ShaderReflection& other);
+    // 最大的 set 编号 + 1, 中间没有绑定的 set 也算在内
+    uint32_t GetSetCount() const;
+    std::vector<vk::DescriptorSetLayoutBinding> GetSetLayoutBindings(uint32_t set) const;
+    // 覆盖所有阶段 push constant 的一个范围, 没有时 size 为 0
+    vk::PushConstantRange GetPushConstantRange() const;
+};
+
+// 直接解析 SPIR-V 字 (4 字节对齐的字节码), 格式不对时抛出 std::runtime_error
+ShaderReflection ReflectSpirv(const uint32_t* words, size_t wordCount);
+inline ShaderReflection ReflectSpirv(std::string_view code) {
+    return ReflectSpirv(reinterpret_cast<const uint32_t*>(code.data()), code.size() / sizeof(uint32_t));
+}
+
+}
+
+#endif // __SPIRV_REFLECT_H__
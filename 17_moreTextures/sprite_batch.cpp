@@ -0,0 +1,211 @@
+#include "sprite_batch.hpp"
+#include "texture2d.hpp"
+#include "context.h"
+#include "bindless_table.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace toy2d {
+
+static_assert(BindlessTextureTable::MaxTextures <= 0xFFFF, "texture index is stored as 16 bits in SpriteInstance");
+
+static uint16_t packUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+static uint32_t packUnorm8(float value) {
+    return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+SpriteInstance SpriteInstance::Create(const Rect& rect, const Rect& uvRect, const Color& tint, float alpha,
+                                      float rotation, uint32_t textureIndex) {
+    constexpr float TwoPi = 6.28318530718f;
+
+    SpriteInstance instance;
+    instance.position = rect.position;
+    instance.size = rect.size;
+    instance.uvRect[0] = packUnorm16(uvRect.position.x);
+    instance.uvRect[1] = packUnorm16(uvRect.position.y);
+    instance.uvRect[2] = packUnorm16(uvRect.size.w);
+    instance.uvRect[3] = packUnorm16(uvRect.size.h);
+    instance.tint = packUnorm8(tint.r) | (packUnorm8(tint.g) << 8) | (packUnorm8(tint.b) << 16) | (packUnorm8(alpha) << 24);
+    // 角度按整圈取模, 负角度也会落到 [0, 65536)
+    float turns = rotation / TwoPi;
+    turns -= std::floor(turns);
+    instance.rotation = static_cast<uint16_t>(static_cast<uint32_t>(std::lround(turns * 65536.0f)) & 0xFFFF);
+    // 未开启 bindless 或表已满时下标为 InvalidIndex, 这样的批次不走 bindless, 截断后着色器也不会用到
+    instance.textureIndex = static_cast<uint16_t>(textureIndex);
+    return instance;
+}
+
+std::vector<vk::VertexInputAttributeDescription> SpriteInstance::GetAttributeDescription() {
+    std::vector<vk::VertexInputAttributeDescription> descriptions(5);
+    descriptions[0].setBinding(1)
+        .setFormat(vk::Format::eR32G32Sfloat)
+        .setLocation(2)
+        .setOffset(offsetof(SpriteInstance, position));
+    descriptions[1].setBinding(1)
+        .setFormat(vk::Format::eR32G32Sfloat)
+        .setLocation(3)
+        .setOffset(offsetof(SpriteInstance, size));
+    descriptions[2].setBinding(1)
+        .setFormat(vk::Format::eR16G16B16A16Unorm)
+        .setLocation(4)
+        .setOffset(offsetof(SpriteInstance, uvRect));
+    descriptions[3].setBinding(1)
+        .setFormat(vk::Format::eR8G8B8A8Unorm)
+        .setLocation(5)
+        .setOffset(offsetof(SpriteInstance, tint));
+    // rotation 与 textureIndex 相邻, 合成一个 uvec2 属性
+    descriptions[4].setBinding(1)
+        .setFormat(vk::Format::eR16G16Uint)
+        .setLocation(6)
+        .setOffset(offsetof(SpriteInstance, rotation));
+    return descriptions;
+}
+
+vk::VertexInputBindingDescription SpriteInstance::GetBindingDescription() {
+    vk::VertexInputBindingDescription description;
+    description.setBinding(1)
+               .setStride(sizeof(SpriteInstance))
+               .setInputRate(vk::VertexInputRate::eInstance);
+    return description;
+}
+
+SpriteBatch::SpriteBatch(FrameRingBuffer& ring) : m_ring(ring) {
+}
+
+SpriteBatch::~SpriteBatch() {
+}
+
+void SpriteBatch::Begin() {
+    Clear();
+}
+
+void SpriteBatch::Clear() {
+    m_instances.clear();
+    m_textures.clear();
+    m_unindexedCount = 0;
+}
+
+void SpriteBatch::Push(Texture& texture, const SpriteInstance& instance) {
+    m_instances.push_back(instance);
+    m_textures.push_back(&texture);
+    if (texture.m_bindlessIndex == BindlessTextureTable::InvalidIndex) {
+        m_unindexedCount++;
+    }
+}
+
+FrameRingBuffer::Allocation SpriteBatch::AllocateInstances(vk::DeviceSize alignment) {
+    return m_ring.Allocate(m_instances.size() * sizeof(SpriteInstance), alignment);
+}
+
+uint32_t SpriteBatch::Flush(vk::CommandBuffer cmd, vk::PipelineLayout layout) {
+    if (Empty()) {
+        return 0;
+    }
+
+    uint32_t drawCalls = RecordRange(cmd, layout, AllocateInstances(), 0, Size());
+    Clear();
+    return drawCalls;
+}
+
+uint32_t SpriteBatch::FlushBindless(vk::CommandBuffer cmd, vk::PipelineLayout layout, vk::DescriptorSet tableSet) {
+    if (Empty()) {
+        return 0;
+    }
+
+    uint32_t drawCalls = RecordRangeBindless(cmd, layout, tableSet, AllocateInstances(), 0, Size());
+    Clear();
+    return drawCalls;
+}
+
+uint32_t SpriteBatch::RecordRange(vk::CommandBuffer cmd, vk::PipelineLayout layout,
+                                  const FrameRingBuffer::Allocation& instances, size_t begin, size_t end) {
+    if (begin >= end) {
+        return 0;
+    }
+
+    auto groups = WriteGrouped(instances, begin, end);
+
+    // 绑定整批的起点, firstInstance 使用整批中的下标
+    cmd.bindVertexBuffers(1, instances.buffer, instances.offset);
+
+    size_t first = begin;
+    for (const auto& group : groups) {
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, group.texture->m_setInfo.set, {});
+        cmd.drawIndexed(6, static_cast<uint32_t>(group.count), 0, 0, static_cast<uint32_t>(first));
+        first += group.count;
+    }
+
+    return static_cast<uint32_t>(groups.size());
+}
+
+std::vector<SpriteBatch::Group> SpriteBatch::WriteGrouped(const FrameRingBuffer::Allocation& instances,
+                                                          size_t begin, size_t end) {
+    // 按纹理首次出现的顺序分组, 同一纹理的精灵保持提交顺序, 不同纹理之间的前后关系会被打乱;
+    // 只在纹理切换时查表, 连续同纹理的精灵不需要哈希
+    std::vector<Group> groups;
+    std::unordered_map<Texture*, size_t> lookup;
+    bool grouped = true; // 每种纹理只出现一段时不需要重排
+    size_t current = 0;
+    for (size_t i = begin; i < end; i++) {
+        Texture* texture = m_textures[i];
+        if (i == begin || texture != m_textures[i - 1]) {
+            auto result = lookup.emplace(texture, groups.size());
+            if (result.second) {
+                groups.push_back({ texture, 0 });
+            }
+            else {
+                grouped = false;
+            }
+            current = result.first->second;
+        }
+        groups[current].count++;
+    }
+
+    auto* dst = static_cast<SpriteInstance*>(instances.data);
+    if (grouped) {
+        memcpy(dst + begin, m_instances.data() + begin, (end - begin) * sizeof(SpriteInstance));
+    }
+    else {
+        // 计数排序: 先算每组的起点, 再一趟把实例散列到各自的位置
+        std::vector<size_t> offsets(groups.size());
+        size_t offset = begin;
+        for (size_t g = 0; g < groups.size(); g++) {
+            offsets[g] = offset;
+            offset += groups[g].count;
+        }
+        for (size_t i = begin; i < end; i++) {
+            if (i == begin || m_textures[i] != m_textures[i - 1]) {
+                current = lookup[m_textures[i]];
+            }
+            dst[offsets[current]++] = m_instances[i];
+        }
+    }
+    return groups;
+}
+
+void SpriteBatch::WriteInOrder(const FrameRingBuffer::Allocation& instances, size_t begin, size_t end) {
+    auto* dst = static_cast<SpriteInstance*>(instances.data);
+    memcpy(dst + begin, m_instances.data() + begin, (end - begin) * sizeof(SpriteInstance));
+}
+
+uint32_t SpriteBatch::RecordRangeBindless(vk::CommandBuffer cmd, vk::PipelineLayout layout, vk::DescriptorSet tableSet,
+                                          const FrameRingBuffer::Allocation& instances, size_t begin, size_t end) {
+    if (begin >= end) {
+        return 0;
+    }
+
+    // 提交顺序即绘制顺序, 混合结果与逐个绘制一致, 整段一次拷贝
+    WriteInOrder(instances, begin, end);
+    cmd.bindVertexBuffers(1, instances.buffer, instances.offset);
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, tableSet, {});
+    cmd.drawIndexed(6, static_cast<uint32_t>(end - begin), 0, 0, static_cast<uint32_t>(begin));
+    return 1;
+}
+
+}
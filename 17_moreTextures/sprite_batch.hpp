@@ -0,0 +1,84 @@
+#ifndef __SPRITE_BATCH_H__
+#define __SPRITE_BATCH_H__
+
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "frame_ring_buffer.hpp"
+#include "math/math.hpp"
+
+namespace toy2d {
+    class Texture;
+
+    // 单个精灵的实例数据, 以 instance 速率喂给顶点着色器 (binding 1)
+    // 压缩为 32 字节: 位置与大小保留 float, 其余分量用归一化整数, 由顶点输入格式在 GPU 上解码
+    struct SpriteInstance final {
+        Vec position;          // 中心点
+        Size size;
+        uint16_t uvRect[4];    // x, y, w, h, unorm16, 只能表示 [0, 1] 内的子矩形
+        uint32_t tint;         // RGBA8 unorm, r 在最低字节
+        uint16_t rotation;     // 绕中心旋转的角度, 一整圈为 65536
+        uint16_t textureIndex; // 全局纹理表中的下标, 仅 bindless 模式使用
+
+        // rotation 为弧度, tint 分量会被截断到 [0, 1]
+        static SpriteInstance Create(const Rect& rect, const Rect& uvRect, const Color& tint, float alpha,
+                                     float rotation, uint32_t textureIndex);
+
+        static std::vector<vk::VertexInputAttributeDescription> GetAttributeDescription();
+        static vk::VertexInputBindingDescription GetBindingDescription();
+    };
+    static_assert(sizeof(SpriteInstance) == 32, "SpriteInstance layout must match the sprite vertex shaders");
+
+    /**
+     * @brief 收集 StartRender/EndRender 之间的精灵, 按纹理合并为实例化绘制
+     *
+     */
+    class SpriteBatch final {
+    public:
+        SpriteBatch(FrameRingBuffer& ring);
+        ~SpriteBatch();
+
+        void Begin();
+        void Push(Texture& texture, const SpriteInstance& instance);
+        // 把累积的精灵写入 ring buffer 的当前帧段, 每种纹理一次 drawIndexed;
+        // 纹理已经成组提交时整段一次 memcpy, 否则按纹理首次出现的顺序分组写入
+        // 调用前需要绑定好 pipeline, binding 0 的顶点/索引 buffer 以及 set 0, 返回发出的 draw 数
+        uint32_t Flush(vk::CommandBuffer cmd, vk::PipelineLayout layout);
+        // bindless 模式: 纹理由实例中的下标选择, 不排序, 整批只需一次 draw
+        uint32_t FlushBindless(vk::CommandBuffer cmd, vk::PipelineLayout layout, vk::DescriptorSet tableSet);
+
+        // 并行录制: 先在主线程为整批分配实例空间, 再由各线程录制互不重叠的 [begin, end) 区间,
+        // 区间内的排序与实例拷贝都在调用线程上完成, 全部录完后调用 Clear
+        // alignment 用于把整批作为 storage buffer 绑定时满足 minStorageBufferOffsetAlignment
+        FrameRingBuffer::Allocation AllocateInstances(vk::DeviceSize alignment = alignof(SpriteInstance));
+        uint32_t RecordRange(vk::CommandBuffer cmd, vk::PipelineLayout layout,
+                             const FrameRingBuffer::Allocation& instances, size_t begin, size_t end);
+        uint32_t RecordRangeBindless(vk::CommandBuffer cmd, vk::PipelineLayout layout, vk::DescriptorSet tableSet,
+                                     const FrameRingBuffer::Allocation& instances, size_t begin, size_t end);
+        void Clear();
+
+        struct Group {
+            Texture* texture;
+            size_t count;
+        };
+        // 只写实例不录制命令: 把 [begin, end) 按纹理分组写入 instances, 返回与写入顺序一致的各组;
+        // GPU 剔除模式在此之后由计算着色器生成绘制命令
+        std::vector<Group> WriteGrouped(const FrameRingBuffer::Allocation& instances, size_t begin, size_t end);
+        // bindless 模式按提交顺序原样写入
+        void WriteInOrder(const FrameRingBuffer::Allocation& instances, size_t begin, size_t end);
+
+        bool Empty() const { return m_instances.empty(); }
+        // 所有纹理都在全局纹理表里时才能走 bindless, 否则整批退回按纹理绑定 set
+        bool IsBindlessReady() const { return m_unindexedCount == 0; }
+        size_t Size() const { return m_instances.size(); }
+
+    private:
+        FrameRingBuffer& m_ring; // 实例数据直接写进持久映射的顶点 ring buffer
+        // 实例与纹理分开存放, 实例数组可以原样拷进 ring buffer
+        std::vector<SpriteInstance> m_instances;
+        std::vector<Texture*> m_textures;
+        size_t m_unindexedCount = 0; // 没有 bindless 下标的精灵数
+    };
+}
+
+#endif // __SPRITE_BATCH_H__
@@ -0,0 +1,147 @@
+#include "sprite_culler.hpp"
+#include "sprite_batch.hpp"
+#include "context.h"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace toy2d {
+
+namespace {
+
+// 与 sprite_cull.comp 的 push constant 一致
+struct CullParams {
+    float viewBounds[4];
+    uint32_t spriteCount;
+    uint32_t groupCount;
+};
+
+constexpr uint32_t kLocalSize = 64;
+
+}
+
+SpriteCuller::SpriteCuller(int maxFlightCount)
+    : m_frames(maxFlightCount), m_curFrame(0), m_lastVisible(-1)
+{
+}
+
+void SpriteCuller::BeginFrame(int frame)
+{
+    m_curFrame = frame;
+    auto& res = m_frames[frame];
+    if (res.groupCount == 0) {
+        m_lastVisible = -1;
+        return;
+    }
+
+    auto* commands = static_cast<const vk::DrawIndexedIndirectCommand*>(res.commands->m_map);
+    m_lastVisible = 0;
+    for (uint32_t i = 0; i < res.groupCount; i++) {
+        m_lastVisible += commands[i].instanceCount;
+    }
+}
+
+void SpriteCuller::reserve(FrameResource& frame, uint32_t instanceCount, uint32_t groupCount)
+{
+    // 只增不减, 该槽位上一次的提交已经完成, 可以直接替换
+    if (instanceCount > frame.instanceCapacity) {
+        uint32_t capacity = std::max(instanceCount, frame.instanceCapacity * 2);
+        frame.instances.reset(new Buffer(capacity * sizeof(SpriteInstance),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal));
+        frame.instanceCapacity = capacity;
+    }
+    if (groupCount > frame.groupCapacity) {
+        uint32_t capacity = std::max(groupCount, frame.groupCapacity * 2);
+        auto usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+        auto property = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        frame.commands.reset(new Buffer(capacity * sizeof(vk::DrawIndexedIndirectCommand), usage, property));
+        frame.counts.reset(new Buffer(capacity * sizeof(uint32_t), usage, property));
+        frame.groupCapacity = capacity;
+    }
+}
+
+void SpriteCuller::Prepare(const FrameRingBuffer::Allocation& instances, const std::vector<uint32_t>& groupSizes,
+                           const Rect& viewBounds)
+{
+    TOY2D_PROFILE_FUNCTION();
+    auto& ctx = Context::GetInstance();
+    auto& res = m_frames[m_curFrame];
+
+    uint32_t spriteCount = 0;
+    for (auto size : groupSizes) {
+        spriteCount += size;
+    }
+    auto groupCount = static_cast<uint32_t>(groupSizes.size());
+    reserve(res, spriteCount, groupCount);
+    res.groupCount = groupCount;
+
+    // instanceCount 与 draw count 清零, 由着色器累加
+    auto* commands = static_cast<vk::DrawIndexedIndirectCommand*>(res.commands->m_map);
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < groupCount; i++) {
+        commands[i] = vk::DrawIndexedIndirectCommand(6, 0, 0, 0, first);
+        first += groupSizes[i];
+    }
+    memset(res.counts->m_map, 0, groupCount * sizeof(uint32_t));
+
+    // 输入来自 ring buffer, 每帧的偏移都不同; 每次剔除用一个新的帧内 set, 同一帧可以剔除多次
+    auto set = DescriptorSetManager::GetInstance().AllocFrameSet(ctx.m_cullShader->GetDescriptorSetLayout());
+    std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+        vk::DescriptorBufferInfo(instances.buffer, instances.offset, spriteCount * sizeof(SpriteInstance)),
+        vk::DescriptorBufferInfo(res.instances->m_buffer, 0, spriteCount * sizeof(SpriteInstance)),
+        vk::DescriptorBufferInfo(res.commands->m_buffer, 0, groupCount * sizeof(vk::DrawIndexedIndirectCommand)),
+        vk::DescriptorBufferInfo(res.counts->m_buffer, 0, groupCount * sizeof(uint32_t)),
+    };
+    std::array<vk::WriteDescriptorSet, 4> writes;
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i].setDstSet(set)
+            .setDstBinding(i)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(bufferInfos[i]);
+    }
+    ctx.GetDevice().updateDescriptorSets(writes, {});
+
+    res.set = set;
+    res.spriteCount = spriteCount;
+    res.viewBounds = viewBounds;
+}
+
+void SpriteCuller::Dispatch(vk::CommandBuffer cmd)
+{
+    auto& ctx = Context::GetInstance();
+    auto& res = m_frames[m_curFrame];
+    const auto& bounds = res.viewBounds;
+
+    CullParams params = {
+        { bounds.position.x, bounds.position.y, bounds.position.x + bounds.size.w, bounds.position.y + bounds.size.h },
+        res.spriteCount,
+        res.groupCount,
+    };
+    auto layout = ctx.m_renderProcess->m_cullLayout;
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, ctx.m_renderProcess->GetCullPipeline());
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, res.set, {});
+    cmd.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+    cmd.dispatch((res.spriteCount + kLocalSize - 1) / kLocalSize, 1, 1);
+}
+
+void SpriteCuller::BindInstances(vk::CommandBuffer cmd)
+{
+    vk::DeviceSize offset = 0;
+    cmd.bindVertexBuffers(1, m_frames[m_curFrame].instances->m_buffer, offset);
+}
+
+void SpriteCuller::DrawGroup(vk::CommandBuffer cmd, uint32_t group)
+{
+    auto& res = m_frames[m_curFrame];
+    vk::DeviceSize offset = group * sizeof(vk::DrawIndexedIndirectCommand);
+    if (Context::GetInstance().IsDrawIndirectCountSupported()) {
+        cmd.drawIndexedIndirectCount(res.commands->m_buffer, offset,
+            res.counts->m_buffer, group * sizeof(uint32_t), 1, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+    else {
+        cmd.drawIndexedIndirect(res.commands->m_buffer, offset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+}
+
+}
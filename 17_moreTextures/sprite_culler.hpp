@@ -0,0 +1,68 @@
+#ifndef __SPRITE_CULLER_H__
+#define __SPRITE_CULLER_H__
+
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "buffer.hpp"
+#include "frame_ring_buffer.hpp"
+#include "math/math.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 在 GPU 上剔除视口外的精灵并生成间接绘制命令
+ * 实例按纹理分组写入 ring buffer 后, 由计算着色器把可见实例压缩到每帧的输出 buffer,
+ * 同时累加每组 VkDrawIndexedIndirectCommand 的 instanceCount, CPU 不需要知道可见数量.
+ * 同一组内可见实例的先后由原子操作决定, 不保证与提交顺序一致
+ */
+class SpriteCuller final
+{
+public:
+    SpriteCuller(int maxFlightCount);
+
+    // 调用方需保证该帧上一次的提交已经完成, 会读回上一次的可见数量
+    void BeginFrame(int frame);
+    // 填写每组的间接命令与剔除用的 descriptor set, 输出 buffer 不够大时在这里重建;
+    // groupSizes 为 instances 中按顺序排列的每组实例数, viewBounds 为世界坐标下的可见矩形
+    void Prepare(const FrameRingBuffer::Allocation& instances, const std::vector<uint32_t>& groupSizes,
+                 const Rect& viewBounds);
+    // 在 render pass 之外录制剔除的 dispatch; 输出到间接绘制与顶点输入的屏障由调用方 (render graph) 负责
+    void Dispatch(vk::CommandBuffer cmd);
+    // 本帧 Prepare 之后的三个输出
+    vk::Buffer GetInstanceBuffer() const { return m_frames[m_curFrame].instances->m_buffer; }
+    vk::Buffer GetCommandBuffer() const { return m_frames[m_curFrame].commands->m_buffer; }
+    vk::Buffer GetCountBuffer() const { return m_frames[m_curFrame].counts->m_buffer; }
+    // 在 render pass 中录制: 把剔除后的实例绑定到 binding 1
+    void BindInstances(vk::CommandBuffer cmd);
+    // 第 group 组的间接绘制, 支持 drawIndirectCount 时被整组剔除的命令不会发出
+    void DrawGroup(vk::CommandBuffer cmd, uint32_t group);
+
+    // 当前槽位上一次提交中通过剔除的实例数, 该槽位还没有剔除过时为 -1
+    int64_t GetLastVisibleCount() const { return m_lastVisible; }
+
+private:
+    struct FrameResource {
+        std::unique_ptr<Buffer> instances; // 剔除后的实例, device local
+        std::unique_ptr<Buffer> commands;  // 每组一条间接命令, host visible, CPU 每帧重写
+        std::unique_ptr<Buffer> counts;    // 每组的 draw count (0 或 1)
+        uint32_t instanceCapacity = 0;
+        uint32_t groupCapacity = 0;
+        uint32_t groupCount = 0;
+
+        // Prepare 到 Dispatch 之间的参数
+        vk::DescriptorSet set;
+        uint32_t spriteCount = 0;
+        Rect viewBounds{};
+    };
+
+    void reserve(FrameResource& frame, uint32_t instanceCount, uint32_t groupCount);
+
+    std::vector<FrameResource> m_frames;
+    int m_curFrame;
+    int64_t m_lastVisible;
+};
+
+}
+
+#endif // __SPRITE_CULLER_H__
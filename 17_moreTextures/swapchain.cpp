@@ -4,7 +4,7 @@
 
 namespace toy2d{
 
-swapchain::swapchain(const int w, const int h)
+swapchain::swapchain(const int w, const int h, vk::SwapchainKHR oldSwapchain)
 {
     // 需要先查询一些信息，用于填充后面的 createInfo
     queryInfo(w, h);
@@ -19,7 +19,8 @@ swapchain::swapchain(const int w, const int h)
         .setImageFormat(m_swapchainInfo.format.format)
         .setImageExtent(m_swapchainInfo.imageExtent)
         .setMinImageCount(m_swapchainInfo.imageCount)
-        .setPresentMode(m_swapchainInfo.presentMode);
+        .setPresentMode(m_swapchainInfo.presentMode)
+        .setOldSwapchain(oldSwapchain);
 
     auto& queueFamilyIndices = Context::GetInstance().GetQueueFamilyIndices();
     if (queueFamilyIndices.grapghicsQueue.value() == queueFamilyIndices.presentQueue.value()) {
@@ -91,6 +92,13 @@ void swapchain::queryInfo(const int w, const int h)
     }
 }
 
+bool swapchain::IsSurfaceDrawable()
+{
+    auto& ctx = Context::GetInstance();
+    auto capabilities = ctx.GetPhyDevice().getSurfaceCapabilitiesKHR(ctx.GetSurface());
+    return capabilities.maxImageExtent.width > 0 && capabilities.maxImageExtent.height > 0;
+}
+
 void swapchain::getImages()
 {
    m_images = Context::GetInstance().GetDevice().getSwapchainImagesKHR(m_swapchain);
@@ -7,7 +7,8 @@ namespace toy2d{
 class swapchain
 {
 public:
-    swapchain(const int w, const int h);
+    // oldSwapchain 不为空时用于重建, 旧交换链上已获取的图像可以继续呈现完, 旧对象仍需由调用方销毁
+    swapchain(const int w, const int h, vk::SwapchainKHR oldSwapchain = nullptr);
     ~swapchain();
 
     struct SwapchainInfo {
@@ -19,6 +20,8 @@ public:
     } m_swapchainInfo;
 
     void createFramebuffers(const int w, const int h);
+    // surface 当前是否能创建交换链, 窗口最小化时尺寸为 0
+    static bool IsSurfaceDrawable();
 
     const auto& GetExtent() const { return m_swapchainInfo.imageExtent; }
     const auto& GetFormat() const { return m_swapchainInfo.format; }
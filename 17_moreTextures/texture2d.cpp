@@ -1,153 +1,197 @@
 ﻿#include "texture2d.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <memory>
+#include <iostream>
 
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "third_party/stb_image.h"
 
 #include "context.h"
+#include "profiler.hpp"
+#include "math/mipmap.hpp"
+#include "tools.hpp"
+#include "lz4.hpp"
 
 namespace toy2d {
     Texture::Texture(std::string_view filename) {
+        TOY2D_PROFILE_FUNCTION();
         int w, h, channel;
 
         // channel: 1-gray, 3-rgb, 4-rgba
         // STBI_rgb_alpha 可以指定转换成哪个通道数, 如果给 0 那就不做转换
         stbi_uc* pixels = stbi_load(filename.data(), &w, &h, &channel, STBI_rgb_alpha);
-        size_t size = w * h * 4;
 
         if (!pixels) {
             throw std::runtime_error("image load failed");
         }
 
-        // 把数据给到 cpu buffer 里面
-        std::unique_ptr<Buffer> buffer(new Buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible));
-        memcpy(buffer->m_map, pixels, size);
+        init(pixels, w, h);
+        stbi_image_free(pixels);
+    }
 
-        createImage(w, h);
-        allocMemory();
-        Context::GetInstance().GetDevice().bindImageMemory(m_image, m_memory, 0);
+    Texture::Texture(const void* rgba, uint32_t w, uint32_t h) {
+        TOY2D_PROFILE_FUNCTION();
+        init(rgba, w, h);
+    }
 
-        transitionImageLayoutFromUndefine2Dst();
-        transformData2Image(*buffer, w, h);
-        transitionImageLayoutFromDst2Optimal();
+    Texture::Texture(const Ktx2Image& image) {
+        TOY2D_PROFILE_FUNCTION();
+        initKtx2(image);
+    }
 
-        createImageView();
+    Texture::Texture() : m_image(nullptr), m_view(nullptr), m_setInfo{},
+        m_bindlessIndex(BindlessTextureTable::InvalidIndex), m_uploadValue(PendingUpload) {
+    }
 
-        stbi_image_free(pixels);
+    bool Texture::IsReady() const {
+        auto& uploadMgr = Context::GetInstance().m_uploadManager;
+        return m_uploadValue <= uploadMgr->GetAcquiredValue() && uploadMgr->IsComplete(m_uploadValue);
+    }
+
+    void Texture::init(const void* rgba, uint32_t w, uint32_t h) {
+        vk::DeviceSize size = static_cast<vk::DeviceSize>(w) * h * 4;
+        auto& uploadMgr = Context::GetInstance().m_uploadManager;
+
+        // 缩小绘制时从合适的 mip 层采样, 避免走样和纹理缓存抖动
+        m_mipLevels = TextureManager::Instance().IsGenerateMips() ? MipLevelCount(w, h) : 1;
+        bool blitMips = m_mipLevels > 1 && uploadMgr->CanBlitMips(vk::Format::eR8G8B8A8Srgb);
+
+        allocateImage(w, h, blitMips);
+
+        // 像素拷进暂存 buffer 后立即返回, 拷贝与 layout 转换在传输队列上异步完成
+        if (m_mipLevels > 1 && !blitMips) {
+            auto chain = BuildMipChainRGBA8(rgba, w, h, m_mipLevels);
+            m_uploadValue = uploadMgr->UploadImage(chain.data(), chain.size(), m_image, w, h, m_mipLevels, false);
+        }
+        else {
+            m_uploadValue = uploadMgr->UploadImage(rgba, size, m_image, w, h, m_mipLevels, blitMips);
+        }
+
+        initView();
+    }
+
+    void Texture::initKtx2(const Ktx2Image& image) {
+        auto& uploadMgr = Context::GetInstance().m_uploadManager;
+        auto info = GetTextureFormatInfo(image.format);
+        uint32_t w = image.width;
+        uint32_t h = image.height;
+        // 压缩格式没法在 GPU 上 blit 生成 mip, 文件里有几层就用几层
+        m_mipLevels = static_cast<uint32_t>(image.levels.size());
+
+        if (IsFormatSampleable(image.format)) {
+            m_format = image.format;
+            allocateImage(w, h, false);
+
+            // 各层在文件里不一定连续排列 (KTX2 里小的层在前), 暂存覆盖所有层的整段数据
+            const uint8_t* begin = image.levels[0].data;
+            const uint8_t* end = begin;
+            for (const auto& level : image.levels) {
+                begin = std::min(begin, level.data);
+                end = std::max(end, level.data + level.size);
+            }
+            std::vector<UploadManager::ImageLevel> regions;
+            for (uint32_t i = 0; i < m_mipLevels; i++) {
+                regions.push_back({ static_cast<vk::DeviceSize>(image.levels[i].data - begin),
+                                    std::max(w >> i, 1u), std::max(h >> i, 1u) });
+            }
+            m_uploadValue = uploadMgr->UploadImageLevels(begin, end - begin, m_image, regions);
+        }
+        else {
+            if (!info->decoder) {
+                throw std::runtime_error("texture format " + vk::to_string(image.format) +
+                    " is not supported by the device and has no CPU decoder");
+            }
+            // 逐层解码为 RGBA8, 保持原来的颜色空间
+            m_format = info->srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+            std::vector<uint8_t> pixels(MipChainSize(w, h, m_mipLevels));
+            size_t offset = 0;
+            for (uint32_t i = 0; i < m_mipLevels; i++) {
+                uint32_t levelW = std::max(w >> i, 1u);
+                uint32_t levelH = std::max(h >> i, 1u);
+                DecodeBlocks(*info->decoder, image.levels[i].data, levelW, levelH, pixels.data() + offset);
+                offset += static_cast<size_t>(levelW) * levelH * 4;
+            }
+            allocateImage(w, h, false);
+            m_uploadValue = uploadMgr->UploadImage(pixels.data(), pixels.size(), m_image, w, h, m_mipLevels, false);
+        }
+
+        initView();
+    }
+
+    void Texture::allocateImage(uint32_t w, uint32_t h, bool blitMips) {
+        createImage(w, h, blitMips);
+        m_allocation = Context::GetInstance().m_memoryAllocator->AllocateForImage(m_image,
+            vk::MemoryPropertyFlagBits::eDeviceLocal);
+        m_memorySize = Context::GetInstance().GetDevice().getImageMemoryRequirements(m_image).size;
+    }
+
+    void Texture::initView() {
+        createImageView();
 
         m_setInfo = DescriptorSetManager::GetInstance().AllocImageSet();
 
         updateDescriptorSet();
+
+        auto& table = Context::GetInstance().m_bindlessTable;
+        m_bindlessIndex = table ? table->Register(m_view, Context::GetInstance().m_renderer->GetSampler())
+                                : BindlessTextureTable::InvalidIndex;
     }
 
     Texture::~Texture()
     {
-        DescriptorSetManager::GetInstance().FreeImageSet(m_setInfo);
-
-        auto& device = Context::GetInstance().GetDevice();
-
-        device.destroyImageView(m_view);
-        device.freeMemory(m_memory);
-        device.destroyImage(m_image);
-    }
-
-    void Texture::transformData2Image(Buffer& buffer, uint32_t w, uint32_t h) {
-        Context::GetInstance().m_commandManager->ExecuteCmd(Context::GetInstance().m_graphicsQueue,
-            [&](vk::CommandBuffer cmdBuf) {
-            vk::BufferImageCopy region;
-            vk::ImageSubresourceLayers subsource;
-            subsource.setAspectMask(vk::ImageAspectFlagBits::eColor)
-                .setBaseArrayLayer(0)
-                .setMipLevel(0)
-                .setLayerCount(1);
-            region.setBufferImageHeight(0)
-                .setBufferOffset(0)
-                .setImageOffset(0)
-                .setImageExtent({ w, h, 1 })
-                .setBufferRowLength(0)
-                .setImageSubresource(subsource);
-            cmdBuf.copyBufferToImage(buffer.m_buffer, m_image,
-                vk::ImageLayout::eTransferDstOptimal,
-                region);
-        });
+        release();
     }
 
-    void Texture::transitionImageLayoutFromUndefine2Dst() {
-        Context::GetInstance().m_commandManager->ExecuteCmd(Context::GetInstance().m_graphicsQueue,
-            [&](vk::CommandBuffer cmdBuf) {
-            vk::ImageMemoryBarrier barrier;
-            vk::ImageSubresourceRange range;
-            range.setLayerCount(1)
-                .setBaseArrayLayer(0)
-                .setLevelCount(1)
-                .setBaseMipLevel(0)
-                .setAspectMask(vk::ImageAspectFlagBits::eColor);
-            barrier.setImage(m_image)
-                .setOldLayout(vk::ImageLayout::eUndefined)
-                .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-                .setDstAccessMask((vk::AccessFlagBits::eTransferWrite))
-                .setSubresourceRange(range);
-            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
-                {}, {}, nullptr, barrier);
-        });
-    }
+    void Texture::release() {
+        if (!m_image) {
+            return; // 异步加载还没完成或已经换出
+        }
+        // 最近的帧可能还在采样, 上传也可能还没完成: set, bindless 下标与句柄都推迟到它们结束后归还,
+        // 纹理对象本身可以立即销毁或重新加载
+        uint64_t uploadValue = m_uploadValue == PendingUpload ? 0 : m_uploadValue;
+        Context::GetInstance().DeferDestroy([view = m_view, image = m_image, allocation = m_allocation,
+                                             setInfo = m_setInfo, bindlessIndex = m_bindlessIndex]() mutable {
+            auto& ctx = Context::GetInstance();
+            DescriptorSetManager::GetInstance().FreeImageSet(setInfo);
+            if (auto& table = ctx.m_bindlessTable) {
+                table->Unregister(bindlessIndex);
+            }
+            ctx.GetDevice().destroyImageView(view);
+            ctx.GetDevice().destroyImage(image);
+            ctx.m_memoryAllocator->Free(allocation);
+        }, uploadValue);
 
-    void Texture::transitionImageLayoutFromDst2Optimal() {
-        Context::GetInstance().m_commandManager->ExecuteCmd(Context::GetInstance().m_graphicsQueue,
-            [&](vk::CommandBuffer cmdBuf) {
-            vk::ImageMemoryBarrier barrier;
-            vk::ImageSubresourceRange range;
-            range.setLayerCount(1)
-                .setBaseArrayLayer(0)
-                .setLevelCount(1)
-                .setBaseMipLevel(0)
-                .setAspectMask(vk::ImageAspectFlagBits::eColor);
-            barrier.setImage(m_image)
-                .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-                .setSrcAccessMask((vk::AccessFlagBits::eTransferWrite))
-                .setDstAccessMask((vk::AccessFlagBits::eShaderRead))
-                .setSubresourceRange(range);
-            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-                {}, {}, nullptr, barrier);
-        });
+        m_image = nullptr;
+        m_view = nullptr;
+        m_allocation = {};
+        m_setInfo = {};
+        m_bindlessIndex = BindlessTextureTable::InvalidIndex;
+        m_uploadValue = PendingUpload;
+        m_memorySize = 0;
     }
 
-    void Texture::createImage(uint32_t w, uint32_t h) {
+    void Texture::createImage(uint32_t w, uint32_t h, bool blitMips) {
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+        if (blitMips) {
+            usage |= vk::ImageUsageFlagBits::eTransferSrc; // 上一层作为 blit 源
+        }
         vk::ImageCreateInfo createInfo;
         createInfo.setImageType(vk::ImageType::e2D) // 2d 纹理
             .setArrayLayers(1) // 1 份图像
-            .setMipLevels(1) // 1 表示自己本身
+            .setMipLevels(m_mipLevels) // 1 表示自己本身
             .setExtent({ w, h, 1 }) // 宽度高度和深度, 3d纹理需要深度
-            .setFormat(vk::Format::eR8G8B8A8Srgb)
+            .setFormat(m_format)
             .setTiling(vk::ImageTiling::eOptimal)
             .setInitialLayout(vk::ImageLayout::eUndefined)
-            .setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled)
+            .setUsage(usage)
             .setSamples(vk::SampleCountFlagBits::e1);
         m_image = Context::GetInstance().GetDevice().createImage(createInfo);
     }
 
-    void Texture::allocMemory() {
-        auto& device = Context::GetInstance().GetDevice();
-        vk::MemoryAllocateInfo allocInfo;
-
-        auto requirements = device.getImageMemoryRequirements(m_image);
-        allocInfo.setAllocationSize(requirements.size);
-
-        auto index = Buffer::QueryBufferMemTypeIndex(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
-        allocInfo.setMemoryTypeIndex(index);
-
-        m_memory = device.allocateMemory(allocInfo);
-    }
-
     void Texture::createImageView() {
         vk::ImageViewCreateInfo createInfo;
         vk::ComponentMapping mapping;
@@ -155,12 +199,12 @@ namespace toy2d {
         range.setAspectMask(vk::ImageAspectFlagBits::eColor)
             .setBaseArrayLayer(0)
             .setLayerCount(1)
-            .setLevelCount(1)
+            .setLevelCount(m_mipLevels)
             .setBaseMipLevel(0);
         createInfo.setImage(m_image)
             .setViewType(vk::ImageViewType::e2D)
             .setComponents(mapping)
-            .setFormat(vk::Format::eR8G8B8A8Srgb)
+            .setFormat(m_format)
             .setSubresourceRange(range);
         m_view = Context::GetInstance().GetDevice().createImageView(createInfo);
     }
@@ -171,13 +215,334 @@ namespace toy2d {
             [&](const std::unique_ptr<Texture>& t) {
             return t.get() == texture;
         });
+        // 还在解码的纹理直接丢弃解码结果
+        pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+            [&](const PendingLoad& load) { return load.texture == texture; }), pending_.end());
         if (it != datas_.end()) {
-            Context::GetInstance().GetDevice().waitIdle();
+            // 句柄的销毁由删除队列推迟到引用它的帧与上传都结束之后, 这里不等待
             datas_.erase(it);
             return;
         }
     }
 
+    void TextureManager::Clear() {
+        pending_.clear();
+        datas_.clear();
+    }
+
+    Texture* TextureManager::LoadKtx2(const std::string& filename) {
+        TOY2D_PROFILE_FUNCTION();
+        std::string content = ReadWholeFile(filename);
+        if (content.empty()) {
+            throw std::runtime_error("KTX2: failed to read " + filename);
+        }
+        // 上传时各层已经拷进暂存 buffer, 文件内容在这之后就可以释放
+        auto image = ParseKtx2(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+        std::unique_ptr<Texture> ptr(new Texture(image));
+        return add(std::move(ptr), { Texture::SourceKind::Ktx2File, filename });
+    }
+
+    Texture* TextureManager::LoadFromPack(const AssetPack& pack, const std::string& name) {
+        TOY2D_PROFILE_FUNCTION();
+        const auto* entry = pack.Find(name);
+        if (!entry) {
+            throw std::runtime_error("asset pack: no entry " + name);
+        }
+        // LZ4 压缩的条目只能先解压到临时内存
+        std::vector<uint8_t> storage;
+        const uint8_t* data = pack.GetData(*entry);
+        if (entry->IsCompressed()) {
+            storage.resize(entry->rawSize);
+            pack.Read(*entry, storage.data());
+            data = storage.data();
+        }
+        size_t size = entry->rawSize;
+
+        std::unique_ptr<Texture> ptr;
+        if (IsKtx2(data, size)) {
+            ptr.reset(new Texture(ParseKtx2(data, size)));
+        }
+        else {
+            int w, h, channel;
+            stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &w, &h, &channel, STBI_rgb_alpha);
+            if (!pixels) {
+                throw std::runtime_error(name + ": " + stbi_failure_reason());
+            }
+            ptr.reset(new Texture(pixels, w, h));
+            stbi_image_free(pixels);
+        }
+        return add(std::move(ptr), { Texture::SourceKind::Pack, name, &pack });
+    }
+
+    Texture* TextureManager::LoadKtx2Variants(const std::vector<std::string>& candidates) {
+        const std::string* fallback = nullptr;
+        for (const auto& filename : candidates) {
+            vk::Format format = ReadKtx2Format(filename);
+            if (IsFormatSampleable(format)) {
+                return LoadKtx2(filename);
+            }
+            auto info = GetTextureFormatInfo(format);
+            if (!fallback && info && info->decoder) {
+                fallback = &filename;
+            }
+        }
+        if (!fallback) {
+            throw std::runtime_error("KTX2: none of the candidate formats can be used on this device");
+        }
+        return LoadKtx2(*fallback);
+    }
+
+    void TextureManager::RefreshSamplers() {
+        auto& ctx = Context::GetInstance();
+        for (auto& texture : datas_) {
+            if (!texture->m_image) {
+                continue;
+            }
+            // 飞行中的帧还绑着旧的 set 与下标, 不能原地改写: 写到新的里, 旧的等这些帧结束后归还
+            ctx.DeferDestroy([setInfo = texture->m_setInfo, bindlessIndex = texture->m_bindlessIndex]() {
+                DescriptorSetManager::GetInstance().FreeImageSet(setInfo);
+                if (auto& table = Context::GetInstance().m_bindlessTable) {
+                    table->Unregister(bindlessIndex);
+                }
+            });
+            texture->m_setInfo = DescriptorSetManager::GetInstance().AllocImageSet();
+            texture->updateDescriptorSet();
+            if (ctx.m_bindlessTable) {
+                // 表满时得到 InvalidIndex, 这张纹理之后按自己的 set 绘制
+                texture->m_bindlessIndex = ctx.m_bindlessTable->Register(texture->m_view, ctx.m_renderer->GetSampler());
+            }
+        }
+    }
+
+    Texture* TextureManager::add(std::unique_ptr<Texture> texture, Texture::Source source) {
+        texture->m_source = std::move(source);
+        texture->m_lastUsedFrame = frame_;
+        datas_.push_back(std::move(texture));
+        return datas_.back().get();
+    }
+
+    ThreadPool& TextureManager::decodePool() {
+        if (!decodePool_) {
+            decodePool_.reset(new ThreadPool(decodeThreadCount_));
+        }
+        return *decodePool_;
+    }
+
+    void TextureManager::SetDecodeThreadCount(uint32_t count) {
+        // 线程池析构时会把队列里的任务执行完, future 仍然有效
+        decodeThreadCount_ = count;
+        decodePool_.reset();
+    }
+
+    uint32_t TextureManager::GetDecodeThreadCount() {
+        return decodePool().GetThreadCount();
+    }
+
+    Texture* TextureManager::LoadAsync(const std::string& filename) {
+        TOY2D_PROFILE_FUNCTION();
+        std::unique_ptr<Texture> ptr(new Texture());
+        Texture::Source source{ Texture::SourceKind::File, filename };
+        auto future = decodePool().Submit([source]() { return decode(source); });
+
+        pending_.push_back({ ptr.get(), std::move(future) });
+        return add(std::move(ptr), std::move(source));
+    }
+
+    TextureManager::Decoded TextureManager::decode(const Texture::Source& source) {
+        TOY2D_PROFILE_SCOPE("DecodeTexture");
+        Decoded decoded;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        switch (source.kind) {
+        case Texture::SourceKind::File:
+            break;
+        case Texture::SourceKind::Ktx2File: {
+            std::string content = ReadWholeFile(source.name);
+            if (content.empty()) {
+                decoded.error = source.name + ": failed to read";
+                return decoded;
+            }
+            decoded.storage.assign(content.begin(), content.end());
+            decoded.ktx2 = decoded.storage.data();
+            decoded.ktx2Size = decoded.storage.size();
+            return decoded;
+        }
+        case Texture::SourceKind::Pack: {
+            const auto* entry = source.pack->Find(source.name);
+            if (!entry) {
+                decoded.error = "asset pack: no entry " + source.name;
+                return decoded;
+            }
+            data = source.pack->GetData(*entry);
+            size = entry->rawSize;
+            if (entry->IsCompressed()) {
+                decoded.storage.resize(entry->rawSize);
+                if (!Lz4Decompress(data, entry->size, decoded.storage.data(), entry->rawSize)) {
+                    decoded.error = "asset pack: corrupted entry " + source.name;
+                    return decoded;
+                }
+                data = decoded.storage.data();
+            }
+            if (IsKtx2(data, size)) {
+                decoded.ktx2 = data;
+                decoded.ktx2Size = size;
+                return decoded;
+            }
+            break;
+        }
+        case Texture::SourceKind::Memory:
+            decoded.error = "texture has no source to load from";
+            return decoded;
+        }
+
+        int w, h, channel;
+        stbi_uc* pixels = data ? stbi_load_from_memory(data, static_cast<int>(size), &w, &h, &channel, STBI_rgb_alpha)
+                               : stbi_load(source.name.c_str(), &w, &h, &channel, STBI_rgb_alpha);
+        if (!pixels) {
+            decoded.error = source.name + ": " + stbi_failure_reason();
+            return decoded;
+        }
+        decoded.storage.clear(); // 解压出的 PNG/JPEG 数据已经用完
+        decoded.pixels.reset(pixels, stbi_image_free);
+        decoded.w = static_cast<uint32_t>(w);
+        decoded.h = static_cast<uint32_t>(h);
+        return decoded;
+    }
+
+    size_t TextureManager::finishLoad(PendingLoad& load) {
+        Decoded decoded = load.future.get();
+        if (decoded.ktx2) {
+            try {
+                load.texture->initKtx2(ParseKtx2(decoded.ktx2, decoded.ktx2Size));
+                return decoded.ktx2Size;
+            }
+            catch (const std::runtime_error& e) {
+                decoded.error = load.texture->m_source.name + ": " + e.what();
+            }
+        }
+        if (!decoded.pixels) {
+            // 与同步加载不同, 这里没有调用方可以接住异常, 只标记失败
+            std::cout << "async texture load failed: " << decoded.error << std::endl;
+            load.texture->m_failed = true;
+            return 0;
+        }
+
+        load.texture->init(decoded.pixels.get(), decoded.w, decoded.h);
+        return static_cast<size_t>(decoded.w) * decoded.h * 4;
+    }
+
+    void TextureManager::restream(Texture& texture) {
+        texture.m_evicted = false;
+        auto future = decodePool().Submit([source = texture.m_source]() { return decode(source); });
+        pending_.push_back({ &texture, std::move(future) });
+        restreams_++;
+    }
+
+    vk::DeviceSize TextureManager::effectiveBudget() const {
+        vk::DeviceSize budget = memoryBudget_;
+        auto& ctx = Context::GetInstance();
+        if (useDeviceBudget_ && ctx.IsMemoryBudgetSupported()) {
+            auto heap = ctx.QueryDeviceLocalBudget();
+            // 驱动报告的用量包含纹理以外的资源, 这部分要从余量里扣掉; 再留 1/8 给驱动与其他进程的波动
+            vk::DeviceSize resident = 0;
+            for (const auto& texture : datas_) {
+                resident += texture->m_memorySize;
+            }
+            vk::DeviceSize others = heap.usage > resident ? heap.usage - resident : 0;
+            vk::DeviceSize usable = heap.budget - heap.budget / 8;
+            vk::DeviceSize deviceBudget = usable > others ? usable - others : 1;
+            budget = budget == 0 ? deviceBudget : std::min(budget, deviceBudget);
+        }
+        return budget;
+    }
+
+    void TextureManager::UpdateResidency(uint64_t frame, uint64_t completedFrame) {
+        frame_ = frame;
+        lastBudget_ = effectiveBudget();
+        if (lastBudget_ == 0) {
+            return;
+        }
+        TOY2D_PROFILE_FUNCTION();
+
+        vk::DeviceSize resident = 0;
+        std::vector<Texture*> candidates;
+        for (const auto& texture : datas_) {
+            if (!texture->m_image) {
+                continue;
+            }
+            resident += texture->m_memorySize;
+            // 上传还没完成的 image 仍被传输队列使用, 最近几帧用过的可能还在 GPU 上被采样
+            if (!texture->m_pinned && texture->m_source.kind != Texture::SourceKind::Memory &&
+                texture->m_lastUsedFrame <= completedFrame && texture->IsReady()) {
+                candidates.push_back(texture.get());
+            }
+        }
+        if (resident <= lastBudget_) {
+            return;
+        }
+
+        // 最久没用的先换出
+        std::sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b) {
+            return a->m_lastUsedFrame < b->m_lastUsedFrame;
+        });
+        for (Texture* texture : candidates) {
+            if (resident <= lastBudget_) {
+                break;
+            }
+            resident -= texture->m_memorySize;
+            texture->release();
+            texture->m_evicted = true;
+            evictions_++;
+        }
+    }
+
+    TextureManager::ResidencyStats TextureManager::GetResidencyStats() const {
+        ResidencyStats stats;
+        stats.budget = lastBudget_;
+        for (const auto& texture : datas_) {
+            if (texture->m_image) {
+                stats.residentBytes += texture->m_memorySize;
+                stats.residentCount++;
+            }
+            else if (texture->m_evicted) {
+                stats.evictedCount++;
+            }
+        }
+        stats.evictions = evictions_;
+        stats.restreams = restreams_;
+        return stats;
+    }
+
+    void TextureManager::Update() {
+        if (pending_.empty()) {
+            return;
+        }
+        TOY2D_PROFILE_FUNCTION();
+
+        // 按完成顺序处理, 没解码完的留在队列里, 不阻塞
+        size_t uploaded = 0;
+        auto it = pending_.begin();
+        while (it != pending_.end()) {
+            if (asyncUploadBudget_ > 0 && uploaded >= asyncUploadBudget_) {
+                break;
+            }
+            if (it->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            uploaded += finishLoad(*it);
+            it = pending_.erase(it);
+        }
+    }
+
+    void TextureManager::WaitAsyncLoads() {
+        TOY2D_PROFILE_FUNCTION();
+        for (auto& load : pending_) {
+            finishLoad(load);
+        }
+        pending_.clear();
+    }
+
     void Texture::updateDescriptorSet() {
         vk::WriteDescriptorSet writer;
         vk::DescriptorImageInfo imageInfo;
@@ -1,11 +1,16 @@
 ﻿#ifndef __TEXTURE2D_H__
 #define __TEXTURE2D_H__
 
+#include <future>
+#include <limits>
 #include <string_view>
 
 #include "vulkan/vulkan.hpp"
 #include "buffer.hpp"
 #include "descriptor_manager.hpp"
+#include "thread_pool.hpp"
+#include "ktx2.hpp"
+#include "asset_pack.hpp"
 
 
 namespace toy2d {
@@ -13,23 +18,69 @@ namespace toy2d {
     {
     public:
         Texture(std::string_view filename);
+        Texture(const void* rgba, uint32_t w, uint32_t h);
+        // 设备支持该格式时直接上传文件中的各层, 否则在 CPU 上逐层解码为 RGBA8
+        Texture(const Ktx2Image& image);
+        // 异步加载用的空纹理, 解码完成后由 TextureManager 在主线程上创建 image 并提交上传
+        Texture();
         ~Texture();
 
+        // 还没有提交上传 (仍在解码) 时 m_uploadValue 的值, 渲染器会把它当作未就绪跳过
+        static constexpr uint64_t PendingUpload = std::numeric_limits<uint64_t>::max();
+
+        // 像素已经上传完成, 可以直接绘制
+        bool IsReady() const;
+        // 异步解码失败, 这张纹理永远不会就绪
+        bool IsFailed() const { return m_failed; }
+        vk::Format GetFormat() const { return m_format; }
+        // image 占用的显存字节数 (vkGetImageMemoryRequirements, 含对齐)
+        vk::DeviceSize GetMemorySize() const { return m_memorySize; }
+        // 持有 image (可能仍在上传); 被换出或仍在解码时为 false
+        bool IsResident() const { return static_cast<bool>(m_image); }
+        // 钉住的纹理不会被换出. 从内存像素创建的纹理没有可以重新读取的来源, 总是不会被换出
+        void SetPinned(bool pinned) { m_pinned = pinned; }
+        bool IsPinned() const { return m_pinned; }
+        // 最近一次绘制它的帧号
+        uint64_t GetLastUsedFrame() const { return m_lastUsedFrame; }
+
         vk::Image m_image;
-        vk::DeviceMemory m_memory;
+        MemoryAllocator::Allocation m_allocation;
         vk::ImageView m_view;
 
         DescriptorSetManager::SetInfo m_setInfo;
+        uint32_t m_bindlessIndex; // 全局纹理表中的下标, 未开启 bindless 或表已满时无效
+        uint64_t m_uploadValue;   // 像素数据上传完成时 UploadManager 的 timeline 值
+        uint32_t m_mipLevels = 1;
     private:
-        void createImage(uint32_t w, uint32_t h);
-        void allocMemory();
+        friend class TextureManager;
+
+        // 换出后重新加载的来源
+        enum class SourceKind { Memory, File, Ktx2File, Pack };
+        struct Source {
+            SourceKind kind = SourceKind::Memory;
+            std::string name; // 文件路径或资源包条目名
+            const AssetPack* pack = nullptr;
+        };
+
+        bool m_failed = false;
+        vk::Format m_format = vk::Format::eR8G8B8A8Srgb;
+        vk::DeviceSize m_memorySize = 0;
+        Source m_source;
+        uint64_t m_lastUsedFrame = 0;
+        bool m_pinned = false;
+        bool m_evicted = false; // 已换出且还没有重新排队加载
+
+        void init(const void* rgba, uint32_t w, uint32_t h);
+        void initKtx2(const Ktx2Image& image);
+        // 创建 image 并分配显存
+        void allocateImage(uint32_t w, uint32_t h, bool blitMips);
+        // image 创建后: view, descriptor 与全局纹理表
+        void initView();
+        void createImage(uint32_t w, uint32_t h, bool blitMips);
         void createImageView();
         void updateDescriptorSet();
-
-        void transitionImageLayoutFromUndefine2Dst();
-        void transitionImageLayoutFromDst2Optimal();
-        void transformData2Image(Buffer&, uint32_t w, uint32_t h);
-
+        // 销毁 image, view, descriptor 与全局纹理表中的槽位, 回到未就绪状态; 析构与换出共用
+        void release();
     };
 
     class TextureManager final {
@@ -43,18 +94,108 @@ namespace toy2d {
 
         Texture* Load(const std::string& filename){
             std::unique_ptr<Texture> ptr(new Texture(filename));
-            datas_.push_back(std::move(ptr));
-            return datas_.back().get();
+            return add(std::move(ptr), { Texture::SourceKind::File, filename });
         }
+        Texture* LoadFromMemory(const void* rgba, uint32_t w, uint32_t h) {
+            std::unique_ptr<Texture> ptr(new Texture(rgba, w, h));
+            return add(std::move(ptr), {});
+        }
+        // 读取 KTX2 文件, 压缩数据直接上传, 不支持的格式在 CPU 上解码
+        Texture* LoadKtx2(const std::string& filename);
+        // 同一张图的多个编码 (如 BC7/ETC2/ASTC 各一份), 只读文件头,
+        // 加载第一个设备能直接采样的文件; 都不支持时加载第一个有 CPU 解码器的文件
+        Texture* LoadKtx2Variants(const std::vector<std::string>& candidates);
+        // 资源包中的 KTX2 或 PNG/JPEG: 未压缩的条目直接从映射内存解析, KTX2 的各层从映射拷进暂存 buffer;
+        // 没有该条目时抛出 std::runtime_error. 换出后会从同一个资源包重新加载, 资源包要比纹理活得久
+        Texture* LoadFromPack(const AssetPack& pack, const std::string& name);
+        // 立即返回未就绪的纹理, 文件读取与解码在解码线程池中进行;
+        // 解码完成的纹理在 Update 中创建 image 并放进当前上传批次, 上传完成后 IsReady 变为 true
+        Texture* LoadAsync(const std::string& filename);
+        // 主线程调用, Renderer::StartRender 会自动调用: 处理已经解码完成的纹理,
+        // 一次最多提交 asyncUploadBudget_ 字节的像素, 剩下的留到下一次, 避免单帧卡顿
+        void Update();
+        // 阻塞到所有异步加载都已解码并提交上传 (不等待上传本身完成)
+        void WaitAsyncLoads();
+        size_t GetPendingCount() const { return pending_.size(); }
+        // 每次 Update 最多提交的像素字节数, 0 表示不限制
+        void SetAsyncUploadBudget(size_t bytes) { asyncUploadBudget_ = bytes; }
+        // 之后创建的纹理是否生成完整的 mip 链, 默认开启; 格式不支持线性 blit 时在 CPU 上生成
+        void SetGenerateMips(bool enable) { generateMips_ = enable; }
+        bool IsGenerateMips() const { return generateMips_; }
+        // 采样器改变后给所有纹理换新的 set 与 bindless 下标, 旧的推迟到引用它们的帧结束后归还
+        void RefreshSamplers();
+        // 解码线程数, 0 表示 hardware_concurrency; 会等待正在进行的解码
+        void SetDecodeThreadCount(uint32_t count);
+        uint32_t GetDecodeThreadCount();
+        // 立即从管理器中移除, 句柄在用过它的帧结束后由删除队列销毁, 不会让设备空闲
         void Destroy(Texture* texture);
 
-        void Clear() {
-            datas_.clear();
+        // 纹理显存预算, 超出时按最近最少使用的顺序换出纹理; 0 表示不限制 (默认)
+        void SetMemoryBudget(vk::DeviceSize bytes) { memoryBudget_ = bytes; }
+        vk::DeviceSize GetMemoryBudget() const { return memoryBudget_; }
+        // 同时受 VK_EXT_memory_budget 报告的 device local 余量限制, 设备不支持该扩展时忽略
+        void SetUseDeviceMemoryBudget(bool enable) { useDeviceBudget_ = enable; }
+        // 渲染器绘制纹理时调用: 记录帧号, 已经换出的纹理重新排队异步加载, 就绪之前用占位图代替
+        void Touch(Texture& texture, uint64_t frame) {
+            texture.m_lastUsedFrame = frame;
+            if (texture.m_evicted) {
+                restream(texture);
+            }
         }
+        // 主线程调用, Renderer::StartRender 在 Update 之后自动调用. frame 为即将录制的帧号,
+        // completedFrame 为 GPU 已经执行完的最大帧号, 只被这些帧用过的纹理才会换出
+        void UpdateResidency(uint64_t frame, uint64_t completedFrame);
+
+        struct ResidencyStats {
+            vk::DeviceSize budget = 0;        // 最近一次 UpdateResidency 生效的预算, 0 表示不限制
+            vk::DeviceSize residentBytes = 0; // 所有持有 image 的纹理
+            uint32_t residentCount = 0;
+            uint32_t evictedCount = 0;        // 当前处于换出状态的纹理
+            uint64_t evictions = 0;           // 累计
+            uint64_t restreams = 0;           // 累计
+        };
+        ResidencyStats GetResidencyStats() const;
+
+        void Clear();
 
     private:
+        // 解码结果, pixels 由 stbi_image_free 释放; KTX2 来源只读出文件, 在主线程上解析
+        struct Decoded {
+            std::shared_ptr<unsigned char> pixels;
+            uint32_t w = 0;
+            uint32_t h = 0;
+            std::vector<uint8_t> storage; // 读出或解压的文件内容; 资源包里未压缩的 KTX2 直接指向映射, 这里为空
+            const uint8_t* ktx2 = nullptr; // 指向 storage 或映射
+            size_t ktx2Size = 0;
+            std::string error;
+        };
+        struct PendingLoad {
+            Texture* texture;
+            std::future<Decoded> future;
+        };
+
+        Texture* add(std::unique_ptr<Texture> texture, Texture::Source source);
+        ThreadPool& decodePool();
+        // 工作线程上执行, 只读文件与解码, 不碰任何 vulkan 对象与分配器
+        static Decoded decode(const Texture::Source& source);
+        void restream(Texture& texture);
+        vk::DeviceSize effectiveBudget() const;
+        // 返回提交的像素字节数
+        size_t finishLoad(PendingLoad& load);
+
         static std::unique_ptr<TextureManager> instance_;
         std::vector<std::unique_ptr<Texture>> datas_;
+        std::unique_ptr<ThreadPool> decodePool_; // 第一次异步加载时才创建
+        uint32_t decodeThreadCount_ = 0;
+        std::vector<PendingLoad> pending_; // 按加载顺序排列
+        size_t asyncUploadBudget_ = 64 * 1024 * 1024;
+        bool generateMips_ = true;
+        vk::DeviceSize memoryBudget_ = 0;
+        bool useDeviceBudget_ = false;
+        vk::DeviceSize lastBudget_ = 0;
+        uint64_t frame_ = 0; // 新建的纹理从这一帧开始计算闲置
+        uint64_t evictions_ = 0;
+        uint64_t restreams_ = 0;
     };
 }
 
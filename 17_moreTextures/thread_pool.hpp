@@ -0,0 +1,53 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace toy2d {
+
+/**
+ * @brief 固定线程数的任务池
+ * Submit 返回 std::future, 任务中抛出的异常会在 future.get() 时重新抛出
+ */
+class ThreadPool final
+{
+public:
+    // threadCount 为 0 时使用 hardware_concurrency
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    template <typename Func>
+    auto Submit(Func&& func) -> std::future<decltype(func())> {
+        using Result = decltype(func());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace([task]() { (*task)(); });
+        }
+        m_cond.notify_one();
+        return future;
+    }
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop;
+};
+
+}
+
+#endif // __THREAD_POOL_H__
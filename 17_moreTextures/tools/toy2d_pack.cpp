@@ -0,0 +1,123 @@
+/**
+ * toy2d_pack: 把文件/目录打成 AssetPack 资源包, 或列出资源包的内容
+ *
+ * 用法: toy2d_pack -o OUT.pack [--root DIR] [--lz4] PATH...
+ *       toy2d_pack --list IN.pack
+ *
+ *   PATH   - 文件或目录 (递归), 条目名为相对 --root (默认当前目录) 的路径, 分隔符统一为 '/'
+ *   --lz4  - 每个条目都尝试 LZ4 压缩, 没有变小的 (PNG/JPEG/块压缩纹理通常如此) 仍然原样存放;
+ *            原样存放的条目在运行时可以零拷贝读取, 着色器之类的小文件才值得压缩
+ *
+ * 引擎按 "bin/vert.spv", "resources/role.png" 这样的名字查找, 在项目根目录下执行
+ * toy2d_pack -o assets.pack bin resources 即可
+ */
+
+#include "asset_pack.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<uint8_t> ReadFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to read " + path.string());
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+int List(const std::string& path) {
+    toy2d::AssetPack pack(path);
+    for (const auto& entry : pack) {
+        std::cout << pack.GetName(entry) << "\t" << entry.rawSize << "\t" << entry.size
+                  << (entry.IsCompressed() ? "\tlz4" : "") << "\n";
+    }
+    std::cout << pack.GetEntryCount() << " entries" << std::endl;
+    return 0;
+}
+
+int Usage() {
+    std::cerr << "usage: toy2d_pack -o OUT.pack [--root DIR] [--lz4] PATH...\n"
+                 "       toy2d_pack --list IN.pack" << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string out;
+    fs::path root = fs::current_path();
+    bool lz4 = false;
+    std::vector<fs::path> inputs;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--list") {
+                return List(next());
+            }
+            else if (arg == "-o") {
+                out = next();
+            }
+            else if (arg == "--root") {
+                root = next();
+            }
+            else if (arg == "--lz4") {
+                lz4 = true;
+            }
+            else if (!arg.empty() && arg[0] == '-') {
+                return Usage();
+            }
+            else {
+                inputs.push_back(arg);
+            }
+        }
+        if (out.empty() || inputs.empty()) {
+            return Usage();
+        }
+
+        // 目录展开后按名字排序, 同样的输入总是得到同样的包
+        std::vector<fs::path> files;
+        for (const auto& input : inputs) {
+            if (fs::is_directory(input)) {
+                for (const auto& item : fs::recursive_directory_iterator(input)) {
+                    if (item.is_regular_file()) {
+                        files.push_back(item.path());
+                    }
+                }
+            }
+            else {
+                files.push_back(input);
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        toy2d::AssetPackWriter writer;
+        for (const auto& file : files) {
+            std::string name = fs::relative(fs::absolute(file), fs::absolute(root)).generic_string();
+            writer.Add(name, ReadFile(file), lz4);
+        }
+        writer.Write(out);
+
+        auto stats = writer.GetStats();
+        std::cout << files.size() << " entries, " << stats.rawBytes << " bytes -> " << stats.storedBytes
+                  << " bytes, written to " << out << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -2,32 +2,103 @@
 #include "context.h"
 #include "shader.hpp"
 #include "descriptor_manager.hpp"
+#include "profiler.hpp"
 
 namespace toy2d{
-    void Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func, const int w, const int h)
+    namespace {
+        std::unique_ptr<AssetPack> mountedPack;
+
+        // SPIR-V 字节码: 资源包里未压缩的条目直接引用映射内存, 其余情况读进 storage
+        struct ShaderBinary {
+            std::string storage;
+            std::string_view view;
+
+            std::string_view Code() const { return storage.empty() ? view : std::string_view(storage); }
+        };
+
+        ShaderBinary LoadShaderBinary(const std::string& name) {
+            ShaderBinary binary;
+            const AssetPack::Entry* entry = mountedPack ? mountedPack->Find("bin/" + name) : nullptr;
+            if (!entry) {
+                binary.storage = ReadWholeFile(S_PATH("./bin/") + name);
+            }
+            else if (entry->IsCompressed()) {
+                binary.storage.resize(entry->rawSize);
+                mountedPack->Read(*entry, binary.storage.data());
+            }
+            else {
+                binary.view = std::string_view(reinterpret_cast<const char*>(mountedPack->GetData(*entry)), entry->size);
+            }
+            return binary;
+        }
+    }
+
+    void SetPreferredDevice(const std::string& name)
+    {
+        Context::SetPreferredDevice(name);
+    }
+
+    void Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func, const int w, const int h,
+              int framesInFlight)
     {
+        TOY2D_PROFILE_SCOPE("toy2d::Init");
         Context::Init(extensions, func);
         auto& ctx = Context::GetInstance();
-        ctx.InitSwapchain(w, h);
-        ctx.initShaderModules(ReadWholeFile(S_PATH("./bin/vert.spv")), ReadWholeFile(S_PATH("./bin/frag.spv")));
+        ctx.InitMemoryAllocator();
+        ctx.InitPipelineCache(S_PATH("./bin/pipeline_cache.bin"));
+
+        // 每帧的资源按槽位分配, 槽位数取上限, 运行时改变飞行帧数不需要重建
+        int maxFlightCount = FrameScheduler::MaxFramesInFlight;
+        if (ctx.IsHeadless()) {
+            ctx.InitRenderTarget(w, h, maxFlightCount);
+        }
+        else {
+            ctx.InitSwapchain(w, h);
+        }
+        ctx.initShaderModules(LoadShaderBinary("vert.spv").Code(), LoadShaderBinary("frag.spv").Code());
+        ctx.initSpriteShaderModules(LoadShaderBinary("sprite_vert.spv").Code(), LoadShaderBinary("sprite_frag.spv").Code());
+        ctx.initCullShaderModule(LoadShaderBinary("sprite_cull_comp.spv").Code());
+        ctx.initPostShaderModules(LoadShaderBinary("post_blur_vert.spv").Code(), LoadShaderBinary("post_blur_frag.spv").Code());
+        if (ctx.IsBindlessSupported()) {
+            ctx.initBindlessShaderModules(LoadShaderBinary("sprite_bindless_vert.spv").Code(),
+                                          LoadShaderBinary("sprite_bindless_frag.spv").Code());
+            ctx.InitBindlessTable();
+        }
         ctx.initRenderProcess();
         //ctx.m_renderProcess->InitLayout();
         //ctx.m_renderProcess->InitRenderPass();
-        ctx.m_swapchain->createFramebuffers(w, h);
+        if (ctx.IsHeadless()) {
+            ctx.m_renderTarget->createFramebuffers();
+        }
+        else {
+            ctx.m_swapchain->createFramebuffers(w, h);
+        }
         ctx.initGraphicsPipeline();
         ctx.InitCommandPool();
+        ctx.InitUploadManager();
 
-        int maxFlightCount = 2;
         DescriptorSetManager::Init(maxFlightCount);
-        ctx.InitRenderer(maxFlightCount);
+        ctx.InitRenderer(framesInFlight);
         Context::GetInstance().m_renderer->SetProject(w, 0, 0, h, -1, 1);
     }
 
+    void InitHeadless(const int w, const int h, int framesInFlight)
+    {
+        Init({}, nullptr, w, h, framesInFlight);
+    }
+
     void Quit()
     {
-        Context::GetInstance().GetDevice().waitIdle(); // 让 cpu 等待所有操作完成
-        Context::GetInstance().DestroyRenderer();
+        auto& ctx = Context::GetInstance();
+        TextureManager::Instance().Clear();
+        ctx.m_uploadManager->Flush(); // 删除队列里的纹理可能还有没提交的上传
+        ctx.GetDevice().waitIdle(); // 让 cpu 等待所有操作完成
+        // 纹理依赖 descriptor 管理器与 bindless 表, 需要在它们之前销毁
+        ctx.m_deletionQueue->Flush();
+        ctx.DestroyRenderer();
+        DescriptorSetManager::Quit();
         Context::Quit();
+        mountedPack.reset();
     }
 
     Renderer& GetRenderer() {
@@ -37,4 +108,43 @@ namespace toy2d{
     Texture* LoadTexture(const std::string& filename) {
         return TextureManager::Instance().Load(filename);
     }
+
+    Texture* LoadTextureFromMemory(const void* rgba, uint32_t w, uint32_t h) {
+        return TextureManager::Instance().LoadFromMemory(rgba, w, h);
+    }
+
+    Texture* LoadTextureAsync(const std::string& filename) {
+        return TextureManager::Instance().LoadAsync(filename);
+    }
+
+    Texture* LoadTextureKtx2(const std::string& filename) {
+        return TextureManager::Instance().LoadKtx2(filename);
+    }
+
+    void MountAssetPack(const std::string& path) {
+        mountedPack = std::make_unique<AssetPack>(path);
+    }
+
+    AssetPack* GetAssetPack() {
+        return mountedPack.get();
+    }
+
+    Texture* LoadTextureFromPack(const std::string& name) {
+        if (!mountedPack) {
+            throw std::runtime_error("no asset pack mounted");
+        }
+        return TextureManager::Instance().LoadFromPack(*mountedPack, name);
+    }
+
+    MemoryAllocator::Stats GetMemoryStats() {
+        return Context::GetInstance().m_memoryAllocator->GetStats();
+    }
+
+    DescriptorSetManager::Stats GetDescriptorStats() {
+        return DescriptorSetManager::GetInstance().GetStats();
+    }
+
+    PipelineCache::Stats GetPipelineStats() {
+        return Context::GetInstance().m_renderProcess->GetPipelineCache().GetStats();
+    }
 }
\ No newline at end of file
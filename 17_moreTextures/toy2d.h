@@ -6,13 +6,39 @@
 #include "vulkan/vulkan.hpp"
 #include "tools.hpp"
 #include "renderer.hpp"
+#include "memory_allocator.hpp"
+#include "asset_pack.hpp"
 
 namespace toy2d
 {
-    void Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func, const int w, const int h);
+    // 在 Init 之前调用, 规则见 Context::SetPreferredDevice
+    void SetPreferredDevice(const std::string& name);
+    // framesInFlight 为初始的飞行帧数 (1~4), 之后可以用 Renderer::SetFramesInFlight 修改
+    void Init(const std::vector<const char*>& extensions, CreateSurfaceFunc func, const int w, const int h,
+              int framesInFlight = 2);
+    // 无窗口模式 (CI, 服务器渲染): 不需要 SDL, 结果通过 Renderer::ReadbackFrame 取回
+    void InitHeadless(const int w, const int h, int framesInFlight = 2);
     void Quit();
     Renderer& GetRenderer();
     Texture* LoadTexture(const std::string& filename);
+    // 已解码的 RGBA8 像素, 每行紧密排列; 数据在返回前已拷进暂存 buffer
+    Texture* LoadTextureFromMemory(const void* rgba, uint32_t w, uint32_t h);
+    // 立即返回, 解码在后台线程中进行, Texture::IsReady 之前的绘制会被跳过或用占位图代替
+    Texture* LoadTextureAsync(const std::string& filename);
+    // KTX2 块压缩纹理 (BC/ETC2/ASTC), 带 mip 链时直接上传; 设备不支持该格式时在 CPU 上解码
+    Texture* LoadTextureKtx2(const std::string& filename);
+    // 挂载资源包 (只读映射整个文件), 在 Init 之前调用时内置着色器也从包里的 bin/*.spv 读取;
+    // 包在 Quit 时卸载. 打包工具见 tools/toy2d_pack.cpp
+    void MountAssetPack(const std::string& path);
+    // 没有挂载时为 nullptr
+    AssetPack* GetAssetPack();
+    // 从挂载的资源包按条目名加载, 如 "resources/role.png"
+    Texture* LoadTextureFromPack(const std::string& name);
+    MemoryAllocator::Stats GetMemoryStats();
+    // 纹理 set 与帧内临时 set 的数量和池数
+    DescriptorSetManager::Stats GetDescriptorStats();
+    // 管线排列的数量, 命中与编译次数, 以及等待后台编译的次数
+    PipelineCache::Stats GetPipelineStats();
 }
 
 #endif // __TOY2D_H__
@@ -0,0 +1,367 @@
+#include "upload_manager.hpp"
+#include "context.h"
+#include <algorithm>
+#include <array>
+
+namespace toy2d {
+
+namespace {
+
+// 所有层都处于 eTransferDstOptimal 且第 0 层已写入, 逐级 blit, 结束时所有层为 eShaderReadOnlyOptimal
+void RecordMipBlits(vk::CommandBuffer cmd, vk::Image image, uint32_t w, uint32_t h, uint32_t levels) {
+    vk::ImageMemoryBarrier barrier;
+    barrier.setImage(image)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+    int32_t srcW = static_cast<int32_t>(w);
+    int32_t srcH = static_cast<int32_t>(h);
+    for (uint32_t i = 1; i < levels; i++) {
+        // 上一层写完后转为 blit 源
+        barrier.subresourceRange.setBaseMipLevel(i - 1);
+        barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+            {}, nullptr, nullptr, barrier);
+
+        int32_t dstW = std::max(srcW / 2, 1);
+        int32_t dstH = std::max(srcH / 2, 1);
+        vk::ImageBlit blit;
+        blit.setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1, 0, 1))
+            .setSrcOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(srcW, srcH, 1) })
+            .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1))
+            .setDstOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(dstW, dstH, 1) });
+        cmd.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal,
+            blit, vk::Filter::eLinear);
+        srcW = dstW;
+        srcH = dstH;
+    }
+
+    // 前 levels - 1 层是 blit 源, 最后一层刚被写入
+    std::array<vk::ImageMemoryBarrier, 2> toRead = { barrier, barrier };
+    toRead[0].setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+        .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, levels - 1, 0, 1));
+    toRead[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+        .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, levels - 1, 1, 0, 1));
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+        {}, nullptr, nullptr, toRead);
+}
+
+}
+
+UploadManager::UploadManager() : m_nextValue(1), m_completedValue(0), m_acquiredValue(0) {
+    auto& ctx = Context::GetInstance();
+    auto& indices = ctx.GetQueueFamilyIndices();
+    m_transferFamily = indices.transferQueue.value();
+    m_graphicsFamily = indices.grapghicsQueue.value();
+    m_cmdManager = std::make_unique<CommandManager>(m_transferFamily);
+
+    m_timeline = nullptr;
+    if (ctx.IsTimelineSupported()) {
+        vk::SemaphoreTypeCreateInfo typeInfo;
+        typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline)
+            .setInitialValue(0);
+        vk::SemaphoreCreateInfo createInfo;
+        createInfo.setPNext(&typeInfo);
+        m_timeline = ctx.GetDevice().createSemaphore(createInfo);
+    }
+
+    m_current.cmd = nullptr;
+    m_current.value = m_nextValue;
+}
+
+UploadManager::~UploadManager() {
+    auto& device = Context::GetInstance().GetDevice();
+
+    Flush();
+    if (m_timeline) {
+        uint64_t value = m_nextValue - 1;
+        vk::SemaphoreWaitInfo waitInfo;
+        waitInfo.setSemaphores(m_timeline)
+            .setValues(value);
+        (void)device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max());
+    }
+    m_completedValue = m_nextValue - 1;
+    Collect();
+
+    m_cmdManager.reset();
+    device.destroySemaphore(m_timeline);
+}
+
+vk::CommandBuffer UploadManager::currentCmd() {
+    if (!m_current.cmd) {
+        m_current.cmd = m_cmdManager->CreateOneCommandBuffer();
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        m_current.cmd.begin(beginInfo);
+    }
+    return m_current.cmd;
+}
+
+Buffer* UploadManager::createStaging(const void* data, vk::DeviceSize size) {
+    std::unique_ptr<Buffer> staging(new Buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+    memcpy(staging->m_map, data, size);
+    m_current.stagings.push_back(std::move(staging));
+    return m_current.stagings.back().get();
+}
+
+uint64_t UploadManager::UploadBuffer(const void* data, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset) {
+    auto* staging = createStaging(data, size);
+    auto cmd = currentCmd();
+
+    vk::BufferCopy region;
+    region.setSize(size)
+        .setSrcOffset(0)
+        .setDstOffset(dstOffset);
+    cmd.copyBuffer(staging->m_buffer, dst, region);
+
+    vk::BufferMemoryBarrier barrier;
+    barrier.setBuffer(dst)
+        .setOffset(dstOffset)
+        .setSize(size)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+
+    if (m_transferFamily != m_graphicsFamily) {
+        // release: 把所有权交给图形队列族, 对应的 acquire 在 AcquirePending 中记录
+        barrier.setSrcQueueFamilyIndex(m_transferFamily)
+            .setDstQueueFamilyIndex(m_graphicsFamily);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+            {}, nullptr, barrier, nullptr);
+
+        barrier.setSrcAccessMask({})
+            .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead |
+                vk::AccessFlagBits::eUniformRead);
+        m_pendingAcquire.bufferBarriers.push_back(barrier);
+    }
+    else {
+        barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead |
+                vk::AccessFlagBits::eUniformRead);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader,
+            {}, nullptr, barrier, nullptr);
+    }
+
+    return m_current.value;
+}
+
+uint64_t UploadManager::UploadImage(const void* pixels, vk::DeviceSize size, vk::Image image, uint32_t w, uint32_t h,
+                                   uint32_t levels, bool generateMips) {
+    bool blit = generateMips && levels > 1;
+
+    // 每层数据在暂存 buffer 中紧密排列; blit 模式只拷第 0 层
+    std::vector<ImageLevel> regions;
+    vk::DeviceSize offset = 0;
+    for (uint32_t i = 0; i < (blit ? 1 : levels); i++) {
+        uint32_t levelW = std::max(w >> i, 1u);
+        uint32_t levelH = std::max(h >> i, 1u);
+        regions.push_back({ offset, levelW, levelH });
+        offset += static_cast<vk::DeviceSize>(levelW) * levelH * 4;
+    }
+    return uploadImage(pixels, size, image, regions, levels, blit);
+}
+
+uint64_t UploadManager::UploadImageLevels(const void* data, vk::DeviceSize size, vk::Image image,
+                                         const std::vector<ImageLevel>& levels) {
+    return uploadImage(data, size, image, levels, static_cast<uint32_t>(levels.size()), false);
+}
+
+uint64_t UploadManager::uploadImage(const void* data, vk::DeviceSize size, vk::Image image,
+                                   const std::vector<ImageLevel>& levelRegions, uint32_t levels, bool blit) {
+    auto* staging = createStaging(data, size);
+    auto cmd = currentCmd();
+    const uint32_t w = levelRegions[0].w;
+    const uint32_t h = levelRegions[0].h;
+
+    vk::ImageSubresourceRange range;
+    range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseMipLevel(0)
+        .setLevelCount(levels)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1);
+
+    vk::ImageMemoryBarrier toDst;
+    toDst.setImage(image)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setSubresourceRange(range);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+        {}, nullptr, nullptr, toDst);
+
+    // 每层一个拷贝区域
+    std::vector<vk::BufferImageCopy> regions;
+    for (uint32_t i = 0; i < levelRegions.size(); i++) {
+        vk::ImageSubresourceLayers subsource;
+        subsource.setAspectMask(vk::ImageAspectFlagBits::eColor)
+            .setBaseArrayLayer(0)
+            .setMipLevel(i)
+            .setLayerCount(1);
+        vk::BufferImageCopy region;
+        region.setBufferImageHeight(0)
+            .setBufferOffset(levelRegions[i].offset)
+            .setImageOffset(0)
+            .setImageExtent({ levelRegions[i].w, levelRegions[i].h, 1 })
+            .setBufferRowLength(0)
+            .setImageSubresource(subsource);
+        regions.push_back(region);
+    }
+    cmd.copyBufferToImage(staging->m_buffer, image, vk::ImageLayout::eTransferDstOptimal, regions);
+
+    if (blit) {
+        if (m_transferFamily == m_graphicsFamily) {
+            RecordMipBlits(cmd, image, w, h, levels);
+        }
+        else {
+            // 传输队列不一定支持 blit: 保持 eTransferDstOptimal 把所有层交给图形队列, 在那边生成
+            vk::ImageMemoryBarrier release = toDst;
+            release.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                .setDstAccessMask({})
+                .setSrcQueueFamilyIndex(m_transferFamily)
+                .setDstQueueFamilyIndex(m_graphicsFamily);
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                {}, nullptr, nullptr, release);
+
+            release.setSrcAccessMask({})
+                .setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+            m_pendingAcquire.mipBarriers.push_back(release);
+            m_pendingAcquire.mipJobs.push_back({ image, w, h, levels });
+        }
+        return m_current.value;
+    }
+
+    vk::ImageMemoryBarrier toRead;
+    toRead.setImage(image)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setSubresourceRange(range);
+
+    if (m_transferFamily != m_graphicsFamily) {
+        // release 与 acquire 两边的 layout 转换必须一致
+        toRead.setSrcQueueFamilyIndex(m_transferFamily)
+            .setDstQueueFamilyIndex(m_graphicsFamily);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+            {}, nullptr, nullptr, toRead);
+
+        toRead.setSrcAccessMask({})
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        m_pendingAcquire.imageBarriers.push_back(toRead);
+    }
+    else {
+        toRead.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+            {}, nullptr, nullptr, toRead);
+    }
+
+    return m_current.value;
+}
+
+bool UploadManager::CanBlitMips(vk::Format format) const {
+    auto features = Context::GetInstance().GetPhyDevice().getFormatProperties(format).optimalTilingFeatures;
+    auto required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst |
+        vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (features & required) == required;
+}
+
+void UploadManager::Flush() {
+    if (!m_current.cmd) {
+        return;
+    }
+
+    auto& ctx = Context::GetInstance();
+    m_current.cmd.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(m_current.cmd);
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    if (m_timeline) {
+        timelineInfo.setSignalSemaphoreValues(m_current.value);
+        submitInfo.setSignalSemaphores(m_timeline)
+            .setPNext(&timelineInfo);
+    }
+    ctx.m_transferQueue.submit(submitInfo);
+
+    if (!m_timeline) {
+        // 不支持 timeline semaphore 时退化为同步上传
+        ctx.m_transferQueue.waitIdle();
+        m_completedValue = m_current.value;
+    }
+
+    if (m_transferFamily != m_graphicsFamily) {
+        m_pendingAcquire.value = m_current.value;
+    }
+    else {
+        m_acquiredValue = m_current.value;
+    }
+
+    m_inFlight.push_back(std::move(m_current));
+    m_current = Batch{};
+    m_current.cmd = nullptr;
+    m_current.value = ++m_nextValue;
+}
+
+uint64_t UploadManager::AcquirePending(vk::CommandBuffer cmd) {
+    if (m_pendingAcquire.bufferBarriers.empty() && m_pendingAcquire.imageBarriers.empty() &&
+        m_pendingAcquire.mipJobs.empty()) {
+        return 0;
+    }
+
+    // acquire 的 src stage 需要落在 semaphore 等待的 stage 内, 这里两边都用 eAllCommands
+    if (!m_pendingAcquire.bufferBarriers.empty() || !m_pendingAcquire.imageBarriers.empty()) {
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+            vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader |
+                vk::PipelineStageFlagBits::eFragmentShader,
+            {}, nullptr, m_pendingAcquire.bufferBarriers, m_pendingAcquire.imageBarriers);
+    }
+    if (!m_pendingAcquire.mipJobs.empty()) {
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+            {}, nullptr, nullptr, m_pendingAcquire.mipBarriers);
+        for (const auto& job : m_pendingAcquire.mipJobs) {
+            RecordMipBlits(cmd, job.image, job.w, job.h, job.levels);
+        }
+    }
+
+    uint64_t value = m_pendingAcquire.value;
+    m_acquiredValue = std::max(m_acquiredValue, value);
+    m_pendingAcquire = PendingAcquire{};
+
+    return IsComplete(value) ? 0 : value;
+}
+
+void UploadManager::Collect() {
+    while (!m_inFlight.empty() && IsComplete(m_inFlight.front().value)) {
+        m_cmdManager->FreeCmd(m_inFlight.front().cmd);
+        m_inFlight.pop_front();
+    }
+}
+
+bool UploadManager::IsComplete(uint64_t value) {
+    if (value <= m_completedValue) {
+        return true;
+    }
+    if (!m_timeline) {
+        return false;
+    }
+
+    m_completedValue = Context::GetInstance().GetDevice().getSemaphoreCounterValue(m_timeline);
+    return value <= m_completedValue;
+}
+
+}
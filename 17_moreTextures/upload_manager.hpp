@@ -0,0 +1,105 @@
+#ifndef __UPLOAD_MANAGER_H__
+#define __UPLOAD_MANAGER_H__
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "buffer.hpp"
+#include "command_manager.hpp"
+
+namespace toy2d {
+
+/**
+ * @brief 异步上传管理
+ * buffer/image 的拷贝先记录到传输队列的命令里, 攒成一批统一提交, 完成时 signal 一个 timeline semaphore.
+ * 每次上传返回这一批的 timeline 值, 渲染器第一次用到该资源时才在提交里等待这个值.
+ * 传输队列族与图形队列族不同时, 在这里做 release, 在帧开头 AcquirePending 时做 acquire.
+ */
+class UploadManager final
+{
+public:
+    UploadManager();
+    ~UploadManager();
+
+    // 返回值: 上传完成时 timeline semaphore 的值
+    uint64_t UploadBuffer(const void* data, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset);
+    // 整张 image 从 undefined 上传, 完成后所有 mip 层都为 eShaderReadOnlyOptimal.
+    // generateMips 为 false 时 pixels 为 levels 层紧密排列的数据; 为 true 时只有第 0 层,
+    // 其余各层用线性 blit 逐级生成 (需要 CanBlitMips 且 image 带 eTransferSrc),
+    // 传输队列族独立时 blit 推迟到图形队列的 AcquirePending 中录制
+    uint64_t UploadImage(const void* pixels, vk::DeviceSize size, vk::Image image, uint32_t w, uint32_t h,
+                         uint32_t levels = 1, bool generateMips = false);
+    // 一层在暂存数据中的位置, 压缩格式的层大小按块计算, 所以由调用方给出
+    struct ImageLevel {
+        vk::DeviceSize offset;
+        uint32_t w;
+        uint32_t h;
+    };
+    // 已经准备好的完整 mip 链 (如 KTX2 中的块压缩数据), levels[i] 写入第 i 层, 不生成 mip
+    uint64_t UploadImageLevels(const void* data, vk::DeviceSize size, vk::Image image,
+                               const std::vector<ImageLevel>& levels);
+    // 该格式的 optimal tiling 是否支持 blit 与线性过滤
+    bool CanBlitMips(vk::Format format) const;
+
+    // 提交当前攒下的上传, 没有上传时什么都不做
+    void Flush();
+    // 在图形队列的帧命令 (render pass 之外) 中完成已提交批次的所有权转移,
+    // 返回这一帧必须等待的 timeline 值, 0 表示不需要等待
+    uint64_t AcquirePending(vk::CommandBuffer cmd);
+    // 释放已经完成的批次的暂存 buffer 与命令
+    void Collect();
+
+    bool IsComplete(uint64_t value);
+    // 已经可以在图形队列上使用的最大 timeline 值
+    uint64_t GetAcquiredValue() const { return m_acquiredValue; }
+    vk::Semaphore GetSemaphore() const { return m_timeline; }
+    // 当前是否在使用 timeline semaphore, 不支持时每批提交后同步等待
+    bool IsAsync() const { return static_cast<bool>(m_timeline); }
+
+private:
+    struct Batch {
+        vk::CommandBuffer cmd;
+        std::vector<std::unique_ptr<Buffer>> stagings;
+        uint64_t value;
+    };
+
+    struct MipJob {
+        vk::Image image;
+        uint32_t w;
+        uint32_t h;
+        uint32_t levels;
+    };
+
+    struct PendingAcquire {
+        std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+        std::vector<vk::ImageMemoryBarrier> imageBarriers;
+        // 需要在图形队列上 blit 生成 mip 的 image, 所有层 acquire 后都是 eTransferDstOptimal
+        std::vector<vk::ImageMemoryBarrier> mipBarriers;
+        std::vector<MipJob> mipJobs;
+        uint64_t value = 0;
+    };
+
+    vk::CommandBuffer currentCmd();
+    Buffer* createStaging(const void* data, vk::DeviceSize size);
+    // regions 写入前 regions.size() 层, blit 为 true 时其余层由第 0 层逐级生成
+    uint64_t uploadImage(const void* data, vk::DeviceSize size, vk::Image image,
+                         const std::vector<ImageLevel>& regions, uint32_t levels, bool blit);
+
+    std::unique_ptr<CommandManager> m_cmdManager; // 传输队列族的命令池
+    vk::Semaphore m_timeline;
+    uint32_t m_transferFamily;
+    uint32_t m_graphicsFamily;
+
+    Batch m_current;             // 正在记录的批次, cmd 为空表示没有待提交的上传
+    std::deque<Batch> m_inFlight; // 已提交未完成的批次
+    PendingAcquire m_pendingAcquire; // 已 release, 等待在图形队列上 acquire 的资源
+
+    uint64_t m_nextValue;      // 当前批次提交后会 signal 的值
+    uint64_t m_completedValue; // 已知完成的值, 避免每次都查询 semaphore
+    uint64_t m_acquiredValue;
+};
+
+}
+
+#endif // __UPLOAD_MANAGER_H__